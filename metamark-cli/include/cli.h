@@ -1,6 +1,7 @@
 #ifndef METAMARK_CLI_H
 #define METAMARK_CLI_H
 
+#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "metamark.h"
@@ -23,6 +24,11 @@ int handle_rollback(int argc, char *argv[]);
 int handle_export(int argc, char *argv[]);
 int handle_sign(int argc, char *argv[]);
 int handle_verify(int argc, char *argv[]);
+int handle_seal(int argc, char *argv[]);
+int handle_reveal(int argc, char *argv[]);
+int handle_index(int argc, char *argv[]);
+int handle_search(int argc, char *argv[]);
+int handle_log(int argc, char *argv[]);
 int handle_version(int argc, char *argv[]);
 int handle_help(int argc, char *argv[]);
 
@@ -35,18 +41,112 @@ void print_success(const char *message);
 int read_file_content(const char *filename, char **content, size_t *size);
 int write_file_content(const char *filename, const char *content, size_t size);
 
+// Path collection
+typedef struct {
+    char **items;     // Collected file paths
+    size_t count;     // Number of paths
+    size_t capacity;  // Allocated slots in items
+} PathList;
+
+int path_list_add(PathList *list, const char *arg);
+void path_list_free(PathList *list);
+
 // Export functions
-int export_to_pdf(const Node *doc, const char *output_path);
-int export_to_html(const Node *doc, const char *output_path);
-int export_to_json(const Node *doc, const char *output_path);
+int export_to_pdf(const Document *doc, const char *output_path, size_t threads);
+int export_to_html(const Document *doc, const char *output_path);
+int export_to_json(const char *input_path, const char *output_path, unsigned flags);
+
+// Security functions, keyed by the contents of a secret key file
+#define MMK_SIGNATURE_SUFFIX ".sig"
+#define MMK_KEY_ENV "MMK_KEY"   // Key file used when --key is not given
+
+typedef struct {
+    uint8_t sign[32];   // HMAC key for signatures
+    uint8_t seal[32];   // AES-256 key for [[secure]] blocks
+} MmkKey;
 
-// Security functions
-int sign_file(const char *file, const char *private_key_path);
-int verify_signature(const char *file);
+int load_key(const char *key_path, MmkKey *key);
+int sign_file(const char *file, const MmkKey *key);
+int verify_signature(const char *file, const MmkKey *key);
+int seal_secure_blocks(const char *file, const MmkKey *key);
+int reveal_secure_blocks(const char *file, const MmkKey *key, long block);
+
+// Hashing
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_HEX_SIZE 65   // 64 hex digits and the terminator
+
+typedef struct {
+    uint32_t state[8];   // Chaining value
+    uint64_t length;     // Bytes hashed so far
+    uint8_t block[64];   // Pending partial block
+    size_t used;         // Bytes in block
+} Sha256;
+
+void sha256_init(Sha256 *ctx);
+void sha256_update(Sha256 *ctx, const void *data, size_t size);
+void sha256_final(Sha256 *ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+void sha256_hex(const void *data, size_t size, char hex[SHA256_HEX_SIZE]);
+void digest_to_hex(const uint8_t digest[SHA256_DIGEST_SIZE], char hex[SHA256_HEX_SIZE]);
+
+typedef struct {
+    Sha256 inner;   // Hash of the inner padded key and the message
+    Sha256 outer;   // Hash of the outer padded key
+} HmacSha256;
+
+void hmac_sha256_init(HmacSha256 *ctx, const void *key, size_t size);
+void hmac_sha256_update(HmacSha256 *ctx, const void *data, size_t size);
+void hmac_sha256_final(HmacSha256 *ctx, uint8_t mac[SHA256_DIGEST_SIZE]);
+
+// Authenticated encryption with AES-256 in Galois/Counter mode
+#define AES_GCM_KEY_SIZE 32
+#define AES_GCM_IV_SIZE 12
+#define AES_GCM_TAG_SIZE 16
+
+typedef struct {
+    uint8_t round_keys[15][16];  // Expanded AES-256 key schedule
+    uint8_t hash_key[16];        // GHASH key, the encryption of the zero block
+    int accelerated;             // Use AES-NI and PCLMULQDQ
+} AesGcm;
+
+void aes_gcm_init(AesGcm *ctx, const uint8_t key[AES_GCM_KEY_SIZE]);
+void aes_gcm_seal(const AesGcm *ctx, const uint8_t iv[AES_GCM_IV_SIZE],
+                  const uint8_t *aad, size_t aad_size, const uint8_t *plain, size_t size,
+                  uint8_t *cipher, uint8_t tag[AES_GCM_TAG_SIZE]);
+int aes_gcm_open(const AesGcm *ctx, const uint8_t iv[AES_GCM_IV_SIZE],
+                 const uint8_t *aad, size_t aad_size, const uint8_t *cipher, size_t size,
+                 const uint8_t tag[AES_GCM_TAG_SIZE], uint8_t *plain);
+
+// Version control functions, working on the store below the current directory
+#define MMK_STORE_DIR ".mmk"
 
-// Version control functions
 int create_commit(const char *message, const char *author);
 int get_commit_history(void);
 int rollback_to_commit(int commit_id);
+int diff_versions(int commit_id);
+int print_block_diff(FILE *out, const char *path, const char *old_content, size_t old_size,
+                     const char *new_content, size_t new_size);
+
+// Files of a commit, read without checking it out
+typedef struct FileEntry FileEntry;
+typedef int (*CommitFileVisitor)(const FileEntry *file, void *user_data);
+
+int current_commit(void);   // Checked-out commit, 0 when there is none
+int for_each_commit_file(int commit_id, CommitFileVisitor visit, void *user_data);
+const char* commit_file_path(const FileEntry *file);
+const char* commit_file_hash(const FileEntry *file);
+char* read_commit_file(const FileEntry *file, size_t *size);
+
+// Search index of the checked-out commit, kept up to date by commit and rollback
+#define MMK_INDEX_FILE MMK_STORE_DIR "/index"
+
+int update_search_index(bool rebuild, bool quiet);
+int refresh_search_index(void);
+int search_documents(const char *query, size_t limit);
+
+// Object store internals
+size_t split_chunks(const char *data, size_t size, size_t *ends, size_t capacity);
+size_t lz_bound(size_t size);
+size_t lz_compress(const char *input, size_t size, unsigned char *output);
+int lz_decompress(const unsigned char *input, size_t size, char *output, size_t expected);
 
 #endif // METAMARK_CLI_H 
\ No newline at end of file
@@ -0,0 +1,338 @@
+#include <string.h>
+#include "../include/cli.h"
+
+#if !defined(MMK_NO_ACCEL) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AES_X86 1
+#include <immintrin.h>
+#endif
+
+// AES-256 as specified in FIPS 197 and GCM as specified in NIST SP 800-38D
+#define AES_ROUNDS 14
+
+static const uint8_t sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+static uint8_t xtime(uint8_t value) {
+    return (uint8_t)((value << 1) ^ ((value >> 7) * 0x1b));
+}
+
+static void store_be32(uint8_t *out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+static uint64_t load_be64(const uint8_t *in) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value = value << 8 | in[i];
+    }
+    return value;
+}
+
+static void store_be64(uint8_t *out, uint64_t value) {
+    for (int i = 7; i >= 0; i--) {
+        out[i] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+static void expand_key(uint8_t round_keys[15][16], const uint8_t key[AES_GCM_KEY_SIZE]) {
+    uint8_t *words = &round_keys[0][0];
+    uint8_t rcon = 1;
+    memcpy(words, key, AES_GCM_KEY_SIZE);
+    for (int i = 8; i < 4 * (AES_ROUNDS + 1); i++) {
+        uint8_t temp[4];
+        memcpy(temp, words + (i - 1) * 4, 4);
+        if (i % 8 == 0) {
+            uint8_t first = temp[0];
+            temp[0] = sbox[temp[1]] ^ rcon;
+            temp[1] = sbox[temp[2]];
+            temp[2] = sbox[temp[3]];
+            temp[3] = sbox[first];
+            rcon = xtime(rcon);
+        } else if (i % 8 == 4) {
+            for (int j = 0; j < 4; j++) {
+                temp[j] = sbox[temp[j]];
+            }
+        }
+        for (int j = 0; j < 4; j++) {
+            words[i * 4 + j] = words[(i - 8) * 4 + j] ^ temp[j];
+        }
+    }
+}
+
+// Portable block encryption, a byte at a time
+static void encrypt_block_portable(const AesGcm *ctx, const uint8_t in[16], uint8_t out[16]) {
+    uint8_t state[16];
+    for (int i = 0; i < 16; i++) {
+        state[i] = in[i] ^ ctx->round_keys[0][i];
+    }
+    for (int round = 1; round <= AES_ROUNDS; round++) {
+        uint8_t shifted[16];
+        // SubBytes and ShiftRows; byte r of column c is state[4c + r]
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 4; r++) {
+                shifted[c * 4 + r] = sbox[state[((c + r) % 4) * 4 + r]];
+            }
+        }
+        if (round < AES_ROUNDS) {
+            for (int c = 0; c < 4; c++) {
+                uint8_t *column = shifted + c * 4;
+                uint8_t all = column[0] ^ column[1] ^ column[2] ^ column[3];
+                uint8_t first = column[0];
+                column[0] ^= all ^ xtime(column[0] ^ column[1]);
+                column[1] ^= all ^ xtime(column[1] ^ column[2]);
+                column[2] ^= all ^ xtime(column[2] ^ column[3]);
+                column[3] ^= all ^ xtime(column[3] ^ first);
+            }
+        }
+        for (int i = 0; i < 16; i++) {
+            state[i] = shifted[i] ^ ctx->round_keys[round][i];
+        }
+    }
+    memcpy(out, state, 16);
+}
+
+// Multiply x by h in GF(2^128) with the bit order GCM uses
+static void gf_multiply(uint8_t x[16], const uint8_t h[16]) {
+    uint64_t z_high = 0, z_low = 0;
+    uint64_t v_high = load_be64(h), v_low = load_be64(h + 8);
+    for (int i = 0; i < 128; i++) {
+        uint64_t bit = (uint64_t)0 - ((x[i / 8] >> (7 - i % 8)) & 1);
+        z_high ^= v_high & bit;
+        z_low ^= v_low & bit;
+        uint64_t carry = (uint64_t)0 - (v_low & 1);
+        v_low = v_low >> 1 | v_high << 63;
+        v_high = v_high >> 1 ^ (0xe100000000000000ULL & carry);
+    }
+    store_be64(x, z_high);
+    store_be64(x + 8, z_low);
+}
+
+static void ghash_portable(const AesGcm *ctx, uint8_t hash[16], const uint8_t *data, size_t size) {
+    while (size > 0) {
+        size_t take = size < 16 ? size : 16;
+        for (size_t i = 0; i < take; i++) {
+            hash[i] ^= data[i];
+        }
+        gf_multiply(hash, ctx->hash_key);
+        data += take;
+        size -= take;
+    }
+}
+
+static void ctr_portable(const AesGcm *ctx, const uint8_t iv[AES_GCM_IV_SIZE], uint32_t counter,
+                         const uint8_t *in, size_t size, uint8_t *out) {
+    uint8_t block[16], stream[16];
+    memcpy(block, iv, AES_GCM_IV_SIZE);
+    while (size > 0) {
+        size_t take = size < 16 ? size : 16;
+        store_be32(block + 12, counter++);
+        encrypt_block_portable(ctx, block, stream);
+        for (size_t i = 0; i < take; i++) {
+            out[i] = in[i] ^ stream[i];
+        }
+        in += take;
+        out += take;
+        size -= take;
+    }
+}
+
+#ifdef AES_X86
+// AES-NI takes the FIPS 197 round keys as they are laid out in memory
+__attribute__((target("aes,sse2")))
+static __m128i encrypt_block_aesni(const __m128i keys[AES_ROUNDS + 1], __m128i block) {
+    block = _mm_xor_si128(block, keys[0]);
+    for (int round = 1; round < AES_ROUNDS; round++) {
+        block = _mm_aesenc_si128(block, keys[round]);
+    }
+    return _mm_aesenclast_si128(block, keys[AES_ROUNDS]);
+}
+
+// Four independent counter blocks keep the AES pipeline busy
+__attribute__((target("aes,sse2")))
+static void ctr_aesni(const AesGcm *ctx, const uint8_t iv[AES_GCM_IV_SIZE], uint32_t counter,
+                      const uint8_t *in, size_t size, uint8_t *out) {
+    __m128i keys[AES_ROUNDS + 1];
+    for (int round = 0; round <= AES_ROUNDS; round++) {
+        keys[round] = _mm_loadu_si128((const __m128i *)ctx->round_keys[round]);
+    }
+    uint8_t blocks[4][16];
+    for (int i = 0; i < 4; i++) {
+        memcpy(blocks[i], iv, AES_GCM_IV_SIZE);
+    }
+
+    for (; size >= 64; in += 64, out += 64, size -= 64) {
+        __m128i stream[4];
+        for (int i = 0; i < 4; i++) {
+            store_be32(blocks[i] + 12, counter++);
+            stream[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)blocks[i]), keys[0]);
+        }
+        for (int round = 1; round < AES_ROUNDS; round++) {
+            for (int i = 0; i < 4; i++) {
+                stream[i] = _mm_aesenc_si128(stream[i], keys[round]);
+            }
+        }
+        for (int i = 0; i < 4; i++) {
+            stream[i] = _mm_aesenclast_si128(stream[i], keys[AES_ROUNDS]);
+            __m128i data = _mm_loadu_si128((const __m128i *)(in + i * 16));
+            _mm_storeu_si128((__m128i *)(out + i * 16), _mm_xor_si128(data, stream[i]));
+        }
+    }
+
+    while (size > 0) {
+        size_t take = size < 16 ? size : 16;
+        uint8_t stream[16];
+        store_be32(blocks[0] + 12, counter++);
+        _mm_storeu_si128((__m128i *)stream,
+            encrypt_block_aesni(keys, _mm_loadu_si128((const __m128i *)blocks[0])));
+        for (size_t i = 0; i < take; i++) {
+            out[i] = in[i] ^ stream[i];
+        }
+        in += take;
+        out += take;
+        size -= take;
+    }
+}
+
+// Carry-less multiplication on byte-reversed operands, reduced modulo
+// x^128 + x^7 + x^2 + x + 1 (Intel's GCM white paper, algorithm 5)
+__attribute__((target("pclmul,sse2")))
+static __m128i gf_multiply_clmul(__m128i a, __m128i b) {
+    __m128i low = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i middle = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10),
+                                   _mm_clmulepi64_si128(a, b, 0x01));
+    __m128i high = _mm_clmulepi64_si128(a, b, 0x11);
+    low = _mm_xor_si128(low, _mm_slli_si128(middle, 8));
+    high = _mm_xor_si128(high, _mm_srli_si128(middle, 8));
+
+    // Shift the 256-bit product left by one bit
+    __m128i low_carry = _mm_srli_epi32(low, 31);
+    __m128i high_carry = _mm_srli_epi32(high, 31);
+    low = _mm_slli_epi32(low, 1);
+    high = _mm_slli_epi32(high, 1);
+    __m128i across = _mm_srli_si128(low_carry, 12);
+    low = _mm_or_si128(low, _mm_slli_si128(low_carry, 4));
+    high = _mm_or_si128(high, _mm_slli_si128(high_carry, 4));
+    high = _mm_or_si128(high, across);
+
+    // Reduce
+    __m128i fold = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(low, 31), _mm_slli_epi32(low, 30)),
+                                 _mm_slli_epi32(low, 25));
+    __m128i rest = _mm_srli_si128(fold, 4);
+    low = _mm_xor_si128(low, _mm_slli_si128(fold, 12));
+    __m128i shifted = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(low, 1), _mm_srli_epi32(low, 2)),
+                                    _mm_srli_epi32(low, 7));
+    low = _mm_xor_si128(low, _mm_xor_si128(shifted, rest));
+    return _mm_xor_si128(high, low);
+}
+
+__attribute__((target("pclmul,ssse3")))
+static void ghash_clmul(const AesGcm *ctx, uint8_t hash[16], const uint8_t *data, size_t size) {
+    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i key = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)ctx->hash_key), reverse);
+    __m128i state = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)hash), reverse);
+
+    for (; size >= 16; data += 16, size -= 16) {
+        __m128i block = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), reverse);
+        state = gf_multiply_clmul(_mm_xor_si128(state, block), key);
+    }
+    if (size > 0) {
+        uint8_t last[16] = {0};
+        memcpy(last, data, size);
+        __m128i block = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)last), reverse);
+        state = gf_multiply_clmul(_mm_xor_si128(state, block), key);
+    }
+    _mm_storeu_si128((__m128i *)hash, _mm_shuffle_epi8(state, reverse));
+}
+#endif
+
+static void ghash(const AesGcm *ctx, uint8_t hash[16], const uint8_t *data, size_t size) {
+#ifdef AES_X86
+    if (ctx->accelerated) {
+        ghash_clmul(ctx, hash, data, size);
+        return;
+    }
+#endif
+    ghash_portable(ctx, hash, data, size);
+}
+
+static void ctr(const AesGcm *ctx, const uint8_t iv[AES_GCM_IV_SIZE], uint32_t counter,
+                const uint8_t *in, size_t size, uint8_t *out) {
+#ifdef AES_X86
+    if (ctx->accelerated) {
+        ctr_aesni(ctx, iv, counter, in, size, out);
+        return;
+    }
+#endif
+    ctr_portable(ctx, iv, counter, in, size, out);
+}
+
+// The authentication tag over the additional data and the ciphertext
+static void compute_tag(const AesGcm *ctx, const uint8_t iv[AES_GCM_IV_SIZE],
+                        const uint8_t *aad, size_t aad_size, const uint8_t *cipher, size_t size,
+                        uint8_t tag[AES_GCM_TAG_SIZE]) {
+    uint8_t hash[16] = {0};
+    uint8_t lengths[16];
+    ghash(ctx, hash, aad, aad_size);
+    ghash(ctx, hash, cipher, size);
+    store_be64(lengths, (uint64_t)aad_size * 8);
+    store_be64(lengths + 8, (uint64_t)size * 8);
+    ghash(ctx, hash, lengths, sizeof(lengths));
+
+    // The first counter block masks the hash
+    ctr(ctx, iv, 1, hash, sizeof(hash), tag);
+}
+
+void aes_gcm_init(AesGcm *ctx, const uint8_t key[AES_GCM_KEY_SIZE]) {
+    static const uint8_t zero[16] = {0};
+    expand_key(ctx->round_keys, key);
+    ctx->accelerated = 0;
+#ifdef AES_X86
+    ctx->accelerated = __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul") &&
+                       __builtin_cpu_supports("ssse3");
+#endif
+    encrypt_block_portable(ctx, zero, ctx->hash_key);
+}
+
+void aes_gcm_seal(const AesGcm *ctx, const uint8_t iv[AES_GCM_IV_SIZE],
+                  const uint8_t *aad, size_t aad_size, const uint8_t *plain, size_t size,
+                  uint8_t *cipher, uint8_t tag[AES_GCM_TAG_SIZE]) {
+    ctr(ctx, iv, 2, plain, size, cipher);
+    compute_tag(ctx, iv, aad, aad_size, cipher, size, tag);
+}
+
+int aes_gcm_open(const AesGcm *ctx, const uint8_t iv[AES_GCM_IV_SIZE],
+                 const uint8_t *aad, size_t aad_size, const uint8_t *cipher, size_t size,
+                 const uint8_t tag[AES_GCM_TAG_SIZE], uint8_t *plain) {
+    uint8_t expected[AES_GCM_TAG_SIZE];
+    uint8_t difference = 0;
+    compute_tag(ctx, iv, aad, aad_size, cipher, size, expected);
+    for (int i = 0; i < AES_GCM_TAG_SIZE; i++) {
+        difference |= expected[i] ^ tag[i];
+    }
+    if (difference != 0) {
+        return -1;
+    }
+
+    ctr(ctx, iv, 2, cipher, size, plain);
+    return 0;
+}
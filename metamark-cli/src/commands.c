@@ -5,23 +5,189 @@
 
 // Remove duplicate function definitions
 // int rollback_to_commit(int commit_id) { return 0; }
-// int sign_file(const char *file, const char *private_key_path) { return 0; }
-// int verify_signature(const char *file) { return 0; }
 
-int handle_parse(int argc, char *argv[]) {
-    if (argc < 3) {
+// Summary of a parse --jobs run
+typedef struct {
+    size_t parsed;  // Files parsed successfully
+    size_t failed;  // Files that could not be read or parsed
+} ParseSummary;
+
+static int report_parse_result(const MMBatchResult *result, void *user_data) {
+    ParseSummary *summary = user_data;
+
+    if (result->doc) {
+        printf("%s: ok (%zu blocks)\n", result->path, result->doc->root->child_count);
+        summary->parsed++;
+    } else if (result->context.error == MM_ERROR_SYNTAX && result->size == 0) {
+        printf("%s: empty\n", result->path);
+        summary->parsed++;
+    } else if (result->context.line > 0) {
+        fprintf(stderr, "%s:%zu:%zu: %s\n", result->path, result->context.line,
+                result->context.column, error_to_string(result->context.error));
+        summary->failed++;
+    } else {
+        fprintf(stderr, "%s: %s\n", result->path, error_to_string(result->context.error));
+        summary->failed++;
+    }
+    return 0;
+}
+
+// Parse one file and print its AST
+static int parse_single_file(const char *path) {
+    char *content;
+    size_t size;
+    if (read_file_content(path, &content, &size) != 0) {
+        print_error("Cannot read input file");
         return 1;
     }
-    // Check if file exists
-    FILE *file = fopen(argv[2], "r");
-    if (!file) {
+
+    // An empty document has nothing to show
+    size_t i = 0;
+    while (i < size && (content[i] == ' ' || content[i] == '\t' ||
+                        content[i] == '\r' || content[i] == '\n')) {
+        i++;
+    }
+    if (i == size) {
+        free(content);
+        return 0;
+    }
+
+    MMContext ctx;
+    Document *doc = mm_parse_document(&ctx, content, size, NULL);
+    free(content);
+    if (!doc) {
+        print_error(error_to_string(ctx.error));
         return 1;
     }
-    fclose(file);
-    // Stub implementation for testing
+
+    print_ast(doc->root, 0);
+    free_document(doc);
     return 0;
 }
 
+// Parse files one at a time on this thread, so parse statistics see them all
+static void parse_files_serially(const PathList *paths, ParseSummary *summary) {
+    for (size_t i = 0; i < paths->count; i++) {
+        MMBatchResult result;
+        memset(&result, 0, sizeof(result));
+        result.path = paths->items[i];
+        result.index = i;
+
+        char *content = NULL;
+        if (read_file_content(result.path, &content, &result.size) != 0) {
+            result.context.error = MM_ERROR_IO;
+        } else {
+            result.doc = mm_parse_document(&result.context, content, result.size, NULL);
+        }
+        report_parse_result(&result, summary);
+        free_document(result.doc);
+        free(content);
+    }
+}
+
+// Print what the parser counted, phases in milliseconds
+static void print_parse_stats(const MMParseStats *stats) {
+    size_t nodes = 0;
+    for (size_t i = 0; i < MM_NODE_TYPE_COUNT; i++) {
+        nodes += stats->nodes[i];
+    }
+
+    printf("\nParse statistics:\n");
+    printf("  Bytes scanned:  %zu\n", stats->bytes_scanned);
+    printf("  Nodes:          %zu\n", nodes);
+    for (size_t i = 0; i < MM_NODE_TYPE_COUNT; i++) {
+        if (stats->nodes[i] > 0) {
+            printf("    %-12s  %zu\n", node_type_to_string((NodeType)i), stats->nodes[i]);
+        }
+    }
+    printf("  Allocations:    %zu (%zu bytes)\n", stats->allocations, stats->allocated_bytes);
+    printf("  Lexing:         %.3f ms\n", stats->lex_seconds * 1000.0);
+    printf("  Metadata:       %.3f ms\n", stats->metadata_seconds * 1000.0);
+    printf("  Components:     %.3f ms\n", stats->component_seconds * 1000.0);
+    printf("  Building:       %.3f ms\n", stats->build_seconds * 1000.0);
+    printf("  Teardown:       %.3f ms\n", stats->free_seconds * 1000.0);
+}
+
+int handle_parse(int argc, char *argv[]) {
+    PathList paths = {0};
+    size_t jobs = 0;
+    int batch = 0;
+    int patterns = 0;
+    int collect_stats = 0;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            collect_stats = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "--jobs") == 0 || strcmp(argv[i], "-j") == 0) {
+            char *end;
+            long value = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : 0;
+            if (i + 1 >= argc || *end != '\0' || value < 1) {
+                print_error("Usage: mmk parse [--stats] [--jobs N] <file.mmk|dir|glob>...");
+                path_list_free(&paths);
+                return 1;
+            }
+            jobs = (size_t)value;
+            batch = 1;
+            i++;
+            continue;
+        }
+
+        size_t before = paths.count;
+        patterns++;
+        if (path_list_add(&paths, argv[i]) != 0) {
+            print_error("Cannot expand input path");
+            path_list_free(&paths);
+            return 1;
+        }
+        if (paths.count != before + 1 || strcmp(paths.items[before], argv[i]) != 0) {
+            batch = 1;  // A directory or glob expanded to other paths
+        }
+    }
+
+    if (patterns == 0) {
+        path_list_free(&paths);
+        return 1;
+    }
+
+    // Statistics only cover this thread, so --stats parses serially
+    MMParseStats stats;
+    memset(&stats, 0, sizeof(stats));
+    if (collect_stats) {
+        mm_parse_stats(&stats);
+    }
+
+    int result;
+    if (!batch && patterns == 1) {
+        // A single file prints its AST
+        result = parse_single_file(paths.items[0]);
+    } else {
+        ParseSummary summary = {0, 0};
+        if (collect_stats) {
+            parse_files_serially(&paths, &summary);
+            result = 0;
+        } else {
+            result = mm_parse_batch((const char *const *)paths.items, paths.count, jobs,
+                                    report_parse_result, &summary);
+        }
+        printf("Parsed %zu of %zu files", summary.parsed, paths.count);
+        if (summary.failed) {
+            printf(" (%zu failed)", summary.failed);
+        }
+        printf("\n");
+        result = result != 0 || summary.failed ? 1 : 0;
+    }
+
+    if (collect_stats) {
+        mm_parse_stats(NULL);
+        print_parse_stats(&stats);
+    }
+
+    path_list_free(&paths);
+    return result;
+}
+
 int handle_commit(int argc, char *argv[]) {
     if (argc < 4 || strcmp(argv[2], "-m") != 0) {
         return 1;
@@ -30,18 +196,40 @@ int handle_commit(int argc, char *argv[]) {
     if (strlen(argv[3]) == 0) {
         return 1;
     }
-    // Stub implementation for testing
-    return 0;
+
+    const char *author = getenv("MMK_AUTHOR");
+    if (!author) {
+        author = getenv("USER");
+    }
+    if (!author) {
+        author = getenv("USERNAME");
+    }
+    int result = create_commit(argv[3], author);
+    if (result == 0) {
+        result = refresh_search_index();
+    }
+    return result;
 }
 
-int handle_diff(int argc, char *argv[]) {
-    if (argc < 2) {
-        print_error("Usage: mmk diff [--latest | --commit N]");
+int handle_log(int argc, char *argv[]) {
+    (void)argv;
+    if (argc != 2) {
+        print_error("Usage: mmk log");
         return 1;
     }
+    return get_commit_history();
+}
 
-    // TODO: Implement diff logic
-    print_error("Diff functionality not implemented yet");
+int handle_diff(int argc, char *argv[]) {
+    // --latest compares the working tree with the checked-out commit
+    if (argc == 2 || (argc == 3 && strcmp(argv[2], "--latest") == 0)) {
+        return diff_versions(0);
+    }
+    if (argc == 4 && strcmp(argv[2], "--commit") == 0 && atoi(argv[3]) > 0) {
+        return diff_versions(atoi(argv[3]));
+    }
+
+    print_error("Usage: mmk diff [--latest | --commit N]");
     return 1;
 }
 
@@ -52,7 +240,49 @@ int handle_rollback(int argc, char *argv[]) {
     }
 
     int commit_id = atoi(argv[3]);
-    return rollback_to_commit(commit_id);
+    int result = rollback_to_commit(commit_id);
+    if (result == 0) {
+        result = refresh_search_index();
+    }
+    return result;
+}
+
+// Derive the output path of an exported file: doc.mmk -> doc.html
+static int export_output_path(char *buffer, size_t size, const char *input, const char *extension) {
+    size_t length = strlen(input);
+    if (length > 4 && strcmp(input + length - 4, ".mmk") == 0) {
+        length -= 4;
+    }
+    int written = snprintf(buffer, size, "%.*s.%s", (int)length, input, extension);
+    return written > 0 && (size_t)written < size ? 0 : -1;
+}
+
+// Parse one file and export it as HTML, or as PDF laid out on threads
+static int export_document_file(const char *input, const char *output, int pdf, size_t threads) {
+    char *content;
+    size_t size;
+    if (read_file_content(input, &content, &size) != 0) {
+        fprintf(stderr, "%s: cannot read file\n", input);
+        return 1;
+    }
+
+    // The content outlives the document, so nodes and bodies can point into it
+    MMContext ctx;
+    MMParseOptions options = { NULL, MM_PARSE_VIEW | MM_PARSE_LAZY, 0 };
+    Document *doc = mm_parse_document(&ctx, content, size, &options);
+    if (!doc) {
+        fprintf(stderr, "%s: %s\n", input, error_to_string(ctx.error));
+        free(content);
+        return 1;
+    }
+
+    int result = pdf ? export_to_pdf(doc, output, threads) : export_to_html(doc, output);
+    if (result != 0) {
+        fprintf(stderr, "%s: cannot write %s\n", input, output);
+    }
+    free_document(doc);
+    free(content);
+    return result != 0 ? 1 : 0;
 }
 
 int handle_export(int argc, char *argv[]) {
@@ -66,26 +296,206 @@ int handle_export(int argc, char *argv[]) {
         strcmp(format, "json") != 0) {
         return 1;
     }
-    // Stub implementation for testing
-    return 0;
+    int json = strcmp(format, "json") == 0;
+    int pdf = strcmp(format, "pdf") == 0;
+
+    PathList paths = {0};
+    const char *output = NULL;
+    unsigned json_flags = 0;
+    size_t jobs = 0;
+    int usage = 0;
+    for (int i = 4; i < argc && !usage; i++) {
+        if (strcmp(argv[i], "--output") == 0 || strcmp(argv[i], "-o") == 0) {
+            if (i + 1 >= argc) {
+                usage = 1;
+            } else {
+                output = argv[++i];
+            }
+        } else if (pdf && (strcmp(argv[i], "--jobs") == 0 || strcmp(argv[i], "-j") == 0)) {
+            char *end;
+            long value = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : 0;
+            if (i + 1 >= argc || *end != '\0' || value < 1) {
+                usage = 1;
+            } else {
+                jobs = (size_t)value;
+                i++;
+            }
+        } else if (json && strcmp(argv[i], "--compact") == 0) {
+            json_flags |= MM_JSON_COMPACT;
+        } else if (json && strcmp(argv[i], "--offsets") == 0) {
+            json_flags |= MM_JSON_OFFSETS;
+        } else if (path_list_add(&paths, argv[i]) != 0) {
+            print_error("Cannot expand input path");
+            path_list_free(&paths);
+            return 1;
+        }
+    }
+
+    // An explicit output only makes sense for a single input
+    if (usage || paths.count == 0 || (output && paths.count != 1)) {
+        print_error(json
+            ? "Usage: mmk export --format json [--compact] [--offsets] [-o out.json|-] <file.mmk|dir|glob>..."
+            : pdf
+            ? "Usage: mmk export --format pdf [--jobs N] [-o out.pdf|-] <file.mmk|dir|glob>..."
+            : "Usage: mmk export --format html [-o out.html|-] <file.mmk|dir|glob>...");
+        path_list_free(&paths);
+        return 1;
+    }
+
+    int failed = 0;
+    for (size_t i = 0; i < paths.count; i++) {
+        char path[4096];
+        const char *target = output;
+        if (!target) {
+            if (export_output_path(path, sizeof(path), paths.items[i], format) != 0) {
+                fprintf(stderr, "%s: path too long\n", paths.items[i]);
+                failed = 1;
+                continue;
+            }
+            target = path;
+        }
+
+        if (!json) {
+            failed |= export_document_file(paths.items[i], target, pdf, jobs);
+        } else if (export_to_json(paths.items[i], target, json_flags) != 0) {
+            fprintf(stderr, "%s: cannot export to %s\n", paths.items[i], target);
+            failed = 1;
+        }
+    }
+
+    path_list_free(&paths);
+    return failed;
 }
 
-int handle_sign(int argc, char *argv[]) {
-    if (argc != 4 || strcmp(argv[2], "--key") != 0) {
-        print_error("Usage: mmk sign --key private.pem");
+// Options shared by the key-based commands: --key FILE and, for reveal,
+// --block N; everything else is a file, directory or glob
+static int parse_key_arguments(int argc, char *argv[], const char **key_path, long *block,
+                               PathList *paths) {
+    int patterns = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--key") == 0 && i + 1 < argc) {
+            *key_path = argv[++i];
+            continue;
+        }
+        if (block && strcmp(argv[i], "--block") == 0 && i + 1 < argc) {
+            char *end;
+            *block = strtol(argv[++i], &end, 10);
+            if (*end != '\0' || *block < 1) {
+                return -1;
+            }
+            continue;
+        }
+        if (argv[i][0] == '-' || path_list_add(paths, argv[i]) != 0) {
+            return -1;
+        }
+        patterns++;
+    }
+    return patterns > 0 ? 0 : -1;
+}
+
+// Run one keyed operation over every input file
+static int run_key_command(int argc, char *argv[], const char *usage,
+                           int (*operation)(const char *file, const MmkKey *key)) {
+    PathList paths = {0};
+    const char *key_path = NULL;
+    if (parse_key_arguments(argc, argv, &key_path, NULL, &paths) != 0) {
+        print_error(usage);
+        path_list_free(&paths);
+        return 1;
+    }
+
+    MmkKey key;
+    if (load_key(key_path, &key) != 0) {
+        path_list_free(&paths);
         return 1;
     }
+    int failed = 0;
+    for (size_t i = 0; i < paths.count; i++) {
+        failed |= operation(paths.items[i], &key);
+    }
+    memset(&key, 0, sizeof(key));
+    path_list_free(&paths);
+    return failed;
+}
 
-    return sign_file(argv[1], argv[3]);
+int handle_sign(int argc, char *argv[]) {
+    return run_key_command(argc, argv, "Usage: mmk sign [--key <key>] <file.mmk|dir|glob>...",
+                           sign_file);
 }
 
 int handle_verify(int argc, char *argv[]) {
-    if (argc != 3) {
-        print_error("Usage: mmk verify <file.mmk>");
+    return run_key_command(argc, argv, "Usage: mmk verify [--key <key>] <file.mmk|dir|glob>...",
+                           verify_signature);
+}
+
+int handle_seal(int argc, char *argv[]) {
+    return run_key_command(argc, argv, "Usage: mmk seal [--key <key>] <file.mmk|dir|glob>...",
+                           seal_secure_blocks);
+}
+
+int handle_reveal(int argc, char *argv[]) {
+    PathList paths = {0};
+    const char *key_path = NULL;
+    long block = 0;
+    if (parse_key_arguments(argc, argv, &key_path, &block, &paths) != 0 || paths.count != 1) {
+        print_error("Usage: mmk reveal [--key <key>] [--block N] <file.mmk>");
+        path_list_free(&paths);
+        return 1;
+    }
+
+    MmkKey key;
+    int result = load_key(key_path, &key);
+    if (result == 0) {
+        result = reveal_secure_blocks(paths.items[0], &key, block);
+    }
+    memset(&key, 0, sizeof(key));
+    path_list_free(&paths);
+    return result;
+}
+
+int handle_index(int argc, char *argv[]) {
+    if (argc == 2 || (argc == 3 && strcmp(argv[2], "--rebuild") == 0)) {
+        return update_search_index(argc == 3, false);
+    }
+
+    print_error("Usage: mmk index [--rebuild]");
+    return 1;
+}
+
+int handle_search(int argc, char *argv[]) {
+    // The terms are searched as one query, so quoting them is optional
+    int first = 2;
+    long limit = 0;
+    if (argc > 3 && strcmp(argv[2], "--limit") == 0) {
+        char *end;
+        limit = strtol(argv[3], &end, 10);
+        first = *end == '\0' && limit > 0 ? 4 : argc;
+    }
+    if (first >= argc) {
+        print_error("Usage: mmk search [--limit N] <terms>...");
         return 1;
     }
 
-    return verify_signature(argv[2]);
+    size_t length = 0;
+    for (int i = first; i < argc; i++) {
+        length += strlen(argv[i]) + 1;
+    }
+    char *query = malloc(length);
+    if (!query) {
+        print_error("Out of memory");
+        return 1;
+    }
+    query[0] = '\0';
+    for (int i = first; i < argc; i++) {
+        if (i > first) {
+            strcat(query, " ");
+        }
+        strcat(query, argv[i]);
+    }
+
+    int result = search_documents(query, (size_t)limit);
+    free(query);
+    return result;
 }
 
 int handle_version(int argc, char *argv[]) {
@@ -134,16 +544,28 @@ void print_help(void) {
     printf("Usage: mmk <command> [options]\n\n");
     printf("Commands:\n");
     printf("  parse <file.mmk>        Parse and display the AST\n");
+    printf("  parse [--jobs N] <dir|glob>... Parse many files in parallel\n");
     printf("  commit -m \"message\"     Create a new commit\n");
     printf("  diff [--latest|--commit N] Show differences\n");
+    printf("  log                     Show the commit history\n");
     printf("  rollback --to N         Roll back to version N\n");
     printf("  export --format [pdf|html|json] Export document\n");
-    printf("  sign --key private.pem   Sign the document\n");
-    printf("  verify <file.mmk>        Verify signature\n");
+    printf("  export --format pdf [--jobs N] [-o out.pdf|-] <file.mmk>... Render to PDF\n");
+    printf("  export --format html [-o out.html|-] <file.mmk>... Render to HTML\n");
+    printf("  export --format json [--compact] [--offsets] [-o out.json|-] <file.mmk>...\n");
+    printf("                           Write the AST as JSON\n");
+    printf("  sign [--key <key>] <file.mmk>...   Sign documents into <file>.sig\n");
+    printf("  verify [--key <key>] <file.mmk>... Verify signatures\n");
+    printf("  seal [--key <key>] <file.mmk>...   Encrypt [[secure]] blocks in place\n");
+    printf("  reveal [--key <key>] [--block N] <file.mmk> Decrypt [[secure]] blocks\n");
+    printf("  index [--rebuild]        Index the checked-out commit for search\n");
+    printf("  search [--limit N] <terms>... Find blocks; heading:, annotation:,\n");
+    printf("                           component: and meta: narrow a term\n");
     printf("  version                  Display version information\n");
     printf("  help                     Show this help\n");
     printf("\nOptions:\n");
     printf("  --test                   Run in test mode\n");
+    printf("\nThe key is any secret file; " MMK_KEY_ENV " names one when --key is not given.\n");
 }
 
 void print_error(const char *message) {
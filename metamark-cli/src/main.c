@@ -7,10 +7,15 @@ static const Command commands[] = {
     {"parse", "Parse and display the AST of a .mmk file", handle_parse},
     {"commit", "Create a new commit with a message", handle_commit},
     {"diff", "Show differences between versions", handle_diff},
+    {"log", "Show the commit history", handle_log},
     {"rollback", "Roll back to a previous version", handle_rollback},
     {"export", "Export document to various formats", handle_export},
     {"sign", "Sign the document cryptographically", handle_sign},
     {"verify", "Verify document signature", handle_verify},
+    {"seal", "Encrypt the [[secure]] blocks of a document", handle_seal},
+    {"reveal", "Decrypt the [[secure]] blocks of a document", handle_reveal},
+    {"index", "Index the checked-out commit for search", handle_index},
+    {"search", "Search the indexed documents", handle_search},
     {"version", "Display version information", handle_version},
     {"help", "Show this help message", handle_help},
     {NULL, NULL, NULL}  // End marker
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/cli.h"
+
+// Search index
+//
+// .mmk/index holds the search index of the checked-out commit, with every
+// file tagged by its content hash. Updating walks the commit manifest and
+// only reads the files whose hash changed, so refreshing after a commit
+// costs as much as the files it touched.
+
+typedef struct {
+    char **items;
+    size_t count;
+    size_t capacity;
+} NameList;
+
+typedef struct {
+    MMIndex *index;
+    NameList paths;      // Files of the commit
+    NameList removed;    // Indexed files the commit no longer has
+    size_t updated;      // Files read and indexed again
+} IndexUpdate;
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static int add_name(NameList *list, const char *name) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 64;
+        char **items = realloc(list->items, capacity * sizeof(char *));
+        if (!items) {
+            return -1;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    size_t length = strlen(name);
+    char *copy = malloc(length + 1);
+    if (!copy) {
+        return -1;
+    }
+    memcpy(copy, name, length + 1);
+    list->items[list->count++] = copy;
+    return 0;
+}
+
+static void free_names(NameList *list) {
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->items[i]);
+    }
+    free(list->items);
+}
+
+// Index one file of the commit unless its hash is already indexed
+static int index_commit_file(const FileEntry *file, void *user_data) {
+    IndexUpdate *update = user_data;
+    const char *path = commit_file_path(file);
+    const char *hash = commit_file_hash(file);
+    if (add_name(&update->paths, path) != 0) {
+        print_error("Out of memory");
+        return -1;
+    }
+
+    const char *tag = mm_index_tag(update->index, path);
+    if (tag && strcmp(tag, hash) == 0) {
+        return 0;
+    }
+
+    size_t size;
+    char *content = read_commit_file(file, &size);
+    if (!content) {
+        fprintf(stderr, "Error: Cannot read %s from the store\n", path);
+        return -1;
+    }
+    int result = mm_index_add(update->index, path, hash, content, size);
+    free(content);
+    if (result != 0) {
+        fprintf(stderr, "Error: Cannot index %s\n", path);
+        return -1;
+    }
+    update->updated++;
+    return 0;
+}
+
+static int collect_removed(const char *name, const char *tag, void *user_data) {
+    IndexUpdate *update = user_data;
+    (void)tag;
+    if (bsearch(&name, update->paths.items, update->paths.count, sizeof(char *), compare_names)) {
+        return 0;
+    }
+    return add_name(&update->removed, name);
+}
+
+static int save_index(const MMIndex *index) {
+    if (mm_index_save(index, MMK_INDEX_FILE ".tmp") != 0) {
+        return -1;
+    }
+#ifdef _WIN32
+    remove(MMK_INDEX_FILE);
+#endif
+    if (rename(MMK_INDEX_FILE ".tmp", MMK_INDEX_FILE) != 0) {
+        remove(MMK_INDEX_FILE ".tmp");
+        return -1;
+    }
+    return 0;
+}
+
+int update_search_index(bool rebuild, bool quiet) {
+    int commit_id = current_commit();
+    if (commit_id == 0) {
+        print_error("No commits to index; run 'mmk commit' first");
+        return 1;
+    }
+
+    // A missing or damaged index is built from scratch
+    IndexUpdate update = {0};
+    update.index = rebuild ? NULL : mm_index_load(MMK_INDEX_FILE);
+    if (!update.index && !(update.index = mm_index_new())) {
+        print_error("Out of memory");
+        return 1;
+    }
+
+    int result = 0;
+    if (for_each_commit_file(commit_id, index_commit_file, &update) != 0) {
+        fprintf(stderr, "Error: Cannot index commit %d\n", commit_id);
+        result = 1;
+    }
+
+    if (result == 0) {
+        if (update.paths.count > 1) {
+            qsort(update.paths.items, update.paths.count, sizeof(char *), compare_names);
+        }
+        if (mm_index_each(update.index, collect_removed, &update) != 0) {
+            print_error("Out of memory");
+            result = 1;
+        }
+        for (size_t i = 0; result == 0 && i < update.removed.count; i++) {
+            mm_index_remove(update.index, update.removed.items[i]);
+        }
+    }
+
+    if (result == 0 && save_index(update.index) != 0) {
+        print_error("Cannot write " MMK_INDEX_FILE);
+        result = 1;
+    }
+    if (result == 0 && !quiet) {
+        printf("Indexed commit %d: %zu files, %zu updated, %zu removed\n",
+               commit_id, update.paths.count, update.updated, update.removed.count);
+    }
+
+    free_names(&update.paths);
+    free_names(&update.removed);
+    mm_index_free(update.index);
+    return result;
+}
+
+int refresh_search_index(void) {
+    // Only repositories that asked for an index keep one
+    FILE *file = fopen(MMK_INDEX_FILE, "rb");
+    if (!file) {
+        return 0;
+    }
+    fclose(file);
+    return update_search_index(false, true);
+}
+
+typedef struct {
+    size_t limit;
+    size_t printed;
+} SearchOutput;
+
+static int print_hit(const MMSearchHit *hit, void *user_data) {
+    SearchOutput *output = user_data;
+    printf("%s:%zu: %s %s\n", hit->document, hit->line, node_type_to_string(hit->type), hit->preview);
+    return ++output->printed == output->limit;
+}
+
+int search_documents(const char *query, size_t limit) {
+    FILE *file = fopen(MMK_INDEX_FILE, "rb");
+    if (!file) {
+        print_error("No search index; run 'mmk index' first");
+        return 1;
+    }
+    fclose(file);
+
+    MMIndex *index = mm_index_load(MMK_INDEX_FILE);
+    if (!index) {
+        print_error("Search index is damaged; run 'mmk index --rebuild'");
+        return 1;
+    }
+
+    SearchOutput output = { limit, 0 };
+    int result = mm_index_search(index, query, print_hit, &output);
+    mm_index_free(index);
+    if (result < 0) {
+        fprintf(stderr, "Error: Invalid query: %s\n", query);
+        return 1;
+    }
+    if (output.printed == 0) {
+        printf("No matches\n");
+    }
+    return 0;
+}
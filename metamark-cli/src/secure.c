@@ -0,0 +1,459 @@
+#ifdef _WIN32
+#define _CRT_RAND_S   // Declares rand_s() in stdlib.h
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/cli.h"
+
+// Signatures and sealed [[secure]] blocks
+//
+// A signature is an HMAC-SHA256 of the file, stored next to it in
+// <file>.sig as "hmac-sha256 <hex>". A sealed block body is a single line
+// "aes-256-gcm:" followed by the base64 of the IV, the ciphertext and the
+// tag, authenticated together with the block's number and the file name so
+// a sealed body cannot be moved to another block or file. Both keys are
+// derived from the contents of one secret key file.
+#define SIGNATURE_SCHEME "hmac-sha256"
+#define SEALED_PREFIX "aes-256-gcm:"
+#define SEALED_PREFIX_LENGTH (sizeof(SEALED_PREFIX) - 1)
+#define STREAM_BUFFER_SIZE (64 * 1024)
+#define MMK_PATH_SIZE 4096
+
+int load_key(const char *key_path, MmkKey *key) {
+    if (!key_path) {
+        key_path = getenv(MMK_KEY_ENV);
+    }
+    if (!key_path || !*key_path) {
+        print_error("No key given: pass --key or set " MMK_KEY_ENV);
+        return 1;
+    }
+
+    char *content;
+    size_t size;
+    if (read_file_content(key_path, &content, &size) != 0) {
+        fprintf(stderr, "Error: Cannot read key file %s\n", key_path);
+        return 1;
+    }
+    if (size == 0) {
+        free(content);
+        fprintf(stderr, "Error: Key file %s is empty\n", key_path);
+        return 1;
+    }
+
+    // Separate keys for signing and sealing
+    HmacSha256 ctx;
+    hmac_sha256_init(&ctx, content, size);
+    hmac_sha256_update(&ctx, "mmk signature", 13);
+    hmac_sha256_final(&ctx, key->sign);
+    hmac_sha256_init(&ctx, content, size);
+    hmac_sha256_update(&ctx, "mmk secure block", 16);
+    hmac_sha256_final(&ctx, key->seal);
+
+    memset(content, 0, size);
+    free(content);
+    return 0;
+}
+
+// HMAC of a file, read in fixed-size pieces rather than loaded whole
+static int mac_file(const char *file, const MmkKey *key, uint8_t mac[SHA256_DIGEST_SIZE]) {
+    FILE *input = fopen(file, "rb");
+    if (!input) {
+        return -1;
+    }
+    unsigned char *buffer = malloc(STREAM_BUFFER_SIZE);
+    if (!buffer) {
+        fclose(input);
+        return -1;
+    }
+
+    HmacSha256 ctx;
+    hmac_sha256_init(&ctx, key->sign, sizeof(key->sign));
+    size_t read;
+    while ((read = fread(buffer, 1, STREAM_BUFFER_SIZE, input)) > 0) {
+        hmac_sha256_update(&ctx, buffer, read);
+    }
+    int failed = ferror(input);
+    free(buffer);
+    fclose(input);
+    if (failed) {
+        return -1;
+    }
+    hmac_sha256_final(&ctx, mac);
+    return 0;
+}
+
+// Build "<file><suffix>"; fails rather than truncate a long name
+static int suffixed_path(const char *file, const char *suffix, char *path, size_t size) {
+    int length = snprintf(path, size, "%s%s", file, suffix);
+    if (length < 0 || (size_t)length >= size) {
+        fprintf(stderr, "%s: path too long\n", file);
+        return -1;
+    }
+    return 0;
+}
+
+int sign_file(const char *file, const MmkKey *key) {
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    if (mac_file(file, key, mac) != 0) {
+        fprintf(stderr, "%s: cannot read file\n", file);
+        return 1;
+    }
+
+    char hex[SHA256_HEX_SIZE];
+    char text[sizeof(SIGNATURE_SCHEME) + SHA256_HEX_SIZE + 1];
+    digest_to_hex(mac, hex);
+    int length = snprintf(text, sizeof(text), SIGNATURE_SCHEME " %s\n", hex);
+
+    char path[MMK_PATH_SIZE];
+    if (suffixed_path(file, MMK_SIGNATURE_SUFFIX, path, sizeof(path)) != 0) {
+        return 1;
+    }
+    if (write_file_content(path, text, (size_t)length) != 0) {
+        fprintf(stderr, "%s: cannot write %s\n", file, path);
+        return 1;
+    }
+    printf("%s: signed\n", file);
+    return 0;
+}
+
+int verify_signature(const char *file, const MmkKey *key) {
+    char path[MMK_PATH_SIZE];
+    char text[128];
+    if (suffixed_path(file, MMK_SIGNATURE_SUFFIX, path, sizeof(path)) != 0) {
+        return 1;
+    }
+    FILE *signature = fopen(path, "rb");
+    if (!signature) {
+        fprintf(stderr, "%s: not signed\n", file);
+        return 1;
+    }
+    size_t length = fread(text, 1, sizeof(text) - 1, signature);
+    fclose(signature);
+    text[length] = '\0';
+    text[strcspn(text, "\r\n")] = '\0';
+
+    const char *expected = text + sizeof(SIGNATURE_SCHEME);
+    if (strncmp(text, SIGNATURE_SCHEME " ", sizeof(SIGNATURE_SCHEME)) != 0 ||
+        strlen(expected) != SHA256_HEX_SIZE - 1) {
+        fprintf(stderr, "%s: malformed signature in %s\n", file, path);
+        return 1;
+    }
+
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    if (mac_file(file, key, mac) != 0) {
+        fprintf(stderr, "%s: cannot read file\n", file);
+        return 1;
+    }
+    char hex[SHA256_HEX_SIZE];
+    digest_to_hex(mac, hex);
+
+    // Compare in constant time
+    unsigned char difference = 0;
+    for (size_t i = 0; i < SHA256_HEX_SIZE - 1; i++) {
+        difference |= (unsigned char)(hex[i] ^ expected[i]);
+    }
+    if (difference != 0) {
+        fprintf(stderr, "%s: signature does not match\n", file);
+        return 1;
+    }
+    printf("%s: OK\n", file);
+    return 0;
+}
+
+static int random_bytes(uint8_t *out, size_t size) {
+#ifdef _WIN32
+    for (size_t i = 0; i < size; i++) {
+        unsigned int value;
+        if (rand_s(&value) != 0) {
+            return -1;
+        }
+        out[i] = (uint8_t)value;
+    }
+    return 0;
+#else
+    FILE *source = fopen("/dev/urandom", "rb");
+    if (!source) {
+        return -1;
+    }
+    size_t read = fread(out, 1, size, source);
+    fclose(source);
+    return read == size ? 0 : -1;
+#endif
+}
+
+static const char base64_digits[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static size_t base64_encode(const uint8_t *data, size_t size, char *out) {
+    char *start = out;
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t group = (uint32_t)data[i] << 16;
+        if (i + 1 < size) group |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < size) group |= data[i + 2];
+        *out++ = base64_digits[group >> 18 & 63];
+        *out++ = base64_digits[group >> 12 & 63];
+        *out++ = i + 1 < size ? base64_digits[group >> 6 & 63] : '=';
+        *out++ = i + 2 < size ? base64_digits[group & 63] : '=';
+    }
+    return (size_t)(out - start);
+}
+
+// Decode into out, which must hold size / 4 * 3 bytes; returns -1 on bad input
+static long base64_decode(const char *text, size_t size, uint8_t *out) {
+    if (size % 4 != 0) {
+        return -1;
+    }
+    long length = 0;
+    for (size_t i = 0; i < size; i += 4) {
+        uint32_t group = 0;
+        int padding = 0;
+        for (int j = 0; j < 4; j++) {
+            const char *digit = text[i + j] ? strchr(base64_digits, text[i + j]) : NULL;
+            if (text[i + j] == '=' && i + 4 == size && j >= 2) {
+                padding++;
+                group <<= 6;
+                continue;
+            }
+            if (!digit || padding) {
+                return -1;
+            }
+            group = group << 6 | (uint32_t)(digit - base64_digits);
+        }
+        out[length++] = (uint8_t)(group >> 16);
+        if (padding < 2) out[length++] = (uint8_t)(group >> 8);
+        if (padding < 1) out[length++] = (uint8_t)group;
+    }
+    return length;
+}
+
+static int is_secure_block(const Document *doc, const Node *node) {
+    size_t length;
+    const char *name = node->type == NODE_COMPONENT ? mm_node_text(doc, node, &length) : NULL;
+    return name && length >= 6 && strncmp(name, "secure", 6) == 0 &&
+           (length == 6 || name[6] == ' ');
+}
+
+static int is_sealed(const char *body, size_t length) {
+    return length >= SEALED_PREFIX_LENGTH &&
+           memcmp(body, SEALED_PREFIX, SEALED_PREFIX_LENGTH) == 0;
+}
+
+// Additional data of a sealed block: its number among the secure blocks of
+// the file and the file name without its directory, which survives moving
+// the file but not renaming it
+static int block_aad(const char *file, long index, char *aad, size_t size) {
+    const char *name = file;
+    for (const char *c = file; *c; c++) {
+        if (*c == '/' || *c == '\\') {
+            name = c + 1;
+        }
+    }
+    int length = snprintf(aad, size, "mmk secure block %ld %s", index, name);
+    if (length < 0 || (size_t)length >= size) {
+        fprintf(stderr, "%s: path too long\n", file);
+        return -1;
+    }
+    return length;
+}
+
+// Parse without building any block bodies; they are read in place
+static Document* parse_lazily(const char *content, size_t size) {
+    MMParseOptions options = {0};
+    options.flags = MM_PARSE_VIEW | MM_PARSE_LAZY;
+    return mm_parse_document(NULL, content, size, &options);
+}
+
+int seal_secure_blocks(const char *file, const MmkKey *key) {
+    char *content;
+    size_t size;
+    if (read_file_content(file, &content, &size) != 0) {
+        fprintf(stderr, "%s: cannot read file\n", file);
+        return 1;
+    }
+    Document *doc = parse_lazily(content, size);
+    if (!doc) {
+        fprintf(stderr, "%s: %s\n", file, error_to_string(get_last_error()));
+        free(content);
+        return 1;
+    }
+
+    AesGcm cipher;
+    aes_gcm_init(&cipher, key->seal);
+
+    // Base64 grows a body by a third, plus the prefix, IV and tag per block
+    size_t capacity = size + size / 2 + 64 * (doc->root->child_count + 1);
+    char *output = malloc(capacity);
+    uint8_t *sealed = malloc(size + AES_GCM_IV_SIZE + AES_GCM_TAG_SIZE);
+    size_t written = 0, copied = 0, count = 0;
+    long index = 0;
+    int failed = !output || !sealed;
+
+    for (size_t i = 0; !failed && i < doc->root->child_count; i++) {
+        const Node *node = doc->root->children[i];
+        if (!is_secure_block(doc, node)) {
+            continue;
+        }
+        index++;
+        size_t length;
+        const char *body = mm_node_body_text(doc, node, &length);
+        if (!body || length == 0 || is_sealed(body, length)) {
+            continue;
+        }
+
+        char aad[MMK_PATH_SIZE];
+        int aad_size = block_aad(file, index, aad, sizeof(aad));
+        if (aad_size < 0) {
+            failed = 1;
+            break;
+        }
+
+        size_t start = (size_t)(body - content);
+        memcpy(output + written, content + copied, start - copied);
+        written += start - copied;
+
+        if (random_bytes(sealed, AES_GCM_IV_SIZE) != 0) {
+            print_error("Cannot read random bytes");
+            failed = 1;
+            break;
+        }
+        aes_gcm_seal(&cipher, sealed, (const uint8_t *)aad, (size_t)aad_size,
+                     (const uint8_t *)body, length,
+                     sealed + AES_GCM_IV_SIZE, sealed + AES_GCM_IV_SIZE + length);
+        memcpy(output + written, SEALED_PREFIX, SEALED_PREFIX_LENGTH);
+        written += SEALED_PREFIX_LENGTH;
+        written += base64_encode(sealed, AES_GCM_IV_SIZE + length + AES_GCM_TAG_SIZE,
+                                 output + written);
+        output[written++] = '\n';
+        copied = start + length;
+        count++;
+    }
+
+    if (!failed && count > 0) {
+        memcpy(output + written, content + copied, size - copied);
+        written += size - copied;
+        char temp[MMK_PATH_SIZE];
+        failed = suffixed_path(file, ".tmp", temp, sizeof(temp)) != 0;
+        if (!failed) {
+            failed = write_file_content(temp, output, written) != 0;
+#ifdef _WIN32
+            if (!failed) {
+                remove(file);
+            }
+#endif
+            if (failed || rename(temp, file) != 0) {
+                remove(temp);
+                fprintf(stderr, "%s: cannot write file\n", file);
+                failed = 1;
+            }
+        }
+    }
+    if (!failed) {
+        printf("%s: sealed %zu block%s\n", file, count, count == 1 ? "" : "s");
+    }
+
+    free(sealed);
+    free(output);
+    free_document(doc);
+    free(content);
+    return failed;
+}
+
+// Decrypt one sealed body; returns the plaintext length, or -1
+static long open_block(const AesGcm *cipher, const char *aad, size_t aad_size,
+                       const char *body, size_t length, uint8_t **plain) {
+    while (length > 0 && (body[length - 1] == '\n' || body[length - 1] == '\r' ||
+                          body[length - 1] == ' ')) {
+        length--;
+    }
+    body += SEALED_PREFIX_LENGTH;
+    length -= SEALED_PREFIX_LENGTH;
+
+    uint8_t *sealed = malloc(length / 4 * 3 + 1);
+    long size = sealed ? base64_decode(body, length, sealed) : -1;
+    if (size < AES_GCM_IV_SIZE + AES_GCM_TAG_SIZE) {
+        free(sealed);
+        return -1;
+    }
+    size -= AES_GCM_IV_SIZE + AES_GCM_TAG_SIZE;
+    *plain = malloc((size_t)size + 1);
+    if (!*plain || aes_gcm_open(cipher, sealed, (const uint8_t *)aad, aad_size, sealed + AES_GCM_IV_SIZE, (size_t)size,
+                                sealed + AES_GCM_IV_SIZE + size, *plain) != 0) {
+        free(*plain);
+        free(sealed);
+        return -1;
+    }
+    free(sealed);
+    return size;
+}
+
+int reveal_secure_blocks(const char *file, const MmkKey *key, long block) {
+    char *content;
+    size_t size;
+    if (read_file_content(file, &content, &size) != 0) {
+        fprintf(stderr, "%s: cannot read file\n", file);
+        return 1;
+    }
+    Document *doc = parse_lazily(content, size);
+    if (!doc) {
+        fprintf(stderr, "%s: %s\n", file, error_to_string(get_last_error()));
+        free(content);
+        return 1;
+    }
+
+    AesGcm cipher;
+    aes_gcm_init(&cipher, key->seal);
+
+    // Only the selected blocks are decrypted
+    long index = 0;
+    int failed = 0;
+    for (size_t i = 0; i < doc->root->child_count; i++) {
+        const Node *node = doc->root->children[i];
+        if (!is_secure_block(doc, node)) {
+            continue;
+        }
+        index++;
+        if (block > 0 && index != block) {
+            continue;
+        }
+
+        size_t length = 0;
+        const char *body = mm_node_body_text(doc, node, &length);
+        if (!body || !is_sealed(body, length)) {
+            fprintf(stderr, "%s: secure block %ld is not sealed\n", file, index);
+            failed = 1;
+            continue;
+        }
+        char aad[MMK_PATH_SIZE];
+        int aad_size = block_aad(file, index, aad, sizeof(aad));
+        if (aad_size < 0) {
+            failed = 1;
+            break;
+        }
+        uint8_t *plain;
+        long plain_size = open_block(&cipher, aad, (size_t)aad_size, body, length, &plain);
+        if (plain_size < 0) {
+            fprintf(stderr, "%s: cannot decrypt secure block %ld\n", file, index);
+            failed = 1;
+            continue;
+        }
+        if (block == 0) {
+            printf("[[secure]]\n");
+        }
+        fwrite(plain, 1, (size_t)plain_size, stdout);
+        if (block == 0) {
+            printf("[[/secure]]\n");
+        }
+        memset(plain, 0, (size_t)plain_size);
+        free(plain);
+    }
+
+    if (block > 0 && index < block) {
+        fprintf(stderr, "%s: no secure block %ld\n", file, block);
+        failed = 1;
+    }
+
+    free_document(doc);
+    free(content);
+    return failed;
+}
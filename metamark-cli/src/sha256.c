@@ -0,0 +1,269 @@
+#include <string.h>
+#include "../include/cli.h"
+
+#if !defined(MMK_NO_ACCEL) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA256_X86 1
+#include <immintrin.h>
+#elif !defined(MMK_NO_ACCEL) && defined(__ARM_FEATURE_SHA2)
+#define SHA256_ARM 1
+#include <arm_neon.h>
+#endif
+
+// SHA-256 as specified in FIPS 180-4
+static const uint32_t round_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static uint32_t rotr32(uint32_t value, int shift) {
+    return (value >> shift) | (value << (32 - shift));
+}
+
+static void sha256_block(uint32_t state[8], const uint8_t *block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) +
+                      ((e & f) ^ (~e & g)) + round_constants[i] + w[i];
+        uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) +
+                      ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+#ifdef SHA256_X86
+// SHA extensions: the state is kept as ABEF and CDGH, and each
+// sha256rnds2 performs two rounds
+__attribute__((target("sha,sse4.1")))
+static void sha256_blocks_shani(uint32_t state[8], const uint8_t *data, size_t count) {
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i temp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b);
+    __m128i state0 = _mm_alignr_epi8(temp, state1, 8);
+    state1 = _mm_blend_epi16(state1, temp, 0xf0);
+
+    for (; count > 0; count--, data += 64) {
+        __m128i saved0 = state0, saved1 = state1;
+        __m128i msg[4];
+        for (int i = 0; i < 4; i++) {
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + i * 16)),
+                                      byte_swap);
+        }
+        for (int i = 0; i < 16; i++) {
+            __m128i words = _mm_add_epi32(msg[i & 3],
+                _mm_loadu_si128((const __m128i *)&round_constants[i * 4]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, words);
+            if (i >= 3 && i < 15) {
+                __m128i carry = _mm_alignr_epi8(msg[i & 3], msg[(i - 1) & 3], 4);
+                msg[(i + 1) & 3] = _mm_add_epi32(msg[(i + 1) & 3], carry);
+                msg[(i + 1) & 3] = _mm_sha256msg2_epu32(msg[(i + 1) & 3], msg[i & 3]);
+            }
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(words, 0x0e));
+            if (i >= 1 && i < 13) {
+                msg[(i - 1) & 3] = _mm_sha256msg1_epu32(msg[(i - 1) & 3], msg[i & 3]);
+            }
+        }
+        state0 = _mm_add_epi32(state0, saved0);
+        state1 = _mm_add_epi32(state1, saved1);
+    }
+
+    temp = _mm_shuffle_epi32(state0, 0x1b);
+    state1 = _mm_shuffle_epi32(state1, 0xb1);
+    _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(temp, state1, 0xf0));
+    _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(state1, temp, 8));
+}
+#endif
+
+#ifdef SHA256_ARM
+// ARMv8 crypto extensions: sha256h and sha256h2 perform four rounds on
+// ABCD and EFGH
+static void sha256_blocks_armv8(uint32_t state[8], const uint8_t *data, size_t count) {
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+
+    for (; count > 0; count--, data += 64) {
+        uint32x4_t saved0 = state0, saved1 = state1;
+        uint32x4_t msg[4];
+        for (int i = 0; i < 4; i++) {
+            msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i * 16)));
+        }
+        uint32x4_t words = vaddq_u32(msg[0], vld1q_u32(&round_constants[0]));
+        for (int i = 0; i < 16; i++) {
+            uint32x4_t next = words;
+            if (i < 12) {
+                msg[i & 3] = vsha256su0q_u32(msg[i & 3], msg[(i + 1) & 3]);
+            }
+            if (i < 15) {
+                next = vaddq_u32(msg[(i + 1) & 3], vld1q_u32(&round_constants[(i + 1) * 4]));
+            }
+            uint32x4_t previous = state0;
+            state0 = vsha256hq_u32(state0, state1, words);
+            state1 = vsha256h2q_u32(state1, previous, words);
+            if (i < 12) {
+                msg[i & 3] = vsha256su1q_u32(msg[i & 3], msg[(i + 2) & 3], msg[(i + 3) & 3]);
+            }
+            words = next;
+        }
+        state0 = vaddq_u32(state0, saved0);
+        state1 = vaddq_u32(state1, saved1);
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+#endif
+
+// Compress whole blocks, with the CPU's SHA instructions when it has them
+static void sha256_blocks(Sha256 *ctx, const uint8_t *data, size_t count) {
+#if defined(SHA256_X86)
+    if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1")) {
+        sha256_blocks_shani(ctx->state, data, count);
+        return;
+    }
+#elif defined(SHA256_ARM)
+    sha256_blocks_armv8(ctx->state, data, count);
+    return;
+#endif
+    for (; count > 0; count--, data += 64) {
+        sha256_block(ctx->state, data);
+    }
+}
+
+void sha256_init(Sha256 *ctx) {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+void sha256_update(Sha256 *ctx, const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    ctx->length += size;
+    if (ctx->used > 0) {
+        size_t take = 64 - ctx->used < size ? 64 - ctx->used : size;
+        memcpy(ctx->block + ctx->used, bytes, take);
+        ctx->used += take;
+        bytes += take;
+        size -= take;
+        if (ctx->used < 64) {
+            return;
+        }
+        sha256_blocks(ctx, ctx->block, 1);
+        ctx->used = 0;
+    }
+    sha256_blocks(ctx, bytes, size / 64);
+    bytes += size - size % 64;
+    size %= 64;
+    memcpy(ctx->block, bytes, size);
+    ctx->used = size;
+}
+
+void sha256_final(Sha256 *ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    uint64_t bits = ctx->length * 8;
+    ctx->block[ctx->used++] = 0x80;
+    if (ctx->used > 56) {
+        memset(ctx->block + ctx->used, 0, 64 - ctx->used);
+        sha256_blocks(ctx, ctx->block, 1);
+        ctx->used = 0;
+    }
+    memset(ctx->block + ctx->used, 0, 56 - ctx->used);
+    for (int i = 0; i < 8; i++) {
+        ctx->block[56 + i] = (uint8_t)(bits >> (56 - i * 8));
+    }
+    sha256_blocks(ctx, ctx->block, 1);
+    for (int i = 0; i < 8; i++) {
+        digest[i * 4] = (uint8_t)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)ctx->state[i];
+    }
+}
+
+void sha256_hex(const void *data, size_t size, char hex[SHA256_HEX_SIZE]) {
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    Sha256 ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, size);
+    sha256_final(&ctx, digest);
+    digest_to_hex(digest, hex);
+}
+
+void digest_to_hex(const uint8_t digest[SHA256_DIGEST_SIZE], char hex[SHA256_HEX_SIZE]) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < SHA256_DIGEST_SIZE; i++) {
+        hex[i * 2] = digits[digest[i] >> 4];
+        hex[i * 2 + 1] = digits[digest[i] & 0xf];
+    }
+    hex[SHA256_DIGEST_SIZE * 2] = '\0';
+}
+
+// HMAC as specified in RFC 2104
+void hmac_sha256_init(HmacSha256 *ctx, const void *key, size_t size) {
+    uint8_t pad[64];
+    memset(pad, 0, sizeof(pad));
+    if (size > sizeof(pad)) {
+        sha256_init(&ctx->inner);
+        sha256_update(&ctx->inner, key, size);
+        sha256_final(&ctx->inner, pad);
+    } else if (size > 0) {
+        memcpy(pad, key, size);
+    }
+
+    for (size_t i = 0; i < sizeof(pad); i++) {
+        pad[i] ^= 0x36;
+    }
+    sha256_init(&ctx->inner);
+    sha256_update(&ctx->inner, pad, sizeof(pad));
+
+    for (size_t i = 0; i < sizeof(pad); i++) {
+        pad[i] ^= 0x36 ^ 0x5c;
+    }
+    sha256_init(&ctx->outer);
+    sha256_update(&ctx->outer, pad, sizeof(pad));
+}
+
+void hmac_sha256_update(HmacSha256 *ctx, const void *data, size_t size) {
+    sha256_update(&ctx->inner, data, size);
+}
+
+void hmac_sha256_final(HmacSha256 *ctx, uint8_t mac[SHA256_DIGEST_SIZE]) {
+    uint8_t inner[SHA256_DIGEST_SIZE];
+    sha256_final(&ctx->inner, inner);
+    sha256_update(&ctx->outer, inner, sizeof(inner));
+    sha256_final(&ctx->outer, mac);
+}
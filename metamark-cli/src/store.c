@@ -0,0 +1,976 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "../include/cli.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#define make_directory(path) _mkdir(path)
+#else
+#define make_directory(path) mkdir(path, 0755)
+#endif
+
+// Versioned object store
+//
+// .mmk/objects/<sha256>  one deduplicated chunk, compressed when that helps
+// .mmk/commits/<id>      a manifest listing every file as chunk hashes
+// .mmk/HEAD              the checked-out commit and the highest commit id
+//
+// Files are split into chunks at content-defined points, so an edit only
+// changes the chunks around it and a commit stores just those. A file
+// whose hash matches the parent commit is not even split again.
+
+#define STORE_OBJECTS MMK_STORE_DIR "/objects"
+#define STORE_COMMITS MMK_STORE_DIR "/commits"
+#define STORE_HEAD MMK_STORE_DIR "/HEAD"
+
+// Chunks are cut at block starts once they reach CHUNK_MIN bytes, when the
+// rolling hash says so or they have passed CHUNK_MAX; a block longer than
+// CHUNK_LIMIT is cut wherever the limit falls
+#define CHUNK_MIN 1024
+#define CHUNK_MAX (16 * 1024)
+#define CHUNK_LIMIT (64 * 1024)
+#define CHUNK_MASK 0xc000000000000000ull
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+
+// Object header: method byte, then the uncompressed length as u32 LE
+#define OBJECT_HEADER_SIZE 5
+#define OBJECT_RAW 0
+#define OBJECT_LZ 1
+
+// Per-byte values of the gear rolling hash, filled from splitmix64
+static uint64_t gear[256];
+
+static void init_gear(void) {
+    static int ready = 0;
+    if (ready) {
+        return;
+    }
+    uint64_t seed = 0;
+    for (int i = 0; i < 256; i++) {
+        uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        gear[i] = z ^ (z >> 31);
+    }
+    ready = 1;
+}
+
+// A top-level block starts after a blank line, as the parser splits them
+static int is_block_start(const char *data, size_t i) {
+    if (i < 2 || data[i - 1] != '\n' || data[i] == '\n' || data[i] == '\r') {
+        return 0;
+    }
+    return data[i - 2] == '\n' || (i >= 3 && data[i - 2] == '\r' && data[i - 3] == '\n');
+}
+
+size_t split_chunks(const char *data, size_t size, size_t *ends, size_t capacity) {
+    init_gear();
+    size_t count = 0;
+    size_t start = 0;
+    uint64_t hash = 0;
+
+    // The hash covers the last 64 bytes only, so cut points depend on
+    // nearby content and line up again right after an edit
+    for (size_t i = 0; i < size; i++) {
+        size_t length = i - start;
+        if ((length >= CHUNK_MIN && is_block_start(data, i) &&
+             ((hash & CHUNK_MASK) == 0 || length >= CHUNK_MAX)) ||
+            length >= CHUNK_LIMIT) {
+            if (count < capacity) {
+                ends[count] = i;
+            }
+            count++;
+            start = i;
+        }
+        hash = (hash << 1) + gear[(unsigned char)data[i]];
+    }
+    if (size > start) {
+        if (count < capacity) {
+            ends[count] = size;
+        }
+        count++;
+    }
+    return count;
+}
+
+size_t lz_bound(size_t size) {
+    return size + size / 255 + 16;
+}
+
+static unsigned char* put_length(unsigned char *out, size_t length) {
+    for (; length >= 255; length -= 255) {
+        *out++ = 255;
+    }
+    *out++ = (unsigned char)length;
+    return out;
+}
+
+// Emit literals and the token nibble for them; returns the token
+static unsigned char* put_literals(unsigned char **out, const unsigned char *literals, size_t count) {
+    unsigned char *token = (*out)++;
+    *token = (unsigned char)((count < 15 ? count : 15) << 4);
+    if (count >= 15) {
+        *out = put_length(*out, count - 15);
+    }
+    memcpy(*out, literals, count);
+    *out += count;
+    return token;
+}
+
+// LZ77 with LZ4-style sequences: a token holding the literal and match
+// lengths, the literals, a 16-bit offset and any extra length bytes. The
+// last sequence has literals only.
+size_t lz_compress(const char *input, size_t size, unsigned char *output) {
+    const unsigned char *in = (const unsigned char *)input;
+    size_t table[1 << LZ_HASH_BITS] = {0};  // position + 1 of a 4-byte prefix
+    unsigned char *out = output;
+    size_t anchor = 0;
+    size_t i = 0;
+
+    while (i + LZ_MIN_MATCH <= size) {
+        uint32_t prefix;
+        memcpy(&prefix, in + i, sizeof(prefix));
+        size_t slot = (uint32_t)(prefix * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t candidate = table[slot];
+        table[slot] = i + 1;
+        if (candidate == 0 || i - (candidate - 1) > LZ_MAX_OFFSET ||
+            memcmp(in + candidate - 1, in + i, LZ_MIN_MATCH) != 0) {
+            i++;
+            continue;
+        }
+
+        size_t match = candidate - 1;
+        size_t length = LZ_MIN_MATCH;
+        while (i + length < size && in[match + length] == in[i + length]) {
+            length++;
+        }
+
+        unsigned char *token = put_literals(&out, in + anchor, i - anchor);
+        size_t offset = i - match;
+        *out++ = (unsigned char)(offset & 0xff);
+        *out++ = (unsigned char)(offset >> 8);
+        size_t extra = length - LZ_MIN_MATCH;
+        *token |= (unsigned char)(extra < 15 ? extra : 15);
+        if (extra >= 15) {
+            out = put_length(out, extra - 15);
+        }
+        i += length;
+        anchor = i;
+    }
+
+    put_literals(&out, in + anchor, size - anchor);
+    return (size_t)(out - output);
+}
+
+static int get_length(const unsigned char *input, size_t size, size_t *i, size_t *length) {
+    unsigned char byte;
+    do {
+        if (*i >= size) {
+            return -1;
+        }
+        byte = input[(*i)++];
+        *length += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+int lz_decompress(const unsigned char *input, size_t size, char *output, size_t expected) {
+    size_t i = 0;
+    size_t o = 0;
+
+    while (i < size) {
+        unsigned token = input[i++];
+        size_t literals = token >> 4;
+        if (literals == 15 && get_length(input, size, &i, &literals) != 0) {
+            return -1;
+        }
+        if (literals > size - i || literals > expected - o) {
+            return -1;
+        }
+        memcpy(output + o, input + i, literals);
+        i += literals;
+        o += literals;
+        if (i == size) {
+            break;
+        }
+
+        if (size - i < 2) {
+            return -1;
+        }
+        size_t offset = input[i] | ((size_t)input[i + 1] << 8);
+        i += 2;
+        size_t length = token & 15;
+        if (length == 15 && get_length(input, size, &i, &length) != 0) {
+            return -1;
+        }
+        length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > o || length > expected - o) {
+            return -1;
+        }
+        // Byte by byte, since a match may overlap the bytes it produces
+        for (size_t k = 0; k < length; k++, o++) {
+            output[o] = output[o - offset];
+        }
+    }
+    return o == expected ? 0 : -1;
+}
+
+// Manifest of one commit
+typedef struct {
+    char hash[SHA256_HEX_SIZE];  // Hash of the chunk
+    size_t length;               // Uncompressed size of the chunk
+} ChunkRef;
+
+struct FileEntry {
+    char *path;                  // Path relative to the working directory
+    char hash[SHA256_HEX_SIZE];  // Hash of the whole file
+    size_t size;                 // File size in bytes
+    ChunkRef *chunks;            // Chunks in file order
+    size_t chunk_count;          // Number of chunks
+};
+
+typedef struct {
+    int parent;                  // Parent commit, 0 for the first
+    long long date;              // Seconds since the epoch
+    char *author;                // Author name
+    char *message;               // Commit message, on one line
+    FileEntry *files;            // Files sorted by path
+    size_t file_count;           // Number of files
+} Manifest;
+
+// Checked-out commit and the highest commit id, 0 when there is none
+typedef struct {
+    int head;
+    int last;
+} StoreHead;
+
+static void free_manifest(Manifest *manifest) {
+    for (size_t i = 0; i < manifest->file_count; i++) {
+        free(manifest->files[i].path);
+        free(manifest->files[i].chunks);
+    }
+    free(manifest->files);
+    free(manifest->author);
+    free(manifest->message);
+    memset(manifest, 0, sizeof(Manifest));
+}
+
+static char* copy_string(const char *text) {
+    size_t length = strlen(text);
+    char *copy = malloc(length + 1);
+    if (copy) {
+        memcpy(copy, text, length + 1);
+    }
+    return copy;
+}
+
+static int parse_manifest_line(Manifest *manifest, char *line) {
+    char hash[SHA256_HEX_SIZE];
+    unsigned long long size, count;
+    int offset = 0;
+
+    if (strncmp(line, "parent ", 7) == 0) {
+        manifest->parent = atoi(line + 7);
+    } else if (strncmp(line, "date ", 5) == 0) {
+        manifest->date = atoll(line + 5);
+    } else if (strncmp(line, "author ", 7) == 0) {
+        free(manifest->author);
+        return (manifest->author = copy_string(line + 7)) ? 0 : -1;
+    } else if (strncmp(line, "message ", 8) == 0) {
+        free(manifest->message);
+        return (manifest->message = copy_string(line + 8)) ? 0 : -1;
+    } else if (sscanf(line, "file %llu %llu %64s %n", &size, &count, hash, &offset) == 3 && offset > 0) {
+        FileEntry *files = realloc(manifest->files, (manifest->file_count + 1) * sizeof(FileEntry));
+        if (!files) {
+            return -1;
+        }
+        manifest->files = files;
+        FileEntry *file = memset(&files[manifest->file_count], 0, sizeof(FileEntry));
+        file->path = copy_string(line + offset);
+        file->size = (size_t)size;
+        memcpy(file->hash, hash, sizeof(hash));
+        file->chunks = count > 0 ? malloc((size_t)count * sizeof(ChunkRef)) : NULL;
+        manifest->file_count++;
+        if (!file->path || (count > 0 && !file->chunks)) {
+            return -1;
+        }
+    } else if (sscanf(line, "chunk %64s %llu", hash, &size) == 2 && manifest->file_count > 0) {
+        FileEntry *file = &manifest->files[manifest->file_count - 1];
+        ChunkRef *chunk = &file->chunks[file->chunk_count++];
+        memcpy(chunk->hash, hash, sizeof(hash));
+        chunk->length = (size_t)size;
+    } else if (line[0] != '\0') {
+        return -1;
+    }
+    return 0;
+}
+
+static int load_manifest(int id, Manifest *manifest) {
+    char path[64];
+    char *content;
+    size_t size;
+    memset(manifest, 0, sizeof(Manifest));
+    snprintf(path, sizeof(path), STORE_COMMITS "/%d", id);
+    if (id <= 0 || read_file_content(path, &content, &size) != 0) {
+        return -1;
+    }
+
+    // Chunk lines must not outnumber the count on their file line
+    int result = 0;
+    size_t expected = 0;
+    char *line = content;
+    while (result == 0 && *line) {
+        char *end = strchr(line, '\n');
+        if (end) {
+            *end = '\0';
+        }
+        if (strncmp(line, "chunk ", 6) == 0 && expected-- == 0) {
+            result = -1;
+        } else if ((result = parse_manifest_line(manifest, line)) == 0 &&
+                   strncmp(line, "file ", 5) == 0) {
+            expected = (size_t)strtoull(line + 5 + strcspn(line + 5, " "), NULL, 10);
+        }
+        line = end ? end + 1 : line + strlen(line);
+    }
+    free(content);
+    if (result != 0) {
+        free_manifest(manifest);
+    }
+    return result;
+}
+
+static const FileEntry* find_file(const Manifest *manifest, const char *path) {
+    for (size_t i = 0; i < manifest->file_count; i++) {
+        if (strcmp(manifest->files[i].path, path) == 0) {
+            return &manifest->files[i];
+        }
+    }
+    return NULL;
+}
+
+static void read_head(StoreHead *head) {
+    head->head = 0;
+    head->last = 0;
+    FILE *file = fopen(STORE_HEAD, "r");
+    if (file) {
+        if (fscanf(file, "head %d last %d", &head->head, &head->last) != 2) {
+            head->head = head->last = 0;
+        }
+        fclose(file);
+    }
+}
+
+// Move a finished temporary file over its destination
+static int replace_file(const char *temp, const char *path) {
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (rename(temp, path) != 0) {
+        remove(temp);
+        return -1;
+    }
+    return 0;
+}
+
+static int write_head(const StoreHead *head) {
+    char text[64];
+    int length = snprintf(text, sizeof(text), "head %d\nlast %d\n", head->head, head->last);
+    if (write_file_content(STORE_HEAD ".tmp", text, (size_t)length) != 0) {
+        return -1;
+    }
+    return replace_file(STORE_HEAD ".tmp", STORE_HEAD);
+}
+
+static int ensure_directory(const char *path) {
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        return (st.st_mode & S_IFMT) == S_IFDIR ? 0 : -1;
+    }
+    return make_directory(path);
+}
+
+static int ensure_store(void) {
+    return ensure_directory(MMK_STORE_DIR) == 0 && ensure_directory(STORE_OBJECTS) == 0 &&
+           ensure_directory(STORE_COMMITS) == 0 ? 0 : -1;
+}
+
+// Create the directories leading up to a file
+static int ensure_parents(const char *path) {
+    char buffer[4096];
+    size_t length = strlen(path);
+    if (length >= sizeof(buffer)) {
+        return -1;
+    }
+    memcpy(buffer, path, length + 1);
+    for (char *p = buffer + 1; *p; p++) {
+        if (*p == '/' || *p == '\\') {
+            char separator = *p;
+            *p = '\0';
+            if (ensure_directory(buffer) != 0) {
+                return -1;
+            }
+            *p = separator;
+        }
+    }
+    return 0;
+}
+
+// Store a chunk unless an object with its hash exists
+// Returns 1 if the object was written, 0 if it was already stored
+static int write_object(const char *hash, const char *data, size_t length, size_t *stored) {
+    char path[128], temp[136];
+    struct stat st;
+    snprintf(path, sizeof(path), STORE_OBJECTS "/%s", hash);
+    if (stat(path, &st) == 0) {
+        return 0;
+    }
+
+    unsigned char *object = malloc(OBJECT_HEADER_SIZE + lz_bound(length));
+    if (!object) {
+        return -1;
+    }
+    size_t size = lz_compress(data, length, object + OBJECT_HEADER_SIZE);
+    object[0] = OBJECT_LZ;
+    if (size >= length) {
+        memcpy(object + OBJECT_HEADER_SIZE, data, length);
+        size = length;
+        object[0] = OBJECT_RAW;
+    }
+    for (int i = 0; i < 4; i++) {
+        object[1 + i] = (unsigned char)((uint32_t)length >> (i * 8));
+    }
+
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    int result = write_file_content(temp, (const char *)object, OBJECT_HEADER_SIZE + size);
+    free(object);
+    if (result != 0) {
+        remove(temp);
+        return -1;
+    }
+    if (replace_file(temp, path) != 0) {
+        return -1;
+    }
+    *stored += OBJECT_HEADER_SIZE + size;
+    return 1;
+}
+
+// Read a chunk into output, checking its length and hash
+static int read_object(const ChunkRef *chunk, char *output) {
+    char path[128];
+    char *object;
+    size_t size;
+    snprintf(path, sizeof(path), STORE_OBJECTS "/%s", chunk->hash);
+    if (read_file_content(path, &object, &size) != 0) {
+        return -1;
+    }
+
+    const unsigned char *bytes = (const unsigned char *)object;
+    int result = -1;
+    if (size >= OBJECT_HEADER_SIZE) {
+        size_t length = (size_t)bytes[1] | (size_t)bytes[2] << 8 |
+                        (size_t)bytes[3] << 16 | (size_t)bytes[4] << 24;
+        size_t payload = size - OBJECT_HEADER_SIZE;
+        if (length != chunk->length) {
+            result = -1;
+        } else if (bytes[0] == OBJECT_RAW && payload == length) {
+            memcpy(output, object + OBJECT_HEADER_SIZE, length);
+            result = 0;
+        } else if (bytes[0] == OBJECT_LZ) {
+            result = lz_decompress(bytes + OBJECT_HEADER_SIZE, payload, output, length);
+        }
+    }
+    free(object);
+
+    char hash[SHA256_HEX_SIZE];
+    if (result == 0) {
+        sha256_hex(output, chunk->length, hash);
+        result = strcmp(hash, chunk->hash) == 0 ? 0 : -1;
+    }
+    return result;
+}
+
+// Rebuild a file of a manifest from its chunks
+static char* assemble_file(const FileEntry *file) {
+    char *content = malloc(file->size + 1);
+    if (!content) {
+        return NULL;
+    }
+    size_t offset = 0;
+    for (size_t i = 0; i < file->chunk_count; i++) {
+        const ChunkRef *chunk = &file->chunks[i];
+        if (chunk->length > file->size - offset || read_object(chunk, content + offset) != 0) {
+            free(content);
+            return NULL;
+        }
+        offset += chunk->length;
+    }
+    content[offset] = '\0';
+    char hash[SHA256_HEX_SIZE];
+    sha256_hex(content, offset, hash);
+    if (offset != file->size || strcmp(hash, file->hash) != 0) {
+        free(content);
+        return NULL;
+    }
+    return content;
+}
+
+// Compare a file on disk with a manifest entry
+// Returns 1 if it matches, 0 if it differs and -1 if it does not exist
+static int file_matches(const char *path, const FileEntry *entry) {
+    char *content;
+    size_t size;
+    if (read_file_content(path, &content, &size) != 0) {
+        return -1;
+    }
+    char hash[SHA256_HEX_SIZE];
+    sha256_hex(content, size, hash);
+    free(content);
+    return entry && entry->size == size && strcmp(entry->hash, hash) == 0;
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static const char* relative_path(const char *path) {
+    return strncmp(path, "./", 2) == 0 ? path + 2 : path;
+}
+
+// Write the entry of one file to a manifest, storing any new chunks
+static int commit_file(FILE *manifest, const char *path, const Manifest *parent,
+                       int *changed, size_t *new_chunks, size_t *stored) {
+    char *content;
+    size_t size;
+    if (read_file_content(path, &content, &size) != 0) {
+        return -1;
+    }
+
+    char hash[SHA256_HEX_SIZE];
+    sha256_hex(content, size, hash);
+    const char *name = relative_path(path);
+    const FileEntry *previous = find_file(parent, name);
+    int result = 0;
+
+    if (previous && previous->size == size && strcmp(previous->hash, hash) == 0) {
+        // Unchanged since the parent: reuse its chunk list as it is
+        fprintf(manifest, "file %zu %zu %s %s\n", size, previous->chunk_count, hash, name);
+        for (size_t i = 0; i < previous->chunk_count; i++) {
+            fprintf(manifest, "chunk %s %zu\n", previous->chunks[i].hash, previous->chunks[i].length);
+        }
+        free(content);
+        return 0;
+    }
+
+    *changed = 1;
+    size_t *ends = malloc((size / CHUNK_MIN + 1) * sizeof(size_t));
+    if (!ends) {
+        free(content);
+        return -1;
+    }
+    size_t count = split_chunks(content, size, ends, size / CHUNK_MIN + 1);
+    fprintf(manifest, "file %zu %zu %s %s\n", size, count, hash, name);
+    size_t start = 0;
+    for (size_t i = 0; result == 0 && i < count; i++) {
+        char chunk[SHA256_HEX_SIZE];
+        size_t length = ends[i] - start;
+        sha256_hex(content + start, length, chunk);
+        int written = write_object(chunk, content + start, length, stored);
+        if (written < 0) {
+            result = -1;
+        }
+        *new_chunks += written > 0;
+        fprintf(manifest, "chunk %s %zu\n", chunk, length);
+        start = ends[i];
+    }
+    free(ends);
+    free(content);
+    return result;
+}
+
+int create_commit(const char *message, const char *author) {
+    if (!message || message[0] == '\0') {
+        print_error("Commit message must not be empty");
+        return 1;
+    }
+    if (ensure_store() != 0) {
+        print_error("Cannot create the " MMK_STORE_DIR " directory");
+        return 1;
+    }
+
+    StoreHead head;
+    Manifest parent;
+    read_head(&head);
+    if (head.head > 0 && load_manifest(head.head, &parent) != 0) {
+        print_error("Cannot read the current commit");
+        return 1;
+    }
+    if (head.head == 0) {
+        memset(&parent, 0, sizeof(parent));
+    }
+
+    PathList paths = {0};
+    if (path_list_add(&paths, ".") != 0 || paths.count == 0) {
+        print_error("No .mmk files to commit");
+        path_list_free(&paths);
+        free_manifest(&parent);
+        return 1;
+    }
+    qsort(paths.items, paths.count, sizeof(char *), compare_paths);
+
+    int id = head.last + 1;
+    char path[64], temp[72];
+    snprintf(path, sizeof(path), STORE_COMMITS "/%d", id);
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    FILE *manifest = fopen(temp, "wb");
+    if (!manifest) {
+        print_error("Cannot write the commit");
+        path_list_free(&paths);
+        free_manifest(&parent);
+        return 1;
+    }
+
+    fprintf(manifest, "parent %d\ndate %lld\nauthor %s\nmessage ", head.head,
+            (long long)time(NULL), author && author[0] ? author : "unknown");
+    for (const char *p = message; *p; p++) {
+        fputc(*p == '\n' || *p == '\r' ? ' ' : *p, manifest);
+    }
+    fputc('\n', manifest);
+
+    int changed = paths.count != parent.file_count;
+    size_t new_chunks = 0, stored = 0;
+    int result = 0;
+    for (size_t i = 0; result == 0 && i < paths.count; i++) {
+        if (commit_file(manifest, paths.items[i], &parent, &changed, &new_chunks, &stored) != 0) {
+            fprintf(stderr, "Error: Cannot store %s\n", paths.items[i]);
+            result = 1;
+        }
+    }
+    if (fclose(manifest) != 0 && result == 0) {
+        print_error("Cannot write the commit");
+        result = 1;
+    }
+
+    if (result == 0 && !changed) {
+        printf("Nothing to commit\n");
+        remove(temp);
+    } else if (result == 0) {
+        head.head = head.last = id;
+        if (replace_file(temp, path) != 0 || write_head(&head) != 0) {
+            print_error("Cannot write the commit");
+            result = 1;
+        } else {
+            printf("Committed %d: %zu files, %zu new chunks (%zu bytes stored)\n",
+                   id, paths.count, new_chunks, stored);
+        }
+    } else {
+        remove(temp);
+    }
+
+    path_list_free(&paths);
+    free_manifest(&parent);
+    return result;
+}
+
+int get_commit_history(void) {
+    StoreHead head;
+    read_head(&head);
+    if (head.head == 0) {
+        printf("No commits yet\n");
+        return 0;
+    }
+
+    for (int id = head.head; id > 0;) {
+        Manifest manifest;
+        if (load_manifest(id, &manifest) != 0) {
+            fprintf(stderr, "Error: Cannot read commit %d\n", id);
+            return 1;
+        }
+        char date[32] = "";
+        time_t when = (time_t)manifest.date;
+        struct tm *local = localtime(&when);
+        if (local) {
+            strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", local);
+        }
+        printf("commit %d\nAuthor: %s\nDate:   %s\n\n    %s\n\n", id,
+               manifest.author ? manifest.author : "unknown", date,
+               manifest.message ? manifest.message : "");
+
+        // Parents always have smaller ids, so a damaged manifest cannot loop
+        int parent = manifest.parent;
+        free_manifest(&manifest);
+        if (parent >= id) {
+            fprintf(stderr, "Error: Commit %d has an invalid parent %d\n", id, parent);
+            return 1;
+        }
+        id = parent;
+    }
+    return 0;
+}
+
+int rollback_to_commit(int commit_id) {
+    Manifest target, current;
+    StoreHead head;
+    read_head(&head);
+    if (load_manifest(commit_id, &target) != 0) {
+        fprintf(stderr, "Error: No commit %d\n", commit_id);
+        return 1;
+    }
+    if (head.head > 0 && load_manifest(head.head, &current) != 0) {
+        print_error("Cannot read the current commit");
+        free_manifest(&target);
+        return 1;
+    }
+    if (head.head == 0) {
+        memset(&current, 0, sizeof(current));
+    }
+
+    // Refuse to overwrite anything that was never committed
+    int result = 0;
+    for (size_t i = 0; result == 0 && i < target.file_count; i++) {
+        const FileEntry *file = &target.files[i];
+        const FileEntry *committed = find_file(&current, file->path);
+        int state = file_matches(file->path, committed);
+        if (state == 0 && file_matches(file->path, file) != 1) {
+            fprintf(stderr, "Error: %s has uncommitted changes\n", file->path);
+            result = 1;
+        }
+    }
+    for (size_t i = 0; result == 0 && i < current.file_count; i++) {
+        const FileEntry *file = &current.files[i];
+        if (!find_file(&target, file->path) && file_matches(file->path, file) == 0) {
+            fprintf(stderr, "Error: %s has uncommitted changes\n", file->path);
+            result = 1;
+        }
+    }
+
+    // Only files that differ from the target are rebuilt
+    size_t restored = 0, removed = 0;
+    for (size_t i = 0; result == 0 && i < target.file_count; i++) {
+        const FileEntry *file = &target.files[i];
+        if (file_matches(file->path, file) == 1) {
+            continue;
+        }
+        char *content = assemble_file(file);
+        if (!content || ensure_parents(file->path) != 0 ||
+            write_file_content(file->path, content, file->size) != 0) {
+            fprintf(stderr, "Error: Cannot restore %s\n", file->path);
+            result = 1;
+        } else {
+            restored++;
+        }
+        free(content);
+    }
+    for (size_t i = 0; result == 0 && i < current.file_count; i++) {
+        if (!find_file(&target, current.files[i].path) && remove(current.files[i].path) == 0) {
+            removed++;
+        }
+    }
+
+    // Files restored before a failure stay restored; say which state is left
+    if (result != 0 && restored > 0) {
+        fprintf(stderr, "Error: Rollback stopped partway: %zu files match commit %d, "
+                "the rest and HEAD are still at commit %d\n", restored, commit_id, head.head);
+    }
+
+    if (result == 0) {
+        head.head = commit_id;
+        if (write_head(&head) != 0) {
+            print_error("Cannot update " STORE_HEAD);
+            result = 1;
+        } else {
+            printf("Rolled back to commit %d (%zu restored, %zu removed)\n", commit_id, restored, removed);
+        }
+    }
+    free_manifest(&target);
+    free_manifest(&current);
+    return result;
+}
+
+int current_commit(void) {
+    StoreHead head;
+    read_head(&head);
+    return head.head;
+}
+
+int for_each_commit_file(int commit_id, CommitFileVisitor visit, void *user_data) {
+    Manifest manifest;
+    if (load_manifest(commit_id, &manifest) != 0) {
+        return -1;
+    }
+    int result = 0;
+    for (size_t i = 0; result == 0 && i < manifest.file_count; i++) {
+        result = visit(&manifest.files[i], user_data);
+    }
+    free_manifest(&manifest);
+    return result;
+}
+
+const char* commit_file_path(const FileEntry *file) {
+    return file->path;
+}
+
+const char* commit_file_hash(const FileEntry *file) {
+    return file->hash;
+}
+
+char* read_commit_file(const FileEntry *file, size_t *size) {
+    char *content = assemble_file(file);
+    if (content) {
+        *size = file->size;
+    }
+    return content;
+}
+
+// Describe a block as its type and the start of its first line
+static void print_block(FILE *out, char sign, const Document *doc, const Node *node) {
+    size_t length = 0;
+    const char *text = mm_node_text(doc, node, &length);
+    while (text && length > 0 && (*text == '\n' || *text == '\r')) {
+        text++;
+        length--;
+    }
+    size_t line = 0;
+    while (text && line < length && line < 60 && text[line] != '\n' && text[line] != '\r') {
+        line++;
+    }
+    fprintf(out, "%c %s", sign, node_type_to_string(node->type));
+    if (line > 0) {
+        fprintf(out, ": %.*s%s", (int)line, text, line < length && text[line] != '\n' ? "..." : "");
+    }
+    fputc('\n', out);
+}
+
+int print_block_diff(FILE *out, const char *path, const char *old_content, size_t old_size,
+                     const char *new_content, size_t new_size) {
+    // Text without any block parses to NULL and compares as empty
+    Document *old_doc = old_content ? parse_metamark_view(old_content, old_size, NULL) : NULL;
+    Document *new_doc = new_content ? parse_metamark_view(new_content, new_size, NULL) : NULL;
+    MMDiff *diff = mm_diff_documents(old_doc, new_doc);
+    if (!diff) {
+        free_document(old_doc);
+        free_document(new_doc);
+        return -1;
+    }
+
+    if (diff->hunk_count > 0) {
+        fprintf(out, "--- %s\n+++ %s\n", old_content ? path : "/dev/null", new_content ? path : "/dev/null");
+    }
+    for (size_t i = 0; i < diff->hunk_count; i++) {
+        const MMDiffHunk *hunk = &diff->hunks[i];
+        fprintf(out, "@@ -%zu,%zu +%zu,%zu @@\n", hunk->old_first + 1, hunk->old_count,
+                hunk->new_first + 1, hunk->new_count);
+        for (size_t j = 0; j < hunk->old_count; j++) {
+            print_block(out, '-', old_doc, old_doc->root->children[hunk->old_first + j]);
+        }
+        for (size_t j = 0; j < hunk->new_count; j++) {
+            print_block(out, '+', new_doc, new_doc->root->children[hunk->new_first + j]);
+        }
+    }
+
+    int changed = diff->hunk_count > 0;
+    mm_diff_free(diff);
+    free_document(old_doc);
+    free_document(new_doc);
+    return changed;
+}
+
+int diff_versions(int commit_id) {
+    StoreHead head;
+    read_head(&head);
+    if (head.head == 0) {
+        print_error("No commits yet");
+        return 1;
+    }
+
+    // A commit against its parent, or the working tree against HEAD
+    Manifest old_side, new_side;
+    PathList paths = {0};
+    int against_worktree = commit_id == 0;
+    memset(&old_side, 0, sizeof(old_side));
+    memset(&new_side, 0, sizeof(new_side));
+    if (!against_worktree && load_manifest(commit_id, &new_side) != 0) {
+        fprintf(stderr, "Error: No commit %d\n", commit_id);
+        return 1;
+    }
+    int old_id = against_worktree ? head.head : new_side.parent;
+    if ((old_id > 0 && load_manifest(old_id, &old_side) != 0) ||
+        (against_worktree && path_list_add(&paths, ".") != 0)) {
+        print_error("Cannot read the versions to compare");
+        free_manifest(&new_side);
+        path_list_free(&paths);
+        return 1;
+    }
+    if (paths.count > 1) {
+        qsort(paths.items, paths.count, sizeof(char *), compare_paths);
+    }
+
+    // Paths of the new side, then those that only the old side has
+    size_t new_count = against_worktree ? paths.count : new_side.file_count;
+    size_t changed = 0;
+    int result = 0;
+    for (size_t i = 0; result == 0 && i < new_count + old_side.file_count; i++) {
+        const char *path;
+        if (i < new_count) {
+            path = against_worktree ? relative_path(paths.items[i]) : new_side.files[i].path;
+        } else {
+            path = old_side.files[i - new_count].path;
+            int found = against_worktree ? 0 : find_file(&new_side, path) != NULL;
+            for (size_t j = 0; against_worktree && !found && j < paths.count; j++) {
+                found = strcmp(relative_path(paths.items[j]), path) == 0;
+            }
+            if (found) {
+                continue;
+            }
+        }
+
+        const FileEntry *old_file = find_file(&old_side, path);
+        const FileEntry *new_file = i < new_count && !against_worktree ? &new_side.files[i] : NULL;
+        char *old_content = NULL, *new_content = NULL;
+        size_t new_size = 0;
+        if (i < new_count && against_worktree) {
+            if (read_file_content(path, &new_content, &new_size) != 0) {
+                result = 1;
+            }
+        } else if (new_file) {
+            new_content = assemble_file(new_file);
+            new_size = new_file->size;
+            result = new_content ? 0 : 1;
+        }
+
+        // Files with the same hash are skipped without parsing
+        char hash[SHA256_HEX_SIZE] = "";
+        if (new_content) {
+            sha256_hex(new_content, new_size, hash);
+        }
+        if (result == 0 && (!old_file || strcmp(old_file->hash, hash) != 0)) {
+            old_content = old_file ? assemble_file(old_file) : NULL;
+            if (old_file && !old_content) {
+                result = 1;
+            } else {
+                int printed = print_block_diff(stdout, path, old_content, old_file ? old_file->size : 0,
+                                               new_content, new_size);
+                result = printed < 0;
+                changed += printed > 0;
+            }
+        }
+        if (result != 0) {
+            fprintf(stderr, "Error: Cannot compare %s\n", path);
+        }
+        free(old_content);
+        free(new_content);
+    }
+
+    if (result == 0) {
+        printf("%zu file%s changed\n", changed, changed == 1 ? "" : "s");
+    }
+    free_manifest(&old_side);
+    free_manifest(&new_side);
+    path_list_free(&paths);
+    return result;
+}
@@ -1,8 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "../include/cli.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <glob.h>
+#endif
+
 int read_file_content(const char *filename, char **content, size_t *size) {
     FILE *file = fopen(filename, "rb");
     if (!file) {
@@ -45,45 +53,257 @@ int write_file_content(const char *filename, const char *content, size_t size) {
     return (written == size) ? 0 : -1;
 }
 
-// Export functions
-int export_to_pdf(const Node *doc, const char *output_path) {
-    // TODO: Implement PDF export
-    return -1;
+// Path collection
+static int path_list_push(PathList *list, const char *path) {
+    if (list->count == list->capacity) {
+        size_t new_capacity = list->capacity ? list->capacity * 2 : 16;
+        char **new_items = realloc(list->items, new_capacity * sizeof(char *));
+        if (!new_items) {
+            return -1;
+        }
+        list->items = new_items;
+        list->capacity = new_capacity;
+    }
+
+    size_t length = strlen(path);
+    char *copy = malloc(length + 1);
+    if (!copy) {
+        return -1;
+    }
+    memcpy(copy, path, length + 1);
+    list->items[list->count++] = copy;
+    return 0;
 }
 
-int export_to_html(const Node *doc, const char *output_path) {
-    // TODO: Implement HTML export
-    return -1;
+static int has_mmk_extension(const char *name) {
+    size_t length = strlen(name);
+    return length > 4 && strcmp(name + length - 4, ".mmk") == 0;
 }
 
-int export_to_json(const Node *doc, const char *output_path) {
-    // TODO: Implement JSON export
-    return -1;
+static int is_directory(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
 }
 
-// Security functions
-int sign_file(const char *file, const char *private_key_path) {
-    // TODO: Implement file signing
-    return 0;
+static int join_path(char *buffer, size_t size, const char *dir, const char *name) {
+    size_t length = strlen(dir);
+    int separator = length > 0 && dir[length - 1] != '/' && dir[length - 1] != '\\';
+    int written = snprintf(buffer, size, "%s%s%s", dir, separator ? "/" : "", name);
+    return written > 0 && (size_t)written < size ? 0 : -1;
 }
 
-int verify_signature(const char *file) {
-    // TODO: Implement signature verification
-    return 0;
+// Add every .mmk file below dir, recursing into subdirectories
+static int path_list_add_directory(PathList *list, const char *dir) {
+    char path[4096];
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    if (join_path(path, sizeof(path), dir, "*") != 0) {
+        return -1;
+    }
+    HANDLE find = FindFirstFileA(path, &entry);
+    if (find == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    int result = 0;
+    do {
+        const char *name = entry.cFileName;
+        if (name[0] == '.' || join_path(path, sizeof(path), dir, name) != 0) {
+            continue;
+        }
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            result = path_list_add_directory(list, path);
+        } else if (has_mmk_extension(name)) {
+            result = path_list_push(list, path);
+        }
+    } while (result == 0 && FindNextFileA(find, &entry));
+    FindClose(find);
+    return result;
+#else
+    DIR *handle = opendir(dir);
+    if (!handle) {
+        return -1;
+    }
+    int result = 0;
+    struct dirent *entry;
+    while (result == 0 && (entry = readdir(handle)) != NULL) {
+        const char *name = entry->d_name;
+        if (name[0] == '.' || join_path(path, sizeof(path), dir, name) != 0) {
+            continue;
+        }
+        if (is_directory(path)) {
+            result = path_list_add_directory(list, path);
+        } else if (has_mmk_extension(name)) {
+            result = path_list_push(list, path);
+        }
+    }
+    closedir(handle);
+    return result;
+#endif
 }
 
-// Version control functions
-int create_commit(const char *message, const char *author) {
-    // TODO: Implement commit creation
-    return 0;
+// Add the files matching a wildcard pattern
+static int path_list_add_glob(PathList *list, const char *pattern) {
+#ifdef _WIN32
+    // Wildcards are only supported in the last path component
+    char dir[4096];
+    const char *slash = strrchr(pattern, '\\');
+    const char *fwd = strrchr(pattern, '/');
+    if (!slash || (fwd && fwd > slash)) {
+        slash = fwd;
+    }
+    size_t dir_length = slash ? (size_t)(slash - pattern) : 0;
+    if (dir_length >= sizeof(dir)) {
+        return -1;
+    }
+    memcpy(dir, pattern, dir_length);
+    dir[dir_length] = '\0';
+
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA(pattern, &entry);
+    if (find == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    int result = 0;
+    do {
+        char path[4096];
+        if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+            join_path(path, sizeof(path), dir, entry.cFileName) == 0) {
+            result = path_list_push(list, path);
+        }
+    } while (result == 0 && FindNextFileA(find, &entry));
+    FindClose(find);
+    return result;
+#else
+    glob_t matches;
+    int status = glob(pattern, 0, NULL, &matches);
+    if (status == GLOB_NOMATCH) {
+        return 0;
+    }
+    if (status != 0) {
+        return -1;
+    }
+    int result = 0;
+    for (size_t i = 0; result == 0 && i < matches.gl_pathc; i++) {
+        const char *path = matches.gl_pathv[i];
+        result = is_directory(path) ? path_list_add_directory(list, path)
+                                    : path_list_push(list, path);
+    }
+    globfree(&matches);
+    return result;
+#endif
 }
 
-int get_commit_history(void) {
-    // TODO: Implement commit history
-    return 0;
+int path_list_add(PathList *list, const char *arg) {
+    if (strpbrk(arg, "*?[")) {
+        return path_list_add_glob(list, arg);
+    }
+    if (is_directory(arg)) {
+        return path_list_add_directory(list, arg);
+    }
+    // Plain files are kept even if missing so the error is reported per file
+    return path_list_push(list, arg);
 }
 
-int rollback_to_commit(int commit_id) {
-    // TODO: Implement rollback
-    return 0;
-} 
\ No newline at end of file
+void path_list_free(PathList *list) {
+    for (size_t i = 0; i < list->count; i++) {
+        free(list->items[i]);
+    }
+    free(list->items);
+    list->items = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+// Export functions
+static int write_to_stream(const char *data, size_t length, void *user_data) {
+    return fwrite(data, 1, length, (FILE *)user_data) == length ? 0 : -1;
+}
+
+int export_to_pdf(const Document *doc, const char *output_path, size_t threads) {
+    int to_stdout = strcmp(output_path, "-") == 0;
+    FILE *file = to_stdout ? stdout : fopen(output_path, "wb");
+    if (!file) {
+        return -1;
+    }
+
+    // Pages are written as they fill up; let stdio batch the small objects
+    MMPdfOptions options = {0};
+    options.threads = threads;
+    int result = mm_render_pdf(doc, &options, write_to_stream, file);
+
+    if (to_stdout) {
+        return fflush(file) == 0 && result == 0 ? 0 : -1;
+    }
+    return fclose(file) == 0 && result == 0 ? 0 : -1;
+}
+
+int export_to_html(const Document *doc, const char *output_path) {
+    int to_stdout = strcmp(output_path, "-") == 0;
+    FILE *file = to_stdout ? stdout : fopen(output_path, "wb");
+    if (!file) {
+        return -1;
+    }
+
+    // The renderer hands over large chunks; write them straight through
+    if (!to_stdout) {
+        setvbuf(file, NULL, _IONBF, 0);
+    }
+    int result = mm_render_html(doc, MM_HTML_STANDALONE, write_to_stream, file);
+
+    if (to_stdout) {
+        return fflush(file) == 0 && result == 0 ? 0 : -1;
+    }
+    return fclose(file) == 0 && result == 0 ? 0 : -1;
+}
+
+// Stream a document through the streaming parser into the JSON writer
+static int write_json_node(Node *node, void *user_data) {
+    return mm_json_writer_node(user_data, NULL, node);
+}
+
+int export_to_json(const char *input_path, const char *output_path, unsigned flags) {
+    FILE *input = fopen(input_path, "rb");
+    if (!input) {
+        return -1;
+    }
+    int to_stdout = strcmp(output_path, "-") == 0;
+    FILE *file = to_stdout ? stdout : fopen(output_path, "wb");
+    if (!file) {
+        fclose(input);
+        return -1;
+    }
+    if (!to_stdout) {
+        setvbuf(file, NULL, _IONBF, 0);
+    }
+
+    // Only one chunk and one block are ever held, whatever the file size
+    MMJsonWriter *writer = mm_json_writer_new(flags, write_to_stream, file);
+    MMParser *parser = writer ? mm_parser_new(write_json_node, writer) : NULL;
+    int result = parser ? 0 : -1;
+    char chunk[65536];
+    size_t n;
+    while (result == 0 && (n = fread(chunk, 1, sizeof(chunk), input)) > 0) {
+        result = mm_parser_feed(parser, chunk, n);
+    }
+    if (result == 0 && ferror(input)) {
+        result = -1;
+    }
+
+    // The document only carries the metadata; an empty file has no nodes
+    Document *doc = result == 0 ? mm_parser_finish(parser) : NULL;
+    if (result == 0 && !doc && get_last_error() != MM_ERROR_SYNTAX) {
+        result = -1;
+    }
+    if (result == 0) {
+        result = mm_json_writer_finish(writer, doc);
+    }
+
+    free_document(doc);
+    mm_parser_free(parser);
+    mm_json_writer_free(writer);
+    fclose(input);
+    if (to_stdout) {
+        return fflush(file) == 0 && result == 0 ? 0 : -1;
+    }
+    return fclose(file) == 0 && result == 0 ? 0 : -1;
+}
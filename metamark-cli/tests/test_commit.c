@@ -7,13 +7,18 @@ TestResult test_commit_valid_message(void) {
     ASSERT(write_test_file("test_repo/test.mmk", SAMPLE_MMK_CONTENT),
            "Failed to create test file");
 
-    // Test commit command
+    // Test commit command; the store lives in the current directory
+    ASSERT(change_test_directory("test_repo"), "Failed to enter test directory");
     char *argv[] = {"mmk", "commit", "-m", "Test commit"};
     int result = handle_commit(4, argv);
+    char *head = read_test_file(".mmk/HEAD");
+    change_test_directory("..");
 
     // Clean up
-    remove("test_repo/test.mmk");
-    remove_test_directory("test_repo");
+    remove_test_tree("test_repo");
+
+    ASSERT(head != NULL && strcmp(head, "head 1\nlast 1\n") == 0, "Commit was not recorded");
+    free(head);
 
     ASSERT(result == 0, "Commit command failed");
     TEST_PASS();
@@ -46,17 +51,154 @@ TestResult test_commit_invalid_args(void) {
     TEST_PASS();
 }
 
+// Build a document of numbered paragraphs, one of them replaced by edit
+static char* build_paragraphs(size_t count, size_t edited, const char *edit) {
+    char *text = malloc(count * 96 + strlen(edit) + 1);
+    size_t length = 0;
+    for (size_t i = 0; text && i < count; i++) {
+        if (i == edited) {
+            length += sprintf(text + length, "%s\n\n", edit);
+        } else {
+            length += sprintf(text + length, "Paragraph %zu talks about topic %zu at some length.\n\n",
+                              i, i * 7 % 13);
+        }
+    }
+    return text;
+}
+
+TestResult test_commit_chunking(void) {
+    char *original = build_paragraphs(2000, 2000, "");
+    char *edited = build_paragraphs(2000, 1000, "A paragraph rewritten in the middle.");
+    ASSERT(original != NULL && edited != NULL, "Failed to build documents");
+
+    // An edit only changes the chunks around it
+    size_t size = strlen(original);
+    size_t edited_size = strlen(edited);
+    size_t ends[512], edited_ends[512];
+    size_t count = split_chunks(original, size, ends, 512);
+    size_t edited_count = split_chunks(edited, edited_size, edited_ends, 512);
+    ASSERT(count > 8 && count <= 512 && edited_count <= 512, "Unexpected chunk count");
+    ASSERT(ends[count - 1] == size, "Chunks must cover the document");
+
+    size_t shared = 0;
+    for (size_t i = 0, start = 0; i < edited_count; start = edited_ends[i++]) {
+        for (size_t j = 0, other = 0; j < count; other = ends[j++]) {
+            if (ends[j] - other == edited_ends[i] - start &&
+                memcmp(original + other, edited + start, ends[j] - other) == 0) {
+                shared++;
+                break;
+            }
+        }
+    }
+    ASSERT(edited_count - shared <= 2, "Edit changed chunks far from it");
+
+    // Chunks compress and round-trip
+    unsigned char *packed = malloc(lz_bound(size));
+    char *unpacked = malloc(size);
+    ASSERT(packed != NULL && unpacked != NULL, "Allocation failed");
+    size_t packed_size = lz_compress(original, size, packed);
+    int round_trip = lz_decompress(packed, packed_size, unpacked, size) == 0 &&
+                     memcmp(unpacked, original, size) == 0;
+    int truncated = lz_decompress(packed, packed_size / 2, unpacked, size);
+
+    free(packed);
+    free(unpacked);
+    free(original);
+    free(edited);
+    ASSERT(packed_size < size / 2, "Chunk did not compress");
+    ASSERT(round_trip, "Compressed chunk did not round-trip");
+    ASSERT(truncated == -1, "Truncated chunk was accepted");
+    TEST_PASS();
+}
+
+TestResult test_commit_rollback(void) {
+    char *first = build_paragraphs(200, 200, "");
+    char *second = build_paragraphs(200, 50, "Changed paragraph.");
+    ASSERT(first != NULL && second != NULL, "Failed to build documents");
+    ASSERT(create_test_directory("test_repo"), "Failed to create test directory");
+    ASSERT(change_test_directory("test_repo"), "Failed to enter test directory");
+    create_test_directory("notes");
+
+    char *commit[] = {"mmk", "commit", "-m", "First"};
+    char *rollback_first[] = {"mmk", "rollback", "--to", "1"};
+    char *rollback_second[] = {"mmk", "rollback", "--to", "2"};
+    char *rollback_missing[] = {"mmk", "rollback", "--to", "9"};
+    char *log[] = {"mmk", "log"};
+
+    write_test_file("notes/doc.mmk", first);
+    write_test_file("extra.mmk", SAMPLE_MMK_CONTENT);
+    int committed = handle_commit(4, commit) == 0;
+    write_test_file("notes/doc.mmk", second);
+    remove("extra.mmk");
+    committed = committed && handle_commit(4, commit) == 0;
+    int unchanged = handle_commit(4, commit) == 0;
+    char *head = read_test_file(".mmk/HEAD");
+
+    // Rolling back restores and removes files
+    int rolled_back = handle_rollback(4, rollback_first) == 0;
+    char *restored = read_test_file("notes/doc.mmk");
+    char *extra = read_test_file("extra.mmk");
+    int restored_first = restored && strcmp(restored, first) == 0 &&
+                         extra && strcmp(extra, SAMPLE_MMK_CONTENT) == 0;
+    free(restored);
+    free(extra);
+    rolled_back = rolled_back && handle_rollback(4, rollback_second) == 0;
+    restored = read_test_file("notes/doc.mmk");
+    FILE *removed = fopen("extra.mmk", "rb");
+    int restored_second = restored && strcmp(restored, second) == 0 && !removed;
+    free(restored);
+    if (removed) {
+        fclose(removed);
+    }
+
+    // Uncommitted work is never overwritten
+    write_test_file("notes/doc.mmk", "# Draft\n");
+    int refused = handle_rollback(4, rollback_first) == 1;
+    restored = read_test_file("notes/doc.mmk");
+    refused = refused && restored && strcmp(restored, "# Draft\n") == 0;
+    free(restored);
+    int missing = handle_rollback(4, rollback_missing) == 1;
+    int logged = handle_log(2, log) == 0;
+
+    // A manifest naming a later commit as its parent ends the log
+    char *manifest = read_test_file(".mmk/commits/1");
+    char *parent = manifest ? strstr(manifest, "parent 0") : NULL;
+    if (parent) {
+        parent[7] = '2';
+        write_test_file(".mmk/commits/1", manifest);
+    }
+    int cycle = parent && handle_log(2, log) == 1;
+    free(manifest);
+
+    change_test_directory("..");
+    remove_test_tree("test_repo");
+    free(first);
+    free(second);
+
+    ASSERT(committed && unchanged, "Commit command failed");
+    ASSERT(head != NULL && strcmp(head, "head 2\nlast 2\n") == 0, "Unchanged tree was committed");
+    free(head);
+    ASSERT(rolled_back && restored_first && restored_second, "Rollback did not restore the files");
+    ASSERT(refused, "Rollback overwrote uncommitted changes");
+    ASSERT(missing, "Rollback to a missing commit should fail");
+    ASSERT(logged, "Log command failed");
+    ASSERT(cycle, "Log should stop at an invalid parent");
+    TEST_PASS();
+}
+
 // Test suite definition
 TestFunction commit_tests[] = {
     test_commit_valid_message,
     test_commit_empty_message,
     test_commit_missing_message,
     test_commit_invalid_args,
+    test_commit_chunking,
+    test_commit_rollback,
     NULL
 };
 
 TestSuite commit_suite = {
     .name = "Commit Command Tests",
     .tests = commit_tests,
-    .test_count = 4
+    .test_count = 6
 }; 
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "test_framework.h"
+#include "../include/cli.h"
+
+// Run print_block_diff into a temporary file and return what it wrote
+static char* capture_block_diff(const char *old_content, const char *new_content, int *result) {
+    FILE *out = tmpfile();
+    if (!out) {
+        return NULL;
+    }
+    *result = print_block_diff(out, "doc.mmk", old_content, old_content ? strlen(old_content) : 0,
+                               new_content, new_content ? strlen(new_content) : 0);
+    long size = ftell(out);
+    char *text = malloc(size + 1);
+    rewind(out);
+    if (text) {
+        text[fread(text, 1, size, out)] = '\0';
+    }
+    fclose(out);
+    return text;
+}
+
+TestResult test_diff_blocks(void) {
+    const char *old_content = "# Title\n\nFirst paragraph.\n\nSecond paragraph.\n\nLast.\n";
+    const char *new_content = "# Title\n\nFirst paragraph.\n\nRewritten paragraph.\n\nLast.\n";
+
+    int result = -1;
+    char *text = capture_block_diff(old_content, new_content, &result);
+    ASSERT(text != NULL, "Failed to capture diff output");
+    bool expected = strstr(text, "@@ -3,1 +3,1 @@\n") != NULL &&
+                    strstr(text, "- PARAGRAPH: Second paragraph.\n") != NULL &&
+                    strstr(text, "+ PARAGRAPH: Rewritten paragraph.\n") != NULL &&
+                    strstr(text, "First") == NULL;
+    free(text);
+    ASSERT(result == 1, "Changed document should report a difference");
+    ASSERT(expected, "Diff should list only the changed block");
+
+    text = capture_block_diff(old_content, old_content, &result);
+    ASSERT(text != NULL && text[0] == '\0' && result == 0, "Identical documents should print nothing");
+    free(text);
+
+    text = capture_block_diff(NULL, "# New\n", &result);
+    expected = text && strstr(text, "--- /dev/null\n") && strstr(text, "+ HEADING: New\n");
+    free(text);
+    ASSERT(result == 1 && expected, "Added file should list its blocks");
+    TEST_PASS();
+}
+
+TestResult test_diff_commits(void) {
+    ASSERT(create_test_directory("test_repo"), "Failed to create test directory");
+    ASSERT(change_test_directory("test_repo"), "Failed to enter test directory");
+
+    char *commit[] = {"mmk", "commit", "-m", "First"};
+    char *latest[] = {"mmk", "diff", "--latest"};
+    char *first[] = {"mmk", "diff", "--commit", "1"};
+    char *second[] = {"mmk", "diff", "--commit", "2"};
+    char *missing[] = {"mmk", "diff", "--commit", "7"};
+
+    int no_commits = handle_diff(3, latest) == 1;
+    write_test_file("doc.mmk", SAMPLE_MMK_CONTENT);
+    int committed = handle_commit(4, commit) == 0;
+    write_test_file("doc.mmk", "# Title\n\nChanged.\n");
+    int worktree = handle_diff(3, latest) == 0 && handle_diff(2, latest) == 0;
+    committed = committed && handle_commit(4, commit) == 0;
+    int commits = handle_diff(4, first) == 0 && handle_diff(4, second) == 0;
+    int unknown = handle_diff(4, missing) == 1;
+
+    change_test_directory("..");
+    remove_test_tree("test_repo");
+
+    ASSERT(no_commits, "Diff without commits should fail");
+    ASSERT(committed, "Commit command failed");
+    ASSERT(worktree, "Diff of the working tree failed");
+    ASSERT(commits, "Diff of a commit failed");
+    ASSERT(unknown, "Diff of a missing commit should fail");
+    TEST_PASS();
+}
+
+TestResult test_diff_invalid_args(void) {
+    char *argv[] = {"mmk", "diff", "--commit", "x"};
+    char *extra[] = {"mmk", "diff", "--latest", "now"};
+    ASSERT(handle_diff(4, argv) == 1, "Diff should reject a bad commit number");
+    ASSERT(handle_diff(4, extra) == 1, "Diff should reject extra arguments");
+    TEST_PASS();
+}
+
+// Test suite definition
+TestFunction diff_tests[] = {
+    test_diff_blocks,
+    test_diff_commits,
+    test_diff_invalid_args,
+    NULL
+};
+
+TestSuite diff_suite = {
+    .name = "Diff Command Tests",
+    .tests = diff_tests,
+    .test_count = 3
+};
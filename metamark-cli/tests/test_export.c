@@ -7,14 +7,23 @@ TestResult test_export_pdf(void) {
            "Failed to create test file");
 
     // Test export command
-    char *argv[] = {"mmk", "export", "--format", "pdf"};
-    int result = handle_export(4, argv);
+    char *argv[] = {"mmk", "export", "--format", "pdf", "--jobs", "2", "test.mmk"};
+    char *no_input[] = {"mmk", "export", "--format", "pdf"};
+    int result = handle_export(7, argv);
+    char *pdf = read_test_file("test.pdf");
+    int usage = handle_export(4, no_input);
 
     // Clean up
     remove("test.mmk");
     remove("test.pdf");
 
     ASSERT(result == 0, "PDF export failed");
+    ASSERT(pdf != NULL, "PDF file was not written");
+    bool complete = strncmp(pdf, "%PDF-", 5) == 0 && strstr(pdf, "%%EOF") != NULL &&
+                    strstr(pdf, "/Type /Page ") != NULL;
+    free(pdf);
+    ASSERT(complete, "PDF export did not write a complete file");
+    ASSERT(usage == 1, "PDF export without an input should fail");
     TEST_PASS();
 }
 
@@ -24,14 +33,59 @@ TestResult test_export_html(void) {
            "Failed to create test file");
 
     // Test export command
-    char *argv[] = {"mmk", "export", "--format", "html"};
-    int result = handle_export(4, argv);
+    char *argv[] = {"mmk", "export", "--format", "html", "test.mmk"};
+    int result = handle_export(5, argv);
+    char *html = read_test_file("test.html");
 
     // Clean up
     remove("test.mmk");
     remove("test.html");
 
     ASSERT(result == 0, "HTML export failed");
+    ASSERT(html != NULL, "HTML file was not written");
+    bool complete = strstr(html, "<!DOCTYPE html>") != NULL && strstr(html, "</html>") != NULL;
+    free(html);
+    ASSERT(complete, "HTML export did not write a complete page");
+    TEST_PASS();
+}
+
+TestResult test_export_html_output(void) {
+    ASSERT(write_test_file("test.mmk", "# Title\n\nFish & chips\n"),
+           "Failed to create test file");
+
+    // Test export command with an explicit output path
+    char *argv[] = {"mmk", "export", "--format", "html", "-o", "out.html", "test.mmk"};
+    int result = handle_export(7, argv);
+    char *html = read_test_file("out.html");
+
+    // Two inputs cannot share one output
+    char *argv_many[] = {"mmk", "export", "--format", "html", "-o", "out.html",
+                         "test.mmk", "test.mmk"};
+    int many = handle_export(8, argv_many);
+
+    // Clean up
+    remove("test.mmk");
+    remove("out.html");
+
+    ASSERT(result == 0, "HTML export with output path failed");
+    ASSERT(html != NULL, "HTML file was not written");
+    bool rendered = strstr(html, "<h1>Title</h1>") != NULL &&
+                    strstr(html, "<p>Fish &amp; chips</p>") != NULL;
+    free(html);
+    ASSERT(rendered, "HTML export did not render the document");
+    ASSERT(many == 1, "Export should fail with several inputs and one output");
+    TEST_PASS();
+}
+
+TestResult test_export_html_missing_input(void) {
+    // HTML export needs something to render
+    char *argv[] = {"mmk", "export", "--format", "html"};
+    int result = handle_export(4, argv);
+    char *argv_missing[] = {"mmk", "export", "--format", "html", "nonexistent.mmk"};
+    int missing = handle_export(5, argv_missing);
+
+    ASSERT(result == 1, "HTML export should fail without input files");
+    ASSERT(missing == 1, "HTML export should fail for a missing file");
     TEST_PASS();
 }
 
@@ -41,14 +95,45 @@ TestResult test_export_json(void) {
            "Failed to create test file");
 
     // Test export command
-    char *argv[] = {"mmk", "export", "--format", "json"};
-    int result = handle_export(4, argv);
+    char *argv[] = {"mmk", "export", "--format", "json", "test.mmk"};
+    int result = handle_export(5, argv);
+    char *json = read_test_file("test.json");
 
     // Clean up
     remove("test.mmk");
     remove("test.json");
 
     ASSERT(result == 0, "JSON export failed");
+    ASSERT(json != NULL, "JSON file was not written");
+    bool complete = strstr(json, "\"type\": \"DOCUMENT\"") != NULL &&
+                    strstr(json, "\"content\": \"Section 2\"") != NULL &&
+                    strstr(json, "\"metadata\": {}") != NULL;
+    free(json);
+    ASSERT(complete, "JSON export did not write the document");
+    TEST_PASS();
+}
+
+TestResult test_export_json_flags(void) {
+    ASSERT(write_test_file("test.mmk", "---\ntitle: T\n---\n# Title\n"),
+           "Failed to create test file");
+
+    // Test compact export with offsets to an explicit output path
+    char *argv[] = {"mmk", "export", "--format", "json", "--compact", "--offsets",
+                    "-o", "out.json", "test.mmk"};
+    int result = handle_export(9, argv);
+    char *json = read_test_file("out.json");
+
+    // Clean up
+    remove("test.mmk");
+    remove("out.json");
+
+    ASSERT(result == 0, "JSON export with flags failed");
+    ASSERT(json != NULL, "JSON file was not written");
+    bool written = strstr(json, "{\"type\":\"HEADING\",\"level\":1,\"content\":\"Title\","
+                                "\"offset\":19,\"length\":5}") != NULL &&
+                   strstr(json, "\"metadata\":{\"title\":\"T\"}}") != NULL;
+    free(json);
+    ASSERT(written, "JSON export did not honor --compact and --offsets");
     TEST_PASS();
 }
 
@@ -74,7 +159,10 @@ TestResult test_export_missing_format(void) {
 TestFunction export_tests[] = {
     test_export_pdf,
     test_export_html,
+    test_export_html_output,
+    test_export_html_missing_input,
     test_export_json,
+    test_export_json_flags,
     test_export_invalid_format,
     test_export_missing_format,
     NULL
@@ -83,5 +171,5 @@ TestFunction export_tests[] = {
 TestSuite export_suite = {
     .name = "Export Command Tests",
     .tests = export_tests,
-    .test_count = 5
+    .test_count = 8
 }; 
\ No newline at end of file
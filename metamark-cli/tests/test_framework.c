@@ -3,6 +3,10 @@
 #include <errno.h>
 #ifdef _WIN32
 #include <direct.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
 #endif
 
 // Test statistics
@@ -128,4 +132,56 @@ bool remove_test_directory(const char *dirname) {
 #else
     return rmdir(dirname) == 0;
 #endif
-} 
\ No newline at end of file
+}
+
+bool remove_test_tree(const char *dirname) {
+    char path[4096];
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    snprintf(path, sizeof(path), "%s\\*", dirname);
+    HANDLE find = FindFirstFileA(path, &entry);
+    if (find != INVALID_HANDLE_VALUE) {
+        do {
+            const char *name = entry.cFileName;
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+                continue;
+            }
+            snprintf(path, sizeof(path), "%s\\%s", dirname, name);
+            if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                remove_test_tree(path);
+            } else {
+                remove(path);
+            }
+        } while (FindNextFileA(find, &entry));
+        FindClose(find);
+    }
+#else
+    DIR *handle = opendir(dirname);
+    if (handle) {
+        struct dirent *entry;
+        while ((entry = readdir(handle)) != NULL) {
+            const char *name = entry->d_name;
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+                continue;
+            }
+            snprintf(path, sizeof(path), "%s/%s", dirname, name);
+            struct stat st;
+            if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+                remove_test_tree(path);
+            } else {
+                remove(path);
+            }
+        }
+        closedir(handle);
+    }
+#endif
+    return remove_test_directory(dirname);
+}
+
+bool change_test_directory(const char *dirname) {
+#ifdef _WIN32
+    return _chdir(dirname) == 0;
+#else
+    return chdir(dirname) == 0;
+#endif
+}
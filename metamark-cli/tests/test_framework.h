@@ -47,6 +47,8 @@ char* read_test_file(const char *filename);
 bool write_test_file(const char *filename, const char *content);
 bool create_test_directory(const char *dirname);
 bool remove_test_directory(const char *dirname);
+bool remove_test_tree(const char *dirname);
+bool change_test_directory(const char *dirname);
 
 // Test data
 extern const char *SAMPLE_MMK_CONTENT;
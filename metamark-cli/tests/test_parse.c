@@ -51,17 +51,84 @@ TestResult test_parse_empty_file(void) {
     TEST_PASS();
 }
 
+TestResult test_parse_directory_jobs(void) {
+    // Create a directory of documents
+    ASSERT(create_test_directory("parse_jobs"), "Failed to create test directory");
+    ASSERT(write_test_file("parse_jobs/a.mmk", SAMPLE_MMK_CONTENT), "Failed to create test file");
+    ASSERT(write_test_file("parse_jobs/b.mmk", "# B\n"), "Failed to create test file");
+    ASSERT(write_test_file("parse_jobs/notes.txt", "not a document"), "Failed to create test file");
+
+    // Test parse command over the directory
+    char *argv[] = {"mmk", "parse", "--jobs", "2", "parse_jobs"};
+    int result = handle_parse(5, argv);
+
+    // Clean up
+    remove("parse_jobs/a.mmk");
+    remove("parse_jobs/b.mmk");
+    remove("parse_jobs/notes.txt");
+    remove_test_directory("parse_jobs");
+
+    ASSERT(result == 0, "Parse command failed for directory");
+    TEST_PASS();
+}
+
+TestResult test_parse_jobs_reports_failures(void) {
+    ASSERT(write_test_file("test.mmk", SAMPLE_MMK_CONTENT), "Failed to create test file");
+
+    // One readable file and one missing file
+    char *argv[] = {"mmk", "parse", "--jobs", "2", "test.mmk", "nonexistent.mmk"};
+    int result = handle_parse(6, argv);
+
+    // Clean up
+    remove("test.mmk");
+
+    ASSERT(result == 1, "Parse command should fail when a file fails");
+    TEST_PASS();
+}
+
+TestResult test_parse_invalid_jobs(void) {
+    // Test with a job count that is not a positive number
+    char *argv[] = {"mmk", "parse", "--jobs", "zero", "test.mmk"};
+    int result = handle_parse(5, argv);
+
+    ASSERT(result == 1, "Parse command should fail with invalid --jobs");
+    TEST_PASS();
+}
+
+TestResult test_parse_stats(void) {
+    ASSERT(write_test_file("stats.mmk", SAMPLE_MMK_CONTENT), "Failed to create test file");
+
+    // A single file prints its AST followed by the statistics
+    char *argv[] = {"mmk", "parse", "--stats", "stats.mmk"};
+    int result = handle_parse(4, argv);
+
+    // Several files are parsed serially and failures still count
+    char *batch_argv[] = {"mmk", "parse", "--stats", "--jobs", "2", "stats.mmk", "nonexistent.mmk"};
+    int batch_result = handle_parse(7, batch_argv);
+
+    remove("stats.mmk");
+
+    ASSERT(result == 0, "Parse command failed with --stats");
+    ASSERT(batch_result == 1, "Parse command should fail when a file fails with --stats");
+    ASSERT(mm_parse_stats(NULL) == NULL, "Parse command left statistics collecting");
+    TEST_PASS();
+}
+
 // Test suite definition
 TestFunction parse_tests[] = {
     test_parse_valid_file,
     test_parse_invalid_file,
     test_parse_invalid_args,
     test_parse_empty_file,
+    test_parse_directory_jobs,
+    test_parse_jobs_reports_failures,
+    test_parse_invalid_jobs,
+    test_parse_stats,
     NULL
 };
 
 TestSuite parse_suite = {
     .name = "Parse Command Tests",
     .tests = parse_tests,
-    .test_count = 4
+    .test_count = 8
 }; 
\ No newline at end of file
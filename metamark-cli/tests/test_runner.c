@@ -3,7 +3,10 @@
 // Forward declarations of test suites
 extern TestSuite parse_suite;
 extern TestSuite commit_suite;
+extern TestSuite diff_suite;
 extern TestSuite export_suite;
+extern TestSuite secure_suite;
+extern TestSuite search_suite;
 
 int main(void) {
     printf("MetaMark CLI Test Suite\n");
@@ -12,7 +15,10 @@ int main(void) {
     // Run all test suites
     run_test_suite(parse_suite);
     run_test_suite(commit_suite);
+    run_test_suite(diff_suite);
     run_test_suite(export_suite);
+    run_test_suite(secure_suite);
+    run_test_suite(search_suite);
 
     // Print final summary
     print_test_summary();
@@ -0,0 +1,84 @@
+#include "test_framework.h"
+#include "../include/cli.h"
+
+static int count_hit(const MMSearchHit *hit, void *user_data) {
+    (void)hit;
+    (*(int *)user_data)++;
+    return 0;
+}
+
+// Count the hits of a query in the index the commands wrote
+static int count_indexed(const char *query) {
+    MMIndex *index = mm_index_load(MMK_INDEX_FILE);
+    int hits = 0;
+    if (!index || mm_index_search(index, query, count_hit, &hits) < 0) {
+        hits = -1;
+    }
+    mm_index_free(index);
+    return hits;
+}
+
+TestResult test_search_index(void) {
+    ASSERT(create_test_directory("test_repo"), "Failed to create test directory");
+    ASSERT(write_test_file("test_repo/notes.mmk",
+                           "---\ntitle: Notes\n---\n\n# Rocket Design\n\nThe engine burns methane.\n"),
+           "Failed to create test file");
+    ASSERT(write_test_file("test_repo/plan.mmk", "# Plan\n\nBuild the engine first.\n"),
+           "Failed to create test file");
+    ASSERT(change_test_directory("test_repo"), "Failed to enter test directory");
+
+    char *commit[] = {"mmk", "commit", "-m", "First"};
+    char *index[] = {"mmk", "index"};
+    char *search[] = {"mmk", "search", "--limit", "1", "engine"};
+    char *missing[] = {"mmk", "search", "engine"};
+
+    int no_index = handle_search(3, missing) == 1;
+    int committed = handle_commit(4, commit) == 0;
+    int indexed = handle_index(2, index) == 0;
+    int engine = count_indexed("engine");
+    int heading = count_indexed("heading:rocket");
+    int title = count_indexed("meta:title");
+    int searched = handle_search(5, search) == 0;
+
+    // Committing again refreshes the index from the changed file only
+    write_test_file("notes.mmk", "# Rocket Design\n\nThe engine burns hydrogen.\n");
+    remove("plan.mmk");
+    commit[3] = "Second";
+    int recommitted = handle_commit(4, commit) == 0;
+    int methane = count_indexed("methane");
+    int hydrogen = count_indexed("hydrogen engine");
+    int after = count_indexed("engine");
+    change_test_directory("..");
+    remove_test_tree("test_repo");
+
+    ASSERT(no_index, "Search should fail without an index");
+    ASSERT(committed && indexed, "Index should build from the commit");
+    ASSERT(engine == 2 && heading == 1 && title == 1, "Index should hold both files");
+    ASSERT(searched, "Search should succeed");
+    ASSERT(recommitted, "Commit should refresh the index");
+    ASSERT(methane == 0 && hydrogen == 1 && after == 1, "Index should follow the new commit");
+    TEST_PASS();
+}
+
+TestResult test_search_invalid_args(void) {
+    char *no_terms[] = {"mmk", "search"};
+    char *bad_limit[] = {"mmk", "search", "--limit", "0", "engine"};
+    char *bad_index[] = {"mmk", "index", "--full"};
+    ASSERT(handle_search(2, no_terms) == 1, "Search should require terms");
+    ASSERT(handle_search(5, bad_limit) == 1, "Search should reject a zero limit");
+    ASSERT(handle_index(3, bad_index) == 1, "Index should reject unknown options");
+    TEST_PASS();
+}
+
+// Test suite definition
+TestFunction search_tests[] = {
+    test_search_index,
+    test_search_invalid_args,
+    NULL
+};
+
+TestSuite search_suite = {
+    .name = "Search Command Tests",
+    .tests = search_tests,
+    .test_count = 2
+};
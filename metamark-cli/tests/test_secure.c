@@ -0,0 +1,153 @@
+#include "test_framework.h"
+#include "../include/cli.h"
+
+static void from_hex(const char *hex, uint8_t *out) {
+    for (size_t i = 0; hex[i * 2]; i++) {
+        unsigned value;
+        sscanf(hex + i * 2, "%2x", &value);
+        out[i] = (uint8_t)value;
+    }
+}
+
+TestResult test_crypto_vectors(void) {
+    // RFC 4231, test case 2
+    HmacSha256 hmac;
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    char hex[SHA256_HEX_SIZE];
+    hmac_sha256_init(&hmac, "Jefe", 4);
+    hmac_sha256_update(&hmac, "what do ya want ", 16);
+    hmac_sha256_update(&hmac, "for nothing?", 12);
+    hmac_sha256_final(&hmac, mac);
+    digest_to_hex(mac, hex);
+    ASSERT(strcmp(hex, "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843") == 0,
+           "HMAC-SHA256 does not match RFC 4231");
+
+    // GCM specification, test case 16
+    uint8_t key[32], iv[12], aad[20], plain[60], expected[60], tag[16];
+    uint8_t cipher[60], sealed_tag[16], opened[60];
+    from_hex("feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308", key);
+    from_hex("cafebabefacedbaddecaf888", iv);
+    from_hex("feedfacedeadbeeffeedfacedeadbeefabaddad2", aad);
+    from_hex("d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+             "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39", plain);
+    from_hex("522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+             "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662", expected);
+    from_hex("76fc6ece0f4e1768cddf8853bb2d551b", tag);
+
+    AesGcm gcm;
+    aes_gcm_init(&gcm, key);
+    for (int pass = 0; pass < 2; pass++) {
+        aes_gcm_seal(&gcm, iv, aad, sizeof(aad), plain, sizeof(plain), cipher, sealed_tag);
+        ASSERT(memcmp(cipher, expected, sizeof(cipher)) == 0, "AES-GCM ciphertext mismatch");
+        ASSERT(memcmp(sealed_tag, tag, sizeof(tag)) == 0, "AES-GCM tag mismatch");
+        ASSERT(aes_gcm_open(&gcm, iv, aad, sizeof(aad), cipher, sizeof(cipher), tag, opened) == 0 &&
+               memcmp(opened, plain, sizeof(plain)) == 0, "AES-GCM failed to open");
+        cipher[5] ^= 1;
+        ASSERT(aes_gcm_open(&gcm, iv, aad, sizeof(aad), cipher, sizeof(cipher), tag, opened) != 0,
+               "AES-GCM accepted a modified ciphertext");
+
+        // The portable code gives the same results
+        gcm.accelerated = 0;
+    }
+    TEST_PASS();
+}
+
+TestResult test_sign_verify(void) {
+    ASSERT(write_test_file("doc.mmk", SAMPLE_MMK_CONTENT), "Failed to create test file");
+    ASSERT(write_test_file("test.key", SAMPLE_PRIVATE_KEY), "Failed to create key file");
+    ASSERT(write_test_file("other.key", SAMPLE_PUBLIC_KEY), "Failed to create key file");
+
+    char *sign[] = {"mmk", "sign", "--key", "test.key", "doc.mmk"};
+    char *verify[] = {"mmk", "verify", "--key", "test.key", "doc.mmk"};
+    char *wrong_key[] = {"mmk", "verify", "--key", "other.key", "doc.mmk"};
+
+    int unsigned_fails = handle_verify(5, verify) == 1;
+    int signed_ok = handle_sign(5, sign) == 0;
+    char *signature = read_test_file("doc.mmk" MMK_SIGNATURE_SUFFIX);
+    int verified = handle_verify(5, verify) == 0;
+    int rejected_key = handle_verify(5, wrong_key) == 1;
+    write_test_file("doc.mmk", "# Tampered\n");
+    int rejected_change = handle_verify(5, verify) == 1;
+
+    remove("doc.mmk");
+    remove("doc.mmk" MMK_SIGNATURE_SUFFIX);
+    remove("test.key");
+    remove("other.key");
+
+    bool scheme = signature && strncmp(signature, "hmac-sha256 ", 12) == 0;
+    free(signature);
+    ASSERT(unsigned_fails, "Verify should fail without a signature");
+    ASSERT(signed_ok && scheme, "Sign should write a signature file");
+    ASSERT(verified, "Verify should accept the signature");
+    ASSERT(rejected_key, "Verify should reject another key");
+    ASSERT(rejected_change, "Verify should reject a modified file");
+    TEST_PASS();
+}
+
+TestResult test_seal_reveal(void) {
+    const char *document = "# Notes\n\n[[secure]]\nThe launch code is 1234.\n[[/secure]]\n\n"
+                           "Public text.\n";
+    ASSERT(write_test_file("secret.mmk", document), "Failed to create test file");
+    ASSERT(write_test_file("test.key", SAMPLE_PRIVATE_KEY), "Failed to create key file");
+    ASSERT(write_test_file("other.key", SAMPLE_PUBLIC_KEY), "Failed to create key file");
+
+    char *seal[] = {"mmk", "seal", "--key", "test.key", "secret.mmk"};
+    char *reveal[] = {"mmk", "reveal", "--key", "test.key", "--block", "1", "secret.mmk"};
+    char *wrong_key[] = {"mmk", "reveal", "--key", "other.key", "secret.mmk"};
+    char *missing[] = {"mmk", "reveal", "--key", "test.key", "--block", "2", "secret.mmk"};
+    char *renamed[] = {"mmk", "reveal", "--key", "test.key", "renamed.mmk"};
+
+    int sealed = handle_seal(5, seal) == 0;
+    char *first = read_test_file("secret.mmk");
+    int resealed = handle_seal(5, seal) == 0;
+    char *second = read_test_file("secret.mmk");
+    int revealed = handle_reveal(7, reveal) == 0;
+    int rejected = handle_reveal(5, wrong_key) == 1;
+    int no_block = handle_reveal(7, missing) == 1;
+
+    // A sealed body is bound to the name of its file
+    int moved = first && write_test_file("renamed.mmk", first) && handle_reveal(5, renamed) == 1;
+
+    remove("secret.mmk");
+    remove("renamed.mmk");
+    remove("test.key");
+    remove("other.key");
+
+    bool hidden = first && !strstr(first, "launch code") && strstr(first, "[[secure]]\naes-256-gcm:") &&
+                  strstr(first, "Public text.");
+    bool unchanged = first && second && strcmp(first, second) == 0;
+    free(first);
+    free(second);
+    ASSERT(sealed && hidden, "Seal should encrypt the secure block in place");
+    ASSERT(resealed && unchanged, "Sealed blocks should not be sealed again");
+    ASSERT(revealed, "Reveal should decrypt with the right key");
+    ASSERT(rejected, "Reveal should fail with another key");
+    ASSERT(no_block, "Reveal should fail for a missing block");
+    ASSERT(moved, "Reveal should fail for a renamed file");
+    TEST_PASS();
+}
+
+TestResult test_sign_invalid_args(void) {
+    char *no_files[] = {"mmk", "sign", "--key", "test.key"};
+    char *no_key[] = {"mmk", "verify", "--key"};
+    char *bad_block[] = {"mmk", "reveal", "--block", "0", "doc.mmk"};
+    ASSERT(handle_sign(4, no_files) == 1, "Sign should require a file");
+    ASSERT(handle_verify(3, no_key) == 1, "Verify should reject a missing key");
+    ASSERT(handle_reveal(5, bad_block) == 1, "Reveal should reject block 0");
+    TEST_PASS();
+}
+
+// Test suite definition
+TestFunction secure_tests[] = {
+    test_crypto_vectors,
+    test_sign_verify,
+    test_seal_reveal,
+    test_sign_invalid_args,
+    NULL
+};
+
+TestSuite secure_suite = {
+    .name = "Security Command Tests",
+    .tests = secure_tests,
+    .test_count = 4
+};
@@ -0,0 +1,983 @@
+/**
+ * @file bench_metamark.c
+ * @brief Throughput benchmarks for the MetaMark core library
+ *
+ * Generates synthetic corpora, times the parse, file, free and render
+ * entry points on each of them and writes the results as JSON. Given the
+ * JSON of an earlier run with --baseline, the exit status is 1 when any
+ * result regressed past the tolerance, so releases can be gated on it.
+ *
+ * On glibc the benchmark wraps malloc() and friends to count allocations
+ * and track the peak heap size of each operation. The operations run on
+ * one thread, so the counters are not synchronized.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <time.h>
+#include <math.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define BENCH_FORMAT_VERSION 1
+#define BENCH_DEFAULT_SIZE_MB 4.0
+#define BENCH_DEFAULT_ITERATIONS 5
+#define BENCH_DEFAULT_TOLERANCE 10.0
+
+/* ------------------------------------------------------------------------
+ * Allocation accounting
+ * ---------------------------------------------------------------------- */
+
+#if defined(__GLIBC__) && !defined(BENCH_NO_MALLOC_HOOKS)
+#define BENCH_COUNT_ALLOCS 1
+#include <malloc.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static size_t alloc_calls;    ///< malloc, calloc and realloc calls so far
+static long long live_bytes;  ///< Usable bytes currently allocated
+static long long peak_bytes;  ///< High-water mark of live_bytes
+
+static void note_alloc(void *ptr) {
+    alloc_calls++;
+    live_bytes += (long long)malloc_usable_size(ptr);
+    if (live_bytes > peak_bytes) {
+        peak_bytes = live_bytes;
+    }
+}
+
+void *malloc(size_t size) {
+    void *ptr = __libc_malloc(size);
+    if (ptr) {
+        note_alloc(ptr);
+    }
+    return ptr;
+}
+
+void *calloc(size_t count, size_t size) {
+    void *ptr = __libc_calloc(count, size);
+    if (ptr) {
+        note_alloc(ptr);
+    }
+    return ptr;
+}
+
+void *realloc(void *ptr, size_t size) {
+    long long old = ptr ? (long long)malloc_usable_size(ptr) : 0;
+    void *result = __libc_realloc(ptr, size);
+    if (result) {
+        live_bytes -= old;
+        note_alloc(result);
+    } else if (size == 0) {
+        live_bytes -= old;
+    }
+    return result;
+}
+
+void free(void *ptr) {
+    if (ptr) {
+        live_bytes -= (long long)malloc_usable_size(ptr);
+    }
+    __libc_free(ptr);
+}
+
+#define BENCH_ALLOCS_COUNTED 1
+#else
+#define BENCH_ALLOCS_COUNTED 0
+#endif
+
+/**
+ * @brief Allocation counters at the start of a measured operation
+ */
+typedef struct {
+    size_t calls;
+    long long live;
+} AllocMark;
+
+static AllocMark alloc_mark(void) {
+    AllocMark mark = { 0, 0 };
+#ifdef BENCH_COUNT_ALLOCS
+    mark.calls = alloc_calls;
+    mark.live = live_bytes;
+    peak_bytes = live_bytes;
+#endif
+    return mark;
+}
+
+/* ------------------------------------------------------------------------
+ * Clocks and memory
+ * ---------------------------------------------------------------------- */
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, count;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+/**
+ * @brief Get the peak resident set size of the process in kilobytes
+ */
+static long max_rss_kb(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return (long)(counters.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;   // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+/* ------------------------------------------------------------------------
+ * Corpus generation
+ * ---------------------------------------------------------------------- */
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+static void buffer_append(Buffer *buffer, const char *text, size_t length) {
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < buffer->length + length + 1) {
+            capacity *= 2;
+        }
+        char *data = realloc(buffer->data, capacity);
+        if (!data) {
+            fprintf(stderr, "bench_metamark: out of memory\n");
+            exit(2);
+        }
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->length, text, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+static void buffer_puts(Buffer *buffer, const char *text) {
+    buffer_append(buffer, text, strlen(text));
+}
+
+static void buffer_printf(Buffer *buffer, const char *format, ...) {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length > 0) {
+        buffer_append(buffer, text, (size_t)length < sizeof(text) ? (size_t)length : sizeof(text) - 1);
+    }
+}
+
+static uint64_t random_state;
+
+/**
+ * @brief xorshift64* generator, so every run sees the same corpus
+ */
+static uint32_t next_random(void) {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return (uint32_t)((random_state * 0x2545f4914f6cdd1dULL) >> 32);
+}
+
+static size_t random_between(size_t low, size_t high) {
+    return low + next_random() % (high - low + 1);
+}
+
+static const char *const words[] = {
+    "the", "parser", "reads", "a", "document", "and", "builds", "its", "tree",
+    "metadata", "renders", "quickly", "with", "every", "block", "of", "text",
+    "component", "annotation", "secure", "diagram", "section", "value", "key",
+    "stream", "arena", "buffer", "nodes", "offset", "length", "markup", "line"
+};
+
+static void append_words(Buffer *buffer, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) {
+            buffer_append(buffer, " ", 1);
+        }
+        buffer_puts(buffer, words[next_random() % (sizeof(words) / sizeof(words[0]))]);
+    }
+}
+
+/** @brief Long paragraphs under a heading every few paragraphs */
+static void generate_prose(Buffer *buffer, size_t target) {
+    size_t section = 0;
+    while (buffer->length < target) {
+        buffer_printf(buffer, "%.*s Section %zu\n\n", (int)(section % 3 + 1), "###", section);
+        section++;
+        for (size_t i = random_between(3, 8); i > 0; i--) {
+            append_words(buffer, random_between(40, 120));
+            buffer_puts(buffer, ".\n\n");
+        }
+    }
+}
+
+/** @brief Components, annotations and comments with short prose between */
+static void generate_components(Buffer *buffer, size_t target) {
+    size_t index = 0;
+    while (buffer->length < target) {
+        switch (next_random() % 5) {
+            case 0:
+                buffer_puts(buffer, "[[note]]\n");
+                append_words(buffer, random_between(5, 30));
+                buffer_puts(buffer, "\n[[/note]]\n\n");
+                break;
+            case 1:
+                buffer_puts(buffer, "[[diagram]]\ngraph TD\n");
+                for (size_t i = random_between(2, 12); i > 0; i--) {
+                    buffer_printf(buffer, "N%zu --> N%zu\n", index + i, index + i + 1);
+                }
+                buffer_puts(buffer, "[[/diagram]]\n\n");
+                break;
+            case 2:
+                buffer_puts(buffer, "[[secure]]\nU2FsdGVkX1");
+                for (size_t i = random_between(16, 64); i > 0; i--) {
+                    buffer_append(buffer, &"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[next_random() % 64], 1);
+                }
+                buffer_puts(buffer, "\n[[/secure]]\n\n");
+                break;
+            case 3:
+                buffer_puts(buffer, "> todo: ");
+                append_words(buffer, random_between(3, 12));
+                buffer_puts(buffer, "\n%% reviewer comment %%\n\n");
+                break;
+            default:
+                append_words(buffer, random_between(5, 20));
+                buffer_puts(buffer, "\n\n");
+                break;
+        }
+        index++;
+    }
+}
+
+/** @brief One frontmatter block with thousands of keys, then a short body */
+static void generate_frontmatter(Buffer *buffer, size_t target) {
+    buffer_puts(buffer, "---\n");
+    for (size_t i = 0; buffer->length + 64 < target; i++) {
+        buffer_printf(buffer, "key_%zu: ", i);
+        append_words(buffer, random_between(1, 6));
+        buffer_puts(buffer, "\n");
+    }
+    buffer_puts(buffer, "---\n# Body\n\nShort body.\n");
+}
+
+/** @brief Headings of every level and markup nested inside component bodies */
+static void generate_nested(Buffer *buffer, size_t target) {
+    size_t index = 0;
+    while (buffer->length < target) {
+        buffer_printf(buffer, "%.*s Level %zu\n\n", (int)(index % 6 + 1), "######", index % 6 + 1);
+        buffer_puts(buffer, "[[outer]]\n[[inner]]\n> note: inside\n%% still inside %%\n# not a heading\n");
+        append_words(buffer, random_between(2, 10));
+        buffer_puts(buffer, "\n[[/outer]]\n\n> todo: [[looks like a component]]\n\n");
+        index++;
+    }
+}
+
+/**
+ * @brief Malformed markup the parser recovers from, then unclosed delimiters
+ *
+ * Every fragment makes the parser report a syntax error and resume; the
+ * final ones leave a component and a comment open until the end of input.
+ */
+static void generate_pathological(Buffer *buffer, size_t target) {
+    static const char *const fragments[] = {
+        "> :\n",
+        ">\n",
+        "[[bad id]]\nbody\n[[/bad id]]\n",
+        "plain text > with a stray marker\n",
+        "#\n",
+        "%%%%\n"
+    };
+    while (buffer->length < target) {
+        buffer_puts(buffer, fragments[next_random() % (sizeof(fragments) / sizeof(fragments[0]))]);
+        append_words(buffer, random_between(1, 8));
+        buffer_puts(buffer, "\n\n");
+    }
+    buffer_puts(buffer, "[[open]]\nbody without a closing marker\n%% comment that never ends\n");
+}
+
+typedef struct {
+    const char *name;
+    void (*generate)(Buffer *buffer, size_t target);
+    double scale;   ///< Fraction of the requested size to generate
+} CorpusKind;
+
+static const CorpusKind corpora[] = {
+    { "prose", generate_prose, 1.0 },
+    { "components", generate_components, 1.0 },
+    { "frontmatter", generate_frontmatter, 0.25 },
+    { "nested", generate_nested, 1.0 },
+    { "pathological", generate_pathological, 1.0 }
+};
+
+/**
+ * @brief Hostile input made of one fragment repeated to the target size
+ */
+typedef struct {
+    const char *name;
+    const char *fragment;
+} AdversarialKind;
+
+/* Each fragment makes the scanner fail, give up early or look for a closer */
+static const AdversarialKind adversarial[] = {
+    { "empty_annotations", ">\n" },
+    { "typeless_annotations", "> :\n" },
+    { "bad_metadata", "---\nno colon\n" },
+    { "metadata_delimiters", "text\n---\n" },
+    { "unclosed_components", "[[open]]\n" },
+    { "unclosed_types", "[[open\n" },
+    { "unclosed_comments", "%% open\n" },
+    { "bad_components", "[[bad id]]\n[[/bad id]]\n" },
+    { "stray_closers", "[[/open]]\n" },
+    { "brackets", "[[[[]]]]" },
+    { "empty_headings", "#\n" },
+    { "markers", "a>b#c%%d---e[[f" }
+};
+
+static void generate_repeated(Buffer *buffer, const char *fragment, size_t target) {
+    size_t length = strlen(fragment);
+    while (buffer->length + length <= target) {
+        buffer_append(buffer, fragment, length);
+    }
+}
+
+/* ------------------------------------------------------------------------
+ * Measurement
+ * ---------------------------------------------------------------------- */
+
+typedef struct {
+    const char *corpus;
+    const char *operation;
+    size_t bytes;           ///< Input size
+    size_t nodes;           ///< Nodes in the parsed tree
+    double seconds;         ///< Fastest iteration
+    size_t allocations;     ///< Allocation calls of one iteration
+    long long peak_heap;    ///< Peak extra heap bytes of one iteration
+} Result;
+
+typedef struct {
+    Result *items;
+    size_t count;
+    size_t capacity;
+} ResultList;
+
+/** @brief Results bench_corpus() adds for one corpus */
+#define BENCH_OPERATIONS 7
+
+/**
+ * @brief Make room for more results, so pointers to them stay valid
+ */
+static void reserve_results(ResultList *list, size_t more) {
+    if (list->count + more <= list->capacity) {
+        return;
+    }
+    size_t capacity = list->capacity ? list->capacity : 32;
+    while (capacity < list->count + more) {
+        capacity *= 2;
+    }
+    Result *items = realloc(list->items, capacity * sizeof(Result));
+    if (!items) {
+        fprintf(stderr, "bench_metamark: out of memory\n");
+        exit(2);
+    }
+    list->items = items;
+    list->capacity = capacity;
+}
+
+static Result* add_result(ResultList *list, const char *corpus, const char *operation,
+                          size_t bytes, size_t nodes) {
+    reserve_results(list, 1);
+
+    Result *result = &list->items[list->count++];
+    memset(result, 0, sizeof(Result));
+    result->corpus = corpus;
+    result->operation = operation;
+    result->bytes = bytes;
+    result->nodes = nodes;
+    result->seconds = -1;
+    return result;
+}
+
+/**
+ * @brief Fold one timed iteration into a result
+ */
+static void record(Result *result, double seconds, AllocMark mark) {
+    if (result->seconds < 0 || seconds < result->seconds) {
+        result->seconds = seconds;
+    }
+#ifdef BENCH_COUNT_ALLOCS
+    result->allocations = alloc_calls - mark.calls;
+    if (peak_bytes - mark.live > result->peak_heap) {
+        result->peak_heap = peak_bytes - mark.live;
+    }
+#else
+    (void)mark;
+#endif
+}
+
+static size_t count_nodes(const Node *node) {
+    size_t count = 0;
+    MMWalker walker;
+    mm_walker_init(&walker, node, MM_WALK_ENTER);
+    while (mm_walker_next(&walker, NULL)) {
+        count++;
+    }
+    mm_walker_finish(&walker);
+    return count;
+}
+
+static int discard_output(const char *data, size_t length, void *user_data) {
+    (void)data;
+    *(size_t *)user_data += length;
+    return 0;
+}
+
+static void write_corpus_file(const char *path, const Buffer *corpus) {
+    FILE *file = fopen(path, "wb");
+    if (!file || fwrite(corpus->data, 1, corpus->length, file) != corpus->length) {
+        fprintf(stderr, "bench_metamark: cannot write %s\n", path);
+        exit(2);
+    }
+    fclose(file);
+}
+
+/**
+ * @brief Run every operation on one corpus
+ */
+static void bench_corpus(ResultList *list, const char *name, const Buffer *corpus,
+                         int iterations, const char *path) {
+    reserve_results(list, BENCH_OPERATIONS);
+
+    Document *doc = parse_metamark(corpus->data);
+    size_t nodes = doc ? count_nodes(doc->root) : 0;
+    free_document(doc);
+
+    Result *parse = add_result(list, name, "parse_metamark", corpus->length, nodes);
+    Result *release = add_result(list, name, "free_document", corpus->length, nodes);
+    for (int i = 0; i < iterations; i++) {
+        AllocMark mark = alloc_mark();
+        double start = now_seconds();
+        doc = parse_metamark(corpus->data);
+        record(parse, now_seconds() - start, mark);
+
+        mark = alloc_mark();
+        start = now_seconds();
+        free_document(doc);
+        record(release, now_seconds() - start, mark);
+    }
+
+    Result *view = add_result(list, name, "parse_metamark_view", corpus->length, nodes);
+    for (int i = 0; i < iterations; i++) {
+        AllocMark mark = alloc_mark();
+        double start = now_seconds();
+        doc = parse_metamark_view(corpus->data, corpus->length, NULL);
+        record(view, now_seconds() - start, mark);
+        free_document(doc);
+    }
+
+    write_corpus_file(path, corpus);
+    Result *file = add_result(list, name, "read_metamark_file", corpus->length, nodes);
+    Result *mapped = add_result(list, name, "read_metamark_file_mapped", corpus->length, nodes);
+    for (int i = 0; i < iterations; i++) {
+        AllocMark mark = alloc_mark();
+        double start = now_seconds();
+        doc = read_metamark_file(path);
+        record(file, now_seconds() - start, mark);
+        free_document(doc);
+
+        mark = alloc_mark();
+        start = now_seconds();
+        doc = read_metamark_file_mapped(path);
+        record(mapped, now_seconds() - start, mark);
+        free_document(doc);
+    }
+    remove(path);
+
+    doc = parse_metamark(corpus->data);
+    if (!doc) {
+        return;
+    }
+    Result *html = add_result(list, name, "render_metamark_html", corpus->length, nodes);
+    Result *json = add_result(list, name, "mm_write_json", corpus->length, nodes);
+    for (int i = 0; i < iterations; i++) {
+        AllocMark mark = alloc_mark();
+        double start = now_seconds();
+        char *rendered = render_metamark_html(doc);
+        record(html, now_seconds() - start, mark);
+        free(rendered);
+
+        size_t written = 0;
+        mark = alloc_mark();
+        start = now_seconds();
+        mm_write_json(doc, 0, discard_output, &written);
+        record(json, now_seconds() - start, mark);
+    }
+    free_document(doc);
+}
+
+/* ------------------------------------------------------------------------
+ * Complexity checks
+ * ---------------------------------------------------------------------- */
+
+#define COMPLEXITY_STEPS 4                 ///< Input sizes, each twice the last
+#define COMPLEXITY_MIN_SECONDS 0.005       ///< Shortest timed batch of parses
+#define COMPLEXITY_TIME_EXPONENT 1.5       ///< Largest accepted time growth
+#define COMPLEXITY_HEAP_EXPONENT 1.25      ///< Largest accepted heap growth
+
+/**
+ * @brief Growth of one parse entry point over the doubling input sizes
+ */
+typedef struct {
+    const char *corpus;
+    const char *operation;
+    size_t bytes[COMPLEXITY_STEPS];
+    double seconds[COMPLEXITY_STEPS];      ///< Fastest parse at each size
+    long long peak_heap[COMPLEXITY_STEPS]; ///< Peak heap of one parse
+    double time_exponent;                  ///< k in time ~ size^k
+    double heap_exponent;                  ///< k in heap ~ size^k, 0 if not counted
+    int superlinear;
+} Growth;
+
+static Document* parse_copy(const Buffer *input) {
+    return parse_metamark(input->data);
+}
+
+static Document* parse_view(const Buffer *input) {
+    return parse_metamark_view(input->data, input->length, NULL);
+}
+
+static const struct {
+    const char *name;
+    Document* (*parse)(const Buffer *input);
+} growth_operations[] = {
+    { "parse_metamark", parse_copy },
+    { "parse_metamark_view", parse_view }
+};
+
+/**
+ * @brief Exponent k of y ~ x^k between the first and last measurement
+ */
+static double growth_exponent(double first, double last, double ratio) {
+    if (first <= 0 || last <= 0) {
+        return 0;
+    }
+    return log2(last / first) / log2(ratio);
+}
+
+/**
+ * @brief Time one parse of an input, repeating it until the clock resolves it
+ */
+static double time_parse(Document* (*parse)(const Buffer *input), const Buffer *input,
+                         int iterations, long long *peak_heap) {
+    double best = -1;
+    for (int i = 0; i < iterations; i++) {
+        size_t runs = 0;
+        double start = now_seconds();
+        double elapsed;
+        do {
+            AllocMark mark = alloc_mark();
+            Document *doc = parse(input);
+#ifdef BENCH_COUNT_ALLOCS
+            if (peak_bytes - mark.live > *peak_heap) {
+                *peak_heap = peak_bytes - mark.live;
+            }
+#else
+            (void)mark;
+#endif
+            free_document(doc);
+            runs++;
+            elapsed = now_seconds() - start;
+        } while (elapsed < COMPLEXITY_MIN_SECONDS);
+        if (best < 0 || elapsed / (double)runs < best) {
+            best = elapsed / (double)runs;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Parse doubling sizes of every adversarial input and fit the growth
+ *
+ * The largest input is the requested size. One parse each time rather
+ * than a fixed count keeps even quadratic cases from running for hours.
+ *
+ * @return size_t The number of growths, stored in @p growths
+ */
+static size_t bench_complexity(Growth *growths, double size_mb, int iterations, const char *only) {
+    size_t count = 0;
+    size_t base = (size_t)(size_mb * 1024 * 1024) >> (COMPLEXITY_STEPS - 1);
+    for (size_t a = 0; a < sizeof(adversarial) / sizeof(adversarial[0]); a++) {
+        if (only && strcmp(only, adversarial[a].name) != 0) {
+            continue;
+        }
+        for (size_t o = 0; o < sizeof(growth_operations) / sizeof(growth_operations[0]); o++) {
+            Growth *growth = &growths[count++];
+            memset(growth, 0, sizeof(Growth));
+            growth->corpus = adversarial[a].name;
+            growth->operation = growth_operations[o].name;
+
+            for (size_t step = 0; step < COMPLEXITY_STEPS; step++) {
+                Buffer input = { NULL, 0, 0 };
+                generate_repeated(&input, adversarial[a].fragment, base << step);
+                growth->bytes[step] = input.length;
+                growth->seconds[step] = time_parse(growth_operations[o].parse, &input,
+                                                   iterations, &growth->peak_heap[step]);
+                free(input.data);
+            }
+
+            size_t last = COMPLEXITY_STEPS - 1;
+            double ratio = (double)growth->bytes[last] / (double)growth->bytes[0];
+            growth->time_exponent = growth_exponent(growth->seconds[0], growth->seconds[last], ratio);
+            growth->heap_exponent = growth_exponent((double)growth->peak_heap[0],
+                                                    (double)growth->peak_heap[last], ratio);
+            growth->superlinear = growth->time_exponent > COMPLEXITY_TIME_EXPONENT ||
+                                  growth->heap_exponent > COMPLEXITY_HEAP_EXPONENT;
+            fprintf(stderr, "%-21s %-20s time ~ n^%.2f  heap ~ n^%.2f%s\n", growth->corpus,
+                    growth->operation, growth->time_exponent, growth->heap_exponent,
+                    growth->superlinear ? "  SUPER-LINEAR" : "");
+        }
+    }
+    return count;
+}
+
+static void write_complexity_json(FILE *out, const Growth *growths, size_t count) {
+    fprintf(out, "{\n  \"format\": %d,\n  \"allocations_counted\": %s,\n",
+            BENCH_FORMAT_VERSION, BENCH_ALLOCS_COUNTED ? "true" : "false");
+    fprintf(out, "  \"complexity\": [\n");
+    for (size_t i = 0; i < count; i++) {
+        const Growth *g = &growths[i];
+        fprintf(out, "    {\"corpus\": \"%s\", \"operation\": \"%s\", \"bytes\": [",
+                g->corpus, g->operation);
+        for (size_t step = 0; step < COMPLEXITY_STEPS; step++) {
+            fprintf(out, "%s%zu", step ? ", " : "", g->bytes[step]);
+        }
+        fprintf(out, "], \"seconds\": [");
+        for (size_t step = 0; step < COMPLEXITY_STEPS; step++) {
+            fprintf(out, "%s%.6f", step ? ", " : "", g->seconds[step]);
+        }
+        fprintf(out, "], \"time_exponent\": %.2f, \"heap_exponent\": %.2f, \"superlinear\": %s}%s\n",
+                g->time_exponent, g->heap_exponent, g->superlinear ? "true" : "false",
+                i + 1 < count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+/* ------------------------------------------------------------------------
+ * Reporting and regression gating
+ * ---------------------------------------------------------------------- */
+
+static double mb_per_s(const Result *result) {
+    return result->seconds > 0 ? (double)result->bytes / 1e6 / result->seconds : 0;
+}
+
+static double nodes_per_s(const Result *result) {
+    return result->seconds > 0 ? (double)result->nodes / result->seconds : 0;
+}
+
+/**
+ * @brief Write the results, one result object per line
+ */
+static void write_json(FILE *out, const ResultList *list, int iterations) {
+    fprintf(out, "{\n  \"format\": %d,\n  \"iterations\": %d,\n", BENCH_FORMAT_VERSION, iterations);
+    fprintf(out, "  \"allocations_counted\": %s,\n", BENCH_ALLOCS_COUNTED ? "true" : "false");
+    fprintf(out, "  \"results\": [\n");
+    for (size_t i = 0; i < list->count; i++) {
+        const Result *r = &list->items[i];
+        fprintf(out, "    {\"corpus\": \"%s\", \"operation\": \"%s\", \"bytes\": %zu, "
+                     "\"nodes\": %zu, \"seconds\": %.6f, \"mb_per_s\": %.2f, "
+                     "\"nodes_per_s\": %.0f, ",
+                r->corpus, r->operation, r->bytes, r->nodes, r->seconds,
+                mb_per_s(r), nodes_per_s(r));
+        if (BENCH_ALLOCS_COUNTED) {
+            fprintf(out, "\"allocations\": %zu, \"peak_heap_bytes\": %lld}",
+                    r->allocations, r->peak_heap);
+        } else {
+            fprintf(out, "\"allocations\": null, \"peak_heap_bytes\": null}");
+        }
+        fprintf(out, "%s\n", i + 1 < list->count ? "," : "");
+    }
+    fprintf(out, "  ],\n  \"max_rss_kb\": %ld\n}\n", max_rss_kb());
+}
+
+/**
+ * @brief Read a string field of a result line
+ */
+static int line_string(const char *line, const char *key, char *value, size_t size) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+    const char *start = strstr(line, pattern);
+    if (!start) {
+        return 0;
+    }
+    start += strlen(pattern);
+    const char *end = strchr(start, '"');
+    if (!end || (size_t)(end - start) >= size) {
+        return 0;
+    }
+    memcpy(value, start, (size_t)(end - start));
+    value[end - start] = '\0';
+    return 1;
+}
+
+/**
+ * @brief Read a numeric field of a result line
+ */
+static int line_number(const char *line, const char *key, double *value) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char *start = strstr(line, pattern);
+    if (!start) {
+        return 0;
+    }
+    char *end;
+    *value = strtod(start + strlen(pattern), &end);
+    return end != start + strlen(pattern);
+}
+
+static const Result* find_result(const ResultList *list, const char *corpus, const char *operation) {
+    for (size_t i = 0; i < list->count; i++) {
+        if (strcmp(list->items[i].corpus, corpus) == 0 &&
+            strcmp(list->items[i].operation, operation) == 0) {
+            return &list->items[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Compare the results with a baseline written by an earlier run
+ *
+ * @return int The number of regressions, or -1 if the baseline is unreadable
+ */
+static int check_baseline(const ResultList *list, const char *path, double tolerance) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "bench_metamark: cannot read baseline %s\n", path);
+        return -1;
+    }
+
+    char line[1024];
+    int regressions = 0;
+    size_t compared = 0;
+    while (fgets(line, sizeof(line), file)) {
+        char corpus[64], operation[64];
+        double base_rate, base_allocations;
+        if (!line_string(line, "corpus", corpus, sizeof(corpus)) ||
+            !line_string(line, "operation", operation, sizeof(operation)) ||
+            !line_number(line, "mb_per_s", &base_rate)) {
+            continue;
+        }
+
+        const Result *current = find_result(list, corpus, operation);
+        if (!current) {
+            continue;
+        }
+        compared++;
+
+        double rate = mb_per_s(current);
+        if (rate < base_rate * (1 - tolerance / 100)) {
+            fprintf(stderr, "regression: %s/%s %.2f MB/s, baseline %.2f MB/s\n",
+                    corpus, operation, rate, base_rate);
+            regressions++;
+        }
+        if (BENCH_ALLOCS_COUNTED && line_number(line, "allocations", &base_allocations) &&
+            (double)current->allocations > base_allocations * (1 + tolerance / 100)) {
+            fprintf(stderr, "regression: %s/%s %zu allocations, baseline %.0f\n",
+                    corpus, operation, current->allocations, base_allocations);
+            regressions++;
+        }
+    }
+    fclose(file);
+
+    if (compared == 0) {
+        fprintf(stderr, "bench_metamark: baseline %s has no matching results\n", path);
+        return -1;
+    }
+    return regressions;
+}
+
+/**
+ * @brief The --complexity mode of main()
+ *
+ * @return int 0 when every parse grew linearly, 1 otherwise, 2 on usage errors
+ */
+static int run_complexity(double size_mb, int iterations, const char *only, const char *output) {
+    size_t capacity = sizeof(adversarial) / sizeof(adversarial[0]) *
+                      (sizeof(growth_operations) / sizeof(growth_operations[0]));
+    Growth *growths = malloc(capacity * sizeof(Growth));
+    if (!growths) {
+        fprintf(stderr, "bench_metamark: out of memory\n");
+        return 2;
+    }
+
+    size_t count = bench_complexity(growths, size_mb, iterations, only);
+    if (count == 0) {
+        fprintf(stderr, "bench_metamark: unknown adversarial input %s\n", only ? only : "");
+        free(growths);
+        return 2;
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "bench_metamark: cannot write %s\n", output);
+        free(growths);
+        return 2;
+    }
+    write_complexity_json(out, growths, count);
+    if (output) {
+        fclose(out);
+    }
+
+    int status = 0;
+    for (size_t i = 0; i < count; i++) {
+        status |= growths[i].superlinear;
+    }
+    free(growths);
+    return status;
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: bench_metamark [options]\n"
+            "  --size MB          Size of each corpus (default %.0f)\n"
+            "  --iterations N     Timed runs per operation, fastest is kept (default %d)\n"
+            "  --corpus NAME      Only run one corpus: prose, components, frontmatter,\n"
+            "                     nested or pathological\n"
+            "  --quick            Small corpora and one iteration, for smoke tests\n"
+            "  --complexity       Parse doubling sizes of adversarial inputs instead and\n"
+            "                     fail when time or heap grows faster than linearly;\n"
+            "                     --corpus then names one adversarial input\n"
+            "  --output FILE      Write the JSON results to FILE instead of stdout\n"
+            "  --baseline FILE    Fail when results regressed against an earlier run\n"
+            "  --tolerance PCT    Allowed regression in percent (default %.0f)\n",
+            BENCH_DEFAULT_SIZE_MB, BENCH_DEFAULT_ITERATIONS, BENCH_DEFAULT_TOLERANCE);
+}
+
+int main(int argc, char *argv[]) {
+    double size_mb = BENCH_DEFAULT_SIZE_MB;
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+    double tolerance = BENCH_DEFAULT_TOLERANCE;
+    const char *only = NULL;
+    const char *output = NULL;
+    const char *baseline = NULL;
+    int complexity = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--quick") == 0) {
+            size_mb = 0.25;
+            iterations = 1;
+            continue;
+        }
+        if (strcmp(arg, "--complexity") == 0) {
+            complexity = 1;
+            continue;
+        }
+        if (!value) {
+            usage();
+            return 2;
+        }
+        if (strcmp(arg, "--size") == 0) {
+            size_mb = atof(value);
+        } else if (strcmp(arg, "--iterations") == 0) {
+            iterations = atoi(value);
+        } else if (strcmp(arg, "--corpus") == 0) {
+            only = value;
+        } else if (strcmp(arg, "--output") == 0) {
+            output = value;
+        } else if (strcmp(arg, "--baseline") == 0) {
+            baseline = value;
+        } else if (strcmp(arg, "--tolerance") == 0) {
+            tolerance = atof(value);
+        } else {
+            usage();
+            return 2;
+        }
+        i++;
+    }
+    if (size_mb <= 0 || iterations < 1 || tolerance < 0 || (complexity && baseline)) {
+        usage();
+        return 2;
+    }
+    if (complexity) {
+        return run_complexity(size_mb, iterations, only, output);
+    }
+
+    ResultList list = { NULL, 0, 0 };
+    for (size_t c = 0; c < sizeof(corpora) / sizeof(corpora[0]); c++) {
+        if (only && strcmp(only, corpora[c].name) != 0) {
+            continue;
+        }
+
+        Buffer corpus = { NULL, 0, 0 };
+        char path[128];
+        random_state = 0x9e3779b97f4a7c15ULL + c;
+        corpora[c].generate(&corpus, (size_t)(size_mb * corpora[c].scale * 1024 * 1024));
+        snprintf(path, sizeof(path), "bench_%s.mmk", corpora[c].name);
+
+        size_t first = list.count;
+        bench_corpus(&list, corpora[c].name, &corpus, iterations, path);
+        for (size_t i = first; i < list.count; i++) {
+            fprintf(stderr, "%-13s %-26s %9.2f MB/s %12.0f nodes/s\n", list.items[i].corpus,
+                    list.items[i].operation, mb_per_s(&list.items[i]), nodes_per_s(&list.items[i]));
+        }
+        free(corpus.data);
+    }
+    if (list.count == 0) {
+        fprintf(stderr, "bench_metamark: unknown corpus %s\n", only ? only : "");
+        return 2;
+    }
+
+    FILE *out = output ? fopen(output, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "bench_metamark: cannot write %s\n", output);
+        return 2;
+    }
+    write_json(out, &list, iterations);
+    if (output) {
+        fclose(out);
+    }
+
+    int status = 0;
+    if (baseline) {
+        int regressions = check_baseline(&list, baseline, tolerance);
+        status = regressions != 0 ? 1 : 0;
+    }
+    free(list.items);
+    return status;
+}
@@ -0,0 +1,15 @@
+# Merge the raw profiles of a Clang PGO training run into metamark.profdata
+#
+# Usage: cmake -DLLVM_PROFDATA=<tool> -DPGO_DIR=<dir> -P MergeProfiles.cmake
+
+file(GLOB raw_profiles "${PGO_DIR}/*.profraw")
+if(NOT raw_profiles)
+    message(FATAL_ERROR "No raw profiles in ${PGO_DIR}; did the training run execute?")
+endif()
+
+execute_process(
+    COMMAND "${LLVM_PROFDATA}" merge -output=${PGO_DIR}/metamark.profdata ${raw_profiles}
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "llvm-profdata merge failed")
+endif()
@@ -0,0 +1,138 @@
+/**
+ * @file fuzz_metamark.c
+ * @brief Fuzz target for the MetaMark parser
+ *
+ * Built with -DMETAMARK_LIBFUZZER and -fsanitize=fuzzer this is a
+ * libFuzzer target. Otherwise it has its own main() that runs every file
+ * named on the command line, or standard input when there is none, which
+ * suits afl-fuzz and replaying crashes under the sanitizers.
+ *
+ * Each input is parsed from a terminated copy, as a view, in parallel and
+ * lazily, then rendered. The parses of one input must agree on the number
+ * of nodes, so the target also catches the entry points drifting apart.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "../include/metamark.h"
+
+static size_t count_nodes(const Node *node) {
+    size_t count = 0;
+    MMWalker walker;
+    mm_walker_init(&walker, node, MM_WALK_ENTER);
+    while (mm_walker_next(&walker, NULL)) {
+        count++;
+    }
+    mm_walker_finish(&walker);
+    return count;
+}
+
+static int discard_output(const char *data, size_t length, void *user_data) {
+    (void)data;
+    *(size_t *)user_data += length;
+    return 0;
+}
+
+/**
+ * @brief Render a document into nothing, so the writers see every tree
+ */
+static void render_all(const Document *doc) {
+    size_t written = 0;
+    mm_render_html(doc, 0, discard_output, &written);
+    mm_write_json(doc, 0, discard_output, &written);
+}
+
+/**
+ * @brief Parse with the given flags, returning the node count or 0
+ */
+static size_t parse_with(const uint8_t *data, size_t size, unsigned flags) {
+    MMContext ctx;
+    MMParseOptions options = { NULL, flags, 2 };
+    Document *doc = mm_parse_document(&ctx, (const char *)data, size, &options);
+    if (!doc) {
+        return 0;
+    }
+    size_t nodes = count_nodes(doc->root);
+    render_all(doc);
+    free_document(doc);
+    return nodes;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    char *copy = malloc(size + 1);
+    if (!copy) {
+        return 0;
+    }
+    memcpy(copy, data, size);
+    copy[size] = '\0';
+
+    Document *doc = parse_metamark(copy);
+    size_t nodes = 0;
+    if (doc) {
+        nodes = count_nodes(doc->root);
+        render_all(doc);
+        free_document(doc);
+    }
+    free(copy);
+
+    // An embedded NUL ends the input of parse_metamark() early
+    size_t view = parse_with(data, size, MM_PARSE_VIEW);
+    size_t parallel = parse_with(data, size, MM_PARSE_VIEW | MM_PARSE_PARALLEL);
+    parse_with(data, size, MM_PARSE_VIEW | MM_PARSE_LAZY);
+    if (!memchr(data, '\0', size) && (view != nodes || parallel != nodes)) {
+        fprintf(stderr, "fuzz_metamark: parses disagree: %zu nodes, %zu as a view, %zu in parallel\n",
+                nodes, view, parallel);
+        abort();
+    }
+    return 0;
+}
+
+#ifndef METAMARK_LIBFUZZER
+
+static int run_stream(FILE *file, const char *name) {
+    uint8_t *data = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    size_t got;
+    do {
+        if (size == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            uint8_t *grown = realloc(data, capacity);
+            if (!grown) {
+                fprintf(stderr, "fuzz_metamark: out of memory reading %s\n", name);
+                free(data);
+                return 1;
+            }
+            data = grown;
+        }
+        got = fread(data + size, 1, capacity - size, file);
+        size += got;
+    } while (got > 0);
+
+    LLVMFuzzerTestOneInput(data, size);
+    free(data);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        return run_stream(stdin, "standard input");
+    }
+
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        FILE *file = fopen(argv[i], "rb");
+        if (!file) {
+            fprintf(stderr, "fuzz_metamark: cannot read %s\n", argv[i]);
+            status = 1;
+            continue;
+        }
+        status |= run_stream(file, argv[i]);
+        fclose(file);
+    }
+    return status;
+}
+
+#endif
@@ -46,6 +46,15 @@ typedef struct {
  */
 void lexer_init(Lexer *lexer, const char *input);
 
+/**
+ * @brief Initialize a new lexer over a buffer of known length
+ * 
+ * @param lexer The lexer to initialize
+ * @param input The input text to tokenize, not necessarily NUL-terminated
+ * @param length The length of the input in bytes
+ */
+void lexer_init_n(Lexer *lexer, const char *input, size_t length);
+
 /**
  * @brief Free lexer resources
  * 
@@ -93,6 +102,16 @@ char next(Lexer *lexer);
  */
 void skip_whitespace(Lexer *lexer);
 
+/**
+ * @brief Skip a run of plain text
+ * 
+ * @param lexer The lexer instance
+ * 
+ * Advances to the next NUL, newline or delimiter character (# [ % - > ]),
+ * or to the end of input if there is none.
+ */
+void skip_plain(Lexer *lexer);
+
 /**
  * @brief Read a token value from the input
  * 
@@ -11,6 +11,28 @@
 #define METAMARK_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Marks the functions exported from the shared library
+ * 
+ * Builds of the library define METAMARK_BUILDING_DLL. On Windows, programs
+ * linking the DLL define METAMARK_DLL. Elsewhere the shared library is
+ * compiled with hidden visibility, so only these functions are exported.
+ */
+#if defined(_WIN32) || defined(__CYGWIN__)
+#  if defined(METAMARK_BUILDING_DLL)
+#    define MM_API __declspec(dllexport)
+#  elif defined(METAMARK_DLL)
+#    define MM_API __declspec(dllimport)
+#  else
+#    define MM_API
+#  endif
+#elif defined(__GNUC__) && __GNUC__ >= 4
+#  define MM_API __attribute__((visibility("default")))
+#else
+#  define MM_API
+#endif
 
 /**
  * @brief Node types in the Abstract Syntax Tree (AST)
@@ -32,11 +54,58 @@ typedef enum {
     NODE_SECURE       ///< Encrypted/secure block
 } NodeType;
 
+/**
+ * @brief Opaque bump allocator that can back a whole document
+ *
+ * See parse_metamark_arena() and the mm_arena_* functions.
+ */
+typedef struct MMArena MMArena;
+
+/**
+ * @brief Opaque read-only file mapping owned by a mapped document
+ *
+ * See read_metamark_file_mapped().
+ */
+typedef struct MMFileMap MMFileMap;
+
+/**
+ * @brief Opaque incremental-reparse state of an editable document
+ *
+ * See MM_PARSE_EDITABLE and mm_reparse().
+ */
+typedef struct MMEditState MMEditState;
+
+/**
+ * @brief Opaque slot of the hash index over a document's metadata
+ *
+ * Maintained by add_metadata() and used by get_metadata().
+ */
+typedef struct MMMetadataSlot MMMetadataSlot;
+
+/**
+ * @brief Node flag: content is a slice of the document source
+ * 
+ * Set on nodes produced by parse_metamark_view(). Such nodes have a NULL
+ * content field; use mm_node_text() to reach their text.
+ */
+#define MM_NODE_VIEW 0x1u
+
+/**
+ * @brief Node flag: the body child has not been built yet
+ * 
+ * Set on component nodes parsed with MM_PARSE_LAZY. The body is the
+ * source range (body_offset, body_length); mm_node_body() builds it as a
+ * paragraph child on first use, mm_node_body_text() reads it in place.
+ */
+#define MM_NODE_LAZY 0x2u
+
 /**
  * @brief Structure representing a node in the AST
  * 
  * Each node can have multiple children, forming a tree structure.
  * The content field stores the actual text content of the node.
+ * Parsed nodes also record where that content starts in the source
+ * and how long it is.
  */
 typedef struct Node {
     NodeType type;           ///< Type of the node
@@ -45,6 +114,12 @@ typedef struct Node {
     size_t child_count;     ///< Number of child nodes
     size_t child_capacity;  ///< Current capacity of children array
     size_t level;           ///< Used for heading levels
+    MMArena *arena;         ///< Owning arena, or NULL for heap-allocated nodes
+    size_t offset;          ///< Byte offset of the content in the source
+    size_t length;          ///< Length of the content in bytes
+    unsigned flags;         ///< MM_NODE_* flags
+    size_t body_offset;     ///< Source offset of an unbuilt body (MM_NODE_LAZY)
+    size_t body_length;     ///< Length of an unbuilt body (MM_NODE_LAZY)
 } Node;
 
 /**
@@ -65,7 +140,15 @@ typedef struct {
 typedef struct {
     MetadataPair *metadata;     ///< Array of metadata key-value pairs
     size_t metadata_count;      ///< Number of metadata entries
+    size_t metadata_capacity;   ///< Allocated entries in metadata
+    MMMetadataSlot *metadata_index; ///< Hash index over the keys, or NULL while small
+    size_t metadata_slots;      ///< Number of slots in metadata_index
     Node *root;                 ///< Root node of the document AST
+    MMArena *arena;             ///< Arena backing the document, or NULL
+    const char *source;         ///< Source referenced by view nodes, or NULL
+    size_t source_length;       ///< Length of the referenced source
+    MMFileMap *mapping;         ///< File mapping holding the source, or NULL
+    MMEditState *edit;          ///< Reparse state of editable documents, or NULL
 } Document;
 
 /**
@@ -79,6 +162,95 @@ typedef enum {
     MM_ERROR_INVALID      /**< Invalid argument */
 } MetaMarkError;
 
+/**
+ * @brief Per-call error state for reentrant parsing
+ * 
+ * Pass a context to mm_parse_document() to receive the outcome of that
+ * call alone. Contexts are plain values owned by the caller, so threads
+ * parsing in parallel each use their own without any locking. Calls made
+ * without a context report to a thread-local default read by
+ * get_last_error().
+ */
+typedef struct {
+    MetaMarkError error;  ///< Last error of the call, or MM_ERROR_NONE
+    size_t offset;        ///< Byte offset of a syntax error in the input
+    size_t line;          ///< 1-based line of the error, or 0 if unknown
+    size_t column;        ///< 1-based column of the error, or 0 if unknown
+} MMContext;
+
+/**
+ * @brief Reset a context to "no error"
+ * 
+ * @param ctx The context to initialize
+ */
+MM_API void mm_context_init(MMContext *ctx);
+
+/**
+ * @brief Parse flag: reference the input instead of copying node content
+ * 
+ * See parse_metamark_view().
+ */
+#define MM_PARSE_VIEW 0x1u
+
+/**
+ * @brief Parse flag: build the top-level blocks on several threads
+ * 
+ * The input is first split into top-level blocks by a serial boundary
+ * scan; the blocks are then built in parallel and joined in order, so the
+ * result is identical to a serial parse. Only heap-allocated parses of
+ * large documents use threads; otherwise the flag has no effect.
+ */
+#define MM_PARSE_PARALLEL 0x2u
+
+/**
+ * @brief Parse flag: keep what mm_reparse() needs to apply edits
+ * 
+ * The document keeps a private copy of the input (which view nodes then
+ * reference) and the byte range of every top-level block. Editable
+ * documents are always heap-allocated and parsed serially.
+ */
+#define MM_PARSE_EDITABLE 0x4u
+
+/**
+ * @brief Parse flag: leave component bodies unbuilt until they are used
+ * 
+ * Component nodes, secure blocks and large diagrams included, only record
+ * where their body lies in the input and carry MM_NODE_LAZY. Requires
+ * MM_PARSE_VIEW, since the body is read from the input, and cannot be
+ * combined with MM_PARSE_EDITABLE. The renderers and writers read lazy
+ * bodies in place, so their output does not change.
+ */
+#define MM_PARSE_LAZY 0x8u
+
+/**
+ * @brief Options for mm_parse_document()
+ * 
+ * A zeroed structure selects the defaults of parse_metamark().
+ */
+typedef struct {
+    MMArena *arena;  ///< Arena to allocate the document from, or NULL for the heap
+    unsigned flags;  ///< MM_PARSE_* flags
+    size_t threads;  ///< Threads for MM_PARSE_PARALLEL, or 0 for one per CPU
+} MMParseOptions;
+
+/**
+ * @brief Parse a MetaMark document with an explicit context and options
+ * 
+ * @param ctx Receives the error state of this call, or NULL for the
+ *            thread-local default
+ * @param input The input buffer, which need not be NUL-terminated
+ * @param length The length of the input in bytes
+ * @param options Parse options, or NULL for the defaults
+ * @return Document* A new document structure, or NULL on error
+ * 
+ * The general form of the parse_metamark*() functions, which are thin
+ * wrappers around it. A non-NULL @p ctx is reset at the start of the
+ * call. Syntax errors inside a block do not stop the parse, so a returned
+ * document may still come with an error describing the last rejected block.
+ */
+MM_API Document* mm_parse_document(MMContext *ctx, const char *input, size_t length,
+                                   const MMParseOptions *options);
+
 /**
  * @brief Parse a MetaMark document from a string
  * 
@@ -89,7 +261,436 @@ typedef enum {
  * The function creates a complete AST representation of the document,
  * including metadata and all document elements.
  */
-Document* parse_metamark(const char *input);
+MM_API Document* parse_metamark(const char *input);
+
+/**
+ * @brief Parse a MetaMark document into an arena
+ * 
+ * @param input The MetaMark document text to parse
+ * @param arena The arena to allocate the document from
+ * @return Document* A new document structure, or NULL on error
+ * 
+ * Behaves like parse_metamark(), but every node, child array, string and
+ * metadata entry is bump-allocated from @p arena. The arena backs at most
+ * one live document: free_document() rewinds it, after which it can be
+ * reused for the next parse.
+ */
+MM_API Document* parse_metamark_arena(const char *input, MMArena *arena);
+
+/**
+ * @brief Parse a MetaMark document without copying node content
+ * 
+ * @param input The input buffer, which need not be NUL-terminated
+ * @param length The length of the input in bytes
+ * @param arena The arena to allocate from, or NULL for the heap
+ * @return Document* A new document structure, or NULL on error
+ * 
+ * Nodes whose content is a literal slice of the input only record an
+ * (offset, length) pair and carry MM_NODE_VIEW; read them through
+ * mm_node_text(). The caller owns @p input and must keep it alive and
+ * unchanged until the document is freed. Metadata pairs are still copied.
+ */
+MM_API Document* parse_metamark_view(const char *input, size_t length, MMArena *arena);
+
+/**
+ * @brief Get the body child of a component or annotation, building it if needed
+ * 
+ * @param node The node whose body to get
+ * @return Node* The body paragraph, or NULL if the node has none
+ * 
+ * For a node carrying MM_NODE_LAZY the paragraph is created on this call,
+ * as a view node over the same input. The node is modified, so calls on
+ * one document must not run concurrently.
+ */
+MM_API Node* mm_node_body(Node *node);
+
+/**
+ * @brief Read the body of a component or annotation without building it
+ * 
+ * @param doc The document the node belongs to
+ * @param node The node whose body to read
+ * @param length Receives the length of the body in bytes; may be NULL
+ * @return const char* The body text (not necessarily NUL-terminated), or
+ *                     NULL if the node has none
+ */
+MM_API const char* mm_node_body_text(const Document *doc, const Node *node, size_t *length);
+
+/**
+ * @brief Span of top-level nodes replaced by mm_reparse()
+ */
+typedef struct {
+    size_t first;     ///< Index of the first changed child of doc->root
+    size_t removed;   ///< Number of old children that were replaced
+    size_t inserted;  ///< Number of new children now at [first, first + inserted)
+} MMRange;
+
+/**
+ * @brief Apply a text edit to an editable document
+ * 
+ * @param doc A document parsed with MM_PARSE_EDITABLE
+ * @param offset Byte offset of the edit in the current text
+ * @param old_length Number of bytes replaced
+ * @param new_text The replacement bytes
+ * @param new_length Number of replacement bytes
+ * @param changed Receives the replaced span of top-level nodes, or NULL
+ * @return int 0 on success, -1 on error
+ * 
+ * Parsing restarts at the end of the last block the edit cannot affect and
+ * stops as soon as a new block ends where an old block ended after the
+ * edit; the old nodes after that point are kept and only have their
+ * offsets moved. Every other child of doc->root stays untouched, so the
+ * caller only needs to re-render @p changed. Edits that reach the
+ * frontmatter reparse the whole document. The tree is always the same as
+ * a full parse of the new text would give, except that a text without any
+ * block yields an empty root instead of an error. On failure the text, the
+ * tree and the metadata are left as they were before the call.
+ */
+MM_API int mm_reparse(Document *doc, size_t offset, size_t old_length,
+                      const char *new_text, size_t new_length, MMRange *changed);
+
+/**
+ * @brief One changed run of children found by mm_diff_nodes()
+ * 
+ * Children [old_first, old_first + old_count) of the old node were
+ * replaced by children [new_first, new_first + new_count) of the new one.
+ * Either count may be 0 for a pure insertion or deletion.
+ */
+typedef struct {
+    size_t old_first;  ///< Index of the first removed old child
+    size_t old_count;  ///< Number of old children removed
+    size_t new_first;  ///< Index of the first inserted new child
+    size_t new_count;  ///< Number of new children inserted
+} MMDiffHunk;
+
+/**
+ * @brief Edit script between two nodes, as a list of hunks in order
+ */
+typedef struct {
+    MMDiffHunk *hunks;     ///< Changed runs, in increasing index order
+    size_t hunk_count;     ///< Number of hunks
+    size_t distance;       ///< Total children removed and inserted
+    int metadata_changed;  ///< Whether the frontmatter differs (documents only)
+} MMDiff;
+
+/**
+ * @brief Hash a node and its whole subtree
+ * 
+ * @param doc The document the node belongs to
+ * @param node The node to hash
+ * @return uint64_t A hash over type, level, text and children
+ * 
+ * Copied, view and lazy nodes with the same text hash alike, so documents
+ * parsed in different modes can be compared.
+ */
+MM_API uint64_t mm_node_hash(const Document *doc, const Node *node);
+
+/**
+ * @brief Diff the children of two nodes
+ * 
+ * @param old_doc The document of the old node
+ * @param old_node The old node, or NULL for one without children
+ * @param new_doc The document of the new node
+ * @param new_node The new node, or NULL for one without children
+ * @return MMDiff* The edit script, released with mm_diff_free(), or NULL
+ *                 on error
+ * 
+ * Children are compared by subtree hash, so an unchanged section costs one
+ * comparison however large it is. The common prefix and suffix are
+ * skipped, and the rest goes through Myers' linear-space diff, which
+ * finds a shortest edit script in O((N + M) D) time and O(N + M) memory.
+ * Call it again on the children of replaced nodes to refine a hunk.
+ */
+MM_API MMDiff* mm_diff_nodes(const Document *old_doc, const Node *old_node,
+                             const Document *new_doc, const Node *new_node);
+
+/**
+ * @brief Diff the top-level blocks and frontmatter of two documents
+ * 
+ * @param old_doc The old document, or NULL for an empty one
+ * @param new_doc The new document, or NULL for an empty one
+ * @return MMDiff* The edit script, released with mm_diff_free(), or NULL
+ *                 on error
+ */
+MM_API MMDiff* mm_diff_documents(const Document *old_doc, const Document *new_doc);
+
+/**
+ * @brief Parse two texts and diff their top-level blocks
+ * 
+ * @param old_input The old text, which need not be NUL-terminated
+ * @param old_length The length of the old text in bytes
+ * @param new_input The new text
+ * @param new_length The length of the new text in bytes
+ * @param count Receives the number of hunks
+ * @return MMDiffHunk* The hunks, released with mm_free(), or NULL on error
+ * 
+ * Entry point for language bindings. A text without any block counts as an
+ * empty document. The array is allocated even when there are no hunks.
+ */
+MM_API MMDiffHunk* mm_diff_text(const char *old_input, size_t old_length,
+                                const char *new_input, size_t new_length, size_t *count);
+
+/**
+ * @brief Free an edit script
+ * 
+ * @param diff The edit script, or NULL
+ */
+MM_API void mm_diff_free(MMDiff *diff);
+
+/**
+ * @brief Outcome of parsing one file of a batch
+ */
+typedef struct {
+    const char *path;   ///< The file, as passed to mm_parse_batch()
+    size_t index;       ///< Position of the path in the input array
+    size_t size;        ///< Size of the file in bytes
+    Document *doc;      ///< The document, or NULL if the file failed
+    MMContext context;  ///< Error state of the parse
+} MMBatchResult;
+
+/**
+ * @brief Callback receiving each result of mm_parse_batch()
+ * 
+ * @param result The result; result->doc is freed when the callback returns
+ * @param user_data The pointer passed to mm_parse_batch()
+ * @return int 0 to continue, nonzero to stop the batch
+ */
+typedef int (*MMBatchCallback)(const MMBatchResult *result, void *user_data);
+
+/**
+ * @brief Parse many files in parallel
+ * 
+ * @param paths The files to parse
+ * @param count Number of paths
+ * @param threads Number of worker threads, or 0 for one per CPU
+ * @param callback Receives every result
+ * @param user_data Pointer handed back to every callback invocation
+ * @return int 0 when every file was reported, the callback's nonzero value
+ *             if it stopped the batch, or -1 on error
+ * 
+ * Files are memory-mapped and parsed in zero-copy mode by a work-stealing
+ * pool, each worker allocating from its own arena. Results reach the
+ * callback in completion order, one at a time, so the callback needs no
+ * locking of its own. A file that cannot be read or parsed is reported
+ * with a NULL document and its error in result->context.
+ */
+MM_API int mm_parse_batch(const char *const *paths, size_t count, size_t threads,
+                          MMBatchCallback callback, void *user_data);
+
+/**
+ * @brief Opaque push-style parser for chunked input
+ */
+typedef struct MMParser MMParser;
+
+/**
+ * @brief Callback receiving finished top-level nodes from an MMParser
+ * 
+ * @param node The completed node, owned by the parser and freed when the
+ *             callback returns
+ * @param user_data The pointer passed to mm_parser_new()
+ * @return int 0 to continue, nonzero to stop parsing
+ */
+typedef int (*MMNodeCallback)(Node *node, void *user_data);
+
+/**
+ * @brief Create a streaming parser
+ * 
+ * @param callback Receives each top-level node as soon as it is complete,
+ *                 or NULL to collect the nodes into the finished document
+ * @param user_data Pointer handed back to every callback invocation
+ * @return MMParser* A new parser, or NULL on error
+ * 
+ * The parser buffers only the block that is still incomplete, so with a
+ * callback installed memory stays bounded by the largest block rather
+ * than the size of the input. Delimiters may be split across chunks.
+ */
+MM_API MMParser* mm_parser_new(MMNodeCallback callback, void *user_data);
+
+/**
+ * @brief Feed the next chunk of input to a streaming parser
+ * 
+ * @param parser The streaming parser
+ * @param buffer The chunk of input, copied by the parser
+ * @param length The length of the chunk in bytes
+ * @return int 0 on success, -1 on error or when the callback stopped parsing
+ */
+MM_API int mm_parser_feed(MMParser *parser, const char *buffer, size_t length);
+
+/**
+ * @brief Signal the end of input and obtain the parsed document
+ * 
+ * @param parser The streaming parser
+ * @return Document* The document, owned by the caller, or NULL on error
+ * 
+ * The document always carries the frontmatter metadata. Its root only
+ * holds the top-level nodes when the parser was created without a
+ * callback. As with parse_metamark(), input without any node is an error.
+ */
+MM_API Document* mm_parser_finish(MMParser *parser);
+
+/**
+ * @brief Free a streaming parser
+ * 
+ * @param parser The streaming parser to free
+ */
+MM_API void mm_parser_free(MMParser *parser);
+
+/**
+ * @brief Callbacks for event-driven (SAX-style) parsing
+ *
+ * Every text argument points into the caller's input and is not
+ * NUL-terminated; use the accompanying length. Slices are only valid while
+ * the input is. Any callback may be NULL. Returning nonzero from a callback
+ * stops parsing, and that value is returned by mm_parse_events().
+ */
+typedef struct {
+    /** One key/value pair of a metadata block */
+    int (*on_metadata_pair)(const char *key, size_t key_length,
+                            const char *value, size_t value_length, void *user_data);
+    /** A heading with its level (number of # characters) */
+    int (*on_heading)(size_t level, const char *text, size_t length, void *user_data);
+    /** A paragraph, including the body of a component */
+    int (*on_paragraph)(const char *text, size_t length, void *user_data);
+    /** Start of a component block; type is NULL for an empty type */
+    int (*on_component_begin)(const char *type, size_t length, void *user_data);
+    /** End of a component block */
+    int (*on_component_end)(const char *type, size_t length, void *user_data);
+    /** An annotation; text is NULL when the annotation has no content */
+    int (*on_annotation)(const char *type, size_t type_length,
+                         const char *text, size_t length, void *user_data);
+    /** A comment block */
+    int (*on_comment)(const char *text, size_t length, void *user_data);
+} MMEventHandler;
+
+/**
+ * @brief Parse a MetaMark document into a stream of events
+ *
+ * @param input The input buffer, which need not be NUL-terminated
+ * @param length The length of the input in bytes
+ * @param handler The callbacks to invoke, in document order
+ * @param user_data Pointer handed back to every callback invocation
+ * @return int 0 on success, -1 on error, or the nonzero value returned by
+ *             a callback that stopped parsing
+ *
+ * No nodes are built and nothing is allocated: the recognizer reports each
+ * element straight from the input, so memory use does not grow with the
+ * document. Errors match parse_metamark(), including input without any
+ * element being a syntax error.
+ */
+MM_API int mm_parse_events(const char *input, size_t length,
+                           const MMEventHandler *handler, void *user_data);
+
+/**
+ * @brief Index meaning "no node" in the link arrays of MMFrozenDocument
+ */
+#define MM_FROZEN_NONE UINT32_MAX
+
+/**
+ * @brief Read-only, flattened copy of a document
+ * 
+ * Nodes are stored in pre-order in parallel arrays, so node 0 is the root,
+ * the subtree of node i is the index range [i, subtree_end[i]) and a walk
+ * over the whole tree is a linear scan. Content and metadata are copied
+ * into a private string pool; the frozen document does not depend on the
+ * document it was made from.
+ */
+typedef struct {
+    size_t count;                  ///< Number of nodes, including the root
+    const uint8_t *types;          ///< NodeType of each node
+    const uint8_t *levels;         ///< Heading level of each node, clamped to 255
+    const uint32_t *depths;        ///< Depth of each node, 0 for the root
+    const uint32_t *first_child;   ///< First child, or MM_FROZEN_NONE
+    const uint32_t *next_sibling;  ///< Next sibling, or MM_FROZEN_NONE
+    const uint32_t *subtree_end;   ///< One past the last node of each subtree
+    const char *const *content;    ///< NUL-terminated content, or NULL
+    const size_t *lengths;         ///< Content length in bytes
+    const size_t *offsets;         ///< Byte offset of the content in the source
+    const MetadataPair *metadata;  ///< Metadata pairs, pointing into the pool
+    size_t metadata_count;         ///< Number of metadata pairs
+    void *block;                   ///< Single allocation holding everything above
+} MMFrozenDocument;
+
+/**
+ * @brief Pre-order cursor over a subtree of a frozen document
+ */
+typedef struct {
+    size_t next;  ///< Next node to visit
+    size_t end;   ///< One past the last node of the subtree
+} MMFrozenIter;
+
+/**
+ * @brief Flatten a document into struct-of-arrays form
+ * 
+ * @param doc The document to freeze
+ * @return MMFrozenDocument* The frozen copy, or NULL on error
+ * 
+ * The frozen copy lives in a single allocation. Free it with
+ * mm_frozen_free().
+ */
+MM_API MMFrozenDocument* mm_document_freeze(const Document *doc);
+
+/**
+ * @brief Free a frozen document
+ * 
+ * @param frozen The frozen document to free, or NULL
+ */
+MM_API void mm_frozen_free(MMFrozenDocument *frozen);
+
+/**
+ * @brief Start a pre-order walk over the subtree of a node
+ * 
+ * @param frozen The frozen document
+ * @param node Index of the subtree root, 0 for the whole document
+ * @return MMFrozenIter The cursor, positioned on @p node
+ */
+MM_API MMFrozenIter mm_frozen_iter(const MMFrozenDocument *frozen, size_t node);
+
+/**
+ * @brief Step a pre-order walk
+ * 
+ * @param iter The cursor
+ * @param node Receives the index of the next node
+ * @return int 1 if a node was produced, 0 at the end of the subtree
+ */
+MM_API int mm_frozen_next(MMFrozenIter *iter, size_t *node);
+
+/**
+ * @brief Number of NodeType values, for arrays indexed by node type
+ */
+#define MM_NODE_TYPE_COUNT (NODE_SECURE + 1)
+
+/**
+ * @brief Counters and phase timings collected while parsing
+ *
+ * Counters accumulate over every call made while the structure is
+ * collecting, so zero it before the first use. Times are wall-clock
+ * seconds. Allocations count heap requests only: arena allocations are
+ * part of the arena blocks they come from.
+ */
+typedef struct {
+    size_t bytes_scanned;                ///< Input bytes consumed by the block scanner
+    size_t nodes[MM_NODE_TYPE_COUNT];    ///< Nodes created, per NodeType
+    size_t allocations;                  ///< Heap allocations and reallocations
+    size_t allocated_bytes;              ///< Bytes requested by those allocations
+    double lex_seconds;                  ///< Scanning block boundaries, components excluded
+    double metadata_seconds;             ///< Scanning and storing the frontmatter
+    double component_seconds;            ///< Scanning and building component blocks
+    double build_seconds;                ///< Building every other node
+    double free_seconds;                 ///< Tearing down documents in free_document()
+} MMParseStats;
+
+/**
+ * @brief Collect parse statistics on the calling thread
+ *
+ * @param stats The structure to accumulate into, or NULL to stop
+ * @return MMParseStats* The structure collected into before, so nested
+ *         users can restore it
+ *
+ * Collection is off by default and then costs one branch per node and
+ * allocation. Only work done on the calling thread is counted:
+ * MM_PARSE_PARALLEL builds the blocks serially while collecting, and
+ * mm_parse_batch() workers are not covered.
+ */
+MM_API MMParseStats* mm_parse_stats(MMParseStats *stats);
 
 /**
  * @brief Free a document and all its resources
@@ -97,9 +698,44 @@ Document* parse_metamark(const char *input);
  * @param doc The document to free
  * 
  * This function properly frees all memory allocated for the document,
- * including the AST, metadata, and all node contents.
+ * including the AST, metadata, and all node contents. Arena-backed
+ * documents are released by rewinding their arena.
+ */
+MM_API void free_document(Document *doc);
+
+/**
+ * @brief Create a new arena
+ * 
+ * @param block_size Size of each arena block in bytes, or 0 for the default
+ * @return MMArena* A new arena, or NULL on error
+ */
+MM_API MMArena* mm_arena_new(size_t block_size);
+
+/**
+ * @brief Allocate memory from an arena
+ * 
+ * @param arena The arena to allocate from, or NULL to use malloc
+ * @param size The number of bytes to allocate
+ * @return void* The allocated memory, or NULL on error
+ */
+MM_API void* mm_arena_alloc(MMArena *arena, size_t size);
+
+/**
+ * @brief Release every allocation made from an arena
+ * 
+ * @param arena The arena to rewind
+ * 
+ * The first block is kept so the arena can be reused without
+ * touching the system allocator again.
+ */
+MM_API void mm_arena_reset(MMArena *arena);
+
+/**
+ * @brief Free an arena and all of its blocks
+ * 
+ * @param arena The arena to free
  */
-void free_document(Document *doc);
+MM_API void mm_arena_free(MMArena *arena);
 
 /**
  * @brief Create a new AST node
@@ -108,7 +744,20 @@ void free_document(Document *doc);
  * @param content The text content of the node
  * @return Node* A new node, or NULL on error
  */
-Node* create_node(NodeType type, const char *content);
+MM_API Node* create_node(NodeType type, const char *content);
+
+/**
+ * @brief Get the text content of a node
+ * 
+ * @param doc The document the node belongs to
+ * @param node The node to read
+ * @param length Receives the content length in bytes, may be NULL
+ * @return const char* The content, or NULL if the node has none
+ * 
+ * Works for both copied and view nodes. The returned text of a view node
+ * points into the document source and is not NUL-terminated.
+ */
+MM_API const char* mm_node_text(const Document *doc, const Node *node, size_t *length);
 
 /**
  * @brief Add a child node to a parent node
@@ -119,63 +768,805 @@ Node* create_node(NodeType type, const char *content);
  * The child node is added to the parent's children array.
  * The array is automatically resized if needed.
  */
-void add_child(Node *parent, Node *child);
+MM_API void add_child(Node *parent, Node *child);
 
 /**
  * @brief Free a node and all its children
  * 
  * @param node The node to free
  */
-void free_node(Node *node);
+MM_API void free_node(Node *node);
 
 /**
- * @brief Add a metadata key-value pair to a document
- * 
- * @param doc The document to add metadata to
- * @param key The metadata key
- * @param value The metadata value
+ * @brief Walker flag: visit each node before its children (pre-order)
  */
-void add_metadata(Document *doc, const char *key, const char *value);
+#define MM_WALK_ENTER 0x1u
 
 /**
- * @brief Get a metadata value by key
- * 
- * @param doc The document to search
- * @param key The metadata key to look up
- * @return const char* The metadata value, or NULL if not found
+ * @brief Walker flag: visit each node after its children (post-order)
  */
-const char* get_metadata(const Document *doc, const char *key);
+#define MM_WALK_LEAVE 0x2u
 
 /**
- * @brief Parse metadata from a metadata node
- * 
- * @param doc The document to add metadata to
- * @param node The metadata node to parse
+ * @brief Walker flag: include unbuilt lazy bodies
+ *
+ * A component parsed with MM_PARSE_LAZY then shows its body as a first
+ * paragraph child, exactly as if mm_node_body() had built it. The stand-in
+ * node belongs to the walker and stays valid until the next step.
  */
-void parse_metadata_node(Document *doc, const Node *node);
+#define MM_WALK_LAZY 0x4u
 
 /**
- * @brief Print the AST structure for debugging
- * 
- * @param root The root node to print
- * @param indent The current indentation level
+ * @brief Frames a walker holds before it allocates
  */
-void print_ast(const Node *root, int indent);
+#define MM_WALK_INLINE_DEPTH 32
 
 /**
- * @brief Convert a node type to a string
- * 
- * @param type The node type to convert
- * @return const char* A string representation of the node type
+ * @brief Where a walk stands when it reaches a node
  */
-const char* node_type_to_string(NodeType type);
+typedef struct {
+    const Node *parent;  ///< Parent of the node, NULL for the root of the walk
+    size_t index;        ///< Position of the node among the children of its parent
+    size_t depth;        ///< Distance from the root of the walk, which is 0
+    int leaving;         ///< Nonzero for the visit after the children
+} MMVisit;
 
 /**
- * @brief Get the last error that occurred
- * 
- * @return MetaMarkError The last error code
+ * @brief One open node of a walk; private to the walker
+ */
+typedef struct {
+    const Node *node;
+    size_t index;
+    size_t next;
+} MMWalkFrame;
+
+/**
+ * @brief Iterator over a subtree with an explicit stack
+ *
+ * Lives wherever the caller puts it, usually the C stack. The fields are
+ * private. Trees no deeper than MM_WALK_INLINE_DEPTH are walked without
+ * any allocation; deeper ones grow the stack on the heap, so the depth of
+ * a tree never reaches the C stack.
+ */
+typedef struct {
+    MMWalkFrame *frames;
+    size_t depth;
+    size_t capacity;
+    unsigned flags;
+    int started;
+    int failed;
+    Node body;
+    MMWalkFrame inline_frames[MM_WALK_INLINE_DEPTH];
+} MMWalker;
+
+/**
+ * @brief Start a walk over a subtree
+ *
+ * @param walker The walker to initialize
+ * @param root The root of the walk, or NULL for an empty walk
+ * @param flags MM_WALK_ENTER and MM_WALK_LEAVE select the visits, and
+ *              MM_WALK_LAZY adds lazy bodies
+ */
+MM_API void mm_walker_init(MMWalker *walker, const Node *root, unsigned flags);
+
+/**
+ * @brief Start another walk, keeping the stack the walker has grown
+ *
+ * @param walker A walker set up by mm_walker_init()
+ * @param root The root of the walk, or NULL for an empty walk
+ * @param flags Flags as for mm_walker_init()
+ *
+ * A walk that goes no deeper than an earlier walk of the same walker
+ * cannot run out of memory, which lets a failed change be undone.
+ */
+MM_API void mm_walker_reset(MMWalker *walker, const Node *root, unsigned flags);
+
+/**
+ * @brief Step to the next visit of a walk
+ *
+ * @param walker The walker
+ * @param visit Receives the position of the node, may be NULL
+ * @return const Node* The node, or NULL when the walk is over
+ *
+ * Children are visited in order, so with MM_WALK_ENTER the nodes come in
+ * document order. A node is never touched again after its leave visit,
+ * which lets that visit free it.
+ */
+MM_API const Node* mm_walker_next(MMWalker *walker, MMVisit *visit);
+
+/**
+ * @brief Skip the unvisited children of the innermost open node
+ *
+ * @param walker The walker
+ *
+ * Called after an enter visit, the node's subtree is skipped; after a
+ * leave visit, the remaining siblings are. A skipped node still gets its
+ * leave visit.
+ */
+MM_API void mm_walker_skip(MMWalker *walker);
+
+/**
+ * @brief Release the stack of a walk, finished or not
+ *
+ * @param walker The walker
+ * @return int 0, or -1 if the walk ended early because memory ran out
+ */
+MM_API int mm_walker_finish(MMWalker *walker);
+
+/**
+ * @brief Action a visitor returns to steer the walk
+ */
+typedef enum {
+    MM_WALK_CONTINUE,  ///< Carry on, entering the children of the node
+    MM_WALK_SKIP,      ///< Skip the children of an entered node
+    MM_WALK_STOP       ///< End the walk now
+} MMWalkAction;
+
+/**
+ * @brief Callback receiving the visits of mm_walk()
+ */
+typedef MMWalkAction (*MMVisitFn)(const Node *node, const MMVisit *visit, void *user_data);
+
+/**
+ * @brief Walk a subtree without recursion
+ *
+ * @param root The root of the walk
+ * @param flags Flags as for mm_walker_init(); with neither MM_WALK_ENTER
+ *              nor MM_WALK_LEAVE, nodes are entered
+ * @param visit Function called for each visit
+ * @param user_data Passed through to @p visit
+ * @return int 0 when every node was visited, 1 if @p visit stopped the
+ *         walk, or -1 on error
+ */
+MM_API int mm_walk(const Node *root, unsigned flags, MMVisitFn visit, void *user_data);
+
+/**
+ * @brief Add a metadata key-value pair to a document
+ * 
+ * @param doc The document to add metadata to
+ * @param key The metadata key
+ * @param value The metadata value
+ * 
+ * Key and value are copied. When a key is added twice, get_metadata()
+ * keeps returning the first value.
+ */
+MM_API void add_metadata(Document *doc, const char *key, const char *value);
+
+/**
+ * @brief Get a metadata value by key
+ * 
+ * @param doc The document to search
+ * @param key The metadata key to look up
+ * @return const char* The metadata value, or NULL if not found
+ * 
+ * Small frontmatter is scanned; larger frontmatter is looked up through a
+ * hash index, so the cost does not grow with the number of keys. Lookups
+ * never modify the document and may run concurrently.
+ */
+MM_API const char* get_metadata(const Document *doc, const char *key);
+
+/**
+ * @brief Parse metadata from a metadata node
+ * 
+ * @param doc The document to add metadata to
+ * @param node The metadata node to parse
+ * 
+ * The parser fills in the metadata of the documents it builds, so this is
+ * only needed for documents assembled by hand. The pairs are read from the
+ * "key:value" children of the node.
+ */
+MM_API void parse_metadata_node(Document *doc, const Node *node);
+
+/**
+ * @brief Print the AST structure for debugging
+ * 
+ * @param root The root node to print
+ * @param indent The current indentation level
+ */
+MM_API void print_ast(const Node *root, int indent);
+
+/**
+ * @brief Convert a node type to a string
+ * 
+ * @param type The node type to convert
+ * @return const char* A string representation of the node type
+ */
+MM_API const char* node_type_to_string(NodeType type);
+
+/**
+ * @brief Sink receiving rendered output
+ * 
+ * @param data The next bytes of output
+ * @param length Number of bytes
+ * @param user_data The pointer passed to the renderer
+ * @return int 0 to continue, nonzero to stop rendering
+ */
+typedef int (*MMWriteFn)(const char *data, size_t length, void *user_data);
+
+/**
+ * @brief Render flag: wrap the output in a complete HTML page
+ * 
+ * The page title comes from the "title" metadata key.
+ */
+#define MM_HTML_STANDALONE 0x1u
+
+/**
+ * @brief Render a document as HTML to a sink
+ * 
+ * @param doc The document to render
+ * @param flags MM_HTML_* flags
+ * @param write The sink
+ * @param user_data Passed to the sink
+ * @return int 0 on success, the sink's nonzero result if it stopped
+ *             rendering, or -1 on error
+ * 
+ * Output is collected in a fixed buffer and handed to the sink in large
+ * chunks. Comments and frontmatter are not rendered.
+ */
+MM_API int mm_render_html(const Document *doc, unsigned flags, MMWriteFn write, void *user_data);
+
+/**
+ * @brief Render a document as an HTML fragment
+ * 
+ * @param doc The document to render
+ * @return char* The NUL-terminated HTML, or NULL on error
+ * 
+ * The caller must free the result with free().
+ */
+MM_API char* render_metamark_html(const Document *doc);
+
+/**
+ * @brief Options for mm_render_pdf()
+ * 
+ * A zeroed structure selects an A4 page with one-inch margins, laid out
+ * on one thread per CPU.
+ */
+typedef struct {
+    unsigned page_width;   ///< Page width in points, or 0 for 595
+    unsigned page_height;  ///< Page height in points, or 0 for 842
+    unsigned margin;       ///< Margin on every side in points, or 0 for 72
+    size_t threads;        ///< Layout threads, or 0 for one per CPU
+} MMPdfOptions;
+
+/**
+ * @brief Render a document as PDF to a sink
+ * 
+ * @param doc The document to render
+ * @param options Page size and threads, or NULL for the defaults
+ * @param write The sink
+ * @param user_data Passed to the sink
+ * @return int 0 on success, the sink's nonzero result if it stopped
+ *             rendering, or -1 on error
+ * 
+ * Top-level blocks are broken into lines in parallel, a window at a time,
+ * and every page is written as soon as it is full, so memory use does not
+ * grow with the document. Text is set in the standard Helvetica fonts,
+ * which every page shares; characters outside WinAnsi print as '?'.
+ * Comments and frontmatter are not rendered, and the "title" metadata
+ * key becomes the document title.
+ */
+MM_API int mm_render_pdf(const Document *doc, const MMPdfOptions *options, MMWriteFn write,
+                         void *user_data);
+
+/**
+ * @brief JSON flag: write no whitespace between tokens
+ */
+#define MM_JSON_COMPACT 0x1u
+
+/**
+ * @brief JSON flag: give every node its source offset and length
+ */
+#define MM_JSON_OFFSETS 0x2u
+
+/**
+ * @brief Opaque JSON writer that takes top-level nodes one at a time
+ */
+typedef struct MMJsonWriter MMJsonWriter;
+
+/**
+ * @brief Create a JSON writer
+ * 
+ * @param flags MM_JSON_* flags
+ * @param write The sink receiving the JSON
+ * @param user_data Passed to the sink
+ * @return MMJsonWriter* A new writer, or NULL on error
+ * 
+ * The document is written as {"type": "DOCUMENT", "children": [...],
+ * "metadata": {...}}. Every node is an object with its "type", "level"
+ * for headings, "content" when it has any, "offset" and "length" with
+ * MM_JSON_OFFSETS, and "children" when it has any. Output is buffered in
+ * a fixed buffer that is flushed to the sink whenever it fills.
+ */
+MM_API MMJsonWriter* mm_json_writer_new(unsigned flags, MMWriteFn write, void *user_data);
+
+/**
+ * @brief Append a top-level node to the document being written
+ * 
+ * @param writer The JSON writer
+ * @param doc The document the node belongs to, may be NULL unless the
+ *            node is a view node
+ * @param node The node to write along with its children
+ * @return int 0 on success, the sink's nonzero result, or -1 on error
+ * 
+ * The node is fully written by the time this returns, so it can be passed
+ * straight from an MMNodeCallback of the streaming parser.
+ */
+MM_API int mm_json_writer_node(MMJsonWriter *writer, const Document *doc, const Node *node);
+
+/**
+ * @brief Write the metadata and close the document
+ * 
+ * @param writer The JSON writer
+ * @param doc The document whose metadata to write, or NULL for none
+ * @return int 0 on success, the sink's nonzero result, or -1 on error
+ */
+MM_API int mm_json_writer_finish(MMJsonWriter *writer, const Document *doc);
+
+/**
+ * @brief Free a JSON writer
+ * 
+ * @param writer The writer to free
+ */
+MM_API void mm_json_writer_free(MMJsonWriter *writer);
+
+/**
+ * @brief Write a whole document as JSON to a sink
+ * 
+ * @param doc The document to write
+ * @param flags MM_JSON_* flags
+ * @param write The sink
+ * @param user_data Passed to the sink
+ * @return int 0 on success, the sink's nonzero result, or -1 on error
+ */
+MM_API int mm_write_json(const Document *doc, unsigned flags, MMWriteFn write, void *user_data);
+
+/**
+ * @brief Version of the snapshot format written by mm_snapshot_write()
+ */
+#define MM_SNAPSHOT_VERSION 1
+
+/**
+ * @brief Opaque read-only view of a snapshot file
+ */
+typedef struct MMSnapshot MMSnapshot;
+
+/**
+ * @brief One node of a snapshot
+ * 
+ * The children of a node are the consecutive nodes
+ * [first_child, first_child + child_count). Node 0 is the document root.
+ */
+typedef struct {
+    NodeType type;       ///< Type of the node
+    size_t level;        ///< Heading level
+    const char *content; ///< NUL-terminated content inside the snapshot, or NULL
+    size_t length;       ///< Length of the content in bytes
+    size_t offset;       ///< Byte offset of the content in the source
+    size_t first_child;  ///< Index of the first child
+    size_t child_count;  ///< Number of children
+} MMSnapshotNode;
+
+/**
+ * @brief Serialize a document into the binary snapshot format
+ * 
+ * @param doc The document to serialize
+ * @param stamp Caller-defined value stored in the header, such as the
+ *              modification time or a hash of the source
+ * @param write The sink receiving the snapshot
+ * @param user_data Passed to the sink
+ * @return int 0 on success, the sink's nonzero result, or -1 on error
+ * 
+ * A snapshot is a header followed by a flat node table in breadth-first
+ * order, a metadata table and a pool of NUL-terminated strings. All
+ * integers are little-endian.
+ */
+MM_API int mm_snapshot_write(const Document *doc, uint64_t stamp, MMWriteFn write, void *user_data);
+
+/**
+ * @brief Write a snapshot of a document to a file
+ * 
+ * @param doc The document to serialize
+ * @param stamp Caller-defined value stored in the header
+ * @param filename The file to create or replace
+ * @return int 0 on success, -1 on error
+ */
+MM_API int mm_snapshot_save(const Document *doc, uint64_t stamp, const char *filename);
+
+/**
+ * @brief Serialize a document into a snapshot held in memory
+ * 
+ * @param doc The document to serialize
+ * @param stamp Caller-defined value stored in the header
+ * @param size Receives the size of the snapshot in bytes, may be NULL
+ * @return unsigned char* The snapshot, released with mm_free(), or NULL
+ *         on error
+ */
+MM_API unsigned char* mm_snapshot_encode(const Document *doc, uint64_t stamp, size_t *size);
+
+/**
+ * @brief Map a snapshot file for reading
+ * 
+ * @param filename The snapshot to open
+ * @return MMSnapshot* The snapshot, or NULL on error
+ * 
+ * Only the header is checked here. Nodes and strings are read in place
+ * from the mapping and each access checks its own bounds, so opening a
+ * snapshot touches no more than its first page.
+ */
+MM_API MMSnapshot* mm_snapshot_open(const char *filename);
+
+/**
+ * @brief Read a snapshot held in memory, such as a flat buffer
+ * 
+ * @param data The snapshot bytes, which must outlive the reader
+ * @param length Size of the snapshot in bytes
+ * @return MMSnapshot* The snapshot, or NULL on error
+ * 
+ * Closing the reader leaves the bytes alone.
+ */
+MM_API MMSnapshot* mm_snapshot_from_buffer(const void *data, size_t length);
+
+/**
+ * @brief Release a snapshot and its mapping
+ * 
+ * @param snapshot The snapshot to close, or NULL
+ */
+MM_API void mm_snapshot_close(MMSnapshot *snapshot);
+
+/**
+ * @brief Get the stamp stored when the snapshot was written
+ */
+MM_API uint64_t mm_snapshot_stamp(const MMSnapshot *snapshot);
+
+/**
+ * @brief Get the number of nodes in a snapshot, including the root
+ */
+MM_API size_t mm_snapshot_node_count(const MMSnapshot *snapshot);
+
+/**
+ * @brief Read one node of a snapshot
+ * 
+ * @param snapshot The snapshot
+ * @param index Index of the node, 0 for the root
+ * @param node Receives the node
+ * @return int 0 on success, -1 if the index is out of range or the node
+ *             is corrupt
+ */
+MM_API int mm_snapshot_node(const MMSnapshot *snapshot, size_t index, MMSnapshotNode *node);
+
+/**
+ * @brief Get the number of metadata pairs in a snapshot
+ */
+MM_API size_t mm_snapshot_metadata_count(const MMSnapshot *snapshot);
+
+/**
+ * @brief Read one metadata pair of a snapshot
+ * 
+ * @param snapshot The snapshot
+ * @param index Index of the pair
+ * @param key Receives the NUL-terminated key
+ * @param value Receives the NUL-terminated value
+ * @return int 0 on success, -1 if the index is out of range or the pair
+ *             is corrupt
+ */
+MM_API int mm_snapshot_metadata(const MMSnapshot *snapshot, size_t index,
+                                const char **key, const char **value);
+
+/**
+ * @brief Look up a metadata value in a snapshot
+ * 
+ * @param snapshot The snapshot
+ * @param key The key to look up
+ * @return const char* The value, or NULL if the key is not present
+ */
+MM_API const char* mm_snapshot_get_metadata(const MMSnapshot *snapshot, const char *key);
+
+/**
+ * @brief Parse a document straight into a flat buffer
+ * 
+ * @param input The input buffer, which need not be NUL-terminated
+ * @param length The length of the input in bytes
+ * @param size Receives the size of the buffer in bytes
+ * @return unsigned char* The buffer, released with mm_free(), or NULL on
+ *         error
+ * 
+ * Entry point for language bindings. The buffer is a snapshot with a stamp
+ * of 0 and holds no pointers, so it can be copied or read from any
+ * address. All integers are little-endian:
+ * 
+ *   header    64 bytes: "MMSNAP\0\0", u32 version, u32 header size,
+ *             u32 node count, u32 metadata count, u64 pool length,
+ *             u64 stamp, u64 node table, metadata table and pool offsets
+ *   node      32 bytes: u16 type, u16 level, u32 flags (bit 0: has
+ *             content), u32 first child, u32 child count, u32 content
+ *             pool offset, u32 content length, u32 source offset, u32 0
+ *   metadata  16 bytes: u32 key offset, u32 key length, u32 value offset,
+ *             u32 value length
+ * 
+ * Nodes are in breadth-first order with node 0 as the root, and pool
+ * strings are NUL-terminated.
+ */
+MM_API unsigned char* mm_flat_parse(const char *input, size_t length, size_t *size);
+
+/**
+ * @brief Release memory returned by the library
+ * 
+ * @param ptr A flat buffer, snapshot or rendered string, or NULL
+ * 
+ * Bindings must use this rather than their own allocator's free, which
+ * may not be the C library's.
+ */
+MM_API void mm_free(void *ptr);
+
+/**
+ * @brief Content-addressed cache of parsed documents
+ * 
+ * Inputs are keyed by a 64-bit hash of their bytes and kept as snapshots
+ * in a least-recently-used list bounded by a byte budget. With a cache
+ * directory, every parsed input is also written there as
+ * "<key>.mms" and later misses are served by mapping that file, so the
+ * cache survives the process. A cache may be shared between threads.
+ */
+typedef struct MMParseCache MMParseCache;
+
+/**
+ * @brief A document handed out by a parse cache
+ * 
+ * Entries are shared and read-only; each lookup must be paired with
+ * mm_cache_release(). An entry is never evicted while it is held.
+ */
+typedef struct MMCacheEntry MMCacheEntry;
+
+/**
+ * @brief Counters of a parse cache
+ */
+typedef struct {
+    size_t hits;       ///< Lookups served from memory
+    size_t disk_hits;  ///< Lookups served from the cache directory
+    size_t misses;     ///< Lookups that parsed the input
+    size_t evictions;  ///< Entries dropped to stay within the budget
+    size_t entries;    ///< Entries held in memory
+    size_t bytes;      ///< Bytes held in memory, counted against the budget
+} MMCacheStats;
+
+/**
+ * @brief Create a parse cache
+ * 
+ * @param byte_budget Bytes of snapshots to keep in memory
+ * @param directory Existing directory to spill snapshots to, or NULL
+ * @return MMParseCache* The cache, or NULL on error
+ */
+MM_API MMParseCache* mm_cache_new(size_t byte_budget, const char *directory);
+
+/**
+ * @brief Free a parse cache and every entry in it
+ * 
+ * @param cache The cache to free, or NULL
+ * 
+ * All entries must have been released.
+ */
+MM_API void mm_cache_free(MMParseCache *cache);
+
+/**
+ * @brief Look up or parse a document held in memory
+ * 
+ * @param cache The cache
+ * @param input The input buffer, which need not be NUL-terminated
+ * @param length The length of the input in bytes
+ * @return MMCacheEntry* The entry, or NULL if the input could not be parsed
+ * 
+ * The input is only read while the call runs; the entry holds its own
+ * copy of every string.
+ */
+MM_API MMCacheEntry* mm_cache_parse(MMParseCache *cache, const char *input, size_t length);
+
+/**
+ * @brief Look up or parse the contents of a file
+ * 
+ * @param cache The cache
+ * @param filename The path to the file to read
+ * @return MMCacheEntry* The entry, or NULL on error
+ * 
+ * The cached counterpart of read_metamark_file(). The file is mapped and
+ * hashed on every call, so an edited file is never served stale.
+ */
+MM_API MMCacheEntry* mm_cache_read_file(MMParseCache *cache, const char *filename);
+
+/**
+ * @brief Get the document of a cache entry
+ * 
+ * @param entry The entry
+ * @return const MMSnapshot* The snapshot, valid until the entry is released;
+ *         its stamp is the cache key
+ */
+MM_API const MMSnapshot* mm_cache_snapshot(const MMCacheEntry *entry);
+
+/**
+ * @brief Release an entry returned by a lookup
+ * 
+ * @param entry The entry, or NULL
+ */
+MM_API void mm_cache_release(MMCacheEntry *entry);
+
+/**
+ * @brief Read the counters of a parse cache
+ * 
+ * @param cache The cache
+ * @param stats Receives the counters
+ */
+MM_API void mm_cache_stats(MMParseCache *cache, MMCacheStats *stats);
+
+/**
+ * @brief Full-text and structural search index over many documents
+ * 
+ * Indexing reads documents through mm_parse_events(), so no tree is
+ * built. Each heading, paragraph, annotation, component and metadata pair
+ * is one searchable entry. Posting lists are delta-encoded varints.
+ */
+typedef struct MMIndex MMIndex;
+
+/**
+ * @brief One entry matching a search
+ */
+typedef struct {
+    const char *document;  ///< Name the document was added under
+    NodeType type;         ///< Type of the matching block
+    size_t line;           ///< Line of the block in its document, from 1
+    const char *preview;   ///< Start of the block's text on one line
+} MMSearchHit;
+
+/**
+ * @brief Callback receiving search hits, in document and entry order
+ * 
+ * The hit is only valid during the call. Returning nonzero stops the search.
+ */
+typedef int (*MMSearchFn)(const MMSearchHit *hit, void *user_data);
+
+/**
+ * @brief Callback receiving the documents of an index
+ */
+typedef int (*MMIndexDocumentFn)(const char *name, const char *tag, void *user_data);
+
+/**
+ * @brief Create an empty index
+ * 
+ * @return MMIndex* The index, released with mm_index_free(), or NULL on error
+ */
+MM_API MMIndex* mm_index_new(void);
+
+/**
+ * @brief Free an index
+ * 
+ * @param index The index, or NULL
+ */
+MM_API void mm_index_free(MMIndex *index);
+
+/**
+ * @brief Index a document, replacing any document of the same name
+ * 
+ * @param index The index
+ * @param name Name reported in search hits, such as a path
+ * @param tag Caller-defined string kept with the document, such as a
+ *            content hash, so unchanged documents can be skipped; may be NULL
+ * @param input The document text, which need not be NUL-terminated
+ * @param length The length of the text in bytes
+ * @return int 0 on success, -1 on error
+ * 
+ * Text without any block is indexed as an empty document. On failure the
+ * previous document of the name stays in the index.
+ */
+MM_API int mm_index_add(MMIndex *index, const char *name, const char *tag,
+                        const char *input, size_t length);
+
+/**
+ * @brief Remove a document from an index
+ * 
+ * @return int 0 on success, -1 with MM_ERROR_INVALID if no document has
+ *             the name
+ */
+MM_API int mm_index_remove(MMIndex *index, const char *name);
+
+/**
+ * @brief Get the tag a document was indexed with
+ * 
+ * @return const char* The tag, "" if none was given, or NULL if no
+ *         document has the name
+ */
+MM_API const char* mm_index_tag(const MMIndex *index, const char *name);
+
+/**
+ * @brief Get the number of documents in an index
+ */
+MM_API size_t mm_index_document_count(const MMIndex *index);
+
+/**
+ * @brief Call a function for every document of an index, in the order added
+ * 
+ * @return int 0, -1 on error, or the nonzero result that stopped the walk
+ * 
+ * The index must not change during the walk.
+ */
+MM_API int mm_index_each(const MMIndex *index, MMIndexDocumentFn callback, void *user_data);
+
+/**
+ * @brief Find the entries matching a query
+ * 
+ * @param index The index
+ * @param query Whitespace-separated terms, all of which must match
+ * @param callback Receives each hit
+ * @param user_data Passed to the callback
+ * @return int The number of hits delivered, or -1 on error
+ * 
+ * A plain word matches entries containing it, ignoring ASCII case.
+ * "heading:word" only matches headings, "annotation:type" and
+ * "component:type" match blocks of that type, and "meta:key" documents
+ * with that metadata key; alone, it matches the metadata pairs. For
+ * example "annotation:todo parser" finds todo annotations mentioning the
+ * parser. Only posting lists are read, so no document is parsed again.
+ */
+MM_API int mm_index_search(const MMIndex *index, const char *query,
+                           MMSearchFn callback, void *user_data);
+
+/**
+ * @brief Serialize an index
+ * 
+ * @return int 0 on success, the sink's nonzero result, or -1 on error
+ */
+MM_API int mm_index_write(const MMIndex *index, MMWriteFn write, void *user_data);
+
+/**
+ * @brief Write an index to a file
+ * 
+ * @return int 0 on success, -1 on error
+ */
+MM_API int mm_index_save(const MMIndex *index, const char *filename);
+
+/**
+ * @brief Read an index written by mm_index_save()
+ * 
+ * @return MMIndex* The index, or NULL if the file is missing or invalid
+ */
+MM_API MMIndex* mm_index_load(const char *filename);
+
+/**
+ * @brief Read an index from serialized bytes
+ * 
+ * @param data The bytes written by mm_index_write(), copied by the call
+ * @param length Their size
+ * @return MMIndex* The index, or NULL if the bytes are invalid
+ * 
+ * Every length, id and posting is checked, so damaged files are rejected.
+ */
+MM_API MMIndex* mm_index_from_buffer(const void *data, size_t length);
+
+/**
+ * @brief Callback receiving parser trace messages
+ * 
+ * @param message The formatted, NUL-terminated trace message
+ * @param user_data The pointer passed to mm_set_trace_callback()
+ */
+typedef void (*MMTraceCallback)(const char *message, void *user_data);
+
+/**
+ * @brief Register a sink for parser trace messages
+ * 
+ * @param callback The callback to invoke, or NULL to disable tracing
+ * @param user_data Pointer handed back to every callback invocation
+ * 
+ * Tracing is compiled out of builds that define NDEBUG unless the library
+ * is built with MM_TRACE_ENABLED=1; the callback is then never invoked.
+ * Registration is process-wide and should happen before parsing starts.
+ */
+MM_API void mm_set_trace_callback(MMTraceCallback callback, void *user_data);
+
+/**
+ * @brief Get the last error that occurred
+ * 
+ * @return MetaMarkError The last error code
+ * 
+ * Errors are tracked per thread; see MMContext for per-call state.
  */
-MetaMarkError get_last_error(void);
+MM_API MetaMarkError get_last_error(void);
 
 /**
  * @brief Convert an error code to a string
@@ -183,6 +1574,6 @@ MetaMarkError get_last_error(void);
  * @param error The error code to convert
  * @return const char* A string description of the error
  */
-const char* error_to_string(MetaMarkError error);
+MM_API const char* error_to_string(MetaMarkError error);
 
 #endif // METAMARK_H 
\ No newline at end of file
@@ -0,0 +1,104 @@
+/**
+ * @file output.h
+ * @brief Output buffer shared by the MetaMark writers
+ *
+ * Writers append to one contiguous buffer. In string mode the buffer grows
+ * geometrically and ends up holding the whole output; in sink mode it has
+ * a fixed size and is handed to an MMWriteFn whenever it fills up, so the
+ * sink sees a few large writes instead of one per node.
+ */
+
+#ifndef METAMARK_OUTPUT_H
+#define METAMARK_OUTPUT_H
+
+#include <stddef.h>
+#include <string.h>
+#include "metamark.h"
+
+/**
+ * @brief Size of the buffer used in sink mode
+ */
+#define MM_OUTPUT_SINK_SIZE 16384
+
+/**
+ * @brief Writer state
+ */
+typedef struct {
+    char *data;          ///< Buffered output
+    size_t length;       ///< Bytes buffered
+    size_t capacity;     ///< Allocated size of data
+    MMWriteFn write;     ///< Sink, or NULL in string mode
+    void *user_data;     ///< Passed to the sink
+    int result;          ///< First failure: -1 or the sink's nonzero result
+} MMOutput;
+
+/**
+ * @brief Start writing into a growable string
+ *
+ * @param out The writer to initialize
+ * @param capacity Initial capacity, a guess of the output size
+ * @return int 0 on success, -1 on error
+ */
+int mm_output_init_string(MMOutput *out, size_t capacity);
+
+/**
+ * @brief Start writing to a sink
+ *
+ * @param out The writer to initialize
+ * @param write The sink
+ * @param user_data Passed to the sink
+ * @return int 0 on success, -1 on error
+ */
+int mm_output_init_sink(MMOutput *out, MMWriteFn write, void *user_data);
+
+/**
+ * @brief Make room for more bytes, flushing or growing the buffer
+ *
+ * @param out The writer
+ * @param length Number of bytes about to be appended
+ * @return int 0 on success, nonzero once the writer has failed
+ */
+int mm_output_reserve(MMOutput *out, size_t length);
+
+/**
+ * @brief Finish writing
+ *
+ * @param out The writer
+ * @param length Receives the string length in string mode, may be NULL
+ * @return char* The NUL-terminated output in string mode, NULL in sink mode
+ *               or on error
+ *
+ * Flushes a sink and releases the buffer, except for the returned string,
+ * which the caller frees with free(). The result is left in out->result.
+ */
+char* mm_output_finish(MMOutput *out, size_t *length);
+
+/**
+ * @brief Append bytes to the output
+ */
+static inline void mm_output_write(MMOutput *out, const char *data, size_t length) {
+    if (out->capacity - out->length < length && mm_output_reserve(out, length) != 0) {
+        return;
+    }
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+/**
+ * @brief Append a NUL-terminated string to the output
+ */
+static inline void mm_output_puts(MMOutput *out, const char *text) {
+    mm_output_write(out, text, strlen(text));
+}
+
+/**
+ * @brief Append one byte to the output
+ */
+static inline void mm_output_char(MMOutput *out, char c) {
+    if (out->length == out->capacity && mm_output_reserve(out, 1) != 0) {
+        return;
+    }
+    out->data[out->length++] = c;
+}
+
+#endif /* METAMARK_OUTPUT_H */
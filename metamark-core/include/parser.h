@@ -0,0 +1,109 @@
+/**
+ * @file parser.h
+ * @brief Internal parser state shared by the MetaMark parse drivers
+ *
+ * parse_metamark() and friends run the parser over a whole buffer; other
+ * drivers (such as the streaming parser) run it one top-level block at a
+ * time through the functions declared here.
+ */
+
+#ifndef METAMARK_PARSER_H
+#define METAMARK_PARSER_H
+
+#include <stddef.h>
+#include "metamark.h"
+#include "lexer.h"
+
+/**
+ * @brief Parser state threaded through the recursive descent functions
+ */
+typedef struct {
+    Lexer lexer;                  ///< Tokenizer over the input text
+    MMArena *arena;               ///< Arena for nodes and strings, or NULL for the heap
+    int zero_copy;                ///< Nonzero when nodes reference the input instead of copying
+    int lazy;                     ///< Nonzero to leave component bodies unbuilt (MM_PARSE_LAZY)
+    const MMEventHandler *events; ///< Event callbacks in event mode, or NULL
+    void *event_data;             ///< Passed back to the event callbacks
+} Parser;
+
+/**
+ * @brief A top-level block located by the scanner
+ *
+ * Scanning only records where a block's pieces lie in the input. The
+ * same description is then either built into nodes or reported as events.
+ */
+typedef struct {
+    NodeType type;      ///< Type of node the block produces
+    size_t level;       ///< Heading level
+    size_t text_start;  ///< Start of the node content
+    size_t text_end;    ///< End of the node content
+    int has_text;       ///< Nonzero if the node has content
+    size_t body_start;  ///< Start of the child paragraph (components, annotations)
+    size_t body_end;    ///< End of the child paragraph
+    int has_body;       ///< Nonzero if the node has a child paragraph
+} Block;
+
+/**
+ * @brief Furthest the parser looks past the end of a completed block
+ *
+ * A block that ends at least this many bytes before the end of the
+ * available input was parsed exactly as it would be with the full input.
+ */
+#define PARSER_LOOKAHEAD 3
+
+/**
+ * @brief Initialize a parser over an input buffer
+ *
+ * @param parser The parser to initialize
+ * @param input The input text
+ * @param length The length of the input in bytes
+ * @param arena The arena to allocate from, or NULL for the heap
+ * @param zero_copy Nonzero to reference the input instead of copying it
+ */
+void parser_init(Parser *parser, const char *input, size_t length,
+                 MMArena *arena, int zero_copy);
+
+/**
+ * @brief Check whether the parser is positioned at a metadata delimiter
+ *
+ * @param parser The parser state
+ * @return int Nonzero if the next bytes are ---
+ */
+int parser_at_metadata(const Parser *parser);
+
+/**
+ * @brief Parse a frontmatter block at the current position
+ *
+ * @param parser The parser state
+ * @param doc The document receiving the key/value pairs, or NULL
+ * @return Node* A new metadata node, or NULL on error
+ *
+ * The pairs are tokenized once, for the node children and the document
+ * metadata alike.
+ */
+Node* parser_metadata(Parser *parser, Document *doc);
+
+/**
+ * @brief Run one iteration of the top-level parse loop
+ *
+ * @param parser The parser state
+ * @return Node* The parsed top-level node, or NULL if none was produced
+ *
+ * When no node is produced, trailing whitespace is skipped exactly as the
+ * whole-document parser does.
+ */
+Node* parser_step(Parser *parser);
+
+/**
+ * @brief Parse an editable document
+ *
+ * @param input The input text, copied into the document
+ * @param length The length of the input in bytes
+ * @param zero_copy Nonzero to make nodes reference the private copy
+ * @return Document* A new document structure, or NULL on error
+ *
+ * Implements MM_PARSE_EDITABLE for parse_document().
+ */
+Document* parser_parse_editable(const char *input, size_t length, int zero_copy);
+
+#endif /* METAMARK_PARSER_H */
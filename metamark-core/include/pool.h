@@ -0,0 +1,48 @@
+/**
+ * @file pool.h
+ * @brief Work-stealing pool for running independent tasks on all cores
+ */
+
+#ifndef METAMARK_POOL_H
+#define METAMARK_POOL_H
+
+#include <stddef.h>
+
+/**
+ * @brief A task run by the pool
+ *
+ * @param task Index of the task, in [0, task count)
+ * @param worker Index of the worker running it, in [0, worker count)
+ * @param user_data The pointer passed to mm_pool_run()
+ * @return int 0 to continue, nonzero to stop starting new tasks
+ */
+typedef int (*MMPoolTask)(size_t task, size_t worker, void *user_data);
+
+/**
+ * @brief Run tasks 0..count-1 on a pool of worker threads
+ *
+ * @param count Number of tasks
+ * @param threads Number of workers, or 0 for one per CPU
+ * @param task The function run for every task
+ * @param user_data Pointer handed to every task
+ * @return int 0 when every task ran, the first nonzero task result if one
+ *             stopped the pool, or -1 on error
+ *
+ * Each worker starts with an even share of the task range and takes tasks
+ * from its front. A worker that runs dry steals the back half of another
+ * worker's remaining range, so uneven task costs still keep every core
+ * busy. The calling thread acts as worker 0. Workers are always fewer
+ * than or equal to the number of tasks.
+ */
+int mm_pool_run(size_t count, size_t threads, MMPoolTask task, void *user_data);
+
+/**
+ * @brief Get the number of workers mm_pool_run() would use
+ *
+ * @param count Number of tasks
+ * @param threads Requested number of workers, or 0 for one per CPU
+ * @return size_t The worker count
+ */
+size_t mm_pool_workers(size_t count, size_t threads);
+
+#endif /* METAMARK_POOL_H */
@@ -0,0 +1,38 @@
+/**
+ * @file scan.h
+ * @brief Vectorized search for bytes that can end a run of plain text
+ *
+ * Most of a prose-heavy document is plain text the parser only steps
+ * over. mm_scan_special() finds the next byte that may start or end a
+ * construct, 16 or 32 bytes at a time where the CPU allows it.
+ */
+
+#ifndef METAMARK_SCAN_H
+#define METAMARK_SCAN_H
+
+#include <stddef.h>
+
+/**
+ * @brief Check whether a byte belongs to the special set
+ *
+ * The set is NUL, newline and the delimiter characters # [ % - > ].
+ */
+#define MM_SCAN_IS_SPECIAL(c) \
+    ((c) == '\0' || (c) == '\n' || (c) == '#' || (c) == '[' || \
+     (c) == '%' || (c) == '-' || (c) == '>' || (c) == ']')
+
+/**
+ * @brief Find the next special byte in a buffer
+ *
+ * @param data The buffer to search
+ * @param pos The offset to start searching from
+ * @param length The length of the buffer in bytes
+ * @return size_t Offset of the first special byte at or after pos, or
+ *                length if there is none
+ *
+ * Uses AVX2, SSE2 or NEON when available, chosen once at runtime, and a
+ * table-driven scalar loop otherwise.
+ */
+size_t mm_scan_special(const char *data, size_t pos, size_t length);
+
+#endif /* METAMARK_SCAN_H */
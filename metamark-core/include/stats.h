@@ -0,0 +1,48 @@
+/**
+ * @file stats.h
+ * @brief Internal hooks filling the MMParseStats of the calling thread
+ *
+ * Every hook first loads mm_active_stats, so while no caller collects
+ * statistics each one costs a single thread-local load and branch. The
+ * pointer is read directly rather than through a function because the
+ * allocation hooks sit on the hottest paths of the library.
+ */
+
+#ifndef METAMARK_STATS_H
+#define METAMARK_STATS_H
+
+#include "metamark.h"
+#include "utils.h"
+
+/**
+ * @brief Statistics collected on this thread, or NULL when collection is off
+ */
+extern MM_THREAD_LOCAL MMParseStats *mm_active_stats;
+
+/**
+ * @brief Monotonic wall-clock time in seconds
+ */
+double mm_stats_clock(void);
+
+/**
+ * @brief Count a heap allocation of the given size
+ */
+#define MM_STATS_ALLOC(size) do { \
+        MMParseStats *mm_stats_ = mm_active_stats; \
+        if (mm_stats_) { \
+            mm_stats_->allocations++; \
+            mm_stats_->allocated_bytes += (size); \
+        } \
+    } while (0)
+
+/**
+ * @brief Count a created node of the given type
+ */
+#define MM_STATS_NODE(type) do { \
+        MMParseStats *mm_stats_ = mm_active_stats; \
+        if (mm_stats_ && (size_t)(type) < MM_NODE_TYPE_COUNT) { \
+            mm_stats_->nodes[(type)]++; \
+        } \
+    } while (0)
+
+#endif /* METAMARK_STATS_H */
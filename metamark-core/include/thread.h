@@ -0,0 +1,86 @@
+/**
+ * @file thread.h
+ * @brief Minimal portable threading shim used by the batch parser
+ *
+ * Wraps pthreads on POSIX systems and the Win32 API on Windows, covering
+ * only what the library needs: threads, mutexes, one-time initialization
+ * and the CPU count.
+ */
+
+#ifndef METAMARK_THREAD_H
+#define METAMARK_THREAD_H
+
+#include <stddef.h>
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE mm_thread_t;
+typedef CRITICAL_SECTION mm_mutex_t;
+typedef INIT_ONCE mm_once_t;
+#define MM_ONCE_INIT INIT_ONCE_STATIC_INIT
+#else
+#include <pthread.h>
+typedef pthread_t mm_thread_t;
+typedef pthread_mutex_t mm_mutex_t;
+typedef pthread_once_t mm_once_t;
+#define MM_ONCE_INIT PTHREAD_ONCE_INIT
+#endif
+
+/**
+ * @brief Entry point of a thread started with mm_thread_create()
+ */
+typedef void (*MMThreadFn)(void *arg);
+
+/**
+ * @brief Start a thread
+ *
+ * @param thread Receives the thread handle
+ * @param fn The function to run
+ * @param arg Argument passed to fn
+ * @return int 0 on success, -1 on error
+ */
+int mm_thread_create(mm_thread_t *thread, MMThreadFn fn, void *arg);
+
+/**
+ * @brief Wait for a thread to finish and release it
+ *
+ * @param thread The thread to join
+ */
+void mm_thread_join(mm_thread_t thread);
+
+/**
+ * @brief Initialize a mutex
+ */
+void mm_mutex_init(mm_mutex_t *mutex);
+
+/**
+ * @brief Lock a mutex
+ */
+void mm_mutex_lock(mm_mutex_t *mutex);
+
+/**
+ * @brief Unlock a mutex
+ */
+void mm_mutex_unlock(mm_mutex_t *mutex);
+
+/**
+ * @brief Destroy a mutex
+ */
+void mm_mutex_destroy(mm_mutex_t *mutex);
+
+/**
+ * @brief Run a function exactly once, however many threads get here
+ *
+ * @param once Flag starting as MM_ONCE_INIT
+ * @param fn The function to run; every caller returns after it finished
+ */
+void mm_once(mm_once_t *once, void (*fn)(void));
+
+/**
+ * @brief Get the number of online CPUs
+ *
+ * @return size_t The CPU count, at least 1
+ */
+size_t mm_cpu_count(void);
+
+#endif /* METAMARK_THREAD_H */
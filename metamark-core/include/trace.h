@@ -0,0 +1,71 @@
+/**
+ * @file trace.h
+ * @brief Internal tracing macros for MetaMark
+ *
+ * MM_TRACE() formats a message and hands it to the callback registered with
+ * mm_set_trace_callback(). When MM_TRACE_ENABLED is 0 (the default for
+ * NDEBUG builds) the macro expands to nothing and its arguments are never
+ * evaluated. When compiled in, an unregistered sink costs a single branch.
+ */
+
+#ifndef METAMARK_TRACE_H
+#define METAMARK_TRACE_H
+
+#include "metamark.h"
+
+#ifndef MM_TRACE_ENABLED
+#  ifdef NDEBUG
+#    define MM_TRACE_ENABLED 0
+#  else
+#    define MM_TRACE_ENABLED 1
+#  endif
+#endif
+
+/**
+ * @brief Maximum length of a single trace message, longer ones are truncated
+ */
+#define MM_TRACE_MAX_MESSAGE 256
+
+/**
+ * @brief Clamp a slice length for use as a "%.*s" precision in MM_TRACE()
+ *
+ * Keeps the formatter from walking whole document bodies that would be
+ * truncated anyway.
+ */
+#define MM_TRACE_CLAMP(length) \
+    ((int)((length) < MM_TRACE_MAX_MESSAGE ? (length) : MM_TRACE_MAX_MESSAGE))
+
+#if MM_TRACE_ENABLED
+
+/**
+ * @brief Check whether a trace callback is registered
+ *
+ * @return int Nonzero if messages would be delivered
+ */
+int mm_trace_active(void);
+
+/**
+ * @brief Format a message and deliver it to the trace callback
+ *
+ * @param format printf-style format string
+ */
+void mm_trace(const char *format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 1, 2)))
+#endif
+    ;
+
+#define MM_TRACE(...) \
+    do { \
+        if (mm_trace_active()) { \
+            mm_trace(__VA_ARGS__); \
+        } \
+    } while (0)
+
+#else
+
+#define MM_TRACE(...) ((void)0)
+
+#endif /* MM_TRACE_ENABLED */
+
+#endif /* METAMARK_TRACE_H */
@@ -4,6 +4,17 @@
 #include <stddef.h>
 #include "metamark.h"
 
+/**
+ * @brief Storage class for per-thread library state
+ */
+#if defined(_MSC_VER) && !defined(__clang__)
+#define MM_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+#define MM_THREAD_LOCAL _Thread_local
+#else
+#define MM_THREAD_LOCAL __thread
+#endif
+
 /**
  * @brief Set the last error code
  * 
@@ -11,6 +22,38 @@
  */
 void set_error(MetaMarkError error);
 
+/**
+ * @brief Set the last error code and where in the input it occurred
+ * 
+ * @param error The error code to set
+ * @param input The input being parsed
+ * @param offset Byte offset of the failure in the input
+ */
+void set_error_at(MetaMarkError error, const char *input, size_t offset);
+
+/**
+ * @brief Forget the position set_error_at() resumes counting lines from
+ * 
+ * Called whenever a lexer starts on an input, since a buffer at the same
+ * address may hold different text than at the last failure.
+ */
+void mm_error_position_reset(void);
+
+/**
+ * @brief Make a context the error target of the calling thread
+ * 
+ * @param ctx The context to report to, or NULL for the thread default
+ * @return MMContext* The previous target, for mm_context_leave()
+ */
+MMContext* mm_context_enter(MMContext *ctx);
+
+/**
+ * @brief Restore the error target saved by mm_context_enter()
+ * 
+ * @param previous The value returned by mm_context_enter()
+ */
+void mm_context_leave(MMContext *previous);
+
 /**
  * @brief Get the last error code
  * 
@@ -43,6 +86,40 @@ void* safe_malloc(size_t size);
  */
 void* safe_realloc(void *ptr, size_t size);
 
+/**
+ * @brief Grow an arena allocation
+ * 
+ * @param arena The arena that owns ptr, or NULL to use realloc
+ * @param ptr The allocation to grow, or NULL
+ * @param old_size The current size of the allocation
+ * @param new_size The requested size
+ * @return void* The grown allocation, or NULL on error
+ * 
+ * The newest allocation in an arena is extended in place when possible.
+ */
+void* mm_arena_grow(MMArena *arena, void *ptr, size_t old_size, size_t new_size);
+
+/**
+ * @brief Copy a string into an arena
+ * 
+ * @param arena The arena to allocate from, or NULL to use malloc
+ * @param str The string to copy
+ * @param length The number of bytes to copy
+ * @return char* A NUL-terminated copy, or NULL on error
+ */
+char* mm_arena_strndup(MMArena *arena, const char *str, size_t length);
+
+/**
+ * @brief Create a node inside an arena
+ * 
+ * @param arena The arena to allocate from, or NULL to use malloc
+ * @param type The type of node to create
+ * @param content The text content of the node, or NULL
+ * @param length The number of content bytes to copy
+ * @return Node* A new node, or NULL on error
+ */
+Node* create_node_in(MMArena *arena, NodeType type, const char *content, size_t length);
+
 /**
  * @brief Check if a string is a valid identifier
  * 
@@ -67,4 +144,124 @@ void print_ast(const Node *node, int indent);
  */
 Document* read_metamark_file(const char *filename);
 
+/**
+ * @brief Map a file read-only into memory
+ * 
+ * @param filename The path to the file to map
+ * @param data Receives the start of the file contents (not NUL-terminated)
+ * @param length Receives the length of the file in bytes
+ * @return MMFileMap* The mapping, or NULL on error
+ */
+MMFileMap* mm_map_file(const char *filename, const char **data, size_t *length);
+
+/**
+ * @brief Release a file mapping
+ * 
+ * @param map The mapping to release, or NULL
+ */
+void mm_unmap_file(MMFileMap *map);
+
+/**
+ * @brief Map and parse a MetaMark file without copying it
+ * 
+ * @param filename The path to the file to read
+ * @return Document* A new document structure, or NULL on error
+ * 
+ * The file is memory-mapped and parsed in zero-copy mode, so view nodes
+ * reference the mapping directly. The document owns the mapping and
+ * free_document() unmaps it.
+ */
+Document* read_metamark_file_mapped(const char *filename);
+
+/**
+ * @brief Parse input straight into a snapshot buffer with the given stamp
+ * 
+ * @param input The input buffer, which need not be NUL-terminated
+ * @param length The length of the input in bytes
+ * @param stamp The stamp stored in the snapshot header
+ * @param size Receives the size of the buffer in bytes
+ * @return unsigned char* The buffer, released with free(), or NULL on error
+ * 
+ * Shared by mm_flat_parse() and the parse cache.
+ */
+unsigned char* mm_flat_encode(const char *input, size_t length, uint64_t stamp, size_t *size);
+
+/**
+ * @brief Fast 64-bit hash of a byte range
+ * 
+ * @param data The bytes to hash
+ * @param length The number of bytes
+ * @param seed Mixed into the result, so hashes can be chained
+ * @return uint64_t The hash
+ */
+uint64_t mm_hash_bytes(const void *data, size_t length, uint64_t seed);
+
+/**
+ * @brief Add a metadata pair given as slices of a larger buffer
+ * 
+ * @param doc The document to add metadata to
+ * @param key Start of the key, not necessarily NUL-terminated
+ * @param key_length Length of the key in bytes
+ * @param value Start of the value, not necessarily NUL-terminated
+ * @param value_length Length of the value in bytes
+ */
+void add_metadata_n(Document *doc, const char *key, size_t key_length,
+                    const char *value, size_t value_length);
+
+/**
+ * @brief Remove every metadata pair from a heap-allocated document
+ * 
+ * @param doc The document to clear
+ */
+void clear_metadata(Document *doc);
+
+/**
+ * @brief Count the children of a node, an unbuilt lazy body included
+ * 
+ * @param node The node
+ * @return size_t The number of children node_child() can return
+ */
+size_t node_child_count(const Node *node);
+
+/**
+ * @brief Get a child of a node, treating an unbuilt lazy body as built
+ * 
+ * @param node The node
+ * @param index Index of the child, below node_child_count()
+ * @param body Scratch node that receives the stand-in for a lazy body
+ * @return const Node* The child, possibly @p body
+ * 
+ * Lets read-only walkers see the same tree whether or not bodies were
+ * built, without modifying it.
+ */
+const Node* node_child(const Node *node, size_t index, Node *body);
+
+/**
+ * @brief Shift the source offsets of a subtree
+ * 
+ * @param node The root of the subtree
+ * @param delta Amount added to every offset; modular arithmetic lets a
+ *              wrapped-around value move offsets backwards
+ * @return int 0 on success, or -1 with the subtree unchanged if memory
+ *             ran out
+ */
+int shift_node_offsets(Node *node, size_t delta);
+
+/**
+ * @brief Shift the source offsets of several subtrees, all or none
+ * 
+ * @param nodes The roots of the subtrees
+ * @param count Number of subtrees
+ * @param delta Amount added to every offset, as for shift_node_offsets()
+ * @return int 0 on success, or -1 with every subtree unchanged
+ */
+int shift_nodes(Node *const *nodes, size_t count, size_t delta);
+
+/**
+ * @brief Free the incremental reparse state of a document
+ * 
+ * @param edit The state to free, or NULL
+ */
+void mm_edit_state_free(MMEditState *edit);
+
 #endif /* METAMARK_UTILS_H */ 
\ No newline at end of file
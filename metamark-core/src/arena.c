@@ -0,0 +1,172 @@
+/**
+ * @file arena.c
+ * @brief Bump-pointer arena allocator for MetaMark documents
+ *
+ * An arena hands out memory from large blocks by advancing a pointer.
+ * Individual allocations are never freed; the whole arena is rewound at once,
+ * which turns document teardown into a walk over blocks instead of nodes.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGNMENT 16
+
+/**
+ * @brief A single block of arena memory
+ *
+ * Blocks form a singly linked list with the newest block at the head.
+ * The usable bytes follow the header directly.
+ */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next; ///< Previously allocated block
+    size_t size;             ///< Usable bytes in this block
+    size_t used;             ///< Bytes handed out so far
+} ArenaBlock;
+
+struct MMArena {
+    ArenaBlock *head;   ///< Block currently being bumped
+    size_t block_size;  ///< Size for newly allocated blocks
+    void *last;         ///< Most recent allocation, for in-place growth
+    size_t last_size;   ///< Size of the most recent allocation
+};
+
+static size_t align_up(size_t size) {
+    return (size + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static char* block_data(ArenaBlock *block) {
+    return (char *)block + align_up(sizeof(ArenaBlock));
+}
+
+static ArenaBlock* arena_push_block(MMArena *arena, size_t min_size) {
+    size_t size = arena->block_size;
+    if (min_size > size) {
+        size = min_size;
+    }
+
+    ArenaBlock *block = safe_malloc(align_up(sizeof(ArenaBlock)) + size);
+    if (!block) {
+        return NULL;
+    }
+
+    block->next = arena->head;
+    block->size = size;
+    block->used = 0;
+    arena->head = block;
+    return block;
+}
+
+MMArena* mm_arena_new(size_t block_size) {
+    MMArena *arena = safe_malloc(sizeof(MMArena));
+    if (!arena) {
+        return NULL;
+    }
+
+    arena->head = NULL;
+    arena->block_size = block_size ? align_up(block_size) : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->last = NULL;
+    arena->last_size = 0;
+    return arena;
+}
+
+void* mm_arena_alloc(MMArena *arena, size_t size) {
+    if (!arena) {
+        return safe_malloc(size);
+    }
+
+    size = align_up(size ? size : 1);
+
+    ArenaBlock *block = arena->head;
+    if (!block || block->size - block->used < size) {
+        block = arena_push_block(arena, size);
+        if (!block) {
+            return NULL;
+        }
+    }
+
+    void *ptr = block_data(block) + block->used;
+    block->used += size;
+    arena->last = ptr;
+    arena->last_size = size;
+    return ptr;
+}
+
+void* mm_arena_grow(MMArena *arena, void *ptr, size_t old_size, size_t new_size) {
+    if (!arena) {
+        return safe_realloc(ptr, new_size);
+    }
+
+    if (!ptr) {
+        return mm_arena_alloc(arena, new_size);
+    }
+
+    // Extend in place when ptr is the newest allocation and the block has room
+    ArenaBlock *block = arena->head;
+    size_t aligned = align_up(new_size);
+    if (ptr == arena->last && block &&
+        block->size - block->used + arena->last_size >= aligned) {
+        block->used += aligned - arena->last_size;
+        arena->last_size = aligned;
+        return ptr;
+    }
+
+    void *new_ptr = mm_arena_alloc(arena, new_size);
+    if (new_ptr && old_size) {
+        memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    }
+    return new_ptr;
+}
+
+char* mm_arena_strndup(MMArena *arena, const char *str, size_t length) {
+    if (!str) {
+        return NULL;
+    }
+
+    char *copy = mm_arena_alloc(arena, length + 1);
+    if (!copy) {
+        return NULL;
+    }
+
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void mm_arena_reset(MMArena *arena) {
+    if (!arena || !arena->head) {
+        return;
+    }
+
+    // Keep the oldest block around so a reused arena does not hit malloc again
+    ArenaBlock *block = arena->head;
+    while (block->next) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    block->used = 0;
+    arena->head = block;
+    arena->last = NULL;
+    arena->last_size = 0;
+}
+
+void mm_arena_free(MMArena *arena) {
+    if (!arena) {
+        return;
+    }
+
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free(arena);
+}
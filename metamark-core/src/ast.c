@@ -7,22 +7,141 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../include/metamark.h"
+#include "../include/utils.h"
+#include "../include/stats.h"
 
-Node* create_node(NodeType type, const char *content) {
-    Node *node = malloc(sizeof(Node));
+Node* create_node_in(MMArena *arena, NodeType type, const char *content, size_t length) {
+    Node *node = mm_arena_alloc(arena, sizeof(Node));
     if (!node) {
         return NULL;
     }
+    MM_STATS_NODE(type);
     
     node->type = type;
-    node->content = content ? strdup(content) : NULL;
+    node->content = NULL;
     node->children = NULL;
     node->child_count = 0;
     node->child_capacity = 0;
+    node->level = 0;
+    node->arena = arena;
+    node->offset = 0;
+    node->length = content ? length : 0;
+    node->flags = 0;
+    node->body_offset = 0;
+    node->body_length = 0;
+    
+    if (content) {
+        node->content = mm_arena_strndup(arena, content, length);
+        if (!node->content) {
+            if (!arena) {
+                free(node);
+            }
+            return NULL;
+        }
+    }
     
     return node;
 }
 
+Node* create_node(NodeType type, const char *content) {
+    return create_node_in(NULL, type, content, content ? strlen(content) : 0);
+}
+
+const char* mm_node_text(const Document *doc, const Node *node, size_t *length) {
+    if (!node) {
+        if (length) {
+            *length = 0;
+        }
+        return NULL;
+    }
+    
+    if (length) {
+        *length = node->length;
+    }
+    
+    if (node->flags & MM_NODE_VIEW) {
+        return doc && doc->source ? doc->source + node->offset : NULL;
+    }
+    
+    return node->content;
+}
+
+/**
+ * @brief Fill in the paragraph that mm_node_body() would build
+ */
+static void lazy_body_node(const Node *node, Node *body) {
+    memset(body, 0, sizeof(Node));
+    body->type = NODE_PARAGRAPH;
+    body->flags = MM_NODE_VIEW;
+    body->offset = node->body_offset;
+    body->length = node->body_length;
+}
+
+size_t node_child_count(const Node *node) {
+    return node->child_count + ((node->flags & MM_NODE_LAZY) ? 1 : 0);
+}
+
+const Node* node_child(const Node *node, size_t index, Node *body) {
+    if (node->flags & MM_NODE_LAZY) {
+        if (index == 0) {
+            lazy_body_node(node, body);
+            return body;
+        }
+        index--;
+    }
+    return node->children[index];
+}
+
+Node* mm_node_body(Node *node) {
+    if (!node) {
+        return NULL;
+    }
+    
+    if (node->flags & MM_NODE_LAZY) {
+        Node *body = create_node_in(node->arena, NODE_PARAGRAPH, NULL, 0);
+        if (!body) {
+            set_error(MM_ERROR_MEMORY);
+            return NULL;
+        }
+        body->flags = MM_NODE_VIEW;
+        body->offset = node->body_offset;
+        body->length = node->body_length;
+        
+        size_t count = node->child_count;
+        add_child(node, body);
+        if (node->child_count == count) {
+            free_node(body);
+            set_error(MM_ERROR_MEMORY);
+            return NULL;
+        }
+        node->flags &= ~MM_NODE_LAZY;
+        return body;
+    }
+    
+    if ((node->type == NODE_COMPONENT || node->type == NODE_ANNOTATION) && node->child_count > 0) {
+        return node->children[0];
+    }
+    return NULL;
+}
+
+const char* mm_node_body_text(const Document *doc, const Node *node, size_t *length) {
+    if (node && (node->flags & MM_NODE_LAZY)) {
+        Node body;
+        lazy_body_node(node, &body);
+        return mm_node_text(doc, &body, length);
+    }
+    
+    if (node && (node->type == NODE_COMPONENT || node->type == NODE_ANNOTATION) &&
+        node->child_count > 0) {
+        return mm_node_text(doc, node->children[0], length);
+    }
+    
+    if (length) {
+        *length = 0;
+    }
+    return NULL;
+}
+
 void add_child(Node *parent, Node *child) {
     if (!parent || !child) {
         return;
@@ -30,7 +149,9 @@ void add_child(Node *parent, Node *child) {
     
     if (parent->child_count >= parent->child_capacity) {
         size_t new_capacity = parent->child_capacity == 0 ? 4 : parent->child_capacity * 2;
-        Node **new_children = realloc(parent->children, new_capacity * sizeof(Node*));
+        Node **new_children = mm_arena_grow(parent->arena, parent->children,
+                                            parent->child_capacity * sizeof(Node*),
+                                            new_capacity * sizeof(Node*));
         if (!new_children) {
             return;
         }
@@ -42,40 +163,131 @@ void add_child(Node *parent, Node *child) {
     parent->children[parent->child_count++] = child;
 }
 
-void free_node(Node *node) {
-    if (!node) {
-        return;
+/**
+ * @brief Shift the offsets of the first limit nodes of a walk
+ *
+ * @return size_t The number of nodes shifted
+ */
+static size_t shift_walk(MMWalker *walker, Node *node, size_t delta, size_t limit) {
+    size_t shifted = 0;
+    const Node *next;
+    mm_walker_reset(walker, node, MM_WALK_ENTER);
+    while (shifted < limit && (next = mm_walker_next(walker, NULL))) {
+        Node *moved = (Node *)next;
+        moved->offset += delta;
+        if (moved->flags & MM_NODE_LAZY) {
+            moved->body_offset += delta;
+        }
+        shifted++;
     }
-    
-    // Free content
-    if (node->content) {
+    return shifted;
+}
+
+int shift_nodes(Node *const *nodes, size_t count, size_t delta) {
+    MMWalker walker;
+    mm_walker_init(&walker, NULL, MM_WALK_ENTER);
+    for (size_t i = 0; i < count; i++) {
+        size_t shifted = shift_walk(&walker, nodes[i], delta, (size_t)-1);
+        if (!walker.failed) {
+            continue;
+        }
+
+        // Shift back what was done; the stack is already deep enough for it
+        shift_walk(&walker, nodes[i], 0 - delta, shifted);
+        for (size_t j = 0; j < i; j++) {
+            shift_walk(&walker, nodes[j], 0 - delta, (size_t)-1);
+        }
+        mm_walker_finish(&walker);
+        return -1;
+    }
+    mm_walker_finish(&walker);
+    return 0;
+}
+
+int shift_node_offsets(Node *node, size_t delta) {
+    return shift_nodes(&node, 1, delta);
+}
+
+/**
+ * @brief Free a node whose children are already gone
+ */
+static void release_node(Node *node) {
+    if (!node->arena) {
         free(node->content);
+        free(node->children);
+        free(node);
     }
-    
-    // Free children recursively
-    for (size_t i = 0; i < node->child_count; i++) {
-        free_node(node->children[i]);
+}
+
+/**
+ * @brief Free a subtree without any stack, one leaf at a time
+ *
+ * Takes time proportional to the size of the subtree times its depth, so
+ * it only finishes teardowns that ran out of memory for a walker stack.
+ */
+static void free_without_stack(Node *root) {
+    while (root->child_count > 0) {
+        Node *parent = root;
+        Node *child = parent->children[parent->child_count - 1];
+        while (child->child_count > 0) {
+            parent = child;
+            child = child->children[child->child_count - 1];
+        }
+        parent->child_count--;
+        release_node(child);
+    }
+    release_node(root);
+}
+
+void free_node(Node *node) {
+    // Arena nodes are released together with their arena
+    if (!node || node->arena) {
+        return;
     }
     
-    // Free children array
-    if (node->children) {
-        free(node->children);
+    // Children are freed before their parent, which the walker no longer
+    // touches once it has been left
+    MMWalker walker;
+    const Node *next;
+    mm_walker_init(&walker, node, MM_WALK_LEAVE);
+    while ((next = mm_walker_next(&walker, NULL))) {
+        release_node((Node *)next);
     }
     
-    free(node);
+    // Without memory to go deeper, drop the children already freed from
+    // the open nodes and finish the teardown without a stack. Every open
+    // node below the top is the last child its parent entered.
+    if (walker.failed) {
+        for (size_t i = 0; i < walker.depth; i++) {
+            Node *open = (Node *)walker.frames[i].node;
+            size_t freed = walker.frames[i].next - (i + 1 < walker.depth ? 1 : 0);
+            memmove(open->children, open->children + freed,
+                    (open->child_count - freed) * sizeof(Node*));
+            open->child_count -= freed;
+        }
+        free_without_stack(node);
+    }
+    mm_walker_finish(&walker);
 }
 
-void free_document(Document *doc) {
-    if (!doc) {
+/**
+ * @brief Release everything a document owns
+ */
+static void release_document(Document *doc) {
+    // View nodes may reference the mapping, so it goes with the document
+    mm_unmap_file(doc->mapping);
+    
+    // The document itself lives in its arena, so rewinding releases everything
+    if (doc->arena) {
+        mm_arena_reset(doc->arena);
         return;
     }
     
     // Free metadata
-    for (size_t i = 0; i < doc->metadata_count; i++) {
-        free(doc->metadata[i].key);
-        free(doc->metadata[i].value);
-    }
-    free(doc->metadata);
+    clear_metadata(doc);
+    
+    // Free the reparse state, which may own the source of view nodes
+    mm_edit_state_free(doc->edit);
     
     // Free AST
     free_node(doc->root);
@@ -83,27 +295,42 @@ void free_document(Document *doc) {
     free(doc);
 }
 
-void print_ast(const Node *root, int indent) {
-    if (!root) {
+void free_document(Document *doc) {
+    if (!doc) {
         return;
     }
     
-    // Print indentation
-    for (int i = 0; i < indent; i++) {
-        printf("  ");
-    }
-    
-    // Print node type and content
-    printf("%s", node_type_to_string(root->type));
-    if (root->content) {
-        printf(": %s", root->content);
+    MMParseStats *stats = mm_active_stats;
+    if (!stats) {
+        release_document(doc);
+        return;
     }
-    printf("\n");
     
-    // Print children
-    for (size_t i = 0; i < root->child_count; i++) {
-        print_ast(root->children[i], indent + 1);
+    double start = mm_stats_clock();
+    release_document(doc);
+    stats->free_seconds += mm_stats_clock() - start;
+}
+
+void print_ast(const Node *root, int indent) {
+    MMWalker walker;
+    MMVisit visit;
+    const Node *node;
+    size_t base = indent > 0 ? (size_t)indent : 0;
+    mm_walker_init(&walker, root, MM_WALK_ENTER);
+    while ((node = mm_walker_next(&walker, &visit))) {
+        // Print indentation
+        for (size_t i = 0; i < base + visit.depth; i++) {
+            printf("  ");
+        }
+        
+        // Print node type and content
+        printf("%s", node_type_to_string(node->type));
+        if (node->content) {
+            printf(": %s", node->content);
+        }
+        printf("\n");
     }
+    mm_walker_finish(&walker);
 }
 
 const char* node_type_to_string(NodeType type) {
@@ -0,0 +1,104 @@
+/**
+ * @file batch.c
+ * @brief Parallel parsing of many documents
+ *
+ * Every file is one pool task. Workers reuse a private arena across the
+ * files they parse, so the steady state allocates nothing from the shared
+ * heap, and only delivery to the callback is serialized.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+#include "../include/thread.h"
+#include "../include/pool.h"
+
+/**
+ * @brief State shared by the workers of one batch
+ */
+typedef struct {
+    const char *const *paths;  ///< Files to parse
+    MMBatchCallback callback;  ///< Receives the results
+    void *user_data;           ///< Passed to the callback
+    MMArena **arenas;          ///< One arena per worker, created on first use
+    mm_mutex_t lock;           ///< Serializes the callback
+    int result;                ///< Nonzero once the callback stopped the batch
+} BatchJob;
+
+static int batch_task(size_t task, size_t worker, void *data) {
+    BatchJob *job = data;
+    MMBatchResult result;
+    memset(&result, 0, sizeof(result));
+    result.path = job->paths[task];
+    result.index = task;
+
+    // Errors raised outside the parse itself also belong to this file
+    MMContext *previous = mm_context_enter(&result.context);
+
+    if (!job->arenas[worker]) {
+        job->arenas[worker] = mm_arena_new(0);
+    }
+
+    const char *data_start;
+    MMFileMap *map = NULL;
+    if (!result.path) {
+        set_error(MM_ERROR_INVALID);
+    } else if (job->arenas[worker]) {
+        map = mm_map_file(result.path, &data_start, &result.size);
+    }
+
+    if (map) {
+        MMParseOptions options = { job->arenas[worker], MM_PARSE_VIEW, 0 };
+        result.doc = mm_parse_document(&result.context, data_start, result.size, &options);
+        if (result.doc) {
+            result.doc->mapping = map;
+        } else {
+            mm_unmap_file(map);
+        }
+    }
+
+    mm_context_leave(previous);
+
+    int stop;
+    mm_mutex_lock(&job->lock);
+    stop = job->result;
+    if (!stop) {
+        stop = job->result = job->callback(&result, job->user_data);
+    }
+    mm_mutex_unlock(&job->lock);
+
+    // Unmaps the file and rewinds the worker's arena for its next file
+    free_document(result.doc);
+    return stop;
+}
+
+int mm_parse_batch(const char *const *paths, size_t count, size_t threads,
+                   MMBatchCallback callback, void *user_data) {
+    if ((!paths && count) || !callback) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    size_t workers = mm_pool_workers(count, threads);
+    BatchJob job;
+    job.paths = paths;
+    job.callback = callback;
+    job.user_data = user_data;
+    job.result = 0;
+    job.arenas = calloc(workers, sizeof(MMArena *));
+    if (!job.arenas) {
+        set_error(MM_ERROR_MEMORY);
+        return -1;
+    }
+    mm_mutex_init(&job.lock);
+
+    int result = mm_pool_run(count, workers, batch_task, &job);
+
+    for (size_t i = 0; i < workers; i++) {
+        mm_arena_free(job.arenas[i]);
+    }
+    free(job.arenas);
+    mm_mutex_destroy(&job.lock);
+    return result;
+}
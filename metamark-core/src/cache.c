@@ -0,0 +1,390 @@
+/**
+ * @file cache.c
+ * @brief Content-addressed parse cache
+ *
+ * Entries are snapshots, so a cached document is one buffer with no
+ * pointers and the on-disk tier is the snapshot file format itself. The
+ * key doubles as the snapshot stamp, which lets a file found in the cache
+ * directory be checked against the name it was looked up by.
+ *
+ * Entries sit in a chained hash table and a doubly linked list ordered by
+ * last use. Parsing runs outside the lock; when two threads miss on the
+ * same input at once, the second to finish adopts the first one's entry.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+#include "../include/thread.h"
+
+#define CACHE_MIN_BUCKETS 64
+
+struct MMCacheEntry {
+    MMParseCache *cache;    ///< The cache holding the entry
+    uint64_t key;           ///< Hash of the input
+    MMSnapshot *snapshot;   ///< Reader over buffer or map
+    unsigned char *buffer;  ///< Snapshot bytes, or NULL when mapped from disk
+    MMFileMap *map;         ///< Mapped spill file, or NULL
+    size_t bytes;           ///< Size counted against the budget
+    size_t refs;            ///< Lookups not yet released
+    MMCacheEntry *chain;    ///< Next entry in the same bucket
+    MMCacheEntry *newer;    ///< Previous entry in use order
+    MMCacheEntry *older;    ///< Next entry in use order
+};
+
+struct MMParseCache {
+    mm_mutex_t lock;          ///< Guards everything below
+    char *directory;          ///< Spill directory, or NULL
+    size_t budget;            ///< Byte budget of the entries in memory
+    MMCacheEntry **buckets;   ///< Hash table, a power of two in size
+    size_t bucket_count;      ///< Number of buckets
+    MMCacheEntry *newest;     ///< Most recently used entry
+    MMCacheEntry *oldest;     ///< Least recently used entry
+    MMCacheStats stats;       ///< Counters, including entries and bytes
+};
+
+MMParseCache* mm_cache_new(size_t byte_budget, const char *directory) {
+    MMParseCache *cache = safe_malloc(sizeof(MMParseCache));
+    if (!cache) {
+        return NULL;
+    }
+    memset(cache, 0, sizeof(MMParseCache));
+    cache->budget = byte_budget;
+    cache->bucket_count = CACHE_MIN_BUCKETS;
+    cache->buckets = calloc(cache->bucket_count, sizeof(MMCacheEntry *));
+    if (directory) {
+        size_t size = strlen(directory) + 1;
+        if ((cache->directory = safe_malloc(size)) != NULL) {
+            memcpy(cache->directory, directory, size);
+        }
+    }
+    if (!cache->buckets || (directory && !cache->directory)) {
+        set_error(MM_ERROR_MEMORY);
+        free(cache->buckets);
+        free(cache->directory);
+        free(cache);
+        return NULL;
+    }
+    mm_mutex_init(&cache->lock);
+    return cache;
+}
+
+static void free_entry(MMCacheEntry *entry) {
+    mm_snapshot_close(entry->snapshot);
+    free(entry->buffer);
+    mm_unmap_file(entry->map);
+    free(entry);
+}
+
+void mm_cache_free(MMParseCache *cache) {
+    if (!cache) {
+        return;
+    }
+
+    MMCacheEntry *entry = cache->newest;
+    while (entry) {
+        MMCacheEntry *older = entry->older;
+        free_entry(entry);
+        entry = older;
+    }
+    mm_mutex_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache->directory);
+    free(cache);
+}
+
+static MMCacheEntry** find_slot(MMParseCache *cache, uint64_t key) {
+    MMCacheEntry **slot = &cache->buckets[key & (cache->bucket_count - 1)];
+    while (*slot && (*slot)->key != key) {
+        slot = &(*slot)->chain;
+    }
+    return slot;
+}
+
+static void unlink_use(MMParseCache *cache, MMCacheEntry *entry) {
+    if (entry->newer) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+    entry->newer = entry->older = NULL;
+}
+
+static void push_newest(MMParseCache *cache, MMCacheEntry *entry) {
+    entry->older = cache->newest;
+    if (cache->newest) {
+        cache->newest->newer = entry;
+    } else {
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+}
+
+/**
+ * @brief Double the table once it holds more entries than buckets
+ *
+ * A failed allocation keeps the old table, which only lengthens chains.
+ */
+static void grow_table(MMParseCache *cache) {
+    if (cache->stats.entries <= cache->bucket_count) {
+        return;
+    }
+
+    size_t count = cache->bucket_count * 2;
+    MMCacheEntry **buckets = calloc(count, sizeof(MMCacheEntry *));
+    if (!buckets) {
+        return;
+    }
+    for (size_t i = 0; i < cache->bucket_count; i++) {
+        MMCacheEntry *entry = cache->buckets[i];
+        while (entry) {
+            MMCacheEntry *next = entry->chain;
+            MMCacheEntry **slot = &buckets[entry->key & (count - 1)];
+            entry->chain = *slot;
+            *slot = entry;
+            entry = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_count = count;
+}
+
+/**
+ * @brief Drop unreferenced entries, oldest first, until within the budget
+ */
+static void evict(MMParseCache *cache) {
+    MMCacheEntry *entry = cache->oldest;
+    while (entry && cache->stats.bytes > cache->budget) {
+        MMCacheEntry *newer = entry->newer;
+        if (entry->refs == 0) {
+            *find_slot(cache, entry->key) = entry->chain;
+            unlink_use(cache, entry);
+            cache->stats.entries--;
+            cache->stats.bytes -= entry->bytes;
+            cache->stats.evictions++;
+            free_entry(entry);
+        }
+        entry = newer;
+    }
+}
+
+/**
+ * @brief Find a cached entry and take a reference to it
+ *
+ * Must be called with the lock held.
+ */
+static MMCacheEntry* acquire(MMParseCache *cache, uint64_t key) {
+    MMCacheEntry *entry = *find_slot(cache, key);
+    if (entry) {
+        entry->refs++;
+        unlink_use(cache, entry);
+        push_newest(cache, entry);
+    }
+    return entry;
+}
+
+/**
+ * @brief Add a new entry, or adopt the one another thread added first
+ *
+ * @param counter The counter of the kind of lookup, bumped either way
+ * @return MMCacheEntry* The entry now in the cache, with a reference taken
+ */
+static MMCacheEntry* insert(MMParseCache *cache, MMCacheEntry *entry, size_t *counter) {
+    mm_mutex_lock(&cache->lock);
+    (*counter)++;
+    MMCacheEntry *existing = acquire(cache, entry->key);
+    if (existing) {
+        mm_mutex_unlock(&cache->lock);
+        free_entry(entry);
+        return existing;
+    }
+
+    entry->refs = 1;
+    *find_slot(cache, entry->key) = entry;
+    push_newest(cache, entry);
+    cache->stats.entries++;
+    cache->stats.bytes += entry->bytes;
+    grow_table(cache);
+    evict(cache);
+    mm_mutex_unlock(&cache->lock);
+    return entry;
+}
+
+/**
+ * @brief Wrap snapshot bytes in an entry, which takes ownership of them
+ *
+ * @return MMCacheEntry* The entry, or NULL if the bytes are not a snapshot
+ *         with the key as its stamp
+ */
+static MMCacheEntry* new_entry(MMParseCache *cache, uint64_t key, unsigned char *buffer,
+                               MMFileMap *map, const void *data, size_t size) {
+    MMSnapshot *snapshot = mm_snapshot_from_buffer(data, size);
+    MMCacheEntry *entry = NULL;
+    if (snapshot && mm_snapshot_stamp(snapshot) == key) {
+        entry = safe_malloc(sizeof(MMCacheEntry));
+    }
+    if (!entry) {
+        mm_snapshot_close(snapshot);
+        free(buffer);
+        mm_unmap_file(map);
+        return NULL;
+    }
+    memset(entry, 0, sizeof(MMCacheEntry));
+    entry->cache = cache;
+    entry->key = key;
+    entry->snapshot = snapshot;
+    entry->buffer = buffer;
+    entry->map = map;
+    entry->bytes = size + sizeof(MMCacheEntry);
+    return entry;
+}
+
+/**
+ * @brief Path of the snapshot for a key in the cache directory
+ *
+ * @param suffix Appended to the name, used for the temporary file
+ */
+static char* spill_path(const MMParseCache *cache, uint64_t key, const char *suffix) {
+    size_t length = strlen(cache->directory) + strlen(suffix) + 22;
+    char *path = safe_malloc(length);
+    if (path) {
+        snprintf(path, length, "%s/%016llx.mms%s", cache->directory,
+                 (unsigned long long)key, suffix);
+    }
+    return path;
+}
+
+/**
+ * @brief Map a spilled snapshot, if one exists for the key
+ */
+static MMCacheEntry* load_spilled(MMParseCache *cache, uint64_t key) {
+    char *path = spill_path(cache, key, "");
+    if (!path) {
+        return NULL;
+    }
+
+    // A missing or damaged file is an ordinary miss, not an error
+    MMContext probe;
+    mm_context_init(&probe);
+    MMContext *previous = mm_context_enter(&probe);
+    const char *data;
+    size_t length;
+    MMFileMap *map = mm_map_file(path, &data, &length);
+    MMCacheEntry *entry = map ? new_entry(cache, key, NULL, map, data, length) : NULL;
+    mm_context_leave(previous);
+    free(path);
+    return entry;
+}
+
+/**
+ * @brief Write a snapshot to the cache directory
+ *
+ * The bytes go to a temporary file that is renamed into place, so readers
+ * in other processes never map a partial snapshot. Failures only cost a
+ * later parse and are not reported.
+ */
+static void spill(MMParseCache *cache, uint64_t key, const unsigned char *buffer, size_t size) {
+    char *path = spill_path(cache, key, "");
+    char *temp = spill_path(cache, key, ".tmp");
+    FILE *file = path && temp ? fopen(temp, "wb") : NULL;
+    if (file) {
+        int written = fwrite(buffer, 1, size, file) == size;
+        if (fclose(file) != 0 || !written || rename(temp, path) != 0) {
+            remove(temp);
+        }
+    }
+    free(path);
+    free(temp);
+}
+
+/**
+ * @brief Serve a lookup for input with a known key
+ */
+static MMCacheEntry* lookup(MMParseCache *cache, uint64_t key, const char *input, size_t length) {
+    mm_mutex_lock(&cache->lock);
+    MMCacheEntry *entry = acquire(cache, key);
+    if (entry) {
+        cache->stats.hits++;
+    }
+    mm_mutex_unlock(&cache->lock);
+    if (entry) {
+        return entry;
+    }
+
+    if (cache->directory && (entry = load_spilled(cache, key)) != NULL) {
+        return insert(cache, entry, &cache->stats.disk_hits);
+    }
+
+    size_t size = 0;
+    unsigned char *buffer = mm_flat_encode(input, length, key, &size);
+    if (!buffer) {
+        return NULL;
+    }
+    if (cache->directory) {
+        spill(cache, key, buffer, size);
+    }
+
+    entry = new_entry(cache, key, buffer, NULL, buffer, size);
+    return entry ? insert(cache, entry, &cache->stats.misses) : NULL;
+}
+
+MMCacheEntry* mm_cache_parse(MMParseCache *cache, const char *input, size_t length) {
+    if (!cache || !input) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+    return lookup(cache, mm_hash_bytes(input, length, 0), input, length);
+}
+
+MMCacheEntry* mm_cache_read_file(MMParseCache *cache, const char *filename) {
+    if (!cache || !filename) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+
+    const char *data;
+    size_t length;
+    MMFileMap *map = mm_map_file(filename, &data, &length);
+    if (!map) {
+        return NULL;
+    }
+    MMCacheEntry *entry = lookup(cache, mm_hash_bytes(data, length, 0), data, length);
+    mm_unmap_file(map);
+    return entry;
+}
+
+const MMSnapshot* mm_cache_snapshot(const MMCacheEntry *entry) {
+    return entry ? entry->snapshot : NULL;
+}
+
+void mm_cache_release(MMCacheEntry *entry) {
+    if (!entry) {
+        return;
+    }
+
+    MMParseCache *cache = entry->cache;
+    mm_mutex_lock(&cache->lock);
+    entry->refs--;
+    if (entry->refs == 0) {
+        evict(cache);
+    }
+    mm_mutex_unlock(&cache->lock);
+}
+
+void mm_cache_stats(MMParseCache *cache, MMCacheStats *stats) {
+    if (!cache || !stats) {
+        return;
+    }
+
+    mm_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    mm_mutex_unlock(&cache->lock);
+}
@@ -0,0 +1,375 @@
+/**
+ * @file diff.c
+ * @brief Structural diff of document trees
+ *
+ * Children are reduced to subtree hashes first, so the diff itself only
+ * ever compares 64-bit values. The shortest edit script comes from Myers'
+ * divide-and-conquer variant: find the middle snake of the current range
+ * by searching from both ends at once, then recurse on either side of it.
+ * Two diagonal arrays sized for the whole problem are reused by every
+ * level, so memory stays linear however far apart the sequences are.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+
+/**
+ * @brief Hash the fields of one node, before its children are chained in
+ */
+static uint64_t hash_fields(NodeType type, size_t level, const char *text, size_t length) {
+    uint64_t seed = ((uint64_t)type << 32) ^ (uint64_t)level;
+    return mm_hash_bytes(text ? text : "", text ? length : 0, seed);
+}
+
+uint64_t mm_node_hash(const Document *doc, const Node *node) {
+    if (!node) {
+        return 0;
+    }
+
+    // One running hash per open node; a child is chained into its parent
+    // when it is left
+    uint64_t inline_hashes[MM_WALK_INLINE_DEPTH];
+    uint64_t *hashes = inline_hashes;
+    size_t capacity = MM_WALK_INLINE_DEPTH;
+    uint64_t result = 0;
+
+    MMWalker walker;
+    MMVisit visit;
+    const Node *current;
+    mm_walker_init(&walker, node, MM_WALK_ENTER | MM_WALK_LEAVE);
+    while ((current = mm_walker_next(&walker, &visit))) {
+        size_t length = 0;
+        const char *text;
+        if (!visit.leaving) {
+            if (visit.depth == capacity) {
+                uint64_t *grown = safe_malloc(capacity * 2 * sizeof(uint64_t));
+                if (!grown) {
+                    result = 0;
+                    break;
+                }
+                memcpy(grown, hashes, capacity * sizeof(uint64_t));
+                if (hashes != inline_hashes) {
+                    free(hashes);
+                }
+                hashes = grown;
+                capacity *= 2;
+            }
+            text = mm_node_text(doc, current, &length);
+            hashes[visit.depth] = hash_fields(current->type, current->level, text, length);
+            continue;
+        }
+
+        // An unbuilt body hashes like the paragraph mm_node_body() would append
+        uint64_t hash = hashes[visit.depth];
+        if (current->flags & MM_NODE_LAZY) {
+            text = mm_node_body_text(doc, current, &length);
+            uint64_t body = hash_fields(NODE_PARAGRAPH, 0, text, length);
+            hash = mm_hash_bytes(&body, sizeof(body), hash);
+        }
+        if (visit.depth > 0) {
+            hashes[visit.depth - 1] = mm_hash_bytes(&hash, sizeof(hash), hashes[visit.depth - 1]);
+        } else {
+            result = hash;
+        }
+    }
+    mm_walker_finish(&walker);
+    if (hashes != inline_hashes) {
+        free(hashes);
+    }
+    return result;
+}
+
+/**
+ * @brief State shared by every level of the recursion
+ */
+typedef struct {
+    const uint64_t *a;        ///< Hashes of the old children
+    const uint64_t *b;        ///< Hashes of the new children
+    unsigned char *deleted;   ///< Marks old children that are removed
+    unsigned char *inserted;  ///< Marks new children that are inserted
+    ptrdiff_t *forward;       ///< Furthest x per diagonal, searching forward
+    ptrdiff_t *backward;      ///< Furthest x per diagonal, searching backward
+    ptrdiff_t offset;         ///< Index of diagonal 0 in both arrays
+} DiffState;
+
+/**
+ * @brief A diagonal run of matches splitting a range in two
+ */
+typedef struct {
+    size_t x0, y0;  ///< Start of the snake
+    size_t x1, y1;  ///< End of the snake
+} Snake;
+
+/**
+ * @brief Find the middle snake of a shortest edit script for a range
+ *
+ * Both searches advance one edit at a time until the forward path on some
+ * diagonal k meets the backward path on the same diagonal, which the
+ * backward arrays index as delta - k because they run on the reversed
+ * sequences. The range must be non-empty on both sides.
+ */
+static Snake middle_snake(DiffState *s, size_t a0, size_t a1, size_t b0, size_t b1) {
+    ptrdiff_t n = (ptrdiff_t)(a1 - a0);
+    ptrdiff_t m = (ptrdiff_t)(b1 - b0);
+    ptrdiff_t delta = n - m;
+    int odd = (int)(delta & 1);
+    ptrdiff_t max = (n + m + 1) / 2;
+    ptrdiff_t *vf = s->forward + s->offset;
+    ptrdiff_t *vb = s->backward + s->offset;
+    Snake snake = { a0, b0, a1, b1 };
+
+    vf[1] = 0;
+    vb[1] = 0;
+    for (ptrdiff_t d = 0; d <= max; d++) {
+        for (ptrdiff_t k = -d; k <= d; k += 2) {
+            ptrdiff_t x = (k == -d || (k != d && vf[k - 1] < vf[k + 1])) ? vf[k + 1] : vf[k - 1] + 1;
+            ptrdiff_t y = x - k;
+            ptrdiff_t x_start = x, y_start = y;
+            while (x < n && y < m && s->a[a0 + x] == s->b[b0 + y]) {
+                x++;
+                y++;
+            }
+            vf[k] = x;
+            if (odd && k >= delta - (d - 1) && k <= delta + (d - 1) && x + vb[delta - k] >= n) {
+                snake.x0 = a0 + (size_t)x_start;
+                snake.y0 = b0 + (size_t)y_start;
+                snake.x1 = a0 + (size_t)x;
+                snake.y1 = b0 + (size_t)y;
+                return snake;
+            }
+        }
+        for (ptrdiff_t k = -d; k <= d; k += 2) {
+            ptrdiff_t x = (k == -d || (k != d && vb[k - 1] < vb[k + 1])) ? vb[k + 1] : vb[k - 1] + 1;
+            ptrdiff_t y = x - k;
+            ptrdiff_t x_start = x, y_start = y;
+            while (x < n && y < m && s->a[a1 - 1 - x] == s->b[b1 - 1 - y]) {
+                x++;
+                y++;
+            }
+            vb[k] = x;
+            if (!odd && delta - k >= -d && delta - k <= d && x + vf[delta - k] >= n) {
+                snake.x0 = a1 - (size_t)x;
+                snake.y0 = b1 - (size_t)y;
+                snake.x1 = a1 - (size_t)x_start;
+                snake.y1 = b1 - (size_t)y_start;
+                return snake;
+            }
+        }
+    }
+    return snake;
+}
+
+/**
+ * @brief Mark the removed and inserted children of a range
+ */
+static void diff_range(DiffState *s, size_t a0, size_t a1, size_t b0, size_t b1) {
+    // Identical runs at either end are matched without searching
+    while (a0 < a1 && b0 < b1 && s->a[a0] == s->b[b0]) {
+        a0++;
+        b0++;
+    }
+    while (a0 < a1 && b0 < b1 && s->a[a1 - 1] == s->b[b1 - 1]) {
+        a1--;
+        b1--;
+    }
+    if (a0 == a1 || b0 == b1) {
+        memset(s->deleted + a0, 1, a1 - a0);
+        memset(s->inserted + b0, 1, b1 - b0);
+        return;
+    }
+
+    // With both ends trimmed neither half can be the whole range again;
+    // the check only guards against looping forever should that break
+    Snake snake = middle_snake(s, a0, a1, b0, b1);
+    if ((snake.x0 == a1 && snake.y0 == b1) || (snake.x1 == a0 && snake.y1 == b0)) {
+        memset(s->deleted + a0, 1, a1 - a0);
+        memset(s->inserted + b0, 1, b1 - b0);
+        return;
+    }
+    diff_range(s, a0, snake.x0, b0, snake.y0);
+    diff_range(s, snake.x1, a1, snake.y1, b1);
+}
+
+static uint64_t* hash_children(const Document *doc, const Node *node, size_t count) {
+    uint64_t *hashes = safe_malloc((count ? count : 1) * sizeof(uint64_t));
+    for (size_t i = 0; hashes && i < count; i++) {
+        hashes[i] = mm_node_hash(doc, node->children[i]);
+    }
+    return hashes;
+}
+
+/**
+ * @brief Turn the marks into hunks, one per run between kept children
+ */
+static int collect_hunks(MMDiff *diff, const DiffState *s, size_t n, size_t m) {
+    size_t capacity = 0;
+    size_t i = 0, j = 0;
+    while (i < n || j < m) {
+        if (i < n && j < m && !s->deleted[i] && !s->inserted[j]) {
+            i++;
+            j++;
+            continue;
+        }
+
+        MMDiffHunk hunk = { i, 0, j, 0 };
+        while (i < n && s->deleted[i]) {
+            i++;
+        }
+        while (j < m && s->inserted[j]) {
+            j++;
+        }
+        hunk.old_count = i - hunk.old_first;
+        hunk.new_count = j - hunk.new_first;
+        if (hunk.old_count == 0 && hunk.new_count == 0) {
+            // Marks out of step would otherwise stall the walk
+            hunk.old_count = n - i;
+            hunk.new_count = m - j;
+            i = n;
+            j = m;
+        }
+
+        if (diff->hunk_count == capacity) {
+            size_t grown = capacity ? capacity * 2 : 8;
+            MMDiffHunk *hunks = safe_realloc(diff->hunks, grown * sizeof(MMDiffHunk));
+            if (!hunks) {
+                return -1;
+            }
+            diff->hunks = hunks;
+            capacity = grown;
+        }
+        diff->hunks[diff->hunk_count++] = hunk;
+        diff->distance += hunk.old_count + hunk.new_count;
+    }
+    return 0;
+}
+
+MMDiff* mm_diff_nodes(const Document *old_doc, const Node *old_node,
+                      const Document *new_doc, const Node *new_node) {
+    size_t n = old_node ? old_node->child_count : 0;
+    size_t m = new_node ? new_node->child_count : 0;
+
+    MMDiff *diff = safe_malloc(sizeof(MMDiff));
+    if (!diff) {
+        return NULL;
+    }
+    memset(diff, 0, sizeof(MMDiff));
+
+    // Diagonals run from -(max + 1) to max + 1 for the widest range
+    size_t max = (n + m + 1) / 2;
+    DiffState s;
+    s.a = hash_children(old_doc, old_node, n);
+    s.b = hash_children(new_doc, new_node, m);
+    s.deleted = calloc(n + 1, 1);
+    s.inserted = calloc(m + 1, 1);
+    s.forward = safe_malloc((2 * max + 3) * sizeof(ptrdiff_t));
+    s.backward = safe_malloc((2 * max + 3) * sizeof(ptrdiff_t));
+    s.offset = (ptrdiff_t)max + 1;
+
+    int result = -1;
+    if (s.a && s.b && s.deleted && s.inserted && s.forward && s.backward) {
+        diff_range(&s, 0, n, 0, m);
+        result = collect_hunks(diff, &s, n, m);
+    } else {
+        set_error(MM_ERROR_MEMORY);
+    }
+
+    free((void *)s.a);
+    free((void *)s.b);
+    free(s.deleted);
+    free(s.inserted);
+    free(s.forward);
+    free(s.backward);
+    if (result != 0) {
+        mm_diff_free(diff);
+        return NULL;
+    }
+    return diff;
+}
+
+static int same_metadata(const Document *a, const Document *b) {
+    size_t count = a ? a->metadata_count : 0;
+    if (count != (b ? b->metadata_count : 0)) {
+        return 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(a->metadata[i].key, b->metadata[i].key) != 0 ||
+            strcmp(a->metadata[i].value, b->metadata[i].value) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+MMDiff* mm_diff_documents(const Document *old_doc, const Document *new_doc) {
+    MMDiff *diff = mm_diff_nodes(old_doc, old_doc ? old_doc->root : NULL,
+                                 new_doc, new_doc ? new_doc->root : NULL);
+    if (diff) {
+        diff->metadata_changed = !same_metadata(old_doc, new_doc);
+    }
+    return diff;
+}
+
+static int is_blank(const char *input, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (input[i] != ' ' && input[i] != '\t' && input[i] != '\r' && input[i] != '\n') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Parse text for diffing into an arena of its own
+ *
+ * @return int 0 with *doc set, or NULL for text without any block; -1 on
+ *             error
+ */
+static int parse_for_diff(const char *input, size_t length, MMArena *arena, Document **doc) {
+    MMParseOptions options = { arena, MM_PARSE_VIEW | MM_PARSE_LAZY, 0 };
+    *doc = mm_parse_document(NULL, input, length, &options);
+    return *doc || is_blank(input, length) ? 0 : -1;
+}
+
+MMDiffHunk* mm_diff_text(const char *old_input, size_t old_length,
+                         const char *new_input, size_t new_length, size_t *count) {
+    if (!old_input || !new_input || !count) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+
+    // An arena backs at most one live document, so each gets its own
+    MMArena *old_arena = mm_arena_new(0);
+    MMArena *new_arena = mm_arena_new(0);
+    Document *old_doc = NULL, *new_doc = NULL;
+    MMDiffHunk *hunks = NULL;
+    if (old_arena && new_arena &&
+        parse_for_diff(old_input, old_length, old_arena, &old_doc) == 0 &&
+        parse_for_diff(new_input, new_length, new_arena, &new_doc) == 0) {
+        MMDiff *diff = mm_diff_documents(old_doc, new_doc);
+        if (diff) {
+            // Hand the array over, allocated even when empty
+            hunks = diff->hunks ? diff->hunks : safe_malloc(sizeof(MMDiffHunk));
+            *count = diff->hunk_count;
+            diff->hunks = NULL;
+            mm_diff_free(diff);
+        }
+    }
+
+    free_document(old_doc);
+    free_document(new_doc);
+    mm_arena_free(old_arena);
+    mm_arena_free(new_arena);
+    return hunks;
+}
+
+void mm_diff_free(MMDiff *diff) {
+    if (!diff) {
+        return;
+    }
+
+    free(diff->hunks);
+    free(diff);
+}
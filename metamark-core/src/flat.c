@@ -0,0 +1,42 @@
+/**
+ * @file flat.c
+ * @brief Flat document buffers for foreign function interfaces
+ *
+ * A flat buffer is a snapshot held in memory: fixed-size node records and
+ * a string pool addressed by offsets, so a binding reads the whole tree
+ * through one pointer without calling back into the library per node.
+ * The document is only needed while encoding, so it lives in a private
+ * arena that is dropped in one step.
+ */
+
+#include <stdlib.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+
+unsigned char* mm_flat_encode(const char *input, size_t length, uint64_t stamp, size_t *size) {
+    if (!input || !size) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+
+    MMArena *arena = mm_arena_new(0);
+    if (!arena) {
+        return NULL;
+    }
+
+    // The encoder copies every string, so nothing needs copying while parsing
+    MMParseOptions options = { arena, MM_PARSE_VIEW | MM_PARSE_LAZY, 0 };
+    Document *doc = mm_parse_document(NULL, input, length, &options);
+    unsigned char *buffer = doc ? mm_snapshot_encode(doc, stamp, size) : NULL;
+    free_document(doc);
+    mm_arena_free(arena);
+    return buffer;
+}
+
+unsigned char* mm_flat_parse(const char *input, size_t length, size_t *size) {
+    return mm_flat_encode(input, length, 0, size);
+}
+
+void mm_free(void *ptr) {
+    free(ptr);
+}
@@ -0,0 +1,215 @@
+/**
+ * @file frozen.c
+ * @brief Struct-of-arrays copies of parsed documents
+ *
+ * A frozen document is laid out in one allocation: the per-node arrays,
+ * widest element type first so every array stays aligned, then the
+ * metadata pairs and finally the string pool. Nodes are numbered in
+ * pre-order, which makes every subtree a contiguous index range.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+
+/**
+ * @brief Writable views of the arrays while a document is being frozen
+ */
+typedef struct {
+    uint8_t *types;
+    uint8_t *levels;
+    uint32_t *depths;
+    uint32_t *first_child;
+    uint32_t *next_sibling;
+    uint32_t *subtree_end;
+    const char **content;
+    size_t *lengths;
+    size_t *offsets;
+    char *pool;          ///< Next free byte of the string pool
+    size_t count;        ///< Nodes written so far
+} FreezeState;
+
+/**
+ * @brief Count the nodes of a subtree and the pool bytes of their content
+ */
+static int measure_tree(const Document *doc, const Node *root, size_t *count, size_t *pool) {
+    MMWalker walker;
+    const Node *node;
+    mm_walker_init(&walker, root, MM_WALK_ENTER | MM_WALK_LAZY);
+    while ((node = mm_walker_next(&walker, NULL))) {
+        size_t length;
+        if (mm_node_text(doc, node, &length)) {
+            *pool += length + 1;
+        }
+        (*count)++;
+    }
+    return mm_walker_finish(&walker);
+}
+
+static const char* pool_copy(FreezeState *state, const char *text, size_t length) {
+    char *copy = state->pool;
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    state->pool += length + 1;
+    return copy;
+}
+
+/**
+ * @brief Write the nodes of a subtree in pre-order
+ *
+ * While a node is open its subtree_end holds the index of its parent, so
+ * the links are completed when it is left without a stack of indices.
+ */
+static int freeze_tree(FreezeState *state, const Document *doc, const Node *root) {
+    uint32_t open = MM_FROZEN_NONE;
+    MMWalker walker;
+    MMVisit visit;
+    const Node *node;
+    mm_walker_init(&walker, root, MM_WALK_ENTER | MM_WALK_LEAVE | MM_WALK_LAZY);
+    while ((node = mm_walker_next(&walker, &visit))) {
+        if (visit.leaving) {
+            size_t index = open;
+            int has_sibling = visit.parent && visit.index + 1 < node_child_count(visit.parent);
+            open = state->subtree_end[index];
+            state->subtree_end[index] = (uint32_t)state->count;
+            state->next_sibling[index] = has_sibling ? (uint32_t)state->count : MM_FROZEN_NONE;
+            continue;
+        }
+
+        size_t index = state->count++;
+        size_t length;
+        const char *text = mm_node_text(doc, node, &length);
+
+        state->types[index] = (uint8_t)node->type;
+        state->levels[index] = (uint8_t)(node->level > 255 ? 255 : node->level);
+        state->depths[index] = (uint32_t)visit.depth;
+        state->content[index] = text ? pool_copy(state, text, length) : NULL;
+        state->lengths[index] = text ? length : 0;
+        state->offsets[index] = node->offset;
+        state->first_child[index] = node_child_count(node) > 0 ? (uint32_t)(index + 1) : MM_FROZEN_NONE;
+        state->subtree_end[index] = open;
+        open = (uint32_t)index;
+    }
+    return mm_walker_finish(&walker);
+}
+
+/**
+ * @brief Round a size up to the alignment of the next array
+ */
+static size_t align_size(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+MMFrozenDocument* mm_document_freeze(const Document *doc) {
+    if (!doc || !doc->root) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+
+    size_t count = 0;
+    size_t pool = 0;
+    if (measure_tree(doc, doc->root, &count, &pool) != 0) {
+        return NULL;
+    }
+    for (size_t i = 0; i < doc->metadata_count; i++) {
+        pool += strlen(doc->metadata[i].key) + strlen(doc->metadata[i].value) + 2;
+    }
+
+    // Indices and subtree ends must fit the 32-bit link arrays
+    if (count >= MM_FROZEN_NONE) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+
+    size_t content_at = 0;
+    size_t lengths_at = content_at + count * sizeof(const char*);
+    size_t offsets_at = lengths_at + count * sizeof(size_t);
+    size_t pairs_at = align_size(offsets_at + count * sizeof(size_t), sizeof(void*));
+    size_t depths_at = align_size(pairs_at + doc->metadata_count * sizeof(MetadataPair), sizeof(uint32_t));
+    size_t first_child_at = depths_at + count * sizeof(uint32_t);
+    size_t next_sibling_at = first_child_at + count * sizeof(uint32_t);
+    size_t subtree_end_at = next_sibling_at + count * sizeof(uint32_t);
+    size_t types_at = subtree_end_at + count * sizeof(uint32_t);
+    size_t levels_at = types_at + count;
+    size_t pool_at = levels_at + count;
+
+    MMFrozenDocument *frozen = safe_malloc(sizeof(MMFrozenDocument));
+    unsigned char *block = safe_malloc(pool_at + pool);
+    if (!frozen || !block) {
+        free(frozen);
+        free(block);
+        set_error(MM_ERROR_MEMORY);
+        return NULL;
+    }
+
+    FreezeState state;
+    state.types = (uint8_t *)(block + types_at);
+    state.levels = (uint8_t *)(block + levels_at);
+    state.depths = (uint32_t *)(block + depths_at);
+    state.first_child = (uint32_t *)(block + first_child_at);
+    state.next_sibling = (uint32_t *)(block + next_sibling_at);
+    state.subtree_end = (uint32_t *)(block + subtree_end_at);
+    state.content = (const char **)(block + content_at);
+    state.lengths = (size_t *)(block + lengths_at);
+    state.offsets = (size_t *)(block + offsets_at);
+    state.pool = (char *)(block + pool_at);
+    state.count = 0;
+    if (freeze_tree(&state, doc, doc->root) != 0) {
+        free(frozen);
+        free(block);
+        return NULL;
+    }
+
+    MetadataPair *pairs = (MetadataPair *)(block + pairs_at);
+    for (size_t i = 0; i < doc->metadata_count; i++) {
+        const MetadataPair *pair = &doc->metadata[i];
+        pairs[i].key = (char *)pool_copy(&state, pair->key, strlen(pair->key));
+        pairs[i].value = (char *)pool_copy(&state, pair->value, strlen(pair->value));
+    }
+
+    frozen->count = count;
+    frozen->types = state.types;
+    frozen->levels = state.levels;
+    frozen->depths = state.depths;
+    frozen->first_child = state.first_child;
+    frozen->next_sibling = state.next_sibling;
+    frozen->subtree_end = state.subtree_end;
+    frozen->content = state.content;
+    frozen->lengths = state.lengths;
+    frozen->offsets = state.offsets;
+    frozen->metadata = pairs;
+    frozen->metadata_count = doc->metadata_count;
+    frozen->block = block;
+    return frozen;
+}
+
+void mm_frozen_free(MMFrozenDocument *frozen) {
+    if (!frozen) {
+        return;
+    }
+
+    free(frozen->block);
+    free(frozen);
+}
+
+MMFrozenIter mm_frozen_iter(const MMFrozenDocument *frozen, size_t node) {
+    MMFrozenIter iter = { 0, 0 };
+    if (frozen && node < frozen->count) {
+        iter.next = node;
+        iter.end = frozen->subtree_end[node];
+    }
+    return iter;
+}
+
+int mm_frozen_next(MMFrozenIter *iter, size_t *node) {
+    if (!iter || iter->next >= iter->end) {
+        return 0;
+    }
+
+    if (node) {
+        *node = iter->next;
+    }
+    iter->next++;
+    return 1;
+}
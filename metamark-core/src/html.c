@@ -0,0 +1,201 @@
+/**
+ * @file html.c
+ * @brief HTML rendering of MetaMark documents
+ *
+ * The renderer walks the tree once and appends to a single MMOutput
+ * buffer. Text is escaped through a byte table, so runs of plain bytes
+ * are copied with one memcpy and nothing is allocated per node.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+#include "../include/output.h"
+
+/**
+ * @brief Replacement of every byte that HTML text and attributes reserve
+ */
+static const char *const html_entities[] = {
+    NULL, "&amp;", "&lt;", "&gt;", "&quot;", "&#39;"
+};
+
+/**
+ * @brief Index into html_entities for each byte, 0 if it is copied as is
+ */
+static const unsigned char html_escape[256] = {
+    ['&'] = 1, ['<'] = 2, ['>'] = 3, ['"'] = 4, ['\''] = 5
+};
+
+static void write_escaped(MMOutput *out, const char *text, size_t length) {
+    size_t start = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        unsigned char index = html_escape[(unsigned char)text[i]];
+        if (index) {
+            mm_output_write(out, text + start, i - start);
+            mm_output_puts(out, html_entities[index]);
+            start = i + 1;
+        }
+    }
+    mm_output_write(out, text + start, length - start);
+}
+
+static void write_node_text(MMOutput *out, const Document *doc, const Node *node) {
+    size_t length;
+    const char *text = mm_node_text(doc, node, &length);
+    if (text) {
+        write_escaped(out, text, length);
+    }
+}
+
+/**
+ * @brief Open a block element carrying the node type as data-type
+ */
+static void write_open_tag(MMOutput *out, const Document *doc, const Node *node,
+                           const char *tag, const char *class_name) {
+    mm_output_char(out, '<');
+    mm_output_puts(out, tag);
+    mm_output_puts(out, " class=\"");
+    mm_output_puts(out, class_name);
+    mm_output_char(out, '"');
+    if (mm_node_text(doc, node, NULL)) {
+        mm_output_puts(out, " data-type=\"");
+        write_node_text(out, doc, node);
+        mm_output_char(out, '"');
+    }
+    mm_output_puts(out, ">\n");
+}
+
+/**
+ * @brief Close the element a node opened when it was entered
+ */
+static void render_leave(MMOutput *out, const Node *node) {
+    if (node->type == NODE_COMPONENT) {
+        mm_output_puts(out, "</div>\n");
+    } else if (node->type == NODE_ANNOTATION) {
+        mm_output_puts(out, "</aside>\n");
+    }
+}
+
+static void render_tree(MMOutput *out, const Document *doc, const Node *root) {
+    MMWalker walker;
+    MMVisit visit;
+    const Node *node;
+    mm_walker_init(&walker, root, MM_WALK_ENTER | MM_WALK_LEAVE | MM_WALK_LAZY);
+    while (out->result == 0 && (node = mm_walker_next(&walker, &visit))) {
+        if (visit.leaving) {
+            render_leave(out, node);
+            continue;
+        }
+
+        switch (node->type) {
+            case NODE_HEADING: {
+                char level = (char)('0' + (node->level < 1 ? 1 : node->level > 6 ? 6 : node->level));
+                mm_output_puts(out, "<h");
+                mm_output_char(out, level);
+                mm_output_char(out, '>');
+                write_node_text(out, doc, node);
+                mm_output_puts(out, "</h");
+                mm_output_char(out, level);
+                mm_output_puts(out, ">\n");
+                mm_walker_skip(&walker);
+                break;
+            }
+            case NODE_PARAGRAPH:
+                mm_output_puts(out, "<p>");
+                write_node_text(out, doc, node);
+                mm_output_puts(out, "</p>\n");
+                mm_walker_skip(&walker);
+                break;
+            case NODE_COMPONENT:
+                write_open_tag(out, doc, node, "div", "mm-component");
+                break;
+            case NODE_ANNOTATION:
+                write_open_tag(out, doc, node, "aside", "mm-annotation");
+                break;
+            case NODE_SECURE:
+                // Encrypted content is never rendered
+                mm_output_puts(out, "<div class=\"mm-secure\"></div>\n");
+                mm_walker_skip(&walker);
+                break;
+            case NODE_METADATA:
+            case NODE_COMMENT:
+                mm_walker_skip(&walker);
+                break;
+            default:
+                break;
+        }
+    }
+    if (mm_walker_finish(&walker) != 0) {
+        out->result = -1;
+    }
+}
+
+/**
+ * @brief Guess the size of the HTML for a subtree
+ */
+static size_t estimate_size(const Node *root) {
+    size_t size = 0;
+    MMWalker walker;
+    const Node *node;
+    mm_walker_init(&walker, root, MM_WALK_ENTER);
+    while ((node = mm_walker_next(&walker, NULL))) {
+        size += (node->flags & MM_NODE_VIEW) ? node->length
+              : node->content ? strlen(node->content) : 0;
+        size += 32;
+        if (node->flags & MM_NODE_LAZY) {
+            size += node->body_length;
+        }
+    }
+    mm_walker_finish(&walker);
+    return size;
+}
+
+static void render_document(MMOutput *out, const Document *doc, unsigned flags) {
+    if (flags & MM_HTML_STANDALONE) {
+        const char *title = get_metadata(doc, "title");
+        mm_output_puts(out, "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n");
+        if (title) {
+            mm_output_puts(out, "<title>");
+            write_escaped(out, title, strlen(title));
+            mm_output_puts(out, "</title>\n");
+        }
+        mm_output_puts(out, "</head>\n<body>\n");
+    }
+
+    render_tree(out, doc, doc->root);
+
+    if (flags & MM_HTML_STANDALONE) {
+        mm_output_puts(out, "</body>\n</html>\n");
+    }
+}
+
+int mm_render_html(const Document *doc, unsigned flags, MMWriteFn write, void *user_data) {
+    if (!doc || !doc->root || !write) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    MMOutput out;
+    if (mm_output_init_sink(&out, write, user_data) != 0) {
+        return -1;
+    }
+    render_document(&out, doc, flags);
+    mm_output_finish(&out, NULL);
+    return out.result;
+}
+
+char* render_metamark_html(const Document *doc) {
+    if (!doc || !doc->root) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+
+    MMOutput out;
+    if (mm_output_init_string(&out, estimate_size(doc->root)) != 0) {
+        return NULL;
+    }
+    render_document(&out, doc, 0);
+    return mm_output_finish(&out, NULL);
+}
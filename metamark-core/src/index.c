@@ -0,0 +1,1286 @@
+/**
+ * @file index.c
+ * @brief Full-text and structural search index
+ *
+ * Documents are read through mm_parse_events(), so indexing builds no
+ * tree. Every heading, paragraph, annotation, component and metadata pair
+ * becomes an entry of its document, and a term maps to the entries it
+ * occurs in. Terms are words of the text, words of headings, annotation
+ * and component types and metadata keys, each kept under its own field,
+ * so "annotation:todo" and the word "todo" have separate posting lists.
+ *
+ * A posting list is a byte string of varint deltas over (document, entry)
+ * pairs in increasing order, which makes most postings a single byte.
+ * Removing a document only marks it dead; once dead documents outnumber
+ * live ones, they are dropped and every list is re-encoded without them.
+ *
+ * File format: "MMIX", a version byte, then the documents and the terms.
+ * All integers are unsigned LEB128 varints.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+#include "../include/output.h"
+
+#define INDEX_MAGIC "MMIX"
+#define INDEX_VERSION 1
+#define INDEX_MIN_BUCKETS 256
+#define INDEX_MAX_TERM 64      ///< Longer words are cut to this many bytes
+#define INDEX_PREVIEW 80       ///< Bytes of entry text kept for search results
+#define INDEX_MIN_COMPACT 16   ///< Dead documents tolerated before compacting
+#define INDEX_NONE UINT32_MAX
+
+/**
+ * @brief Kinds of terms, each with posting lists of its own
+ */
+typedef enum {
+    FIELD_TEXT,
+    FIELD_HEADING,
+    FIELD_ANNOTATION,
+    FIELD_COMPONENT,
+    FIELD_META,
+    FIELD_COUNT
+} IndexField;
+
+static const char *const field_names[FIELD_COUNT] = {
+    NULL, "heading", "annotation", "component", "meta"
+};
+
+typedef struct {
+    NodeType type;   ///< Type of the block
+    size_t line;     ///< Line of the block, from 1
+    size_t preview;  ///< Offset of its preview in the document's pool
+} IndexEntry;
+
+typedef struct IndexDocument {
+    char *name;                    ///< Name the document was added under
+    char *tag;                     ///< Caller's tag, such as a content hash
+    IndexEntry *entries;           ///< Entries in document order
+    size_t entry_count;
+    size_t entry_capacity;
+    char *previews;                ///< NUL-terminated previews of the entries
+    size_t preview_size;
+    size_t preview_capacity;
+    int live;                      ///< Cleared when removed or replaced
+    struct IndexDocument *chain;   ///< Next document in the same name bucket
+} IndexDocument;
+
+typedef struct IndexTerm {
+    uint64_t hash;                 ///< Hash of field and text
+    unsigned char field;           ///< IndexField of the term
+    char *text;                    ///< Lowercased term, NUL-terminated
+    size_t length;
+    unsigned char *postings;       ///< Varint-encoded (document, entry) deltas
+    size_t size;
+    size_t capacity;
+    size_t count;                  ///< Number of postings
+    uint32_t last_document;        ///< Last posting, the base of the next delta
+    uint32_t last_entry;
+    struct IndexTerm *chain;       ///< Next term in the same bucket
+} IndexTerm;
+
+struct MMIndex {
+    IndexDocument **documents;     ///< Documents by id, dead ones included
+    size_t document_count;
+    size_t document_capacity;
+    size_t dead;                   ///< Dead documents not yet compacted away
+    IndexDocument **names;         ///< Hash table of documents by name
+    size_t name_buckets;
+    IndexTerm **terms;             ///< Hash table of terms
+    size_t term_buckets;
+    size_t term_count;
+};
+
+/**
+ * @brief One decoded posting
+ */
+typedef struct {
+    uint32_t document;
+    uint32_t entry;
+} Posting;
+
+/* ------------------------------------------------------------------------
+ * Helpers
+ * ---------------------------------------------------------------------- */
+
+static char* copy_text(const char *text, size_t length) {
+    char *copy = safe_malloc(length + 1);
+    if (copy) {
+        memcpy(copy, text, length);
+        copy[length] = '\0';
+    }
+    return copy;
+}
+
+/**
+ * @brief Grow an array so it holds at least @p needed elements
+ */
+static int reserve(void **items, size_t *capacity, size_t needed, size_t size) {
+    if (needed <= *capacity) {
+        return 0;
+    }
+    size_t grown = *capacity ? *capacity : 16;
+    while (grown < needed) {
+        grown *= 2;
+    }
+    void *resized = safe_realloc(*items, grown * size);
+    if (!resized) {
+        return -1;
+    }
+    *items = resized;
+    *capacity = grown;
+    return 0;
+}
+
+static size_t put_varint(unsigned char *out, uint64_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (unsigned char)value;
+    return length;
+}
+
+static int get_varint(const unsigned char *data, size_t size, size_t *pos, uint64_t *value) {
+    uint64_t result = 0;
+    for (unsigned shift = 0; shift < 64 && *pos < size; shift += 7) {
+        unsigned char byte = data[(*pos)++];
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int is_word_byte(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+/**
+ * @brief Lowercase a term into a buffer of INDEX_MAX_TERM + 1 bytes
+ *
+ * A term cut at the limit may end in part of a UTF-8 sequence; documents
+ * and queries are cut alike, so they still match.
+ */
+static size_t fold_term(const char *text, size_t length, char *term) {
+    if (length > INDEX_MAX_TERM) {
+        length = INDEX_MAX_TERM;
+    }
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        term[i] = c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+    }
+    term[length] = '\0';
+    return length;
+}
+
+/**
+ * @brief Read the next word of a text
+ *
+ * @return size_t Length of the folded word in @p term, 0 at the end
+ */
+static size_t next_word(const char **cursor, const char *end, char *term) {
+    const char *p = *cursor;
+    while (p < end && !is_word_byte((unsigned char)*p)) {
+        p++;
+    }
+    const char *start = p;
+    while (p < end && is_word_byte((unsigned char)*p)) {
+        p++;
+    }
+    *cursor = p;
+    return p > start ? fold_term(start, (size_t)(p - start), term) : 0;
+}
+
+/**
+ * @brief Trim whitespace off both ends of a type or key
+ */
+static const char* trim(const char *text, size_t *length) {
+    while (*length > 0 && (*text == ' ' || *text == '\t')) {
+        text++;
+        (*length)--;
+    }
+    while (*length > 0 && (text[*length - 1] == ' ' || text[*length - 1] == '\t' ||
+                           text[*length - 1] == '\r')) {
+        (*length)--;
+    }
+    return text;
+}
+
+/* ------------------------------------------------------------------------
+ * Tables
+ * ---------------------------------------------------------------------- */
+
+static uint64_t term_hash(unsigned char field, const char *text, size_t length) {
+    return mm_hash_bytes(text, length, field + 1);
+}
+
+static IndexTerm* find_term(const MMIndex *index, unsigned char field, const char *text, size_t length) {
+    uint64_t hash = term_hash(field, text, length);
+    for (IndexTerm *term = index->terms[hash & (index->term_buckets - 1)]; term; term = term->chain) {
+        if (term->hash == hash && term->field == field && term->length == length &&
+            memcmp(term->text, text, length) == 0) {
+            return term;
+        }
+    }
+    return NULL;
+}
+
+static void grow_terms(MMIndex *index) {
+    size_t buckets = index->term_buckets * 2;
+    IndexTerm **table = calloc(buckets, sizeof(IndexTerm *));
+    if (!table) {
+        return;  // A full table is only slower
+    }
+    for (size_t i = 0; i < index->term_buckets; i++) {
+        IndexTerm *term = index->terms[i];
+        while (term) {
+            IndexTerm *next = term->chain;
+            term->chain = table[term->hash & (buckets - 1)];
+            table[term->hash & (buckets - 1)] = term;
+            term = next;
+        }
+    }
+    free(index->terms);
+    index->terms = table;
+    index->term_buckets = buckets;
+}
+
+static IndexTerm* intern_term(MMIndex *index, unsigned char field, const char *text, size_t length) {
+    IndexTerm *term = find_term(index, field, text, length);
+    if (term) {
+        return term;
+    }
+    if (index->term_count >= index->term_buckets) {
+        grow_terms(index);
+    }
+
+    term = safe_malloc(sizeof(IndexTerm));
+    if (!term) {
+        return NULL;
+    }
+    memset(term, 0, sizeof(IndexTerm));
+    if (!(term->text = copy_text(text, length))) {
+        free(term);
+        return NULL;
+    }
+    term->hash = term_hash(field, text, length);
+    term->field = field;
+    term->length = length;
+    size_t bucket = term->hash & (index->term_buckets - 1);
+    term->chain = index->terms[bucket];
+    index->terms[bucket] = term;
+    index->term_count++;
+    return term;
+}
+
+static void free_term(IndexTerm *term) {
+    free(term->text);
+    free(term->postings);
+    free(term);
+}
+
+/**
+ * @brief Append a posting, which must not precede the last one
+ */
+static int add_posting(IndexTerm *term, uint32_t document, uint32_t entry) {
+    if (term->count > 0 && term->last_document == document && term->last_entry == entry) {
+        return 0;
+    }
+    if (reserve((void **)&term->postings, &term->capacity, term->size + 10, 1) != 0) {
+        return -1;
+    }
+    uint32_t delta = document - term->last_document;
+    term->size += put_varint(term->postings + term->size, delta);
+    term->size += put_varint(term->postings + term->size, delta ? entry : entry - term->last_entry);
+    term->last_document = document;
+    term->last_entry = entry;
+    term->count++;
+    return 0;
+}
+
+/**
+ * @brief Decode a posting list into an array of term->count postings
+ */
+static int decode_postings(const IndexTerm *term, Posting *out) {
+    size_t pos = 0;
+    uint32_t document = 0;
+    uint32_t entry = 0;
+    for (size_t i = 0; i < term->count; i++) {
+        uint64_t delta, value;
+        if (get_varint(term->postings, term->size, &pos, &delta) != 0 ||
+            get_varint(term->postings, term->size, &pos, &value) != 0) {
+            return -1;
+        }
+        document += (uint32_t)delta;
+        entry = delta ? (uint32_t)value : entry + (uint32_t)value;
+        out[i].document = document;
+        out[i].entry = entry;
+    }
+    return 0;
+}
+
+static uint64_t name_hash(const char *name) {
+    return mm_hash_bytes(name, strlen(name), 0);
+}
+
+static IndexDocument* find_document(const MMIndex *index, const char *name) {
+    size_t bucket = name_hash(name) & (index->name_buckets - 1);
+    for (IndexDocument *doc = index->names[bucket]; doc; doc = doc->chain) {
+        if (doc->live && strcmp(doc->name, name) == 0) {
+            return doc;
+        }
+    }
+    return NULL;
+}
+
+static size_t name_buckets_for(size_t documents) {
+    size_t buckets = INDEX_MIN_BUCKETS;
+    while (buckets < documents) {
+        buckets *= 2;
+    }
+    return buckets;
+}
+
+/**
+ * @brief Put every document into a new, empty name table
+ */
+static void fill_names(MMIndex *index, IndexDocument **table, size_t buckets) {
+    for (size_t i = 0; i < index->document_count; i++) {
+        IndexDocument *doc = index->documents[i];
+        size_t bucket = name_hash(doc->name) & (buckets - 1);
+        doc->chain = table[bucket];
+        table[bucket] = doc;
+    }
+    free(index->names);
+    index->names = table;
+    index->name_buckets = buckets;
+}
+
+/**
+ * @brief Resize the name table to fit the documents and rebuild it
+ */
+static int rebuild_names(MMIndex *index) {
+    size_t buckets = name_buckets_for(index->document_count);
+    IndexDocument **table = calloc(buckets, sizeof(IndexDocument *));
+    if (!table) {
+        set_error(MM_ERROR_MEMORY);
+        return -1;
+    }
+    fill_names(index, table, buckets);
+    return 0;
+}
+
+static void free_document_entry(IndexDocument *doc) {
+    free(doc->name);
+    free(doc->tag);
+    free(doc->entries);
+    free(doc->previews);
+    free(doc);
+}
+
+/**
+ * @brief Drop dead documents and re-encode every posting list without them
+ *
+ * Every list is re-encoded into a new buffer before any is replaced, so
+ * running out of memory leaves the index as it was.
+ */
+static void compact(MMIndex *index) {
+    size_t live = index->document_count - index->dead;
+    size_t buckets = name_buckets_for(live);
+    uint32_t *remap = safe_malloc((index->document_count + 1) * sizeof(uint32_t));
+    IndexTerm *encoded = calloc(index->term_count + 1, sizeof(IndexTerm));
+    IndexDocument **table = calloc(buckets, sizeof(IndexDocument *));
+    Posting *postings = NULL;
+    size_t posting_capacity = 0;
+    size_t done = 0;
+    int failed = !remap || !encoded || !table;
+
+    live = 0;
+    for (size_t i = 0; !failed && i < index->document_count; i++) {
+        remap[i] = index->documents[i]->live ? (uint32_t)live++ : INDEX_NONE;
+    }
+
+    for (size_t b = 0; !failed && b < index->term_buckets; b++) {
+        for (IndexTerm *term = index->terms[b]; !failed && term; term = term->chain) {
+            IndexTerm *fresh = &encoded[done++];
+            if (reserve((void **)&postings, &posting_capacity, term->count, sizeof(Posting)) != 0 ||
+                decode_postings(term, postings) != 0) {
+                failed = 1;
+                break;
+            }
+            for (size_t i = 0; i < term->count; i++) {
+                uint32_t document = remap[postings[i].document];
+                if (document != INDEX_NONE && add_posting(fresh, document, postings[i].entry) != 0) {
+                    failed = 1;
+                    break;
+                }
+            }
+        }
+    }
+    free(postings);
+    free(remap);
+
+    if (failed) {
+        for (size_t i = 0; encoded && i < done; i++) {
+            free(encoded[i].postings);
+        }
+        free(encoded);
+        free(table);
+        return;  // Nothing replaced yet, so still consistent
+    }
+
+    // Swap the new lists in, in the same order they were made
+    done = 0;
+    for (size_t b = 0; b < index->term_buckets; b++) {
+        IndexTerm **link = &index->terms[b];
+        while (*link) {
+            IndexTerm *term = *link;
+            IndexTerm *fresh = &encoded[done++];
+            free(term->postings);
+            term->postings = fresh->postings;
+            term->size = fresh->size;
+            term->capacity = fresh->capacity;
+            term->count = fresh->count;
+            term->last_document = fresh->last_document;
+            term->last_entry = fresh->last_entry;
+            if (term->count == 0) {
+                *link = term->chain;
+                free_term(term);
+                index->term_count--;
+            } else {
+                link = &term->chain;
+            }
+        }
+    }
+    free(encoded);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < index->document_count; i++) {
+        if (index->documents[i]->live) {
+            index->documents[kept++] = index->documents[i];
+        } else {
+            free_document_entry(index->documents[i]);
+        }
+    }
+    index->document_count = kept;
+    index->dead = 0;
+    fill_names(index, table, buckets);
+}
+
+static void retire_document(MMIndex *index, IndexDocument *doc) {
+    doc->live = 0;
+    index->dead++;
+    if (index->dead >= INDEX_MIN_COMPACT && index->dead > index->document_count - index->dead) {
+        compact(index);
+    }
+}
+
+/* ------------------------------------------------------------------------
+ * Building
+ * ---------------------------------------------------------------------- */
+
+MMIndex* mm_index_new(void) {
+    MMIndex *index = safe_malloc(sizeof(MMIndex));
+    if (!index) {
+        return NULL;
+    }
+    memset(index, 0, sizeof(MMIndex));
+    index->term_buckets = INDEX_MIN_BUCKETS;
+    index->terms = calloc(index->term_buckets, sizeof(IndexTerm *));
+    if (!index->terms || rebuild_names(index) != 0) {
+        set_error(MM_ERROR_MEMORY);
+        free(index->terms);
+        free(index);
+        return NULL;
+    }
+    return index;
+}
+
+void mm_index_free(MMIndex *index) {
+    if (!index) {
+        return;
+    }
+    for (size_t i = 0; i < index->term_buckets; i++) {
+        IndexTerm *term = index->terms[i];
+        while (term) {
+            IndexTerm *next = term->chain;
+            free_term(term);
+            term = next;
+        }
+    }
+    for (size_t i = 0; i < index->document_count; i++) {
+        free_document_entry(index->documents[i]);
+    }
+    free(index->terms);
+    free(index->names);
+    free(index->documents);
+    free(index);
+}
+
+/**
+ * @brief State of one mm_index_add() while events arrive
+ */
+typedef struct {
+    MMIndex *index;
+    IndexDocument *doc;
+    uint32_t id;             ///< Id of the document
+    const char *input;
+    const char *input_end;
+    const char *cursor;      ///< Position lines have been counted up to
+    size_t line;             ///< Line of the cursor
+    int in_component;        ///< Paragraphs belong to the open component
+    int body_previewed;      ///< The component preview has its body text
+} IndexBuilder;
+
+/**
+ * @brief Line of a slice of the input; slices arrive in document order
+ */
+static size_t line_of(IndexBuilder *b, const char *text) {
+    if (!text || text < b->cursor || text > b->input_end) {
+        return b->line;
+    }
+    for (const char *p = b->cursor; p < text; p++) {
+        b->line += *p == '\n';
+    }
+    b->cursor = text;
+    return b->line;
+}
+
+/**
+ * @brief Append text to the preview being written, up to INDEX_PREVIEW bytes
+ */
+static void preview_append(IndexDocument *doc, size_t start, const char *text, size_t length) {
+    size_t used = doc->preview_size - start;
+    while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r')) {
+        length--;
+    }
+    if (used + length > INDEX_PREVIEW) {
+        length = INDEX_PREVIEW > used ? INDEX_PREVIEW - used : 0;
+        // Never end inside a UTF-8 sequence
+        while (length > 0 && ((unsigned char)text[length] & 0xc0) == 0x80) {
+            length--;
+        }
+    }
+    if (reserve((void **)&doc->previews, &doc->preview_capacity, doc->preview_size + length + 1, 1) != 0) {
+        return;
+    }
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        doc->previews[doc->preview_size++] = c == '\n' || c == '\r' || c == '\t' ? ' ' : c;
+    }
+    doc->previews[doc->preview_size] = '\0';
+}
+
+/**
+ * @brief Start a new entry with its preview
+ *
+ * @return uint32_t The entry id, or INDEX_NONE on failure
+ */
+static uint32_t add_entry(IndexBuilder *b, NodeType type, const char *at,
+                          const char *prefix, size_t prefix_length,
+                          const char *text, size_t length) {
+    IndexDocument *doc = b->doc;
+    if (reserve((void **)&doc->entries, &doc->entry_capacity, doc->entry_count + 1, sizeof(IndexEntry)) != 0 ||
+        reserve((void **)&doc->previews, &doc->preview_capacity, doc->preview_size + 1, 1) != 0) {
+        return INDEX_NONE;
+    }
+    IndexEntry *entry = &doc->entries[doc->entry_count];
+    entry->type = type;
+    entry->line = line_of(b, at);
+    entry->preview = doc->preview_size;
+    doc->previews[doc->preview_size] = '\0';
+    if (prefix_length > 0) {
+        preview_append(doc, entry->preview, prefix, prefix_length);
+        if (text && length > 0) {
+            preview_append(doc, entry->preview, ": ", 2);
+        }
+    }
+    if (text) {
+        preview_append(doc, entry->preview, text, length);
+    }
+    doc->preview_size++;  // Keep the terminator
+    return (uint32_t)doc->entry_count++;
+}
+
+static int index_term(IndexBuilder *b, unsigned char field, const char *text, size_t length,
+                      uint32_t entry) {
+    IndexTerm *term = intern_term(b->index, field, text, length);
+    return term && add_posting(term, b->id, entry) == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Index every word of a text under a field
+ */
+static int index_words(IndexBuilder *b, unsigned char field, const char *text, size_t length,
+                       uint32_t entry) {
+    char term[INDEX_MAX_TERM + 1];
+    const char *cursor = text;
+    const char *end = text + length;
+    size_t term_length;
+    while ((term_length = next_word(&cursor, end, term)) > 0) {
+        if (index_term(b, field, term, term_length, entry) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Index a type or key as one term
+ */
+static int index_name(IndexBuilder *b, unsigned char field, const char *text, size_t length,
+                      uint32_t entry) {
+    char term[INDEX_MAX_TERM + 1];
+    text = trim(text, &length);
+    return length > 0 ? index_term(b, field, term, fold_term(text, length, term), entry) : 0;
+}
+
+static int on_metadata_pair(const char *key, size_t key_length,
+                            const char *value, size_t value_length, void *user_data) {
+    IndexBuilder *b = user_data;
+    uint32_t entry = add_entry(b, NODE_METADATA, key, key, key_length, value, value_length);
+    if (entry == INDEX_NONE || index_name(b, FIELD_META, key, key_length, entry) != 0) {
+        return -1;
+    }
+    return index_words(b, FIELD_TEXT, value, value_length, entry);
+}
+
+static int on_heading(size_t level, const char *text, size_t length, void *user_data) {
+    IndexBuilder *b = user_data;
+    (void)level;
+    uint32_t entry = add_entry(b, NODE_HEADING, text, NULL, 0, text, length);
+    if (entry == INDEX_NONE || index_words(b, FIELD_HEADING, text, length, entry) != 0) {
+        return -1;
+    }
+    return index_words(b, FIELD_TEXT, text, length, entry);
+}
+
+static int on_paragraph(const char *text, size_t length, void *user_data) {
+    IndexBuilder *b = user_data;
+    uint32_t entry;
+    if (b->in_component) {
+        // Component bodies are searched as part of their component
+        IndexDocument *doc = b->doc;
+        entry = (uint32_t)doc->entry_count - 1;
+        if (!b->body_previewed) {
+            size_t start = doc->entries[entry].preview;
+            doc->preview_size--;
+            preview_append(doc, start, doc->preview_size > start ? ": " : "", doc->preview_size > start ? 2 : 0);
+            preview_append(doc, start, text, length);
+            doc->preview_size++;
+            b->body_previewed = 1;
+        }
+    } else {
+        entry = add_entry(b, NODE_PARAGRAPH, text, NULL, 0, text, length);
+        if (entry == INDEX_NONE) {
+            return -1;
+        }
+    }
+    return index_words(b, FIELD_TEXT, text, length, entry);
+}
+
+static int on_component_begin(const char *type, size_t length, void *user_data) {
+    IndexBuilder *b = user_data;
+    uint32_t entry = add_entry(b, NODE_COMPONENT, type, NULL, 0, type ? type : "", type ? length : 0);
+    if (entry == INDEX_NONE) {
+        return -1;
+    }
+    b->in_component = 1;
+    b->body_previewed = 0;
+    return type ? index_name(b, FIELD_COMPONENT, type, length, entry) : 0;
+}
+
+static int on_component_end(const char *type, size_t length, void *user_data) {
+    IndexBuilder *b = user_data;
+    (void)type;
+    (void)length;
+    b->in_component = 0;
+    return 0;
+}
+
+static int on_annotation(const char *type, size_t type_length,
+                         const char *text, size_t length, void *user_data) {
+    IndexBuilder *b = user_data;
+    uint32_t entry = add_entry(b, NODE_ANNOTATION, type, type, type_length, text, text ? length : 0);
+    if (entry == INDEX_NONE || index_name(b, FIELD_ANNOTATION, type, type_length, entry) != 0) {
+        return -1;
+    }
+    return text ? index_words(b, FIELD_TEXT, text, length, entry) : 0;
+}
+
+int mm_index_add(MMIndex *index, const char *name, const char *tag,
+                 const char *input, size_t length) {
+    if (!index || !name || (!input && length > 0)) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+    if ((uint64_t)index->document_count + 1 >= INDEX_NONE ||
+        reserve((void **)&index->documents, &index->document_capacity,
+                index->document_count + 1, sizeof(IndexDocument *)) != 0) {
+        set_error(MM_ERROR_MEMORY);
+        return -1;
+    }
+
+    IndexDocument *doc = safe_malloc(sizeof(IndexDocument));
+    if (!doc) {
+        return -1;
+    }
+    memset(doc, 0, sizeof(IndexDocument));
+    doc->name = copy_text(name, strlen(name));
+    doc->tag = copy_text(tag ? tag : "", tag ? strlen(tag) : 0);
+    if (!doc->name || !doc->tag) {
+        free_document_entry(doc);
+        return -1;
+    }
+
+    // A failed add leaves a dead document, skipped like a removed one
+    IndexDocument *previous = find_document(index, name);
+    uint32_t id = (uint32_t)index->document_count;
+    index->documents[index->document_count++] = doc;
+    size_t bucket = name_hash(name) & (index->name_buckets - 1);
+    doc->chain = index->names[bucket];
+    index->names[bucket] = doc;
+
+    IndexBuilder builder = { index, doc, id, input, input + length, input, 1, 0, 0 };
+    MMEventHandler handler = {
+        on_metadata_pair, on_heading, on_paragraph, on_component_begin,
+        on_component_end, on_annotation, NULL
+    };
+    int result = length > 0 ? mm_parse_events(input, length, &handler, &builder) : 0;
+
+    // Input without any block is an empty document rather than an error
+    if (result == -1 && get_last_error() == MM_ERROR_SYNTAX && doc->entry_count == 0) {
+        result = 0;
+    }
+    if (result != 0) {
+        index->dead++;
+        set_error(MM_ERROR_MEMORY);
+        return -1;
+    }
+    doc->live = 1;
+    if (previous) {
+        retire_document(index, previous);
+    }
+
+    if (index->document_count > index->name_buckets * 2) {
+        rebuild_names(index);
+    }
+    return 0;
+}
+
+int mm_index_remove(MMIndex *index, const char *name) {
+    if (!index || !name) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+    IndexDocument *doc = find_document(index, name);
+    if (!doc) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+    retire_document(index, doc);
+    return 0;
+}
+
+const char* mm_index_tag(const MMIndex *index, const char *name) {
+    const IndexDocument *doc = index && name ? find_document(index, name) : NULL;
+    return doc ? doc->tag : NULL;
+}
+
+size_t mm_index_document_count(const MMIndex *index) {
+    return index ? index->document_count - index->dead : 0;
+}
+
+int mm_index_each(const MMIndex *index, MMIndexDocumentFn callback, void *user_data) {
+    if (!index || !callback) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+    for (size_t i = 0; i < index->document_count; i++) {
+        const IndexDocument *doc = index->documents[i];
+        int result;
+        if (doc->live && (result = callback(doc->name, doc->tag, user_data)) != 0) {
+            return result;
+        }
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Searching
+ * ---------------------------------------------------------------------- */
+
+typedef struct {
+    unsigned char field;
+    char term[INDEX_MAX_TERM + 1];
+    size_t length;
+} Clause;
+
+typedef struct {
+    Clause *items;
+    size_t count;
+    size_t capacity;
+} ClauseList;
+
+static int add_clause(ClauseList *list, unsigned char field, const char *term, size_t length) {
+    if (reserve((void **)&list->items, &list->capacity, list->count + 1, sizeof(Clause)) != 0) {
+        return -1;
+    }
+    Clause *clause = &list->items[list->count++];
+    clause->field = field;
+    memcpy(clause->term, term, length + 1);
+    clause->length = length;
+    return 0;
+}
+
+/**
+ * @brief Split a query into clauses
+ *
+ * Words match the text of an entry and "field:value" restricts by field.
+ * Heading values are split into words like text; annotation and component
+ * types and metadata keys are matched whole.
+ */
+static int parse_query(const char *query, ClauseList *list) {
+    const char *p = query;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+            p++;
+        }
+        const char *start = p;
+        while (*p && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+            p++;
+        }
+        if (p == start) {
+            break;
+        }
+
+        unsigned char field = FIELD_TEXT;
+        const char *value = start;
+        const char *colon = memchr(start, ':', (size_t)(p - start));
+        for (unsigned char f = FIELD_HEADING; colon && f < FIELD_COUNT; f++) {
+            size_t length = strlen(field_names[f]);
+            if ((size_t)(colon - start) == length && memcmp(start, field_names[f], length) == 0) {
+                field = f;
+                value = colon + 1;
+            }
+        }
+
+        char term[INDEX_MAX_TERM + 1];
+        size_t length = (size_t)(p - value);
+        if (field == FIELD_TEXT || field == FIELD_HEADING) {
+            const char *cursor = value;
+            while ((length = next_word(&cursor, p, term)) > 0) {
+                if (add_clause(list, field, term, length) != 0) {
+                    return -1;
+                }
+            }
+        } else if (length == 0 || add_clause(list, field, term, fold_term(value, length, term)) != 0) {
+            return -1;
+        }
+    }
+    return list->count > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Keep the postings of @p a that are also in @p b, by entry or by document
+ */
+static size_t intersect(Posting *a, size_t a_count, const Posting *b, size_t b_count, int by_document) {
+    size_t i = 0, j = 0, kept = 0;
+    while (i < a_count && j < b_count) {
+        uint64_t x = (uint64_t)a[i].document << 32 | (by_document ? 0 : a[i].entry);
+        uint64_t y = (uint64_t)b[j].document << 32 | (by_document ? 0 : b[j].entry);
+        if (x < y) {
+            i++;
+        } else if (x > y) {
+            j++;
+        } else {
+            a[kept++] = a[i++];
+        }
+    }
+    return kept;
+}
+
+int mm_index_search(const MMIndex *index, const char *query, MMSearchFn callback, void *user_data) {
+    if (!index || !query || !callback) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    ClauseList clauses = { NULL, 0, 0 };
+    if (parse_query(query, &clauses) != 0) {
+        free(clauses.items);
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    // Look every clause up; one missing term means no hits at all
+    IndexTerm **terms = safe_malloc(clauses.count * sizeof(IndexTerm *));
+    int found = terms != NULL;
+    for (size_t i = 0; found && i < clauses.count; i++) {
+        terms[i] = find_term(index, clauses.items[i].field, clauses.items[i].term, clauses.items[i].length);
+        found = terms[i] != NULL;
+    }
+    free(clauses.items);
+    if (!found) {
+        free(terms);
+        return terms ? 0 : -1;
+    }
+
+    // Entry clauses shortest first, so the candidates only shrink. Metadata
+    // keys select documents, except in a query of nothing else.
+    size_t entry_clauses = 0;
+    for (size_t i = 0; i < clauses.count; i++) {
+        if (terms[i]->field != FIELD_META) {
+            IndexTerm *swap = terms[entry_clauses];
+            terms[entry_clauses++] = terms[i];
+            terms[i] = swap;
+        }
+    }
+    size_t first = entry_clauses > 0 ? 0 : clauses.count - 1;
+    for (size_t i = 1; i < entry_clauses; i++) {
+        for (size_t j = i; j > 0 && terms[j]->count < terms[j - 1]->count; j--) {
+            IndexTerm *swap = terms[j];
+            terms[j] = terms[j - 1];
+            terms[j - 1] = swap;
+        }
+    }
+
+    size_t largest = 0;
+    for (size_t i = 0; i < clauses.count; i++) {
+        largest = terms[i]->count > largest ? terms[i]->count : largest;
+    }
+    Posting *hits = safe_malloc((terms[first]->count + 1) * sizeof(Posting));
+    Posting *other = safe_malloc((largest + 1) * sizeof(Posting));
+    int result = hits && other && decode_postings(terms[first], hits) == 0 ? 0 : -1;
+    size_t count = terms[first]->count;
+    for (size_t i = 0; result == 0 && count > 0 && i < clauses.count; i++) {
+        if (i == first) {
+            continue;
+        }
+        if (decode_postings(terms[i], other) != 0) {
+            result = -1;
+            break;
+        }
+        count = intersect(hits, count, other, terms[i]->count, terms[i]->field == FIELD_META);
+    }
+    free(other);
+    free(terms);
+
+    int delivered = 0;
+    for (size_t i = 0; result == 0 && i < count; i++) {
+        const IndexDocument *doc = index->documents[hits[i].document];
+        if (!doc->live || hits[i].entry >= doc->entry_count) {
+            continue;
+        }
+        const IndexEntry *entry = &doc->entries[hits[i].entry];
+        MMSearchHit hit = { doc->name, entry->type, entry->line, doc->previews + entry->preview };
+        if (callback(&hit, user_data) != 0) {
+            break;
+        }
+        delivered++;
+    }
+    free(hits);
+    if (result != 0) {
+        set_error(MM_ERROR_MEMORY);
+        return -1;
+    }
+    return delivered;
+}
+
+/* ------------------------------------------------------------------------
+ * Files
+ * ---------------------------------------------------------------------- */
+
+static void write_varint(MMOutput *out, uint64_t value) {
+    unsigned char bytes[10];
+    mm_output_write(out, (const char *)bytes, put_varint(bytes, value));
+}
+
+static void write_bytes(MMOutput *out, const char *data, size_t length) {
+    write_varint(out, length);
+    mm_output_write(out, data, length);
+}
+
+int mm_index_write(const MMIndex *index, MMWriteFn write, void *user_data) {
+    if (!index || !write) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    // Dead documents are left out, so written ids are renumbered
+    uint32_t *remap = safe_malloc((index->document_count + 1) * sizeof(uint32_t));
+    Posting *postings = NULL;
+    size_t posting_capacity = 0;
+    MMOutput out;
+    if (!remap || mm_output_init_sink(&out, write, user_data) != 0) {
+        free(remap);
+        return -1;
+    }
+
+    mm_output_write(&out, INDEX_MAGIC, 4);
+    mm_output_char(&out, INDEX_VERSION);
+    write_varint(&out, mm_index_document_count(index));
+    size_t live = 0;
+    for (size_t i = 0; i < index->document_count; i++) {
+        const IndexDocument *doc = index->documents[i];
+        remap[i] = doc->live ? (uint32_t)live++ : INDEX_NONE;
+        if (!doc->live) {
+            continue;
+        }
+        write_bytes(&out, doc->name, strlen(doc->name));
+        write_bytes(&out, doc->tag, strlen(doc->tag));
+        write_varint(&out, doc->entry_count);
+        for (size_t e = 0; e < doc->entry_count; e++) {
+            const IndexEntry *entry = &doc->entries[e];
+            const char *preview = doc->previews + entry->preview;
+            write_varint(&out, entry->type);
+            write_varint(&out, entry->line);
+            write_bytes(&out, preview, strlen(preview));
+        }
+    }
+
+    // Terms left with no live posting are not written
+    size_t term_count = 0;
+    for (int pass = 0; pass < 2 && out.result == 0; pass++) {
+        if (pass == 1) {
+            write_varint(&out, term_count);
+        }
+        for (size_t b = 0; b < index->term_buckets && out.result == 0; b++) {
+            for (const IndexTerm *term = index->terms[b]; term; term = term->chain) {
+                if (reserve((void **)&postings, &posting_capacity, term->count, sizeof(Posting)) != 0 ||
+                    decode_postings(term, postings) != 0) {
+                    out.result = -1;
+                    break;
+                }
+                IndexTerm copy = { 0 };
+                for (size_t i = 0; i < term->count; i++) {
+                    uint32_t document = remap[postings[i].document];
+                    if (document != INDEX_NONE && add_posting(&copy, document, postings[i].entry) != 0) {
+                        out.result = -1;
+                    }
+                }
+                if (copy.count > 0 && pass == 0) {
+                    term_count++;
+                } else if (copy.count > 0) {
+                    mm_output_char(&out, (char)term->field);
+                    write_bytes(&out, term->text, term->length);
+                    write_varint(&out, copy.count);
+                    write_bytes(&out, (const char *)copy.postings, copy.size);
+                }
+                free(copy.postings);
+            }
+        }
+    }
+    free(postings);
+    free(remap);
+
+    mm_output_finish(&out, NULL);
+    if (out.result != 0) {
+        set_error(MM_ERROR_IO);
+    }
+    return out.result;
+}
+
+static int write_to_file(const char *data, size_t length, void *user_data) {
+    return fwrite(data, 1, length, (FILE *)user_data) == length ? 0 : -1;
+}
+
+int mm_index_save(const MMIndex *index, const char *filename) {
+    if (!index || !filename) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        set_error(MM_ERROR_IO);
+        return -1;
+    }
+
+    int result = mm_index_write(index, write_to_file, file);
+    if (fclose(file) != 0 && result == 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        set_error(MM_ERROR_IO);
+        remove(filename);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Cursor over index file bytes; every read checks the bounds
+ */
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    size_t pos;
+} Reader;
+
+static int read_varint(Reader *r, uint64_t *value) {
+    return get_varint(r->data, r->size, &r->pos, value);
+}
+
+static const char* read_bytes(Reader *r, size_t *length) {
+    uint64_t value;
+    if (read_varint(r, &value) != 0 || value > r->size - r->pos) {
+        return NULL;
+    }
+    *length = (size_t)value;
+    const char *bytes = (const char *)r->data + r->pos;
+    r->pos += *length;
+    return bytes;
+}
+
+static int read_document(Reader *r, MMIndex *index) {
+    size_t name_length, tag_length;
+    uint64_t entries;
+    const char *name = read_bytes(r, &name_length);
+    const char *tag = name ? read_bytes(r, &tag_length) : NULL;
+    // Every entry takes at least three bytes
+    if (!tag || memchr(name, '\0', name_length) || read_varint(r, &entries) != 0 ||
+        entries > (r->size - r->pos) / 3 ||
+        reserve((void **)&index->documents, &index->document_capacity,
+                index->document_count + 1, sizeof(IndexDocument *)) != 0) {
+        return -1;
+    }
+
+    IndexDocument *doc = safe_malloc(sizeof(IndexDocument));
+    if (!doc) {
+        return -1;
+    }
+    memset(doc, 0, sizeof(IndexDocument));
+    doc->live = 1;
+    index->documents[index->document_count++] = doc;
+    doc->name = copy_text(name, name_length);
+    doc->tag = copy_text(tag, tag_length);
+    if (!doc->name || !doc->tag ||
+        reserve((void **)&doc->entries, &doc->entry_capacity, (size_t)entries, sizeof(IndexEntry)) != 0) {
+        return -1;
+    }
+    for (size_t e = 0; e < entries; e++) {
+        uint64_t type, line;
+        size_t length;
+        const char *preview;
+        if (read_varint(r, &type) != 0 || type > NODE_SECURE || read_varint(r, &line) != 0 ||
+            !(preview = read_bytes(r, &length)) || memchr(preview, '\0', length) ||
+            reserve((void **)&doc->previews, &doc->preview_capacity, doc->preview_size + length + 1, 1) != 0) {
+            return -1;
+        }
+        IndexEntry *entry = &doc->entries[doc->entry_count++];
+        entry->type = (NodeType)type;
+        entry->line = (size_t)line;
+        entry->preview = doc->preview_size;
+        memcpy(doc->previews + doc->preview_size, preview, length);
+        doc->preview_size += length;
+        doc->previews[doc->preview_size++] = '\0';
+    }
+    return 0;
+}
+
+static int read_term(Reader *r, MMIndex *index) {
+    size_t length, size;
+    uint64_t count;
+    if (r->pos >= r->size) {
+        return -1;
+    }
+    unsigned char field = r->data[r->pos++];
+    const char *text = read_bytes(r, &length);
+    if (field >= FIELD_COUNT || !text || length > INDEX_MAX_TERM || read_varint(r, &count) != 0) {
+        return -1;
+    }
+    const unsigned char *postings = (const unsigned char *)read_bytes(r, &size);
+    if (!postings || count == 0 || count > size / 2 || find_term(index, field, text, length)) {
+        return -1;
+    }
+
+    // Postings are re-added one by one, which checks their order and ids
+    IndexTerm *term = intern_term(index, field, text, length);
+    if (!term) {
+        return -1;
+    }
+    size_t pos = 0;
+    uint32_t document = 0;
+    uint32_t entry = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t delta, value;
+        if (get_varint(postings, size, &pos, &delta) != 0 || get_varint(postings, size, &pos, &value) != 0 ||
+            delta >= index->document_count - document || (delta == 0 && (value == 0 && i > 0)) ||
+            value >= INDEX_NONE - (delta ? 0 : entry)) {
+            return -1;
+        }
+        document += (uint32_t)delta;
+        entry = delta ? (uint32_t)value : entry + (uint32_t)value;
+        if (entry >= index->documents[document]->entry_count || add_posting(term, document, entry) != 0) {
+            return -1;
+        }
+    }
+    return pos == size ? 0 : -1;
+}
+
+MMIndex* mm_index_from_buffer(const void *data, size_t length) {
+    if (!data && length > 0) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+
+    Reader r = { data, length, 5 };
+    uint64_t documents, terms;
+    if (length < 5 || memcmp(data, INDEX_MAGIC, 4) != 0 || r.data[4] != INDEX_VERSION) {
+        set_error(MM_ERROR_SYNTAX);
+        return NULL;
+    }
+
+    MMIndex *index = mm_index_new();
+    if (!index) {
+        return NULL;
+    }
+    int result = read_varint(&r, &documents) == 0 && documents < INDEX_NONE ? 0 : -1;
+    for (uint64_t i = 0; result == 0 && i < documents; i++) {
+        result = read_document(&r, index);
+    }
+    if (result == 0 && rebuild_names(index) != 0) {
+        result = -1;
+    }
+    // Names are unique; the table finds the later of two equal ones
+    for (size_t i = 0; result == 0 && i < index->document_count; i++) {
+        if (find_document(index, index->documents[i]->name) != index->documents[i]) {
+            result = -1;
+        }
+    }
+    if (result == 0 && read_varint(&r, &terms) != 0) {
+        result = -1;
+    }
+    for (uint64_t i = 0; result == 0 && i < terms; i++) {
+        result = read_term(&r, index);
+    }
+    if (result != 0 || r.pos != r.size) {
+        mm_index_free(index);
+        set_error(MM_ERROR_SYNTAX);
+        return NULL;
+    }
+    return index;
+}
+
+MMIndex* mm_index_load(const char *filename) {
+    const char *data;
+    size_t length;
+    MMFileMap *map = filename ? mm_map_file(filename, &data, &length) : NULL;
+    if (!map) {
+        if (!filename) {
+            set_error(MM_ERROR_INVALID);
+        }
+        return NULL;
+    }
+    MMIndex *index = mm_index_from_buffer(data, length);
+    mm_unmap_file(map);
+    return index;
+}
@@ -0,0 +1,316 @@
+/**
+ * @file json.c
+ * @brief JSON serialization of MetaMark documents
+ *
+ * The writer appends to a fixed MMOutput buffer that is flushed to the
+ * sink whenever it fills, and it can take the top-level nodes one at a
+ * time. Fed from the streaming parser, neither side ever holds more than
+ * one block, so documents of any size can be serialized.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+#include "../include/output.h"
+
+/**
+ * @brief How each ASCII byte goes into a JSON string
+ *
+ * 0 copies the byte, 'u' writes a \u00XX escape, and anything else is the
+ * letter of a two-character escape. Bytes from 0x80 up start a UTF-8
+ * sequence that must be validated.
+ */
+static const char json_escape[128] = {
+    ['\0'] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u', [0x04] = 'u',
+    [0x05] = 'u', [0x06] = 'u', [0x07] = 'u', ['\b'] = 'b', ['\t'] = 't',
+    ['\n'] = 'n', [0x0b] = 'u', ['\f'] = 'f', ['\r'] = 'r', [0x0e] = 'u',
+    [0x0f] = 'u', [0x10] = 'u', [0x11] = 'u', [0x12] = 'u', [0x13] = 'u',
+    [0x14] = 'u', [0x15] = 'u', [0x16] = 'u', [0x17] = 'u', [0x18] = 'u',
+    [0x19] = 'u', [0x1a] = 'u', [0x1b] = 'u', [0x1c] = 'u', [0x1d] = 'u',
+    [0x1e] = 'u', [0x1f] = 'u', ['"'] = '"', ['\\'] = '\\', [0x7f] = 'u'
+};
+
+struct MMJsonWriter {
+    MMOutput out;     ///< Buffered output
+    unsigned flags;   ///< MM_JSON_* flags
+    size_t nodes;     ///< Top-level nodes written so far
+};
+
+/**
+ * @brief Get the length of a valid UTF-8 sequence
+ *
+ * @return size_t The sequence length, or 0 if the bytes are not valid UTF-8
+ */
+static size_t utf8_length(const unsigned char *s, size_t remaining) {
+    size_t length;
+    unsigned min;
+    unsigned code;
+
+    if (s[0] >= 0xc2 && s[0] <= 0xdf) {
+        length = 2; min = 0x80; code = s[0] & 0x1f;
+    } else if (s[0] >= 0xe0 && s[0] <= 0xef) {
+        length = 3; min = 0x800; code = s[0] & 0x0f;
+    } else if (s[0] >= 0xf0 && s[0] <= 0xf4) {
+        length = 4; min = 0x10000; code = s[0] & 0x07;
+    } else {
+        return 0;
+    }
+    if (remaining < length) {
+        return 0;
+    }
+
+    for (size_t i = 1; i < length; i++) {
+        if ((s[i] & 0xc0) != 0x80) {
+            return 0;
+        }
+        code = (code << 6) | (s[i] & 0x3f);
+    }
+
+    // Reject overlong forms, surrogates and code points past U+10FFFF
+    if (code < min || (code >= 0xd800 && code <= 0xdfff) || code > 0x10ffff) {
+        return 0;
+    }
+    return length;
+}
+
+/**
+ * @brief Write a quoted JSON string, replacing invalid UTF-8 with U+FFFD
+ */
+static void write_string(MMOutput *out, const char *text, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char *s = (const unsigned char *)text;
+    size_t start = 0;
+
+    mm_output_char(out, '"');
+    for (size_t i = 0; i < length; ) {
+        char escape = s[i] < 0x80 ? json_escape[s[i]] : 'x';
+        if (!escape) {
+            i++;
+            continue;
+        }
+        if (escape == 'x') {
+            size_t sequence = utf8_length(s + i, length - i);
+            if (sequence) {
+                i += sequence;
+                continue;
+            }
+        }
+
+        mm_output_write(out, text + start, i - start);
+        if (escape == 'x') {
+            mm_output_puts(out, "\\ufffd");
+        } else if (escape == 'u') {
+            char buffer[6] = { '\\', 'u', '0', '0', hex[s[i] >> 4], hex[s[i] & 0xf] };
+            mm_output_write(out, buffer, sizeof(buffer));
+        } else {
+            char buffer[2] = { '\\', escape };
+            mm_output_write(out, buffer, sizeof(buffer));
+        }
+        start = ++i;
+    }
+    mm_output_write(out, text + start, length - start);
+    mm_output_char(out, '"');
+}
+
+static void write_number(MMOutput *out, size_t value) {
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%zu", value);
+    mm_output_write(out, buffer, (size_t)length);
+}
+
+/**
+ * @brief Start a new line at a nesting depth, unless writing compact JSON
+ */
+static void write_indent(MMJsonWriter *writer, size_t depth) {
+    if (writer->flags & MM_JSON_COMPACT) {
+        return;
+    }
+    mm_output_char(&writer->out, '\n');
+    for (size_t i = 0; i < depth; i++) {
+        mm_output_write(&writer->out, "  ", 2);
+    }
+}
+
+/**
+ * @brief Write an object key, preceded by a comma unless it is the first
+ */
+static void write_key(MMJsonWriter *writer, size_t depth, const char *key, int first) {
+    if (!first) {
+        mm_output_char(&writer->out, ',');
+    }
+    write_indent(writer, depth);
+    write_string(&writer->out, key, strlen(key));
+    if (writer->flags & MM_JSON_COMPACT) {
+        mm_output_char(&writer->out, ':');
+    } else {
+        mm_output_write(&writer->out, ": ", 2);
+    }
+}
+
+static void write_node_fields(MMJsonWriter *writer, const Document *doc, const Node *node, size_t depth) {
+    MMOutput *out = &writer->out;
+    mm_output_char(out, '{');
+    write_key(writer, depth + 1, "type", 1);
+    write_string(out, node_type_to_string(node->type), strlen(node_type_to_string(node->type)));
+
+    if (node->type == NODE_HEADING) {
+        write_key(writer, depth + 1, "level", 0);
+        write_number(out, node->level);
+    }
+
+    size_t length;
+    const char *text = mm_node_text(doc, node, &length);
+    if (text) {
+        write_key(writer, depth + 1, "content", 0);
+        write_string(out, text, length);
+    }
+
+    if (writer->flags & MM_JSON_OFFSETS) {
+        write_key(writer, depth + 1, "offset", 0);
+        write_number(out, node->offset);
+        write_key(writer, depth + 1, "length", 0);
+        write_number(out, node->length);
+    }
+
+    if (node_child_count(node) > 0) {
+        write_key(writer, depth + 1, "children", 0);
+        mm_output_char(out, '[');
+    }
+}
+
+/**
+ * @brief Write a subtree whose first line is already indented to depth
+ *
+ * Each level of the tree nests two levels of JSON: the object and its
+ * children array.
+ */
+static void write_node(MMJsonWriter *writer, const Document *doc, const Node *root, size_t depth) {
+    MMOutput *out = &writer->out;
+    MMWalker walker;
+    MMVisit visit;
+    const Node *node;
+    mm_walker_init(&walker, root, MM_WALK_ENTER | MM_WALK_LEAVE | MM_WALK_LAZY);
+    while (out->result == 0 && (node = mm_walker_next(&walker, &visit))) {
+        size_t level = depth + visit.depth * 2;
+        if (visit.leaving) {
+            if (node_child_count(node) > 0) {
+                write_indent(writer, level + 1);
+                mm_output_char(out, ']');
+            }
+            write_indent(writer, level);
+            mm_output_char(out, '}');
+            continue;
+        }
+
+        if (visit.depth > 0) {
+            if (visit.index > 0) {
+                mm_output_char(out, ',');
+            }
+            write_indent(writer, level);
+        }
+        write_node_fields(writer, doc, node, level);
+    }
+    if (mm_walker_finish(&walker) != 0) {
+        out->result = -1;
+    }
+}
+
+MMJsonWriter* mm_json_writer_new(unsigned flags, MMWriteFn write, void *user_data) {
+    MMJsonWriter *writer = safe_malloc(sizeof(MMJsonWriter));
+    if (!writer) {
+        set_error(MM_ERROR_MEMORY);
+        return NULL;
+    }
+    if (mm_output_init_sink(&writer->out, write, user_data) != 0) {
+        free(writer);
+        return NULL;
+    }
+    writer->flags = flags;
+    writer->nodes = 0;
+
+    mm_output_char(&writer->out, '{');
+    write_key(writer, 1, "type", 1);
+    mm_output_puts(&writer->out, "\"DOCUMENT\"");
+    write_key(writer, 1, "children", 0);
+    mm_output_char(&writer->out, '[');
+    return writer;
+}
+
+int mm_json_writer_node(MMJsonWriter *writer, const Document *doc, const Node *node) {
+    if (!writer || !node) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    if (writer->nodes++ > 0) {
+        mm_output_char(&writer->out, ',');
+    }
+    write_indent(writer, 2);
+    write_node(writer, doc, node, 2);
+    return writer->out.result;
+}
+
+int mm_json_writer_finish(MMJsonWriter *writer, const Document *doc) {
+    if (!writer) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    MMOutput *out = &writer->out;
+    if (writer->nodes > 0) {
+        write_indent(writer, 1);
+    }
+    mm_output_char(out, ']');
+
+    write_key(writer, 1, "metadata", 0);
+    mm_output_char(out, '{');
+    size_t count = doc ? doc->metadata_count : 0;
+    for (size_t i = 0; i < count; i++) {
+        const MetadataPair *pair = &doc->metadata[i];
+        write_key(writer, 2, pair->key, i == 0);
+        write_string(out, pair->value, strlen(pair->value));
+    }
+    if (count > 0) {
+        write_indent(writer, 1);
+    }
+    mm_output_char(out, '}');
+
+    write_indent(writer, 0);
+    mm_output_char(out, '}');
+    if (!(writer->flags & MM_JSON_COMPACT)) {
+        mm_output_char(out, '\n');
+    }
+
+    mm_output_finish(out, NULL);
+    return out->result;
+}
+
+void mm_json_writer_free(MMJsonWriter *writer) {
+    if (!writer) {
+        return;
+    }
+
+    // A writer that was never finished still owns its buffer
+    free(writer->out.data);
+    free(writer);
+}
+
+int mm_write_json(const Document *doc, unsigned flags, MMWriteFn write, void *user_data) {
+    if (!doc || !doc->root) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    MMJsonWriter *writer = mm_json_writer_new(flags, write, user_data);
+    if (!writer) {
+        return -1;
+    }
+    for (size_t i = 0; i < doc->root->child_count && writer->out.result == 0; i++) {
+        mm_json_writer_node(writer, doc, doc->root->children[i]);
+    }
+    int result = mm_json_writer_finish(writer, doc);
+    mm_json_writer_free(writer);
+    return result;
+}
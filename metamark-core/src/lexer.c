@@ -9,13 +9,20 @@
 #include <ctype.h>
 #include "../include/metamark.h"
 #include "../include/lexer.h"
+#include "../include/scan.h"
+#include "../include/utils.h"
 
 void lexer_init(Lexer *lexer, const char *input) {
+    lexer_init_n(lexer, input, strlen(input));
+}
+
+void lexer_init_n(Lexer *lexer, const char *input, size_t length) {
     lexer->input = input;
     lexer->pos = 0;
-    lexer->length = strlen(input);
+    lexer->length = length;
     lexer->current = TOKEN_EOF;
     lexer->token_value = NULL;
+    mm_error_position_reset();
 }
 
 void lexer_free(Lexer *lexer) {
@@ -49,6 +56,10 @@ void skip_whitespace(Lexer *lexer) {
     }
 }
 
+void skip_plain(Lexer *lexer) {
+    lexer->pos = mm_scan_special(lexer->input, lexer->pos, lexer->length);
+}
+
 char* read_token_value(const Lexer *lexer, size_t start, size_t end) {
     if (start >= end || end > lexer->length) {
         return NULL;
@@ -0,0 +1,142 @@
+/**
+ * @file mapfile.c
+ * @brief Read-only file mappings for zero-copy document input
+ *
+ * Mapping a file shares its pages with the page cache instead of copying
+ * them into a heap buffer. A mapped document keeps its mapping alive and
+ * releases it from free_document().
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct MMFileMap {
+    void *data;     ///< Start of the mapped view, or NULL for an empty file
+    size_t length;  ///< Length of the mapped view in bytes
+#ifdef _WIN32
+    HANDLE mapping; ///< File mapping object backing the view
+#endif
+};
+
+MMFileMap* mm_map_file(const char *filename, const char **data, size_t *length) {
+    if (!filename || !data || !length) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+
+    MMFileMap *map = safe_malloc(sizeof(MMFileMap));
+    if (!map) {
+        return NULL;
+    }
+    memset(map, 0, sizeof(MMFileMap));
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        set_error(MM_ERROR_IO);
+        free(map);
+        return NULL;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (unsigned long long)size.QuadPart > (size_t)-1) {
+        set_error(MM_ERROR_IO);
+        CloseHandle(file);
+        free(map);
+        return NULL;
+    }
+
+    // Empty files cannot be mapped; they are represented by an empty view
+    map->length = (size_t)size.QuadPart;
+    if (map->length > 0) {
+        map->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (map->mapping) {
+            map->data = MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+        if (!map->data) {
+            set_error(MM_ERROR_IO);
+            if (map->mapping) {
+                CloseHandle(map->mapping);
+            }
+            CloseHandle(file);
+            free(map);
+            return NULL;
+        }
+    }
+
+    // The mapping object keeps the file open
+    CloseHandle(file);
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        set_error(MM_ERROR_IO);
+        free(map);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        set_error(MM_ERROR_IO);
+        close(fd);
+        free(map);
+        return NULL;
+    }
+
+    // Empty files cannot be mapped; they are represented by an empty view
+    map->length = (size_t)st.st_size;
+    if (map->length > 0) {
+        void *view = mmap(NULL, map->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) {
+            set_error(MM_ERROR_IO);
+            close(fd);
+            free(map);
+            return NULL;
+        }
+        map->data = view;
+#ifdef MADV_SEQUENTIAL
+        // The parser reads front to back
+        madvise(view, map->length, MADV_SEQUENTIAL);
+#endif
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+#endif
+
+    *data = map->data ? map->data : "";
+    *length = map->length;
+    return map;
+}
+
+void mm_unmap_file(MMFileMap *map) {
+    if (!map) {
+        return;
+    }
+
+#ifdef _WIN32
+    if (map->data) {
+        UnmapViewOfFile(map->data);
+    }
+    if (map->mapping) {
+        CloseHandle(map->mapping);
+    }
+#else
+    if (map->data) {
+        munmap(map->data, map->length);
+    }
+#endif
+
+    free(map);
+}
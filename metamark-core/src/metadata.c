@@ -1,82 +1,170 @@
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include "../include/metamark.h"
+#include "../include/utils.h"
 
 #define INITIAL_METADATA_CAPACITY 8
 
-static void trim_whitespace(char *str) {
-    char *end;
-    
-    // Trim leading spaces
-    while (isspace((unsigned char)*str)) str++;
-    
-    if (*str == 0) return;
-    
-    // Trim trailing spaces
-    end = str + strlen(str) - 1;
-    while (end > str && isspace((unsigned char)*end)) end--;
-    
-    end[1] = '\0';
+/** @brief Pairs up to which get_metadata() scans instead of hashing */
+#define METADATA_INDEX_THRESHOLD 8
+
+/** @brief Smallest hash index, a power of two */
+#define METADATA_MIN_SLOTS 32
+
+struct MMMetadataSlot {
+    uint32_t hash;   ///< Hash of the key
+    uint32_t entry;  ///< Index of the pair plus one, 0 for an empty slot
+};
+
+/**
+ * @brief Hash a metadata key with 32-bit FNV-1a
+ */
+static uint32_t hash_key(const char *key) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
 }
 
-static char* extract_key(const char *line) {
-    const char *colon = strchr(line, ':');
-    if (!colon) {
-        return NULL;
+/**
+ * @brief Find a key through the hash index
+ *
+ * @return size_t The index of the first pair with the key, or
+ *                doc->metadata_count if there is none
+ */
+static size_t index_find(const Document *doc, const char *key, uint32_t hash) {
+    size_t mask = doc->metadata_slots - 1;
+
+    for (size_t i = hash & mask; doc->metadata_index[i].entry; i = (i + 1) & mask) {
+        const MMMetadataSlot *slot = &doc->metadata_index[i];
+        if (slot->hash == hash && strcmp(doc->metadata[slot->entry - 1].key, key) == 0) {
+            return slot->entry - 1;
+        }
     }
-    
-    size_t key_len = colon - line;
-    char *key = malloc(key_len + 1);
-    if (!key) {
-        return NULL;
+    return doc->metadata_count;
+}
+
+/**
+ * @brief Index a pair unless an earlier pair already has its key
+ */
+static void index_insert(Document *doc, size_t entry) {
+    uint32_t hash = hash_key(doc->metadata[entry].key);
+    size_t mask = doc->metadata_slots - 1;
+    size_t i = hash & mask;
+
+    if (index_find(doc, doc->metadata[entry].key, hash) < doc->metadata_count) {
+        return;
     }
-    
-    strncpy(key, line, key_len);
-    key[key_len] = '\0';
-    trim_whitespace(key);
-    
-    return key;
+    while (doc->metadata_index[i].entry) {
+        i = (i + 1) & mask;
+    }
+    doc->metadata_index[i].hash = hash;
+    doc->metadata_index[i].entry = (uint32_t)(entry + 1);
 }
 
-static char* extract_value(const char *line) {
-    const char *colon = strchr(line, ':');
-    if (!colon) {
-        return NULL;
+/**
+ * @brief Build the hash index again with room for twice the pairs
+ *
+ * @return int 0 on success, -1 on error
+ */
+static int index_rebuild(Document *doc) {
+    size_t slots = METADATA_MIN_SLOTS;
+    while (slots < doc->metadata_count * 2) {
+        slots *= 2;
     }
-    
-    const char *value_start = colon + 1;
-    while (isspace((unsigned char)*value_start)) value_start++;
-    
-    return strdup(value_start);
+
+    MMMetadataSlot *index = mm_arena_alloc(doc->arena, slots * sizeof(MMMetadataSlot));
+    if (!index) {
+        return -1;
+    }
+    memset(index, 0, slots * sizeof(MMMetadataSlot));
+
+    // An arena index is reclaimed with the arena
+    if (!doc->arena) {
+        free(doc->metadata_index);
+    }
+    doc->metadata_index = index;
+    doc->metadata_slots = slots;
+
+    for (size_t i = 0; i < doc->metadata_count; i++) {
+        index_insert(doc, i);
+    }
+    return 0;
 }
 
 void add_metadata(Document *doc, const char *key, const char *value) {
-    if (!doc || !key || !value) {
+    if (!key || !value) {
         return;
     }
     
-    if (doc->metadata_count == 0) {
-        doc->metadata = malloc(sizeof(MetadataPair) * INITIAL_METADATA_CAPACITY);
-        if (!doc->metadata) {
-            return;
-        }
-        doc->metadata_count = 0;
+    add_metadata_n(doc, key, strlen(key), value, strlen(value));
+}
+
+void add_metadata_n(Document *doc, const char *key, size_t key_length,
+                    const char *value, size_t value_length) {
+    if (!doc || !key || !value || doc->metadata_count >= UINT32_MAX - 1) {
+        return;
     }
     
-    if (doc->metadata_count >= INITIAL_METADATA_CAPACITY) {
-        size_t new_capacity = INITIAL_METADATA_CAPACITY * 2;
-        MetadataPair *new_metadata = realloc(doc->metadata, 
-                                           sizeof(MetadataPair) * new_capacity);
+    if (doc->metadata_count == doc->metadata_capacity) {
+        size_t new_capacity = doc->metadata_capacity ? doc->metadata_capacity * 2
+                                                     : INITIAL_METADATA_CAPACITY;
+        MetadataPair *new_metadata = mm_arena_grow(doc->arena, doc->metadata,
+                                                   sizeof(MetadataPair) * doc->metadata_capacity,
+                                                   sizeof(MetadataPair) * new_capacity);
         if (!new_metadata) {
             return;
         }
         doc->metadata = new_metadata;
+        doc->metadata_capacity = new_capacity;
     }
     
-    doc->metadata[doc->metadata_count].key = strdup(key);
-    doc->metadata[doc->metadata_count].value = strdup(value);
+    MetadataPair *pair = &doc->metadata[doc->metadata_count];
+    pair->key = mm_arena_strndup(doc->arena, key, key_length);
+    pair->value = mm_arena_strndup(doc->arena, value, value_length);
+    if (!pair->key || !pair->value) {
+        if (!doc->arena) {
+            free(pair->key);
+            free(pair->value);
+        }
+        return;
+    }
     doc->metadata_count++;
+    
+    // Small frontmatter is scanned; the index keeps a load factor below 3/4
+    if (doc->metadata_count > METADATA_INDEX_THRESHOLD) {
+        if (!doc->metadata_index || doc->metadata_count * 4 > doc->metadata_slots * 3) {
+            if (index_rebuild(doc) != 0) {
+                // Without an index lookups simply scan
+                if (!doc->arena) {
+                    free(doc->metadata_index);
+                }
+                doc->metadata_index = NULL;
+                doc->metadata_slots = 0;
+            }
+        } else {
+            index_insert(doc, doc->metadata_count - 1);
+        }
+    }
+}
+
+void clear_metadata(Document *doc) {
+    if (!doc || doc->arena) {
+        return;
+    }
+    
+    for (size_t i = 0; i < doc->metadata_count; i++) {
+        free(doc->metadata[i].key);
+        free(doc->metadata[i].value);
+    }
+    free(doc->metadata);
+    free(doc->metadata_index);
+    doc->metadata = NULL;
+    doc->metadata_count = 0;
+    doc->metadata_capacity = 0;
+    doc->metadata_index = NULL;
+    doc->metadata_slots = 0;
 }
 
 const char* get_metadata(const Document *doc, const char *key) {
@@ -84,6 +172,11 @@ const char* get_metadata(const Document *doc, const char *key) {
         return NULL;
     }
     
+    if (doc->metadata_index) {
+        size_t entry = index_find(doc, key, hash_key(key));
+        return entry < doc->metadata_count ? doc->metadata[entry].value : NULL;
+    }
+    
     for (size_t i = 0; i < doc->metadata_count; i++) {
         if (strcmp(doc->metadata[i].key, key) == 0) {
             return doc->metadata[i].value;
@@ -93,56 +186,20 @@ const char* get_metadata(const Document *doc, const char *key) {
     return NULL;
 }
 
-// Parse YAML-style metadata from a string
-static void parse_metadata_string(Document *doc, const char *metadata_str) {
-    if (!metadata_str) return;
-    
-    const char *line_start = metadata_str;
-    const char *line_end;
-    
-    while (line_start && *line_start) {
-        // Find end of line
-        line_end = strchr(line_start, '\n');
-        
-        // Process the line
-        size_t line_len = line_end ? (line_end - line_start) : strlen(line_start);
-        char *line = malloc(line_len + 1);
-        if (!line) break;
-        
-        strncpy(line, line_start, line_len);
-        line[line_len] = '\0';
-        
-        trim_whitespace(line);
-        
-        // Skip empty lines and comments
-        if (*line != '\0' && *line != '#') {
-            char *key = extract_key(line);
-            char *value = extract_value(line);
-            
-            if (key && value) {
-                add_metadata(doc, key, value);
-            }
-            
-            free(key);
-            free(value);
-        }
-        
-        free(line);
-        
-        // Move to next line
-        if (line_end) {
-            line_start = line_end + 1;
-        } else {
-            break;
-        }
-    }
-}
-
 // Public function to parse metadata from a node
 void parse_metadata_node(Document *doc, const Node *node) {
-    if (!doc || !node || node->type != NODE_METADATA || !node->content) {
+    if (!doc || !node || node->type != NODE_METADATA) {
         return;
     }
     
-    parse_metadata_string(doc, node->content);
-} 
\ No newline at end of file
+    // The parser already split the pairs into "key:value" children
+    for (size_t i = 0; i < node->child_count; i++) {
+        size_t length;
+        const char *text = mm_node_text(doc, node->children[i], &length);
+        const char *colon = text ? memchr(text, ':', length) : NULL;
+        if (colon) {
+            size_t key_length = (size_t)(colon - text);
+            add_metadata_n(doc, text, key_length, colon + 1, length - key_length - 1);
+        }
+    }
+}
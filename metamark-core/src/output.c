@@ -0,0 +1,98 @@
+/**
+ * @file output.c
+ * @brief Output buffer shared by the MetaMark writers
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+#include "../include/output.h"
+
+static int output_init(MMOutput *out, size_t capacity, MMWriteFn write, void *user_data) {
+    memset(out, 0, sizeof(MMOutput));
+    out->write = write;
+    out->user_data = user_data;
+    out->data = safe_malloc(capacity);
+    if (!out->data) {
+        set_error(MM_ERROR_MEMORY);
+        out->result = -1;
+        return -1;
+    }
+    out->capacity = capacity;
+    return 0;
+}
+
+int mm_output_init_string(MMOutput *out, size_t capacity) {
+    return output_init(out, capacity < 64 ? 64 : capacity, NULL, NULL);
+}
+
+int mm_output_init_sink(MMOutput *out, MMWriteFn write, void *user_data) {
+    if (!write) {
+        memset(out, 0, sizeof(MMOutput));
+        set_error(MM_ERROR_INVALID);
+        out->result = -1;
+        return -1;
+    }
+    return output_init(out, MM_OUTPUT_SINK_SIZE, write, user_data);
+}
+
+/**
+ * @brief Hand the buffered bytes to the sink
+ */
+static int output_flush(MMOutput *out) {
+    if (out->result == 0 && out->length > 0) {
+        out->result = out->write(out->data, out->length, out->user_data);
+    }
+    out->length = 0;
+    return out->result;
+}
+
+int mm_output_reserve(MMOutput *out, size_t length) {
+    if (out->result != 0) {
+        return out->result;
+    }
+    if (out->write && output_flush(out) != 0) {
+        return out->result;
+    }
+    if (out->capacity - out->length >= length) {
+        return 0;
+    }
+
+    // Strings grow geometrically; a sink only grows for one oversized write
+    size_t capacity = out->capacity;
+    while (capacity - out->length < length) {
+        capacity *= 2;
+    }
+    char *data = safe_realloc(out->data, capacity);
+    if (!data) {
+        set_error(MM_ERROR_MEMORY);
+        out->result = -1;
+        return -1;
+    }
+    out->data = data;
+    out->capacity = capacity;
+    return 0;
+}
+
+char* mm_output_finish(MMOutput *out, size_t *length) {
+    char *result = NULL;
+
+    if (out->write) {
+        output_flush(out);
+    } else {
+        mm_output_char(out, '\0');
+        if (out->result == 0) {
+            result = out->data;
+            out->data = NULL;
+            if (length) {
+                *length = out->length - 1;
+            }
+        }
+    }
+
+    free(out->data);
+    out->data = NULL;
+    out->capacity = 0;
+    return result;
+}
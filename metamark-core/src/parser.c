@@ -9,42 +9,176 @@
 
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
 #include <ctype.h>
-#define _GNU_SOURCE  // For strndup
 #include "../include/metamark.h"
 #include "../include/lexer.h"
 #include "../include/utils.h"
+#include "../include/trace.h"
+#include "../include/parser.h"
+#include "../include/pool.h"
+#include "../include/stats.h"
 
-// Custom implementation of strndup
-static char* mm_strndup(const char *s, size_t n) {
-    size_t len = strnlen(s, n);
-    char *new = malloc(len + 1);
-    if (new == NULL) {
+/**
+ * @brief Blocks built per pool task in a parallel parse
+ */
+#define PARSER_PARALLEL_CHUNK 256
+
+/**
+ * @brief Fewest blocks for which a parallel parse uses the pool
+ */
+#define PARSER_PARALLEL_MIN_BLOCKS (4 * PARSER_PARALLEL_CHUNK)
+
+// Forward declarations for parser functions
+static int scan_block(Lexer *lexer, Block *block);
+static int scan_heading(Lexer *lexer, Block *block);
+static int scan_component(Lexer *lexer, Block *block);
+static int scan_annotation(Lexer *lexer, Block *block);
+static int scan_comment(Lexer *lexer, Block *block);
+static int scan_metadata(Lexer *lexer, Block *block);
+static Node* build_block(Parser *parser, const Block *block);
+static Node* build_block_into(Parser *parser, const Block *block, Document *doc);
+static int emit_block(Parser *parser, const Block *block);
+
+/**
+ * @brief A key/value pair located inside a metadata block
+ */
+typedef struct {
+    const char *key;     ///< Start of the trimmed key
+    size_t key_length;   ///< Length of the trimmed key
+    const char *value;   ///< Start of the trimmed value
+    size_t value_length; ///< Length of the trimmed value
+} MetadataSpan;
+
+/**
+ * @brief Create a node whose content is a slice of the input
+ * 
+ * @param parser The parser state
+ * @param type The type of node to create
+ * @param start Offset of the first content byte
+ * @param end Offset one past the last content byte
+ * @return Node* A new node, or NULL on error
+ * 
+ * In zero-copy mode the node only records the slice; otherwise the slice
+ * is copied straight from the input into the node content.
+ */
+static Node* make_span_node(Parser *parser, NodeType type, size_t start, size_t end) {
+    const Lexer *lexer = &parser->lexer;
+    Node *node;
+    
+    if (parser->zero_copy) {
+        node = create_node_in(parser->arena, type, NULL, 0);
+        if (node) {
+            node->flags |= MM_NODE_VIEW;
+        }
+    } else {
+        node = create_node_in(parser->arena, type, lexer->input + start, end - start);
+    }
+    
+    if (!node) {
+        set_error(MM_ERROR_MEMORY);
         return NULL;
     }
-    new[len] = '\0';
-    return memcpy(new, s, len);
+    
+    node->offset = start;
+    node->length = end - start;
+    return node;
 }
 
-// Forward declarations for parser functions
-static Node* parse_node(Lexer *lexer);
-static Node* parse_heading(Lexer *lexer);
-static Node* parse_component(Lexer *lexer);
-static Node* parse_annotation(Lexer *lexer);
-static Node* parse_comment(Lexer *lexer);
-static Node* parse_metadata(Lexer *lexer);
+/**
+ * @brief Check that an input slice is a valid identifier
+ * 
+ * @param str Start of the slice
+ * @param length Length of the slice
+ * @return int 1 if valid, 0 if not
+ * 
+ * Span counterpart of is_valid_identifier().
+ */
+static int is_identifier_span(const char *str, size_t length) {
+    if (length == 0 || (!isalpha((unsigned char)str[0]) && str[0] != '_')) {
+        return 0;
+    }
+    
+    for (size_t i = 1; i < length; i++) {
+        if (!isalnum((unsigned char)str[i]) && str[i] != '_') {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
 
 /**
- * @brief Parse a heading node from the input
+ * @brief Find the next key/value pair in metadata content
+ * 
+ * @param cursor Current line start, advanced past the consumed lines
+ * @param end End of the metadata content
+ * @param pair Receives the trimmed key and value
+ * @return int 1 if a pair was found, 0 at the end, -1 on a line without a colon
+ * 
+ * Empty lines and lines starting with # are skipped. On a line without a
+ * colon, cursor is left at the start of that line.
+ */
+static int next_metadata_pair(const char **cursor, const char *end, MetadataSpan *pair) {
+    const char *line_start = *cursor;
+    
+    while (line_start < end) {
+        // Find end of line
+        const char *line_end = memchr(line_start, '\n', end - line_start);
+        if (!line_end) {
+            line_end = end;
+        }
+        *cursor = line_end + 1;
+        
+        // Skip empty lines and comments
+        const char *p = line_start;
+        while (p < line_end && isspace((unsigned char)*p)) p++;
+        
+        if (p < line_end && *p != '#') {
+            // Look for colon
+            const char *colon = memchr(line_start, ':', line_end - line_start);
+            if (!colon) {
+                *cursor = line_start;
+                return -1;
+            }
+            
+            // Trim key
+            const char *k = line_start;
+            const char *k_end = colon;
+            while (k < k_end && isspace((unsigned char)*k)) k++;
+            while (k_end > k && isspace((unsigned char)k_end[-1])) k_end--;
+            
+            // Trim value
+            const char *v = colon + 1;
+            const char *v_end = line_end;
+            while (v < v_end && isspace((unsigned char)*v)) v++;
+            while (v_end > v && isspace((unsigned char)v_end[-1])) v_end--;
+            
+            pair->key = k;
+            pair->key_length = k_end - k;
+            pair->value = v;
+            pair->value_length = v_end - v;
+            return 1;
+        }
+        
+        // Move to next line
+        line_start = line_end + 1;
+    }
+    
+    *cursor = end;
+    return 0;
+}
+
+/**
+ * @brief Scan a heading from the input
  * 
  * @param lexer The lexer instance
- * @return Node* A new heading node, or NULL on error
+ * @param block Receives the heading description
+ * @return int 1 if a heading was found, 0 otherwise
  * 
  * Headings start with one or more # characters, followed by whitespace
  * and the heading text. The number of # characters determines the heading level.
  */
-static Node* parse_heading(Lexer *lexer) {
+static int scan_heading(Lexer *lexer, Block *block) {
     // Skip # characters and count level
     size_t level = 0;
     while (peek(lexer) == '#') {
@@ -52,7 +186,7 @@ static Node* parse_heading(Lexer *lexer) {
         next(lexer);
     }
     
-    printf("Found heading level %zu\n", level);
+    MM_TRACE("Found heading level %zu", level);
     
     // Skip whitespace after #
     while (isspace(peek(lexer)) && peek(lexer) != '\n') {
@@ -64,39 +198,37 @@ static Node* parse_heading(Lexer *lexer) {
     while (peek(lexer) != '\0' && peek(lexer) != '\n') {
         next(lexer);
     }
+    size_t end = lexer->pos;
     
     // Skip the newline
     if (peek(lexer) == '\n') {
         next(lexer);
     }
     
-    char *content = read_token_value(lexer, start, lexer->pos - 1);  // -1 to exclude newline
-    if (content && *content) {
-        printf("Heading content: '%s'\n", content);
-        Node *node = create_node(NODE_HEADING, content);
-        printf("Created heading node with type %d\n", node->type);
-        free(content);
-        
-        // Store heading level directly in the node
-        node->level = level;
-        
-        return node;
+    if (end == start) {
+        return 0;
     }
     
-    free(content);
-    return NULL;
+    MM_TRACE("Heading content: '%.*s'", MM_TRACE_CLAMP(end - start), lexer->input + start);
+    block->type = NODE_HEADING;
+    block->level = level;
+    block->has_text = 1;
+    block->text_start = start;
+    block->text_end = end;
+    return 1;
 }
 
 /**
- * @brief Parse a component block from the input
+ * @brief Scan a component block from the input
  * 
  * @param lexer The lexer instance
- * @return Node* A new component node, or NULL on error
+ * @param block Receives the component description
+ * @return int 1 if a component was found, 0 on error
  * 
  * Component blocks are delimited by [[ and ]] and have the format:
  * [[type:content]]. The type determines how the content should be processed.
  */
-static Node* parse_component(Lexer *lexer) {
+static int scan_component(Lexer *lexer, Block *block) {
     // Skip [[ delimiter
     next(lexer);
     next(lexer);
@@ -109,14 +241,15 @@ static Node* parse_component(Lexer *lexer) {
     
     // Check for closing delimiter
     if (peek(lexer) != ']' || peek_at(lexer, 1) != ']') {
-        set_error(MM_ERROR_SYNTAX);
-        return NULL;
+        set_error_at(MM_ERROR_SYNTAX, lexer->input, lexer->pos);
+        return 0;
     }
     
-    char *type = read_token_value(lexer, start, lexer->pos);
-    printf("Component type: '%s'\n", type);
-    Node *node = create_node(NODE_COMPONENT, type);
-    free(type);
+    MM_TRACE("Component type: '%.*s'", MM_TRACE_CLAMP(lexer->pos - start), lexer->input + start);
+    block->type = NODE_COMPONENT;
+    block->has_text = lexer->pos > start;
+    block->text_start = start;
+    block->text_end = lexer->pos;
     
     // Skip ]] delimiter
     if (peek(lexer) == ']' && peek_at(lexer, 1) == ']') {
@@ -136,21 +269,20 @@ static Node* parse_component(Lexer *lexer) {
             break;
         }
         next(lexer);
+        skip_plain(lexer);
     }
     
     // Check for closing delimiter
     if (peek(lexer) != '[' || peek_at(lexer, 1) != '[' || peek_at(lexer, 2) != '/') {
-        free_node(node);
-        set_error(MM_ERROR_SYNTAX);
-        return NULL;
+        set_error_at(MM_ERROR_SYNTAX, lexer->input, lexer->pos);
+        return 0;
     }
     
-    char *content = read_token_value(lexer, start, lexer->pos);
-    if (content) {
-        printf("Component content: '%s'\n", content);
-        Node *content_node = create_node(NODE_PARAGRAPH, content);
-        add_child(node, content_node);
-        free(content);
+    if (lexer->pos > start) {
+        MM_TRACE("Component content: '%.*s'", MM_TRACE_CLAMP(lexer->pos - start), lexer->input + start);
+        block->has_body = 1;
+        block->body_start = start;
+        block->body_end = lexer->pos;
     }
     
     // Skip [[/type]] delimiter
@@ -166,19 +298,20 @@ static Node* parse_component(Lexer *lexer) {
         next(lexer);
     }
     
-    return node;
+    return 1;
 }
 
 /**
- * @brief Parse an annotation from the input
+ * @brief Scan an annotation from the input
  * 
  * @param lexer The lexer instance
- * @return Node* A new annotation node, or NULL on error
+ * @param block Receives the annotation description
+ * @return int 1 if an annotation was found, 0 on error
  * 
  * Annotations are delimited by @[ and ] and have the format:
  * @[type:content]. They are used for inline notes and comments.
  */
-static Node* parse_annotation(Lexer *lexer) {
+static int scan_annotation(Lexer *lexer, Block *block) {
     // Skip > delimiter
     next(lexer);
     
@@ -195,20 +328,20 @@ static Node* parse_annotation(Lexer *lexer) {
     
     // Check if we found a type
     if (lexer->pos == start) {
-        set_error(MM_ERROR_SYNTAX);
-        return NULL;
+        set_error_at(MM_ERROR_SYNTAX, lexer->input, lexer->pos);
+        return 0;
     }
     
-    char *type = read_token_value(lexer, start, lexer->pos);
-    if (!type || !is_valid_identifier(type)) {
-        free(type);
-        set_error(MM_ERROR_SYNTAX);
-        return NULL;
+    if (!is_identifier_span(lexer->input + start, lexer->pos - start)) {
+        set_error_at(MM_ERROR_SYNTAX, lexer->input, lexer->pos);
+        return 0;
     }
     
-    printf("Annotation type: '%s'\n", type);
-    Node *node = create_node(NODE_ANNOTATION, type);
-    free(type);
+    MM_TRACE("Annotation type: '%.*s'", MM_TRACE_CLAMP(lexer->pos - start), lexer->input + start);
+    block->type = NODE_ANNOTATION;
+    block->has_text = 1;
+    block->text_start = start;
+    block->text_end = lexer->pos;
     
     // Skip : delimiter if present
     if (peek(lexer) == ':') {
@@ -225,12 +358,11 @@ static Node* parse_annotation(Lexer *lexer) {
             next(lexer);
         }
         
-        char *content = read_token_value(lexer, start, lexer->pos);
-        if (content) {
-            printf("Annotation content: '%s'\n", content);
-            Node *content_node = create_node(NODE_PARAGRAPH, content);
-            add_child(node, content_node);
-            free(content);
+        if (lexer->pos > start) {
+            MM_TRACE("Annotation content: '%.*s'", MM_TRACE_CLAMP(lexer->pos - start), lexer->input + start);
+            block->has_body = 1;
+            block->body_start = start;
+            block->body_end = lexer->pos;
         }
     }
     
@@ -239,19 +371,20 @@ static Node* parse_annotation(Lexer *lexer) {
         next(lexer);
     }
     
-    return node;
+    return 1;
 }
 
 /**
- * @brief Parse a comment block from the input
+ * @brief Scan a comment block from the input
  * 
  * @param lexer The lexer instance
- * @return Node* A new comment node, or NULL on error
+ * @param block Receives the comment description
+ * @return int 1 if a comment was found, 0 on error
  * 
  * Comment blocks are delimited by %% and are not rendered in the output.
  * They can span multiple lines.
  */
-static Node* parse_comment(Lexer *lexer) {
+static int scan_comment(Lexer *lexer, Block *block) {
     // Skip %% delimiter
     next(lexer);
     next(lexer);
@@ -268,12 +401,13 @@ static Node* parse_comment(Lexer *lexer) {
             break;
         }
         next(lexer);
+        skip_plain(lexer);
     }
     
     // Check if we found the closing delimiter
     if (peek(lexer) != '%' || peek_at(lexer, 1) != '%') {
-        set_error(MM_ERROR_SYNTAX);
-        return NULL;
+        set_error_at(MM_ERROR_SYNTAX, lexer->input, lexer->pos);
+        return 0;
     }
     
     // Trim trailing whitespace
@@ -281,19 +415,13 @@ static Node* parse_comment(Lexer *lexer) {
     while (end > start && isspace(lexer->input[end - 1])) {
         end--;
     }
-   
-    char *content = read_token_value(lexer, start, end);
-    if (!content) {
-        content = strdup("");  // Create empty string for empty comments
-        if (!content) {
-            set_error(MM_ERROR_MEMORY);
-            return NULL;
-        }
-    }
     
-    printf("Comment content: '%s'\n", content);
-    Node *node = create_node(NODE_COMMENT, content);
-    free(content);
+    // Empty comments still get an (empty) content string
+    MM_TRACE("Comment content: '%.*s'", MM_TRACE_CLAMP(end - start), lexer->input + start);
+    block->type = NODE_COMMENT;
+    block->has_text = 1;
+    block->text_start = start;
+    block->text_end = end;
     
     // Skip %% delimiter
     if (peek(lexer) == '%' && peek_at(lexer, 1) == '%') {
@@ -305,19 +433,20 @@ static Node* parse_comment(Lexer *lexer) {
         next(lexer);
     }
     
-    return node;
+    return 1;
 }
 
 /**
- * @brief Parse a metadata block from the input
+ * @brief Scan a metadata block from the input
  * 
  * @param lexer The lexer instance
- * @return Node* A new metadata node, or NULL on error
+ * @param block Receives the metadata description
+ * @return int 1 if a valid metadata block was found, 0 on error
  * 
  * Metadata blocks are delimited by --- and contain YAML-style key-value pairs.
- * The content is stored as a single string and later parsed by parse_metadata_string.
+ * Every non-empty, non-comment line must contain a colon.
  */
-static Node* parse_metadata(Lexer *lexer) {
+static int scan_metadata(Lexer *lexer, Block *block) {
     // Skip opening ---
     next_token(lexer);
     
@@ -335,122 +464,48 @@ static Node* parse_metadata(Lexer *lexer) {
     // Check if we found the closing delimiter
     if (peek(lexer) != '-' || 
         peek_at(lexer, 1) != '-' || 
-        peek_at(lexer, 2) != '-') {
-        set_error(MM_ERROR_SYNTAX);
-        return NULL;
+        peek_at(lexer, 2) != '-' ||
+        lexer->pos == start) {
+        set_error_at(MM_ERROR_SYNTAX, lexer->input, lexer->pos);
+        return 0;
     }
     
-    char *content = read_token_value(lexer, start, lexer->pos);
-    if (!content) {
-        set_error(MM_ERROR_MEMORY);
-        return NULL;
+    // Validate the lines before accepting the block
+    const char *cursor = lexer->input + start;
+    const char *end = lexer->input + lexer->pos;
+    MetadataSpan pair;
+    int found;
+    while ((found = next_metadata_pair(&cursor, end, &pair)) > 0) {
     }
-    
-    // Create metadata node with original content
-    Node *node = create_node(NODE_METADATA, content);
-    if (!node) {
-        free(content);
-        set_error(MM_ERROR_MEMORY);
-        return NULL;
+    if (found < 0) {
+        // Invalid metadata line - no colon
+        set_error_at(MM_ERROR_SYNTAX, lexer->input, cursor - lexer->input);
+        return 0;
     }
     
-    // Parse metadata content and create child nodes
-    const char *line_start = content;
-    const char *line_end;
-    
-    while (*line_start) {
-        // Find end of line
-        line_end = strchr(line_start, '\n');
-        if (!line_end) {
-            line_end = line_start + strlen(line_start);
-        }
-        
-        // Skip empty lines and comments
-        const char *p = line_start;
-        while (p < line_end && isspace(*p)) p++;
-        
-        if (p < line_end && *p != '#') {
-            // Look for colon
-            const char *colon = memchr(line_start, ':', line_end - line_start);
-            if (!colon) {
-                // Invalid metadata line - no colon
-                free_node(node);
-                set_error(MM_ERROR_SYNTAX);
-                return NULL;
-            }
-            
-            // Extract key
-            size_t key_len = colon - line_start;
-            char *key = malloc(key_len + 1);
-            if (key) {
-                memcpy(key, line_start, key_len);
-                key[key_len] = '\0';
-                
-                // Trim key
-                char *k = key;
-                while (*k && isspace(*k)) k++;
-                char *k_end = key + key_len - 1;
-                while (k_end > k && isspace(*k_end)) k_end--;
-                k_end[1] = '\0';
-                
-                // Extract value
-                const char *v = colon + 1;
-                while (v < line_end && isspace(*v)) v++;
-                size_t value_len = line_end - v;
-                char *value = malloc(value_len + 1);
-                if (value) {
-                    memcpy(value, v, value_len);
-                    value[value_len] = '\0';
-                    
-                    // Trim value
-                    char *v_end = value + value_len - 1;
-                    while (v_end > value && isspace(*v_end)) v_end--;
-                    v_end[1] = '\0';
-                    
-                    // Create child node
-                    char *child_content = malloc(strlen(k) + strlen(value) + 2);
-                    if (child_content) {
-                        sprintf(child_content, "%s:%s", k, value);
-                        Node *child = create_node(NODE_PARAGRAPH, child_content);
-                        if (child) {
-                            add_child(node, child);
-                        }
-                        free(child_content);
-                    }
-                    free(value);
-                }
-                free(key);
-            }
-        }
-        
-        // Move to next line
-        if (*line_end == '\n') {
-            line_start = line_end + 1;
-        } else {
-            break;
-        }
-    }
+    block->type = NODE_METADATA;
+    block->has_text = 1;
+    block->text_start = start;
+    block->text_end = lexer->pos;
     
     // Skip closing ---
-    if (peek_at(lexer, 0) == '-' && 
-        peek_at(lexer, 1) == '-' && 
-        peek_at(lexer, 2) == '-') {
-        lexer->pos += 3;
-    }
-    
-    return node;
+    lexer->pos += 3;
+    return 1;
 }
 
 /**
- * @brief Parse a single node based on the current token
+ * @brief Scan a single block based on the current character
  * 
  * @param lexer The lexer instance
- * @return Node* A new node, or NULL on error
+ * @param block Receives the block description
+ * @return int 1 if a block was found, 0 otherwise
  * 
- * This function determines the type of node to parse based on the current token
- * and delegates to the appropriate parsing function.
+ * This function determines the type of block to scan based on the current
+ * character and delegates to the appropriate scanning function. Scanning
+ * only locates the block; nothing is allocated.
  */
-static Node* parse_node(Lexer *lexer) {
+static int scan_block(Lexer *lexer, Block *block) {
+    memset(block, 0, sizeof(Block));
     char current = peek(lexer);
     
     // Skip empty lines
@@ -467,15 +522,15 @@ static Node* parse_node(Lexer *lexer) {
     
     // Handle different node types based on the current character
     if (current == '#') {
-        return parse_heading(lexer);
+        return scan_heading(lexer, block);
     } else if (current == '[' && peek_at(lexer, 1) == '[') {
-        return parse_component(lexer);
+        return scan_component(lexer, block);
     } else if (current == '>') {
-        return parse_annotation(lexer);
+        return scan_annotation(lexer, block);
     } else if (current == '%' && peek_at(lexer, 1) == '%') {
-        return parse_comment(lexer);
+        return scan_comment(lexer, block);
     } else if (current == '-' && peek_at(lexer, 1) == '-' && peek_at(lexer, 2) == '-') {
-        return parse_metadata(lexer);
+        return scan_metadata(lexer, block);
     } else if (current != '\0') {
         // For text tokens, collect all text until a special token or double newline
         size_t start = lexer->pos;
@@ -498,6 +553,7 @@ static Node* parse_node(Lexer *lexer) {
             } else {
                 consecutive_newlines = 0;
                 next(lexer);
+                skip_plain(lexer);
             }
         }
         
@@ -507,90 +563,520 @@ static Node* parse_node(Lexer *lexer) {
             end--;
         }
         
-        char *content = read_token_value(lexer, start, end);
-        if (content && *content) {  // Only create node if content is not empty
-            Node *node = create_node(NODE_PARAGRAPH, content);
-            free(content);
-            
+        if (end > start) {  // Only produce a block if content is not empty
             // Skip any remaining newlines
             while (peek(lexer) == '\n' || peek(lexer) == '\r') {
                 next(lexer);
             }
             
-            return node;
+            block->type = NODE_PARAGRAPH;
+            block->has_text = 1;
+            block->text_start = start;
+            block->text_end = end;
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+/**
+ * @brief Build the children of a metadata node
+ * 
+ * @param parser The parser state
+ * @param node The metadata node
+ * @param block The scanned metadata block
+ * @param doc The document receiving the pairs, or NULL
+ * 
+ * Each key/value pair becomes a paragraph child holding "key:value" and,
+ * from the same tokenization, an entry of the document metadata.
+ */
+static void build_metadata_children(Parser *parser, Node *node, const Block *block,
+                                    Document *doc) {
+    const char *base = parser->lexer.input;
+    const char *cursor = base + block->text_start;
+    const char *end = base + block->text_end;
+    MetadataSpan pair;
+    
+    while (next_metadata_pair(&cursor, end, &pair) > 0) {
+        if (doc) {
+            add_metadata_n(doc, pair.key, pair.key_length, pair.value, pair.value_length);
+        }
+        
+        size_t length = pair.key_length + pair.value_length + 1;
+        Node *child = create_node_in(parser->arena, NODE_PARAGRAPH, NULL, 0);
+        if (!child) {
+            continue;
+        }
+        
+        child->content = mm_arena_alloc(parser->arena, length + 1);
+        if (!child->content) {
+            free_node(child);
+            continue;
+        }
+        
+        memcpy(child->content, pair.key, pair.key_length);
+        child->content[pair.key_length] = ':';
+        memcpy(child->content + pair.key_length + 1, pair.value, pair.value_length);
+        child->content[length] = '\0';
+        child->offset = pair.key - base;
+        child->length = length;
+        add_child(node, child);
+    }
+}
+
+/**
+ * @brief Build the AST node for a scanned block
+ * 
+ * @param parser The parser state
+ * @param block The scanned block
+ * @return Node* A new node, or NULL on error
+ */
+static Node* build_block(Parser *parser, const Block *block) {
+    return build_block_into(parser, block, NULL);
+}
+
+/**
+ * @brief Build the AST node for a scanned block, filling in frontmatter
+ * 
+ * @param parser The parser state
+ * @param block The scanned block
+ * @param doc The document receiving metadata pairs, or NULL
+ * @return Node* A new node, or NULL on error
+ */
+static Node* build_block_into(Parser *parser, const Block *block, Document *doc) {
+    Node *node = block->has_text
+        ? make_span_node(parser, block->type, block->text_start, block->text_end)
+        : create_node_in(parser->arena, block->type, NULL, 0);
+    if (!node) {
+        set_error(MM_ERROR_MEMORY);
+        return NULL;
+    }
+    
+    node->level = block->level;
+    
+    if (block->has_body && parser->lazy && block->type == NODE_COMPONENT) {
+        node->flags |= MM_NODE_LAZY;
+        node->body_offset = block->body_start;
+        node->body_length = block->body_end - block->body_start;
+    } else if (block->has_body) {
+        Node *content_node = make_span_node(parser, NODE_PARAGRAPH,
+                                            block->body_start, block->body_end);
+        add_child(node, content_node);
+    }
+    
+    if (block->type == NODE_METADATA) {
+        build_metadata_children(parser, node, block, doc);
+    }
+    
+    return node;
+}
+
+/**
+ * @brief Report a scanned block to the event handler
+ * 
+ * @param parser The parser state
+ * @param block The scanned block
+ * @return int 0 to continue, or the nonzero value returned by a callback
+ */
+static int emit_block(Parser *parser, const Block *block) {
+    const MMEventHandler *events = parser->events;
+    void *data = parser->event_data;
+    const char *input = parser->lexer.input;
+    const char *text = block->has_text ? input + block->text_start : NULL;
+    size_t length = block->has_text ? block->text_end - block->text_start : 0;
+    const char *body = block->has_body ? input + block->body_start : NULL;
+    size_t body_length = block->has_body ? block->body_end - block->body_start : 0;
+    int result = 0;
+    
+    switch (block->type) {
+        case NODE_HEADING:
+            if (events->on_heading) {
+                result = events->on_heading(block->level, text, length, data);
+            }
+            break;
+        case NODE_PARAGRAPH:
+            if (events->on_paragraph) {
+                result = events->on_paragraph(text, length, data);
+            }
+            break;
+        case NODE_COMPONENT:
+            if (events->on_component_begin) {
+                result = events->on_component_begin(text, length, data);
+            }
+            if (!result && body && events->on_paragraph) {
+                result = events->on_paragraph(body, body_length, data);
+            }
+            if (!result && events->on_component_end) {
+                result = events->on_component_end(text, length, data);
+            }
+            break;
+        case NODE_ANNOTATION:
+            if (events->on_annotation) {
+                result = events->on_annotation(text, length, body, body_length, data);
+            }
+            break;
+        case NODE_COMMENT:
+            if (events->on_comment) {
+                result = events->on_comment(text, length, data);
+            }
+            break;
+        case NODE_METADATA:
+            if (events->on_metadata_pair) {
+                const char *cursor = text;
+                MetadataSpan pair;
+                while (!result && next_metadata_pair(&cursor, text + length, &pair) > 0) {
+                    result = events->on_metadata_pair(pair.key, pair.key_length,
+                                                      pair.value, pair.value_length, data);
+                }
+            }
+            break;
+        default:
+            break;
+    }
+    
+    return result;
+}
+
+/**
+ * @brief Parse a metadata block from the input
+ * 
+ * @param parser The parser state
+ * @param doc The document receiving the pairs, or NULL
+ * @return Node* A new metadata node, or NULL on error
+ */
+static Node* parse_metadata(Parser *parser, Document *doc) {
+    MMParseStats *stats = mm_active_stats;
+    size_t start = parser->lexer.pos;
+    double begin = stats ? mm_stats_clock() : 0.0;
+    
+    Block block;
+    memset(&block, 0, sizeof(Block));
+    Node *node = NULL;
+    if (scan_metadata(&parser->lexer, &block)) {
+        node = build_block_into(parser, &block, doc);
+    }
+    
+    if (stats) {
+        stats->bytes_scanned += parser->lexer.pos - start;
+        stats->metadata_seconds += mm_stats_clock() - begin;
+    }
+    return node;
+}
+
+/**
+ * @brief Scan a block while collecting statistics
+ * 
+ * Component blocks are charged to component scanning, everything else to
+ * lexing.
+ */
+static int scan_block_counted(Lexer *lexer, Block *block, MMParseStats *stats) {
+    size_t start = lexer->pos;
+    double begin = mm_stats_clock();
+    int found = scan_block(lexer, block);
+    double elapsed = mm_stats_clock() - begin;
+    
+    stats->bytes_scanned += lexer->pos - start;
+    if (found && block->type == NODE_COMPONENT) {
+        stats->component_seconds += elapsed;
+    } else {
+        stats->lex_seconds += elapsed;
+    }
+    return found;
+}
+
+/**
+ * @brief Build a scanned block while collecting statistics
+ */
+static Node* build_block_counted(Parser *parser, const Block *block, MMParseStats *stats) {
+    double begin = mm_stats_clock();
+    Node *node = build_block(parser, block);
+    double elapsed = mm_stats_clock() - begin;
+    
+    if (block->type == NODE_COMPONENT) {
+        stats->component_seconds += elapsed;
+    } else {
+        stats->build_seconds += elapsed;
+    }
+    return node;
+}
+
+/**
+ * @brief Parse a single node based on the current character
+ * 
+ * @param parser The parser state
+ * @return Node* A new node, or NULL on error
+ */
+static Node* parse_node(Parser *parser) {
+    Block block;
+    MMParseStats *stats = mm_active_stats;
+    if (stats) {
+        if (!scan_block_counted(&parser->lexer, &block, stats)) {
+            return NULL;
         }
-        free(content);
+        return build_block_counted(parser, &block, stats);
     }
     
-    return NULL;
+    if (!scan_block(&parser->lexer, &block)) {
+        return NULL;
+    }
+    return build_block(parser, &block);
+}
+
+void parser_init(Parser *parser, const char *input, size_t length,
+                 MMArena *arena, int zero_copy) {
+    lexer_init_n(&parser->lexer, input, length);
+    parser->arena = arena;
+    parser->zero_copy = zero_copy;
+    parser->lazy = 0;
+    parser->events = NULL;
+    parser->event_data = NULL;
+}
+
+int parser_at_metadata(const Parser *parser) {
+    return peek_at(&parser->lexer, 0) == '-' && 
+           peek_at(&parser->lexer, 1) == '-' && 
+           peek_at(&parser->lexer, 2) == '-';
+}
+
+Node* parser_metadata(Parser *parser, Document *doc) {
+    return parse_metadata(parser, doc);
+}
+
+/**
+ * @brief Move past a block the scanner rejected
+ * 
+ * @param lexer The lexer instance
+ * @param start Position the rejected block started at
+ * 
+ * Skips any remaining whitespace or empty lines. A scanner giving up
+ * without consuming anything also loses the rest of its line, so every
+ * failed scan moves forward and hostile input is parsed in linear time.
+ */
+static void skip_rejected(Lexer *lexer, size_t start) {
+    if (lexer->pos == start) {
+        while (peek(lexer) != '\0' && peek(lexer) != '\n') {
+            next(lexer);
+        }
+    }
+    while (isspace(peek(lexer))) {
+        next(lexer);
+    }
+}
+
+Node* parser_step(Parser *parser) {
+    size_t start = parser->lexer.pos;
+    Node *node = parse_node(parser);
+    if (!node) {
+        skip_rejected(&parser->lexer, start);
+    }
+    return node;
+}
+
+/**
+ * @brief Blocks of one parallel build
+ */
+typedef struct {
+    Parser *parser;       ///< Parser over the whole input, only read by workers
+    const Block *blocks;  ///< Scanned top-level blocks, in document order
+    Node **nodes;         ///< Receives the node built for each block
+    size_t count;         ///< Number of blocks
+} BuildJob;
+
+/**
+ * @brief Build one chunk of blocks on a pool worker
+ */
+static int build_chunk(size_t task, size_t worker, void *data) {
+    BuildJob *job = data;
+    size_t start = task * PARSER_PARALLEL_CHUNK;
+    size_t end = start + PARSER_PARALLEL_CHUNK < job->count
+        ? start + PARSER_PARALLEL_CHUNK : job->count;
+    (void)worker;
+    
+    for (size_t i = start; i < end; i++) {
+        job->nodes[i] = build_block(job->parser, &job->blocks[i]);
+    }
+    return 0;
+}
+
+/**
+ * @brief Parse the document content in two phases
+ * 
+ * @param parser The parser, positioned after the frontmatter
+ * @param root The node receiving the top-level nodes
+ * @param threads Number of worker threads, or 0 for one per CPU
+ * @return int 0 on success, -1 if the block list could not grow
+ * 
+ * The first phase runs the scanner serially, which only records block
+ * boundaries. The second builds the blocks on a thread pool, each node
+ * landing in its block's slot, and appends them in document order. Since
+ * scanning alone decides the structure, the tree is identical to the one
+ * the serial loop builds. Arena-backed parses and small documents skip the
+ * pool, as an arena cannot be shared between threads, and so do parses
+ * collecting statistics, which only count work on the calling thread.
+ */
+static int parse_blocks_parallel(Parser *parser, Node *root, size_t threads) {
+    Lexer *lexer = &parser->lexer;
+    MMParseStats *stats = mm_active_stats;
+    Block *blocks = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    
+    // Phase 1: find the block boundaries
+    while (peek(lexer) != '\0') {
+        if (count == capacity) {
+            size_t new_capacity = capacity ? capacity * 2 : 64;
+            Block *new_blocks = safe_realloc(blocks, new_capacity * sizeof(Block));
+            if (!new_blocks) {
+                // A partial block list would silently drop the rest
+                free(blocks);
+                return -1;
+            }
+            blocks = new_blocks;
+            capacity = new_capacity;
+        }
+        
+        size_t start = lexer->pos;
+        int found = stats ? scan_block_counted(lexer, &blocks[count], stats)
+                          : scan_block(lexer, &blocks[count]);
+        if (found) {
+            count++;
+        } else {
+            skip_rejected(lexer, start);
+        }
+    }
+    
+    // Phase 2: build the blocks, in parallel when worthwhile
+    Node **nodes = NULL;
+    if (!parser->arena && !stats && count >= PARSER_PARALLEL_MIN_BLOCKS) {
+        nodes = safe_malloc(count * sizeof(Node*));
+    }
+    
+    BuildJob job = { parser, blocks, nodes, count };
+    size_t tasks = (count + PARSER_PARALLEL_CHUNK - 1) / PARSER_PARALLEL_CHUNK;
+    if (nodes && mm_pool_run(tasks, threads, build_chunk, &job) == 0) {
+        for (size_t i = 0; i < count; i++) {
+            if (!nodes[i]) {
+                // Worker failures are not visible in this thread's context
+                set_error(MM_ERROR_MEMORY);
+                continue;
+            }
+            add_child(root, nodes[i]);
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            add_child(root, stats ? build_block_counted(parser, &blocks[i], stats)
+                                  : build_block(parser, &blocks[i]));
+        }
+    }
+    
+    free(nodes);
+    free(blocks);
+    return 0;
 }
 
 /**
  * @brief Parse a complete MetaMark document
  * 
  * @param input The input text to parse
+ * @param length The length of the input in bytes
+ * @param options Parse options
  * @return Document* A new document structure, or NULL on error
  * 
- * This is the main entry point for parsing MetaMark documents.
+ * Shared implementation behind the parse_metamark*() entry points.
  * It handles both the frontmatter metadata and the document content.
  */
-Document* parse_metamark(const char *input) {
+static Document* parse_document(const char *input, size_t length,
+                                const MMParseOptions *options) {
+    MMArena *arena = options->arena;
+    int zero_copy = (options->flags & MM_PARSE_VIEW) != 0;
+    
     if (!input) {
         set_error(MM_ERROR_INVALID);
         return NULL;
     }
     
+    // Lazy bodies are read from the input, which editing replaces
+    if ((options->flags & MM_PARSE_LAZY) &&
+        (!zero_copy || (options->flags & MM_PARSE_EDITABLE))) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+    
+    // Editable documents own their text, which an arena cannot grow
+    if (options->flags & MM_PARSE_EDITABLE) {
+        if (arena) {
+            set_error(MM_ERROR_INVALID);
+            return NULL;
+        }
+        return parser_parse_editable(input, length, zero_copy);
+    }
+    
+    Parser parser;
+    Lexer *lexer = &parser.lexer;
+    parser_init(&parser, input, length, arena, zero_copy);
+    parser.lazy = (options->flags & MM_PARSE_LAZY) != 0;
+    
     // Skip leading whitespace
-    while (*input && isspace(*input)) {
-        input++;
+    while (isspace((unsigned char)peek(lexer))) {
+        next(lexer);
     }
     
     // Check for empty input
-    if (!*input) {
+    if (peek(lexer) == '\0') {
         set_error(MM_ERROR_SYNTAX);
         return NULL;
     }
     
-    Lexer lexer;
-    lexer_init(&lexer, input);
-    
-    Document *doc = malloc(sizeof(Document));
+    Document *doc = mm_arena_alloc(arena, sizeof(Document));
     if (!doc) {
         set_error(MM_ERROR_MEMORY);
-        lexer_free(&lexer);
+        lexer_free(lexer);
         return NULL;
     }
     
     doc->metadata = NULL;
     doc->metadata_count = 0;
-    doc->root = create_node(NODE_DOCUMENT, NULL);
+    doc->metadata_capacity = 0;
+    doc->metadata_index = NULL;
+    doc->metadata_slots = 0;
+    doc->arena = arena;
+    doc->source = zero_copy ? input : NULL;
+    doc->source_length = zero_copy ? length : 0;
+    doc->mapping = NULL;
+    doc->edit = NULL;
+    doc->root = create_node_in(arena, NODE_DOCUMENT, NULL, 0);
     if (!doc->root) {
         set_error(MM_ERROR_MEMORY);
-        free(doc);
-        lexer_free(&lexer);
+        if (arena) {
+            mm_arena_reset(arena);
+        } else {
+            free(doc);
+        }
+        lexer_free(lexer);
         return NULL;
     }
     
     // Parse metadata if present (delimited by ---)
-    if (peek_at(&lexer, 0) == '-' && 
-        peek_at(&lexer, 1) == '-' && 
-        peek_at(&lexer, 2) == '-') {
-        Node *metadata_node = parse_metadata(&lexer);
+    if (parser_at_metadata(&parser)) {
+        Node *metadata_node = parse_metadata(&parser, doc);
         if (metadata_node) {
             add_child(doc->root, metadata_node);
-            parse_metadata_node(doc, metadata_node);
         }
     }
     
     // Parse document content
-    while (peek(&lexer) != '\0') {
-        Node *node = parse_node(&lexer);
-        if (node) {
-            add_child(doc->root, node);
-        } else {
-            // Skip any remaining whitespace or empty lines
-            while (isspace(peek(&lexer))) {
-                next(&lexer);
+    if (options->flags & MM_PARSE_PARALLEL) {
+        if (parse_blocks_parallel(&parser, doc->root, options->threads) != 0) {
+            free_document(doc);
+            lexer_free(lexer);
+            return NULL;
+        }
+    } else {
+        while (peek(lexer) != '\0') {
+            Node *node = parser_step(&parser);
+            if (node) {
+                add_child(doc->root, node);
             }
         }
     }
@@ -599,10 +1085,159 @@ Document* parse_metamark(const char *input) {
     if (doc->root->child_count == 0) {
         set_error(MM_ERROR_SYNTAX);
         free_document(doc);
-        lexer_free(&lexer);
+        lexer_free(lexer);
         return NULL;
     }
     
-    lexer_free(&lexer);
+    lexer_free(lexer);
     return doc;
-} 
\ No newline at end of file
+}
+
+/**
+ * @brief Parse a complete MetaMark document
+ * 
+ * @param input The input text to parse
+ * @return Document* A new document structure, or NULL on error
+ * 
+ * This is the main entry point for parsing MetaMark documents.
+ * It handles both the frontmatter metadata and the document content.
+ */
+Document* parse_metamark(const char *input) {
+    if (!input) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+    
+    return mm_parse_document(NULL, input, strlen(input), NULL);
+}
+
+/**
+ * @brief Parse a complete MetaMark document into an arena
+ * 
+ * @param input The input text to parse
+ * @param arena The arena backing every allocation of the document
+ * @return Document* A new document structure, or NULL on error
+ */
+Document* parse_metamark_arena(const char *input, MMArena *arena) {
+    if (!input || !arena) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+    
+    MMParseOptions options = { arena, 0, 0 };
+    return mm_parse_document(NULL, input, strlen(input), &options);
+}
+
+/**
+ * @brief Parse a MetaMark document without copying node content
+ * 
+ * @param input The input buffer, which must outlive the document
+ * @param length The length of the input in bytes
+ * @param arena The arena to allocate from, or NULL for the heap
+ * @return Document* A new document structure, or NULL on error
+ */
+Document* parse_metamark_view(const char *input, size_t length, MMArena *arena) {
+    MMParseOptions options = { arena, MM_PARSE_VIEW, 0 };
+    return mm_parse_document(NULL, input, length, &options);
+}
+
+/**
+ * @brief Parse a MetaMark document with an explicit context and options
+ * 
+ * @param ctx Receives the error state of this call, or NULL
+ * @param input The input buffer, which need not be NUL-terminated
+ * @param length The length of the input in bytes
+ * @param options Parse options, or NULL for the defaults
+ * @return Document* A new document structure, or NULL on error
+ * 
+ * Every error raised while parsing, including allocation failures deep in
+ * the AST code, is routed to @p ctx for the duration of the call.
+ */
+Document* mm_parse_document(MMContext *ctx, const char *input, size_t length,
+                            const MMParseOptions *options) {
+    static const MMParseOptions defaults = { NULL, 0, 0 };
+    if (!options) {
+        options = &defaults;
+    }
+    
+    mm_context_init(ctx);
+    MMContext *previous = ctx ? mm_context_enter(ctx) : NULL;
+    Document *doc = parse_document(input, length, options);
+    if (ctx) {
+        mm_context_leave(previous);
+    }
+    return doc;
+}
+
+/**
+ * @brief Parse a MetaMark document into a stream of events
+ * 
+ * @param input The input buffer, which need not be NUL-terminated
+ * @param length The length of the input in bytes
+ * @param handler The callbacks to invoke
+ * @param user_data Pointer handed back to every callback invocation
+ * @return int 0 on success, -1 on error, or a callback's nonzero result
+ * 
+ * Runs the same scanner as parse_metamark(), but reports each block
+ * instead of building it.
+ */
+int mm_parse_events(const char *input, size_t length,
+                    const MMEventHandler *handler, void *user_data) {
+    if (!input || !handler) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+    
+    Parser parser;
+    Lexer *lexer = &parser.lexer;
+    parser_init(&parser, input, length, NULL, 1);
+    parser.events = handler;
+    parser.event_data = user_data;
+    
+    // Skip leading whitespace
+    while (isspace((unsigned char)peek(lexer))) {
+        next(lexer);
+    }
+    
+    // Check for empty input
+    if (peek(lexer) == '\0') {
+        set_error(MM_ERROR_SYNTAX);
+        return -1;
+    }
+    
+    Block block;
+    size_t blocks = 0;
+    int result;
+    
+    // Report metadata if present (delimited by ---)
+    if (parser_at_metadata(&parser)) {
+        memset(&block, 0, sizeof(Block));
+        if (scan_metadata(lexer, &block)) {
+            blocks++;
+            if ((result = emit_block(&parser, &block)) != 0) {
+                return result;
+            }
+        }
+    }
+    
+    // Report document content
+    while (peek(lexer) != '\0') {
+        size_t start = lexer->pos;
+        if (scan_block(lexer, &block)) {
+            blocks++;
+            if ((result = emit_block(&parser, &block)) != 0) {
+                return result;
+            }
+        } else {
+            skip_rejected(lexer, start);
+        }
+    }
+    
+    // Verify document structure
+    if (blocks == 0) {
+        set_error(MM_ERROR_SYNTAX);
+        return -1;
+    }
+    
+    return 0;
+}
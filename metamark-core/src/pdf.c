@@ -0,0 +1,693 @@
+/**
+ * @file pdf.c
+ * @brief PDF rendering of MetaMark documents
+ *
+ * Top-level blocks are broken into lines independently of each other, on
+ * the worker pool, one window of blocks at a time. The calling thread then
+ * places those lines on pages in document order and writes every page as
+ * soon as it is full, so only the current window and page are ever held
+ * in memory. All pages share one resource dictionary naming the standard
+ * fonts, and the cross-reference table is written last from the object
+ * offsets recorded on the way.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+#include "../include/output.h"
+#include "../include/pool.h"
+
+/**
+ * @brief Fonts used by the renderer, all standard Type 1 fonts
+ */
+enum {
+    FONT_REGULAR,
+    FONT_BOLD,
+    FONT_ITALIC,
+    FONT_COUNT
+};
+
+static const char *const font_names[FONT_COUNT] = {
+    "Helvetica", "Helvetica-Bold", "Helvetica-Oblique"
+};
+
+/**
+ * @brief Fixed object numbers; page contents and pages follow in pairs
+ */
+#define OBJECT_CATALOG 1
+#define OBJECT_PAGES 2
+#define OBJECT_RESOURCES 3
+#define OBJECT_FONTS 4
+#define OBJECT_INFO (OBJECT_FONTS + FONT_COUNT)
+#define OBJECT_FIRST_PAGE (OBJECT_INFO + 1)
+
+/**
+ * @brief Top-level blocks laid out per window and worker
+ */
+#define BLOCKS_PER_WORKER 32
+
+#define PARAGRAPH_SIZE 11
+#define LABEL_SIZE 9
+#define ANNOTATION_SIZE 10
+#define BODY_INDENT 18
+
+static const unsigned char heading_sizes[6] = { 22, 18, 15, 13, 12, 11 };
+
+/**
+ * @brief Advance widths of ASCII 32..126 in 1/1000 em (Adobe AFM metrics)
+ */
+static const unsigned short helvetica_widths[95] = {
+    278, 278, 355, 556, 556, 889, 667, 191, 333, 333, 389, 584, 278, 333, 278, 278,
+    556, 556, 556, 556, 556, 556, 556, 556, 556, 556, 278, 278, 584, 584, 584, 556,
+    1015, 667, 667, 722, 722, 667, 611, 778, 722, 278, 500, 667, 556, 833, 722, 778,
+    667, 778, 722, 667, 611, 722, 667, 944, 667, 667, 611, 278, 278, 278, 469, 556,
+    333, 556, 556, 500, 556, 556, 278, 556, 556, 222, 222, 500, 222, 833, 556, 556,
+    556, 556, 333, 500, 278, 556, 500, 722, 500, 500, 500, 334, 260, 334, 584
+};
+
+static const unsigned short helvetica_bold_widths[95] = {
+    278, 333, 474, 556, 556, 889, 722, 238, 333, 333, 389, 584, 278, 333, 278, 278,
+    556, 556, 556, 556, 556, 556, 556, 556, 556, 556, 333, 333, 584, 584, 584, 611,
+    975, 722, 722, 722, 722, 667, 611, 778, 722, 278, 556, 722, 611, 833, 722, 778,
+    667, 778, 722, 667, 611, 722, 667, 944, 667, 667, 611, 333, 278, 333, 584, 556,
+    333, 556, 611, 556, 611, 556, 333, 611, 611, 278, 278, 556, 278, 889, 611, 611,
+    611, 611, 389, 556, 333, 611, 556, 778, 556, 556, 500, 389, 280, 389, 584
+};
+
+/**
+ * @brief Width of a WinAnsi byte in 1/1000 em
+ */
+static unsigned glyph_width(int font, unsigned char c) {
+    if (c < 32 || c > 126) {
+        return 556;
+    }
+    return font == FONT_BOLD ? helvetica_bold_widths[c - 32] : helvetica_widths[c - 32];
+}
+
+/**
+ * @brief One laid-out line; its text is escaped for a PDF string
+ */
+typedef struct {
+    unsigned char font;   ///< FONT_* index
+    unsigned char size;   ///< Font size in points
+    unsigned indent;      ///< Indent from the left margin in points
+    size_t start;         ///< Offset of the text in the block buffer
+    size_t length;        ///< Length of the text
+} PdfLine;
+
+/**
+ * @brief The lines of one top-level block
+ */
+typedef struct {
+    PdfLine *lines;        ///< Lines in order
+    size_t count;          ///< Number of lines
+    size_t capacity;       ///< Allocated lines
+    char *text;            ///< Escaped text of all lines
+    size_t length;         ///< Bytes used in text
+    size_t text_capacity;  ///< Allocated size of text
+    unsigned space_before; ///< Gap above the block in tenths of a point
+    int failed;            ///< Set when an allocation failed
+} PdfBlock;
+
+/**
+ * @brief State shared by the layout workers of one window
+ */
+typedef struct {
+    const Document *doc;  ///< The document being rendered
+    Node **nodes;         ///< First top-level node of the window
+    PdfBlock *blocks;     ///< One block per node of the window
+    unsigned width;       ///< Width available to text in points
+} LayoutJob;
+
+static int block_reserve_text(PdfBlock *block, size_t length) {
+    if (block->text_capacity - block->length >= length) {
+        return 0;
+    }
+    size_t capacity = block->text_capacity ? block->text_capacity : 256;
+    while (capacity - block->length < length) {
+        capacity *= 2;
+    }
+    char *text = realloc(block->text, capacity);
+    if (!text) {
+        block->failed = 1;
+        return -1;
+    }
+    block->text = text;
+    block->text_capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Append a line, escaping the backslash and parentheses
+ */
+static void block_add_line(PdfBlock *block, const unsigned char *text, size_t length,
+                           int font, unsigned size, unsigned indent) {
+    if (block->count == block->capacity) {
+        size_t capacity = block->capacity ? block->capacity * 2 : 8;
+        PdfLine *lines = realloc(block->lines, capacity * sizeof(PdfLine));
+        if (!lines) {
+            block->failed = 1;
+            return;
+        }
+        block->lines = lines;
+        block->capacity = capacity;
+    }
+    if (block_reserve_text(block, length * 2) != 0) {
+        return;
+    }
+
+    PdfLine *line = &block->lines[block->count++];
+    line->font = (unsigned char)font;
+    line->size = (unsigned char)size;
+    line->indent = indent;
+    line->start = block->length;
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] == '(' || text[i] == ')' || text[i] == '\\') {
+            block->text[block->length++] = '\\';
+        }
+        block->text[block->length++] = (char)text[i];
+    }
+    line->length = block->length - line->start;
+}
+
+/**
+ * @brief WinAnsi byte for the punctuation Unicode places outside Latin-1
+ */
+static unsigned char winansi_punctuation(unsigned long code) {
+    switch (code) {
+        case 0x20ac: return 0x80;
+        case 0x2026: return 0x85;
+        case 0x2018: return 0x91;
+        case 0x2019: return 0x92;
+        case 0x201c: return 0x93;
+        case 0x201d: return 0x94;
+        case 0x2022: return 0x95;
+        case 0x2013: return 0x96;
+        case 0x2014: return 0x97;
+        default: return '?';
+    }
+}
+
+/**
+ * @brief Convert UTF-8 to the WinAnsi encoding of the standard fonts
+ *
+ * @return size_t The converted length, never more than @p length
+ *
+ * Control characters become spaces, so line breaks in the source join
+ * words like any other whitespace. Characters WinAnsi lacks become '?'.
+ */
+static size_t to_winansi(const char *text, size_t length, unsigned char *out) {
+    const unsigned char *in = (const unsigned char *)text;
+    size_t n = 0;
+    for (size_t i = 0; i < length;) {
+        unsigned char c = in[i];
+        if (c < 0x80) {
+            out[n++] = c < 32 || c == 127 ? ' ' : c;
+            i++;
+            continue;
+        }
+
+        size_t extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+        unsigned long code = c & (0x3f >> extra);
+        size_t j = 1;
+        for (; j <= extra && i + j < length && (in[i + j] & 0xc0) == 0x80; j++) {
+            code = code << 6 | (in[i + j] & 0x3f);
+        }
+        if (extra == 0 || j <= extra) {
+            out[n++] = '?';
+            i += j;
+            continue;
+        }
+        out[n++] = code >= 0xa0 && code <= 0xff ? (unsigned char)code : winansi_punctuation(code);
+        i += j;
+    }
+    return n;
+}
+
+/**
+ * @brief Break text into lines no wider than the available width
+ */
+static void layout_text(PdfBlock *block, const char *text, size_t length, int font,
+                        unsigned size, unsigned indent, unsigned width) {
+    if (!text || length == 0 || indent >= width) {
+        return;
+    }
+    unsigned char *s = malloc(length);
+    if (!s) {
+        block->failed = 1;
+        return;
+    }
+    size_t n = to_winansi(text, length, s);
+
+    // Widths are compared in 1/1000 em of the font size
+    unsigned long limit = (unsigned long)(width - indent) * 1000 / size;
+    size_t start = 0;
+    while (start < n && !block->failed) {
+        while (start < n && s[start] == ' ') {
+            start++;
+        }
+        if (start == n) {
+            break;
+        }
+
+        unsigned long line_width = 0;
+        size_t fit = start;
+        size_t i = start;
+        while (i < n) {
+            line_width += glyph_width(font, s[i]);
+            if (line_width > limit && i > start) {
+                break;
+            }
+            i++;
+            if (i == n || s[i] == ' ') {
+                fit = i;
+            }
+        }
+
+        // Break after the last word that fits, or inside a word too long
+        // for a line of its own
+        size_t end = i == n ? n : fit > start ? fit : i;
+        size_t trimmed = end;
+        while (trimmed > start && s[trimmed - 1] == ' ') {
+            trimmed--;
+        }
+        block_add_line(block, s + start, trimmed - start, font, size, indent);
+        start = end;
+    }
+    free(s);
+}
+
+static void layout_node_text(PdfBlock *block, const Document *doc, const Node *node,
+                             int font, unsigned size, unsigned indent, unsigned width) {
+    size_t length;
+    const char *text = mm_node_text(doc, node, &length);
+    layout_text(block, text, length, font, size, indent, width);
+}
+
+/**
+ * @brief Lay out a subtree; component and annotation bodies are indented
+ * below their label, and everything inside an annotation is italic
+ */
+static void layout_node(PdfBlock *block, const Document *doc, const Node *root,
+                        int font, unsigned indent, unsigned width) {
+    size_t nesting = 0;
+    size_t annotations = 0;
+    MMWalker walker;
+    MMVisit visit;
+    const Node *node;
+    mm_walker_init(&walker, root, MM_WALK_ENTER | MM_WALK_LEAVE | MM_WALK_LAZY);
+    while ((node = mm_walker_next(&walker, &visit))) {
+        int annotation = node->type == NODE_ANNOTATION;
+        if (visit.leaving) {
+            if (annotation || node->type == NODE_COMPONENT) {
+                nesting--;
+                annotations -= annotation;
+            }
+            continue;
+        }
+
+        unsigned at = indent + (unsigned)nesting * BODY_INDENT;
+        int body_font = annotations > 0 ? FONT_ITALIC : font;
+        switch (node->type) {
+            case NODE_HEADING: {
+                size_t level = node->level < 1 ? 1 : node->level > 6 ? 6 : node->level;
+                unsigned size = heading_sizes[level - 1];
+                if (block->count == 0) {
+                    block->space_before = size * 8;
+                }
+                layout_node_text(block, doc, node, FONT_BOLD, size, at, width);
+                mm_walker_skip(&walker);
+                break;
+            }
+            case NODE_PARAGRAPH:
+                layout_node_text(block, doc, node, body_font,
+                                 body_font == FONT_ITALIC ? ANNOTATION_SIZE : PARAGRAPH_SIZE, at, width);
+                mm_walker_skip(&walker);
+                break;
+            case NODE_COMPONENT:
+            case NODE_ANNOTATION:
+                layout_node_text(block, doc, node, annotation ? FONT_ITALIC : FONT_BOLD,
+                                 LABEL_SIZE, at, width);
+                nesting++;
+                annotations += annotation;
+                break;
+            case NODE_SECURE:
+                // Encrypted content is never rendered
+                layout_text(block, "[secure]", 8, FONT_ITALIC, LABEL_SIZE, at, width);
+                mm_walker_skip(&walker);
+                break;
+            case NODE_METADATA:
+            case NODE_COMMENT:
+                mm_walker_skip(&walker);
+                break;
+            default:
+                break;
+        }
+    }
+    if (mm_walker_finish(&walker) != 0) {
+        block->failed = 1;
+    }
+}
+
+static int layout_task(size_t task, size_t worker, void *data) {
+    LayoutJob *job = data;
+    PdfBlock *block = &job->blocks[task];
+    (void)worker;
+    block->space_before = PARAGRAPH_SIZE * 6;
+    layout_node(block, job->doc, job->nodes[task], FONT_REGULAR, 0, job->width);
+    return block->failed ? -1 : 0;
+}
+
+static void free_blocks(PdfBlock *blocks, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(blocks[i].lines);
+        free(blocks[i].text);
+    }
+    memset(blocks, 0, count * sizeof(PdfBlock));
+}
+
+/**
+ * @brief Output state: the file so far and the object offsets
+ */
+typedef struct {
+    MMOutput out;          ///< Buffered output
+    MMWriteFn write;       ///< The caller's sink
+    void *user_data;       ///< Passed to the sink
+    size_t flushed;        ///< Bytes already handed to the sink
+    size_t *offsets;       ///< File offset of every object, by number
+    size_t objects;        ///< Highest object number plus one
+    size_t capacity;       ///< Allocated offsets
+    MMOutput page;         ///< Content stream of the current page
+    size_t pages;          ///< Pages written so far
+    long y;                ///< Baseline position on the page, in tenths of a point
+    int font;              ///< Font selected in the content stream, or -1
+    unsigned size;         ///< Size selected in the content stream
+    unsigned width;        ///< Page width in points
+    unsigned height;       ///< Page height in points
+    unsigned margin;       ///< Margin in points
+} PdfWriter;
+
+static int count_and_write(const char *data, size_t length, void *user_data) {
+    PdfWriter *writer = user_data;
+    writer->flushed += length;
+    return writer->write(data, length, writer->user_data);
+}
+
+static void write_number(MMOutput *out, unsigned long value) {
+    char digits[24];
+    int length = snprintf(digits, sizeof(digits), "%lu", value);
+    mm_output_write(out, digits, (size_t)length);
+}
+
+/**
+ * @brief Write a length in tenths of a point as a decimal
+ */
+static void write_tenths(MMOutput *out, long value) {
+    if (value < 0) {
+        mm_output_char(out, '-');
+        value = -value;
+    }
+    write_number(out, (unsigned long)value / 10);
+    if (value % 10) {
+        mm_output_char(out, '.');
+        mm_output_char(out, (char)('0' + value % 10));
+    }
+}
+
+static void begin_object(PdfWriter *writer, size_t number) {
+    if (number >= writer->capacity) {
+        size_t capacity = writer->capacity * 2;
+        while (capacity <= number) {
+            capacity *= 2;
+        }
+        size_t *offsets = realloc(writer->offsets, capacity * sizeof(size_t));
+        if (!offsets) {
+            writer->out.result = -1;
+            return;
+        }
+        writer->offsets = offsets;
+        writer->capacity = capacity;
+    }
+    writer->offsets[number] = writer->flushed + writer->out.length;
+    if (number >= writer->objects) {
+        writer->objects = number + 1;
+    }
+    write_number(&writer->out, number);
+    mm_output_puts(&writer->out, " 0 obj\n");
+}
+
+static void end_object(PdfWriter *writer) {
+    mm_output_puts(&writer->out, "endobj\n");
+}
+
+static void write_string(MMOutput *out, const char *text) {
+    size_t length = strlen(text);
+    unsigned char *converted = malloc(length + 1);
+    if (!converted) {
+        out->result = -1;
+        return;
+    }
+    length = to_winansi(text, length, converted);
+    mm_output_char(out, '(');
+    for (size_t i = 0; i < length; i++) {
+        if (converted[i] == '(' || converted[i] == ')' || converted[i] == '\\') {
+            mm_output_char(out, '\\');
+        }
+        mm_output_char(out, (char)converted[i]);
+    }
+    mm_output_char(out, ')');
+    free(converted);
+}
+
+static void write_header(PdfWriter *writer, const Document *doc) {
+    MMOutput *out = &writer->out;
+    mm_output_puts(out, "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n");
+
+    // One resource dictionary and one object per font serve every page
+    begin_object(writer, OBJECT_RESOURCES);
+    mm_output_puts(out, "<< /Font <<");
+    for (int i = 0; i < FONT_COUNT; i++) {
+        mm_output_puts(out, " /F");
+        write_number(out, (unsigned long)i + 1);
+        mm_output_char(out, ' ');
+        write_number(out, (unsigned long)(OBJECT_FONTS + i));
+        mm_output_puts(out, " 0 R");
+    }
+    mm_output_puts(out, " >> >>\n");
+    end_object(writer);
+
+    for (int i = 0; i < FONT_COUNT; i++) {
+        begin_object(writer, (size_t)(OBJECT_FONTS + i));
+        mm_output_puts(out, "<< /Type /Font /Subtype /Type1 /BaseFont /");
+        mm_output_puts(out, font_names[i]);
+        mm_output_puts(out, " /Encoding /WinAnsiEncoding >>\n");
+        end_object(writer);
+    }
+
+    const char *title = get_metadata(doc, "title");
+    begin_object(writer, OBJECT_INFO);
+    mm_output_puts(out, "<< /Producer (MetaMark)");
+    if (title) {
+        mm_output_puts(out, " /Title ");
+        write_string(out, title);
+    }
+    mm_output_puts(out, " >>\n");
+    end_object(writer);
+}
+
+static void start_page(PdfWriter *writer) {
+    writer->page.length = 0;
+    writer->y = (long)(writer->height - writer->margin) * 10;
+    writer->font = -1;
+}
+
+/**
+ * @brief Write the current page as a content stream and a page object
+ */
+static void finish_page(PdfWriter *writer) {
+    MMOutput *out = &writer->out;
+    size_t contents = OBJECT_FIRST_PAGE + writer->pages * 2;
+    if (writer->page.length > 0) {
+        mm_output_puts(&writer->page, "ET\n");
+    }
+
+    begin_object(writer, contents);
+    mm_output_puts(out, "<< /Length ");
+    write_number(out, writer->page.length);
+    mm_output_puts(out, " >>\nstream\n");
+    mm_output_write(out, writer->page.data, writer->page.length);
+    mm_output_puts(out, "endstream\n");
+    end_object(writer);
+
+    begin_object(writer, contents + 1);
+    mm_output_puts(out, "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 ");
+    write_number(out, writer->width);
+    mm_output_char(out, ' ');
+    write_number(out, writer->height);
+    mm_output_puts(out, "] /Resources 3 0 R /Contents ");
+    write_number(out, contents);
+    mm_output_puts(out, " 0 R >>\n");
+    end_object(writer);
+
+    if (writer->page.result != 0) {
+        out->result = writer->page.result;
+    }
+    writer->pages++;
+    start_page(writer);
+}
+
+/**
+ * @brief Place the lines of a block below the previous one
+ */
+static void place_block(PdfWriter *writer, const PdfBlock *block) {
+    long bottom = (long)writer->margin * 10;
+    long top = (long)(writer->height - writer->margin) * 10;
+    MMOutput *page = &writer->page;
+
+    for (size_t i = 0; i < block->count && writer->out.result == 0; i++) {
+        const PdfLine *line = &block->lines[i];
+        long leading = (long)line->size * 13;
+        long gap = i == 0 && writer->y < top ? (long)block->space_before : 0;
+        if (writer->y - gap - leading < bottom && writer->y < top) {
+            finish_page(writer);
+            gap = 0;
+        }
+        writer->y -= gap + leading;
+
+        if (page->length == 0) {
+            mm_output_puts(page, "BT\n");
+        }
+        if (line->font != writer->font || line->size != writer->size) {
+            mm_output_puts(page, "/F");
+            write_number(page, (unsigned long)line->font + 1);
+            mm_output_char(page, ' ');
+            write_number(page, line->size);
+            mm_output_puts(page, " Tf\n");
+            writer->font = line->font;
+            writer->size = line->size;
+        }
+        mm_output_puts(page, "1 0 0 1 ");
+        write_number(page, writer->margin + line->indent);
+        mm_output_char(page, ' ');
+        write_tenths(page, writer->y);
+        mm_output_puts(page, " Tm (");
+        mm_output_write(page, block->text + line->start, line->length);
+        mm_output_puts(page, ") Tj\n");
+    }
+}
+
+static void write_trailer(PdfWriter *writer) {
+    MMOutput *out = &writer->out;
+    begin_object(writer, OBJECT_PAGES);
+    mm_output_puts(out, "<< /Type /Pages /Count ");
+    write_number(out, writer->pages);
+    mm_output_puts(out, " /Kids [");
+    for (size_t i = 0; i < writer->pages; i++) {
+        mm_output_char(out, ' ');
+        write_number(out, OBJECT_FIRST_PAGE + i * 2 + 1);
+        mm_output_puts(out, " 0 R");
+    }
+    mm_output_puts(out, " ] >>\n");
+    end_object(writer);
+
+    begin_object(writer, OBJECT_CATALOG);
+    mm_output_puts(out, "<< /Type /Catalog /Pages 2 0 R >>\n");
+    end_object(writer);
+    if (out->result != 0) {
+        return;
+    }
+
+    size_t xref = writer->flushed + out->length;
+    mm_output_puts(out, "xref\n0 ");
+    write_number(out, writer->objects);
+    mm_output_puts(out, "\n0000000000 65535 f \n");
+    for (size_t i = 1; i < writer->objects; i++) {
+        char entry[24];
+        snprintf(entry, sizeof(entry), "%010lu 00000 n \n", (unsigned long)writer->offsets[i]);
+        mm_output_write(out, entry, 20);
+    }
+    mm_output_puts(out, "trailer\n<< /Size ");
+    write_number(out, writer->objects);
+    mm_output_puts(out, " /Root 1 0 R /Info ");
+    write_number(out, OBJECT_INFO);
+    mm_output_puts(out, " 0 R >>\nstartxref\n");
+    write_number(out, xref);
+    mm_output_puts(out, "\n%%EOF\n");
+}
+
+int mm_render_pdf(const Document *doc, const MMPdfOptions *options, MMWriteFn write,
+                  void *user_data) {
+    MMPdfOptions defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    if (!options) {
+        options = &defaults;
+    }
+    unsigned width = options->page_width ? options->page_width : 595;
+    unsigned height = options->page_height ? options->page_height : 842;
+    unsigned margin = options->margin ? options->margin : 72;
+    if (!doc || !doc->root || !write || margin * 2 + 72 > width || margin * 2 + 72 > height) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    const Node *root = doc->root;
+    size_t workers = mm_pool_workers(root->child_count, options->threads);
+    size_t window = workers * BLOCKS_PER_WORKER;
+    PdfBlock *blocks = calloc(window, sizeof(PdfBlock));
+
+    PdfWriter writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.write = write;
+    writer.user_data = user_data;
+    writer.width = width;
+    writer.height = height;
+    writer.margin = margin;
+    writer.capacity = 64;
+    writer.offsets = malloc(writer.capacity * sizeof(size_t));
+    int ready = blocks && writer.offsets && mm_output_init_string(&writer.page, 4096) == 0;
+    if (!ready || mm_output_init_sink(&writer.out, count_and_write, &writer) != 0) {
+        if (ready) {
+            mm_output_finish(&writer.page, NULL);
+        }
+        free(writer.offsets);
+        free(blocks);
+        set_error(MM_ERROR_MEMORY);
+        return -1;
+    }
+
+    write_header(&writer, doc);
+    start_page(&writer);
+
+    int failed = 0;
+    for (size_t first = 0; first < root->child_count && !failed && writer.out.result == 0;
+         first += window) {
+        size_t count = root->child_count - first < window ? root->child_count - first : window;
+        LayoutJob job = { doc, root->children + first, blocks, width - margin * 2 };
+        failed = mm_pool_run(count, workers, layout_task, &job) != 0;
+        for (size_t i = 0; i < count && !failed; i++) {
+            place_block(&writer, &blocks[i]);
+        }
+        free_blocks(blocks, count);
+    }
+
+    // A document without content still gets one empty page
+    if (!failed && (writer.pages == 0 || writer.page.length > 0)) {
+        finish_page(&writer);
+    }
+    if (!failed) {
+        write_trailer(&writer);
+    }
+
+    char *page = mm_output_finish(&writer.page, NULL);
+    free(page);
+    mm_output_finish(&writer.out, NULL);
+    free(writer.offsets);
+    free(blocks);
+    if (failed) {
+        set_error(MM_ERROR_MEMORY);
+        return -1;
+    }
+    return writer.out.result;
+}
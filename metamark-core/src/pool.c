@@ -0,0 +1,189 @@
+/**
+ * @file pool.c
+ * @brief Work-stealing task pool
+ *
+ * Tasks are plain indices, so a worker's queue is just a range [next, end).
+ * The owner pops from the front and thieves split off the back half under
+ * the owner's lock. Ranges only ever shrink, so a worker may stop as soon
+ * as one sweep finds every range empty: whatever is still in flight is
+ * already owned by the worker that stole it.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+#include "../include/thread.h"
+#include "../include/pool.h"
+
+/**
+ * @brief Queue of one worker
+ */
+typedef struct {
+    mm_mutex_t lock; ///< Guards next and end
+    size_t next;     ///< Next task to run
+    size_t end;      ///< One past the last task of the range
+} WorkerQueue;
+
+typedef struct Pool Pool;
+
+/**
+ * @brief Argument of a worker thread
+ */
+typedef struct {
+    Pool *pool;    ///< The pool the worker belongs to
+    size_t index;  ///< Worker index
+} WorkerArg;
+
+struct Pool {
+    WorkerQueue *queues;  ///< One queue per worker
+    size_t workers;       ///< Number of workers
+    MMPoolTask task;      ///< Function run for every task
+    void *user_data;      ///< Passed to every task
+    mm_mutex_t lock;      ///< Guards result
+    int result;           ///< First nonzero task result
+};
+
+/**
+ * @brief Take the next task of a worker's own range
+ *
+ * @return int 1 if a task was taken, 0 if the range is empty
+ */
+static int pool_pop(WorkerQueue *queue, size_t *task) {
+    int found = 0;
+    mm_mutex_lock(&queue->lock);
+    if (queue->next < queue->end) {
+        *task = queue->next++;
+        found = 1;
+    }
+    mm_mutex_unlock(&queue->lock);
+    return found;
+}
+
+/**
+ * @brief Move the back half of another worker's range to this worker
+ *
+ * @return int 1 if a task was stolen, 0 if every other range is empty
+ */
+static int pool_steal(Pool *pool, size_t self, size_t *task) {
+    for (size_t i = 1; i < pool->workers; i++) {
+        WorkerQueue *victim = &pool->queues[(self + i) % pool->workers];
+        size_t start = 0, end = 0;
+
+        mm_mutex_lock(&victim->lock);
+        size_t remaining = victim->end - victim->next;
+        if (remaining > 0) {
+            end = victim->end;
+            start = end - (remaining + 1) / 2;
+            victim->end = start;
+        }
+        mm_mutex_unlock(&victim->lock);
+
+        if (end > start) {
+            // Keep the first stolen task, queue the rest for ourselves
+            WorkerQueue *own = &pool->queues[self];
+            mm_mutex_lock(&own->lock);
+            own->next = start + 1;
+            own->end = end;
+            mm_mutex_unlock(&own->lock);
+            *task = start;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int pool_stopped(Pool *pool) {
+    mm_mutex_lock(&pool->lock);
+    int stopped = pool->result != 0;
+    mm_mutex_unlock(&pool->lock);
+    return stopped;
+}
+
+static void pool_worker(void *arg) {
+    WorkerArg *worker = arg;
+    Pool *pool = worker->pool;
+    size_t task;
+
+    while (!pool_stopped(pool) &&
+           (pool_pop(&pool->queues[worker->index], &task) ||
+            pool_steal(pool, worker->index, &task))) {
+        int result = pool->task(task, worker->index, pool->user_data);
+        if (result != 0) {
+            mm_mutex_lock(&pool->lock);
+            if (pool->result == 0) {
+                pool->result = result;
+            }
+            mm_mutex_unlock(&pool->lock);
+        }
+    }
+}
+
+size_t mm_pool_workers(size_t count, size_t threads) {
+    if (threads == 0) {
+        threads = mm_cpu_count();
+    }
+    if (threads > count) {
+        threads = count;
+    }
+    return threads ? threads : 1;
+}
+
+int mm_pool_run(size_t count, size_t threads, MMPoolTask task, void *user_data) {
+    if (!task) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    Pool pool;
+    pool.workers = mm_pool_workers(count, threads);
+    pool.task = task;
+    pool.user_data = user_data;
+    pool.result = 0;
+    pool.queues = safe_malloc(pool.workers * sizeof(WorkerQueue));
+    WorkerArg *args = safe_malloc(pool.workers * sizeof(WorkerArg));
+    mm_thread_t *handles = safe_malloc(pool.workers * sizeof(mm_thread_t));
+    unsigned char *started = calloc(pool.workers, 1);
+    if (!pool.queues || !args || !handles || !started) {
+        set_error(MM_ERROR_MEMORY);
+        free(pool.queues);
+        free(args);
+        free(handles);
+        free(started);
+        return -1;
+    }
+
+    // Split the tasks evenly; stealing rebalances uneven costs
+    mm_mutex_init(&pool.lock);
+    for (size_t i = 0; i < pool.workers; i++) {
+        mm_mutex_init(&pool.queues[i].lock);
+        pool.queues[i].next = count * i / pool.workers;
+        pool.queues[i].end = count * (i + 1) / pool.workers;
+        args[i].pool = &pool;
+        args[i].index = i;
+    }
+
+    // A worker that fails to start just leaves its range to the thieves
+    for (size_t i = 1; i < pool.workers; i++) {
+        started[i] = mm_thread_create(&handles[i], pool_worker, &args[i]) == 0;
+    }
+    pool_worker(&args[0]);
+    for (size_t i = 1; i < pool.workers; i++) {
+        if (started[i]) {
+            mm_thread_join(handles[i]);
+        }
+    }
+
+    for (size_t i = 0; i < pool.workers; i++) {
+        mm_mutex_destroy(&pool.queues[i].lock);
+    }
+    mm_mutex_destroy(&pool.lock);
+    free(pool.queues);
+    free(args);
+    free(handles);
+    free(started);
+    return pool.result;
+}
@@ -0,0 +1,416 @@
+/**
+ * @file reparse.c
+ * @brief Incremental reparsing of editable documents
+ *
+ * Between two iterations the top-level parse loop carries no state but
+ * the lexer position, and no block looks more than PARSER_LOOKAHEAD bytes
+ * past its end. So a block ending that far before an edit is unaffected,
+ * and once a new block ends where an old block ended after the edit, the
+ * rest of the old tree is exactly what parsing would produce again. An
+ * editable document records where every top-level block ends so both
+ * points can be found.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+#include "../include/parser.h"
+
+struct MMEditState {
+    char *source;          ///< Private copy of the current text
+    size_t length;         ///< Length of the text in bytes
+    size_t capacity;       ///< Allocated size of source
+    size_t content_start;  ///< Where the content after the frontmatter begins
+    size_t first_content;  ///< Index of the first non-frontmatter root child
+    size_t *ends;          ///< End offset of the block of each root child
+    size_t end_capacity;   ///< Allocated entries in ends
+    int zero_copy;         ///< Nonzero when nodes reference source
+};
+
+/**
+ * @brief Top-level nodes and block ends produced by one parse run
+ */
+typedef struct {
+    Node **nodes;     ///< New top-level nodes
+    size_t *ends;     ///< End offset of each node's block
+    size_t count;     ///< Number of nodes
+    size_t capacity;  ///< Allocated entries in both arrays
+} BlockRun;
+
+static int run_push(BlockRun *run, Node *node, size_t end) {
+    if (run->count == run->capacity) {
+        size_t new_capacity = run->capacity ? run->capacity * 2 : 16;
+        Node **nodes = safe_realloc(run->nodes, new_capacity * sizeof(Node*));
+        if (!nodes) {
+            return -1;
+        }
+        run->nodes = nodes;
+        size_t *ends = safe_realloc(run->ends, new_capacity * sizeof(size_t));
+        if (!ends) {
+            return -1;
+        }
+        run->ends = ends;
+        run->capacity = new_capacity;
+    }
+
+    run->nodes[run->count] = node;
+    run->ends[run->count] = end;
+    run->count++;
+    return 0;
+}
+
+static void run_free(BlockRun *run) {
+    free(run->nodes);
+    free(run->ends);
+}
+
+/**
+ * @brief Find the root child whose block ends at an offset
+ *
+ * @return size_t The child index, or doc->root->child_count if none does
+ */
+static size_t find_end(const Document *doc, size_t first, size_t end) {
+    const MMEditState *edit = doc->edit;
+    size_t lo = first;
+    size_t hi = doc->root->child_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (edit->ends[mid] < end) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo < doc->root->child_count && edit->ends[lo] == end
+        ? lo : doc->root->child_count;
+}
+
+/**
+ * @brief Make room for count root children and block ends
+ *
+ * @return int 0 on success, -1 on error
+ */
+static int reserve_children(Document *doc, size_t count) {
+    MMEditState *edit = doc->edit;
+    Node *root = doc->root;
+
+    if (count > root->child_capacity) {
+        Node **children = safe_realloc(root->children, count * sizeof(Node*));
+        if (!children) {
+            return -1;
+        }
+        root->children = children;
+        root->child_capacity = count;
+    }
+    if (count > edit->end_capacity) {
+        size_t *ends = safe_realloc(edit->ends, count * sizeof(size_t));
+        if (!ends) {
+            return -1;
+        }
+        edit->ends = ends;
+        edit->end_capacity = count;
+    }
+    return 0;
+}
+
+/**
+ * @brief Replace root children [first, first + removed) with a run of nodes
+ *
+ * The caller reserves room for the resulting children first, so the
+ * splice itself cannot fail.
+ */
+static void splice_children(Document *doc, size_t first, size_t removed, const BlockRun *run) {
+    MMEditState *edit = doc->edit;
+    Node *root = doc->root;
+    size_t tail = root->child_count - first - removed;
+
+    for (size_t i = first; i < first + removed; i++) {
+        free_node(root->children[i]);
+    }
+
+    if (tail) {
+        memmove(root->children + first + run->count, root->children + first + removed,
+                tail * sizeof(Node*));
+        memmove(edit->ends + first + run->count, edit->ends + first + removed,
+                tail * sizeof(size_t));
+    }
+    if (run->count) {
+        memcpy(root->children + first, run->nodes, run->count * sizeof(Node*));
+        memcpy(edit->ends + first, run->ends, run->count * sizeof(size_t));
+    }
+    root->child_count = first + run->count + tail;
+}
+
+static void run_discard(BlockRun *run) {
+    for (size_t i = 0; i < run->count; i++) {
+        free_node(run->nodes[i]);
+    }
+    run_free(run);
+}
+
+/**
+ * @brief Parse the whole text again, frontmatter included
+ *
+ * @return int 0 on success, or -1 with the tree and metadata unchanged
+ */
+static int rebuild(Document *doc) {
+    MMEditState *edit = doc->edit;
+    Parser parser;
+    Lexer *lexer = &parser.lexer;
+    BlockRun run = {0};
+    parser_init(&parser, edit->source, edit->length, NULL, edit->zero_copy);
+
+    // Skip leading whitespace
+    while (isspace((unsigned char)peek(lexer))) {
+        next(lexer);
+    }
+
+    // Parse the new metadata aside, keeping the old until the end
+    Document old = *doc;
+    doc->metadata = NULL;
+    doc->metadata_count = 0;
+    doc->metadata_capacity = 0;
+    doc->metadata_index = NULL;
+    doc->metadata_slots = 0;
+    int result = 0;
+
+    // Parse metadata if present (delimited by ---)
+    if (parser_at_metadata(&parser)) {
+        Node *metadata_node = parser_metadata(&parser, doc);
+        if (metadata_node && run_push(&run, metadata_node, lexer->pos) != 0) {
+            free_node(metadata_node);
+            result = -1;
+        }
+    }
+    size_t content_start = lexer->pos;
+    size_t first_content = run.count;
+
+    // Parse document content
+    while (result == 0 && peek(lexer) != '\0') {
+        Node *node = parser_step(&parser);
+        if (node && run_push(&run, node, lexer->pos) != 0) {
+            free_node(node);
+            result = -1;
+        }
+    }
+    lexer_free(lexer);
+
+    if (result == 0) {
+        result = reserve_children(doc, run.count);
+    }
+    if (result != 0) {
+        run_discard(&run);
+        clear_metadata(doc);
+        doc->metadata = old.metadata;
+        doc->metadata_count = old.metadata_count;
+        doc->metadata_capacity = old.metadata_capacity;
+        doc->metadata_index = old.metadata_index;
+        doc->metadata_slots = old.metadata_slots;
+        return -1;
+    }
+
+    clear_metadata(&old);
+    edit->content_start = content_start;
+    edit->first_content = first_content;
+    splice_children(doc, 0, doc->root->child_count, &run);
+    run_free(&run);
+    return 0;
+}
+
+/**
+ * @brief Replace bytes of the private source copy
+ *
+ * @return int 0 on success, -1 on error
+ */
+static int apply_edit(Document *doc, size_t offset, size_t old_length,
+                      const char *new_text, size_t new_length) {
+    MMEditState *edit = doc->edit;
+    size_t length = edit->length - old_length + new_length;
+
+    if (length + 1 > edit->capacity) {
+        size_t capacity = edit->capacity ? edit->capacity : 64;
+        while (capacity < length + 1) {
+            capacity *= 2;
+        }
+        char *source = safe_realloc(edit->source, capacity);
+        if (!source) {
+            return -1;
+        }
+        edit->source = source;
+        edit->capacity = capacity;
+    }
+
+    memmove(edit->source + offset + new_length, edit->source + offset + old_length,
+            edit->length - offset - old_length);
+    if (new_length) {
+        memcpy(edit->source + offset, new_text, new_length);
+    }
+    edit->length = length;
+    edit->source[length] = '\0';
+
+    if (edit->zero_copy) {
+        doc->source = edit->source;
+        doc->source_length = edit->length;
+    }
+    return 0;
+}
+
+Document* parser_parse_editable(const char *input, size_t length, int zero_copy) {
+    Document *doc = safe_malloc(sizeof(Document));
+    MMEditState *edit = safe_malloc(sizeof(MMEditState));
+    if (!doc || !edit) {
+        free(doc);
+        free(edit);
+        return NULL;
+    }
+
+    memset(doc, 0, sizeof(Document));
+    memset(edit, 0, sizeof(MMEditState));
+    edit->zero_copy = zero_copy;
+    doc->edit = edit;
+    doc->root = create_node(NODE_DOCUMENT, NULL);
+    if (!doc->root || apply_edit(doc, 0, 0, input, length) != 0 || rebuild(doc) != 0) {
+        set_error(MM_ERROR_MEMORY);
+        free_document(doc);
+        return NULL;
+    }
+
+    // Match parse_metamark(): a document without any node is an error
+    if (doc->root->child_count == 0) {
+        set_error(MM_ERROR_SYNTAX);
+        free_document(doc);
+        return NULL;
+    }
+
+    return doc;
+}
+
+void mm_edit_state_free(MMEditState *edit) {
+    if (!edit) {
+        return;
+    }
+
+    free(edit->source);
+    free(edit->ends);
+    free(edit);
+}
+
+/**
+ * @brief Bring the tree up to date with an edit already applied to the text
+ *
+ * @return int 0 on success, or -1 with the tree unchanged
+ */
+static int reparse_edited(Document *doc, size_t offset, size_t old_length,
+                          size_t new_length, MMRange *changed) {
+    MMEditState *edit = doc->edit;
+    size_t old_count = doc->root->child_count;
+
+    // The frontmatter decides the metadata and where the content starts
+    if (offset < edit->content_start + PARSER_LOOKAHEAD) {
+        if (rebuild(doc) != 0) {
+            return -1;
+        }
+        if (changed) {
+            changed->first = 0;
+            changed->removed = old_count;
+            changed->inserted = doc->root->child_count;
+        }
+        return 0;
+    }
+
+    // Restart after the last block the edit cannot have changed
+    size_t first = edit->first_content;
+    while (first < old_count && edit->ends[first] + PARSER_LOOKAHEAD <= offset) {
+        first++;
+    }
+    size_t restart = first > edit->first_content ? edit->ends[first - 1] : edit->content_start;
+
+    Parser parser;
+    Lexer *lexer = &parser.lexer;
+    BlockRun run = {0};
+    parser_init(&parser, edit->source, edit->length, NULL, edit->zero_copy);
+    lexer->pos = restart;
+
+    // Offsets past the edit move by delta; wrap-around handles shrinking
+    size_t delta = new_length - old_length;
+    size_t edit_end = offset + new_length;
+    size_t resync = old_count;
+
+    while (peek(lexer) != '\0') {
+        Node *node = parser_step(&parser);
+        if (!node) {
+            continue;
+        }
+        if (run_push(&run, node, lexer->pos) != 0) {
+            free_node(node);
+            run_discard(&run);
+            lexer_free(lexer);
+            return -1;
+        }
+
+        // Stop once the new block ends where an old block ended
+        if (lexer->pos >= edit_end) {
+            resync = find_end(doc, first, lexer->pos - delta);
+            if (resync < old_count) {
+                break;
+            }
+        }
+    }
+    lexer_free(lexer);
+
+    // Keep the old blocks after the resync point, shifted into place
+    size_t removed = resync < old_count ? resync + 1 - first : old_count - first;
+    size_t tail = old_count - first - removed;
+    if (reserve_children(doc, first + run.count + tail) != 0 ||
+        shift_nodes(doc->root->children + first + removed, tail, delta) != 0) {
+        run_discard(&run);
+        return -1;
+    }
+    for (size_t i = first + removed; i < old_count; i++) {
+        edit->ends[i] += delta;
+    }
+    splice_children(doc, first, removed, &run);
+
+    if (changed) {
+        changed->first = first;
+        changed->removed = removed;
+        changed->inserted = run.count;
+    }
+    run_free(&run);
+    return 0;
+}
+
+int mm_reparse(Document *doc, size_t offset, size_t old_length,
+               const char *new_text, size_t new_length, MMRange *changed) {
+    if (!doc || !doc->edit || offset > doc->edit->length ||
+        old_length > doc->edit->length - offset || (!new_text && new_length)) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    // Keep the replaced bytes so a failed reparse can put them back
+    char *replaced = NULL;
+    if (old_length) {
+        replaced = safe_malloc(old_length);
+        if (!replaced) {
+            return -1;
+        }
+        memcpy(replaced, doc->edit->source + offset, old_length);
+    }
+    if (apply_edit(doc, offset, old_length, new_text, new_length) != 0) {
+        free(replaced);
+        return -1;
+    }
+
+    int result = reparse_edited(doc, offset, old_length, new_length, changed);
+    if (result != 0) {
+        // The old text fits the buffer it came from, so this cannot fail
+        apply_edit(doc, offset, new_length, replaced, old_length);
+    }
+    free(replaced);
+    return result;
+}
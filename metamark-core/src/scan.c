@@ -0,0 +1,208 @@
+/**
+ * @file scan.c
+ * @brief SIMD and scalar implementations of mm_scan_special()
+ *
+ * Each vector kernel compares a block of input against every special byte,
+ * ORs the results and jumps to the first hit. The remaining tail shorter
+ * than one vector goes through the scalar loop. The best kernel for the
+ * running CPU is picked on first use.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/scan.h"
+#include "../include/thread.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MM_SCAN_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MM_SCAN_SSE2 1
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define MM_SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MM_SCAN_TARGET_AVX2
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define MM_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef size_t (*ScanFn)(const char *data, size_t pos, size_t length);
+
+/**
+ * @brief Lookup table marking the special bytes
+ */
+static const unsigned char special_table[256] = {
+    ['\0'] = 1, ['\n'] = 1, ['#'] = 1, ['['] = 1,
+    ['%'] = 1, ['-'] = 1, ['>'] = 1, [']'] = 1
+};
+
+static size_t scan_scalar(const char *data, size_t pos, size_t length) {
+    const unsigned char *p = (const unsigned char *)data;
+    while (pos < length && !special_table[p[pos]]) {
+        pos++;
+    }
+    return pos;
+}
+
+static unsigned count_trailing_zeros(uint32_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+#ifdef MM_SCAN_SSE2
+static size_t scan_sse2(const char *data, size_t pos, size_t length) {
+    const __m128i nul = _mm_setzero_si128();
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i hash = _mm_set1_epi8('#');
+    const __m128i open = _mm_set1_epi8('[');
+    const __m128i percent = _mm_set1_epi8('%');
+    const __m128i dash = _mm_set1_epi8('-');
+    const __m128i greater = _mm_set1_epi8('>');
+    const __m128i close = _mm_set1_epi8(']');
+
+    while (pos + 16 <= length) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + pos));
+        __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, nul), _mm_cmpeq_epi8(v, newline)),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, hash), _mm_cmpeq_epi8(v, open))),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, percent), _mm_cmpeq_epi8(v, dash)),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, greater), _mm_cmpeq_epi8(v, close))));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(hit);
+        if (mask) {
+            return pos + count_trailing_zeros(mask);
+        }
+        pos += 16;
+    }
+
+    return scan_scalar(data, pos, length);
+}
+#endif
+
+#ifdef MM_SCAN_X86
+MM_SCAN_TARGET_AVX2
+static size_t scan_avx2(const char *data, size_t pos, size_t length) {
+    const __m256i nul = _mm256_setzero_si256();
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i hash = _mm256_set1_epi8('#');
+    const __m256i open = _mm256_set1_epi8('[');
+    const __m256i percent = _mm256_set1_epi8('%');
+    const __m256i dash = _mm256_set1_epi8('-');
+    const __m256i greater = _mm256_set1_epi8('>');
+    const __m256i close = _mm256_set1_epi8(']');
+
+    while (pos + 32 <= length) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + pos));
+        __m256i hit = _mm256_or_si256(
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, nul), _mm256_cmpeq_epi8(v, newline)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(v, hash), _mm256_cmpeq_epi8(v, open))),
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, percent), _mm256_cmpeq_epi8(v, dash)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(v, greater), _mm256_cmpeq_epi8(v, close))));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit);
+        if (mask) {
+            return pos + count_trailing_zeros(mask);
+        }
+        pos += 32;
+    }
+
+    return scan_scalar(data, pos, length);
+}
+
+/**
+ * @brief Check that both the CPU and the OS support AVX2
+ */
+static int cpu_has_avx2(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    int osxsave = (info[2] & (1 << 27)) != 0;
+    int avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return 0;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#ifdef MM_SCAN_NEON
+static size_t scan_neon(const char *data, size_t pos, size_t length) {
+    const uint8x16_t nul = vdupq_n_u8(0);
+    const uint8x16_t newline = vdupq_n_u8('\n');
+    const uint8x16_t hash = vdupq_n_u8('#');
+    const uint8x16_t open = vdupq_n_u8('[');
+    const uint8x16_t percent = vdupq_n_u8('%');
+    const uint8x16_t dash = vdupq_n_u8('-');
+    const uint8x16_t greater = vdupq_n_u8('>');
+    const uint8x16_t close = vdupq_n_u8(']');
+
+    while (pos + 16 <= length) {
+        uint8x16_t v = vld1q_u8((const uint8_t *)data + pos);
+        uint8x16_t hit = vorrq_u8(
+            vorrq_u8(vorrq_u8(vceqq_u8(v, nul), vceqq_u8(v, newline)),
+                     vorrq_u8(vceqq_u8(v, hash), vceqq_u8(v, open))),
+            vorrq_u8(vorrq_u8(vceqq_u8(v, percent), vceqq_u8(v, dash)),
+                     vorrq_u8(vceqq_u8(v, greater), vceqq_u8(v, close))));
+        if (vmaxvq_u8(hit)) {
+            // Narrow to one nibble per byte and locate the first set nibble
+            uint64_t mask = vget_lane_u64(
+                vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+            unsigned index = 0;
+            while (!(mask & 0xF)) {
+                mask >>= 4;
+                index++;
+            }
+            return pos + index;
+        }
+        pos += 16;
+    }
+
+    return scan_scalar(data, pos, length);
+}
+#endif
+
+/**
+ * @brief Kernel in use, written once by scan_resolve()
+ */
+static ScanFn scan_impl = scan_scalar;
+static mm_once_t scan_once = MM_ONCE_INIT;
+
+static void scan_resolve(void) {
+    ScanFn fn = scan_scalar;
+#if defined(MM_SCAN_X86)
+    if (cpu_has_avx2()) {
+        fn = scan_avx2;
+    }
+#ifdef MM_SCAN_SSE2
+    else {
+        fn = scan_sse2;
+    }
+#endif
+#elif defined(MM_SCAN_NEON)
+    fn = scan_neon;
+#endif
+    scan_impl = fn;
+}
+
+size_t mm_scan_special(const char *data, size_t pos, size_t length) {
+    // Short runs are cheaper to finish without entering a kernel
+    if (pos + 16 > length) {
+        return scan_scalar(data, pos, length);
+    }
+    mm_once(&scan_once, scan_resolve);
+    return scan_impl(data, pos, length);
+}
@@ -0,0 +1,451 @@
+/**
+ * @file snapshot.c
+ * @brief Binary snapshots of parsed documents
+ *
+ * Layout, all integers little-endian:
+ *
+ *   header    64 bytes: magic, version, header size, counts, pool length,
+ *             stamp and the offsets of the three sections
+ *   nodes     32 bytes per node, breadth-first so that the children of
+ *             every node are one consecutive index range
+ *   metadata  16 bytes per pair: key and value as pool offset and length
+ *   pool      NUL-terminated strings
+ *
+ * Readers decode fields straight from the mapping, so a snapshot works on
+ * any host byte order and only the pages that are read get faulted in.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+#include "../include/output.h"
+
+#define SNAPSHOT_MAGIC "MMSNAP\0\0"
+#define SNAPSHOT_HEADER_SIZE 64
+#define SNAPSHOT_NODE_SIZE 32
+#define SNAPSHOT_PAIR_SIZE 16
+
+/** @brief Node record flag: the node has content */
+#define SNAPSHOT_HAS_CONTENT 0x1u
+
+struct MMSnapshot {
+    MMFileMap *map;               ///< Mapping of the file
+    const unsigned char *nodes;   ///< Node table
+    const unsigned char *pairs;   ///< Metadata table
+    const char *pool;             ///< String pool
+    size_t node_count;            ///< Entries in the node table
+    size_t metadata_count;        ///< Entries in the metadata table
+    size_t pool_length;           ///< Size of the string pool
+    uint64_t stamp;               ///< Caller-defined stamp
+};
+
+static void put_u16(unsigned char *p, uint16_t value) {
+    p[0] = (unsigned char)value;
+    p[1] = (unsigned char)(value >> 8);
+}
+
+static void put_u32(unsigned char *p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static void put_u64(unsigned char *p, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static uint16_t get_u16(const unsigned char *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+/**
+ * @brief Count the nodes of a subtree and the pool bytes of their content
+ */
+static int measure_tree(const Document *doc, const Node *root, size_t *count,
+                        size_t *lazy, uint64_t *pool) {
+    MMWalker walker;
+    const Node *node;
+    mm_walker_init(&walker, root, MM_WALK_ENTER | MM_WALK_LAZY);
+    while ((node = mm_walker_next(&walker, NULL))) {
+        size_t length;
+        if (mm_node_text(doc, node, &length)) {
+            *pool += length + 1;
+        }
+        (*count)++;
+        if (node->flags & MM_NODE_LAZY) {
+            (*lazy)++;
+        }
+    }
+    return mm_walker_finish(&walker);
+}
+
+/**
+ * @brief Append a string and its terminator to the pool
+ */
+static void write_pooled(MMOutput *out, const char *text, size_t length) {
+    mm_output_write(out, text, length);
+    mm_output_char(out, '\0');
+}
+
+/**
+ * @brief Serialize a document to a sink, or into one buffer when write is NULL
+ * 
+ * @param buffer Receives the buffer in buffer mode
+ * @param size Receives the size of the buffer in buffer mode
+ * 
+ * The size of the snapshot is known once the tree has been measured, so
+ * a buffer is allocated exactly once.
+ */
+static int write_snapshot(const Document *doc, uint64_t stamp, MMWriteFn write, void *user_data,
+                          unsigned char **buffer, size_t *size) {
+
+    size_t count = 0;
+    size_t lazy = 0;
+    uint64_t pool_length = 0;
+    if (measure_tree(doc, doc->root, &count, &lazy, &pool_length) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < doc->metadata_count; i++) {
+        pool_length += strlen(doc->metadata[i].key) + strlen(doc->metadata[i].value) + 2;
+    }
+
+    // Node records address the pool and the node table with 32 bits
+    if (count > UINT32_MAX || doc->metadata_count > UINT32_MAX || pool_length > UINT32_MAX) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    // Unbuilt lazy bodies are queued as stand-in nodes
+    const Node **order = safe_malloc(count * sizeof(Node*));
+    Node *bodies = lazy ? safe_malloc(lazy * sizeof(Node)) : NULL;
+    if (!order || (lazy && !bodies)) {
+        free(order);
+        free(bodies);
+        return -1;
+    }
+
+    uint64_t nodes_offset = SNAPSHOT_HEADER_SIZE;
+    uint64_t pairs_offset = nodes_offset + (uint64_t)count * SNAPSHOT_NODE_SIZE;
+    uint64_t pool_offset = pairs_offset + (uint64_t)doc->metadata_count * SNAPSHOT_PAIR_SIZE;
+
+    MMOutput out;
+    int started = write ? mm_output_init_sink(&out, write, user_data)
+                        : mm_output_init_string(&out, (size_t)(pool_offset + pool_length));
+    if (started != 0) {
+        free(order);
+        free(bodies);
+        return -1;
+    }
+
+    unsigned char header[SNAPSHOT_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    memcpy(header, SNAPSHOT_MAGIC, 8);
+    put_u32(header + 8, MM_SNAPSHOT_VERSION);
+    put_u32(header + 12, SNAPSHOT_HEADER_SIZE);
+    put_u32(header + 16, (uint32_t)count);
+    put_u32(header + 20, (uint32_t)doc->metadata_count);
+    put_u64(header + 24, pool_length);
+    put_u64(header + 32, stamp);
+    put_u64(header + 40, nodes_offset);
+    put_u64(header + 48, pairs_offset);
+    put_u64(header + 56, pool_offset);
+    mm_output_write(&out, (const char *)header, sizeof(header));
+
+    // Breadth-first order gives every node's children consecutive indices
+    size_t tail = 1;
+    lazy = 0;
+    uint32_t cursor = 0;
+    order[0] = doc->root;
+    for (size_t i = 0; i < count; i++) {
+        const Node *node = order[i];
+        unsigned char record[SNAPSHOT_NODE_SIZE];
+        size_t length;
+        int has_content = mm_node_text(doc, node, &length) != NULL;
+
+        memset(record, 0, sizeof(record));
+        put_u16(record, (uint16_t)node->type);
+        put_u16(record + 2, (uint16_t)(node->level > UINT16_MAX ? UINT16_MAX : node->level));
+        put_u32(record + 4, has_content ? SNAPSHOT_HAS_CONTENT : 0);
+        put_u32(record + 8, (uint32_t)tail);
+        put_u32(record + 12, (uint32_t)node_child_count(node));
+        if (has_content) {
+            put_u32(record + 16, cursor);
+            put_u32(record + 20, (uint32_t)length);
+            cursor += (uint32_t)length + 1;
+        }
+        put_u32(record + 24, (uint32_t)(node->offset > UINT32_MAX ? UINT32_MAX : node->offset));
+        mm_output_write(&out, (const char *)record, sizeof(record));
+
+        Node *body = (node->flags & MM_NODE_LAZY) ? &bodies[lazy++] : NULL;
+        for (size_t c = 0; c < node_child_count(node); c++) {
+            order[tail++] = node_child(node, c, body);
+        }
+    }
+
+    for (size_t i = 0; i < doc->metadata_count; i++) {
+        unsigned char record[SNAPSHOT_PAIR_SIZE];
+        size_t key_length = strlen(doc->metadata[i].key);
+        size_t value_length = strlen(doc->metadata[i].value);
+        put_u32(record, cursor);
+        put_u32(record + 4, (uint32_t)key_length);
+        cursor += (uint32_t)key_length + 1;
+        put_u32(record + 8, cursor);
+        put_u32(record + 12, (uint32_t)value_length);
+        cursor += (uint32_t)value_length + 1;
+        mm_output_write(&out, (const char *)record, sizeof(record));
+    }
+
+    // The pool holds the strings in the order the tables refer to them
+    for (size_t i = 0; i < count; i++) {
+        size_t length;
+        const char *text = mm_node_text(doc, order[i], &length);
+        if (text) {
+            write_pooled(&out, text, length);
+        }
+    }
+    for (size_t i = 0; i < doc->metadata_count; i++) {
+        write_pooled(&out, doc->metadata[i].key, strlen(doc->metadata[i].key));
+        write_pooled(&out, doc->metadata[i].value, strlen(doc->metadata[i].value));
+    }
+
+    free(order);
+    free(bodies);
+    char *data = mm_output_finish(&out, size);
+    if (buffer) {
+        *buffer = (unsigned char *)data;
+    }
+    return out.result;
+}
+
+int mm_snapshot_write(const Document *doc, uint64_t stamp, MMWriteFn write, void *user_data) {
+    if (!doc || !doc->root || !write) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+    return write_snapshot(doc, stamp, write, user_data, NULL, NULL);
+}
+
+unsigned char* mm_snapshot_encode(const Document *doc, uint64_t stamp, size_t *size) {
+    if (!doc || !doc->root) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+
+    unsigned char *buffer = NULL;
+    size_t length = 0;
+    if (write_snapshot(doc, stamp, NULL, NULL, &buffer, &length) != 0) {
+        free(buffer);
+        return NULL;
+    }
+    if (size) {
+        *size = length;
+    }
+    return buffer;
+}
+
+static int write_to_file(const char *data, size_t length, void *user_data) {
+    return fwrite(data, 1, length, (FILE *)user_data) == length ? 0 : -1;
+}
+
+int mm_snapshot_save(const Document *doc, uint64_t stamp, const char *filename) {
+    if (!doc || !filename) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        set_error(MM_ERROR_IO);
+        return -1;
+    }
+
+    int result = mm_snapshot_write(doc, stamp, write_to_file, file);
+    if (fclose(file) != 0 && result == 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        set_error(MM_ERROR_IO);
+        remove(filename);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Check the header of snapshot bytes and create a reader over them
+ * 
+ * @param map The mapping holding the bytes, owned by the reader, or NULL
+ */
+static MMSnapshot* snapshot_view(MMFileMap *map, const char *data, size_t length) {
+    const unsigned char *header = (const unsigned char *)data;
+    if (!data || length < SNAPSHOT_HEADER_SIZE || memcmp(header, SNAPSHOT_MAGIC, 8) != 0 ||
+        get_u32(header + 8) != MM_SNAPSHOT_VERSION ||
+        get_u32(header + 12) < SNAPSHOT_HEADER_SIZE) {
+        set_error(MM_ERROR_SYNTAX);
+        mm_unmap_file(map);
+        return NULL;
+    }
+
+    uint64_t node_count = get_u32(header + 16);
+    uint64_t metadata_count = get_u32(header + 20);
+    uint64_t pool_length = get_u64(header + 24);
+    uint64_t nodes_offset = get_u64(header + 40);
+    uint64_t pairs_offset = get_u64(header + 48);
+    uint64_t pool_offset = get_u64(header + 56);
+
+    // Every section must lie inside the file; there is always a root
+    if (node_count == 0 ||
+        nodes_offset > length || node_count * SNAPSHOT_NODE_SIZE > length - nodes_offset ||
+        pairs_offset > length || metadata_count * SNAPSHOT_PAIR_SIZE > length - pairs_offset ||
+        pool_offset > length || pool_length > length - pool_offset) {
+        set_error(MM_ERROR_SYNTAX);
+        mm_unmap_file(map);
+        return NULL;
+    }
+
+    MMSnapshot *snapshot = safe_malloc(sizeof(MMSnapshot));
+    if (!snapshot) {
+        mm_unmap_file(map);
+        return NULL;
+    }
+    snapshot->map = map;
+    snapshot->nodes = header + nodes_offset;
+    snapshot->pairs = header + pairs_offset;
+    snapshot->pool = data + pool_offset;
+    snapshot->node_count = (size_t)node_count;
+    snapshot->metadata_count = (size_t)metadata_count;
+    snapshot->pool_length = (size_t)pool_length;
+    snapshot->stamp = get_u64(header + 32);
+    return snapshot;
+}
+
+MMSnapshot* mm_snapshot_open(const char *filename) {
+    const char *data;
+    size_t length;
+    MMFileMap *map = mm_map_file(filename, &data, &length);
+    if (!map) {
+        return NULL;
+    }
+    return snapshot_view(map, data, length);
+}
+
+MMSnapshot* mm_snapshot_from_buffer(const void *data, size_t length) {
+    return snapshot_view(NULL, data, length);
+}
+
+void mm_snapshot_close(MMSnapshot *snapshot) {
+    if (!snapshot) {
+        return;
+    }
+
+    mm_unmap_file(snapshot->map);
+    free(snapshot);
+}
+
+uint64_t mm_snapshot_stamp(const MMSnapshot *snapshot) {
+    return snapshot ? snapshot->stamp : 0;
+}
+
+size_t mm_snapshot_node_count(const MMSnapshot *snapshot) {
+    return snapshot ? snapshot->node_count : 0;
+}
+
+size_t mm_snapshot_metadata_count(const MMSnapshot *snapshot) {
+    return snapshot ? snapshot->metadata_count : 0;
+}
+
+/**
+ * @brief Resolve a pooled string, checking that it is terminated in bounds
+ */
+static const char* pool_string(const MMSnapshot *snapshot, uint32_t offset, uint32_t length) {
+    if ((uint64_t)offset + length >= snapshot->pool_length ||
+        snapshot->pool[offset + length] != '\0') {
+        return NULL;
+    }
+    return snapshot->pool + offset;
+}
+
+int mm_snapshot_node(const MMSnapshot *snapshot, size_t index, MMSnapshotNode *node) {
+    if (!snapshot || !node || index >= snapshot->node_count) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    const unsigned char *record = snapshot->nodes + index * SNAPSHOT_NODE_SIZE;
+    uint16_t type = get_u16(record);
+    uint32_t flags = get_u32(record + 4);
+    uint32_t first_child = get_u32(record + 8);
+    uint32_t child_count = get_u32(record + 12);
+
+    // Children always come after their parent in breadth-first order
+    if (type > NODE_SECURE ||
+        (child_count > 0 && first_child <= index) ||
+        (uint64_t)first_child + child_count > snapshot->node_count) {
+        set_error(MM_ERROR_SYNTAX);
+        return -1;
+    }
+
+    node->type = (NodeType)type;
+    node->level = get_u16(record + 2);
+    node->content = NULL;
+    node->length = 0;
+    node->offset = get_u32(record + 24);
+    node->first_child = first_child;
+    node->child_count = child_count;
+
+    if (flags & SNAPSHOT_HAS_CONTENT) {
+        uint32_t length = get_u32(record + 20);
+        node->content = pool_string(snapshot, get_u32(record + 16), length);
+        if (!node->content) {
+            set_error(MM_ERROR_SYNTAX);
+            return -1;
+        }
+        node->length = length;
+    }
+    return 0;
+}
+
+int mm_snapshot_metadata(const MMSnapshot *snapshot, size_t index,
+                         const char **key, const char **value) {
+    if (!snapshot || !key || !value || index >= snapshot->metadata_count) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    const unsigned char *record = snapshot->pairs + index * SNAPSHOT_PAIR_SIZE;
+    *key = pool_string(snapshot, get_u32(record), get_u32(record + 4));
+    *value = pool_string(snapshot, get_u32(record + 8), get_u32(record + 12));
+    if (!*key || !*value) {
+        set_error(MM_ERROR_SYNTAX);
+        return -1;
+    }
+    return 0;
+}
+
+const char* mm_snapshot_get_metadata(const MMSnapshot *snapshot, const char *key) {
+    if (!snapshot || !key) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < snapshot->metadata_count; i++) {
+        const char *pair_key;
+        const char *value;
+        if (mm_snapshot_metadata(snapshot, i, &pair_key, &value) == 0 &&
+            strcmp(pair_key, key) == 0) {
+            return value;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,41 @@
+/**
+ * @file stats.c
+ * @brief Opt-in parse statistics
+ *
+ * The counters live in a caller-owned MMParseStats that the hooks in the
+ * parser, allocators and free_document() update through a thread-local
+ * pointer, the same way errors reach the active MMContext.
+ */
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <time.h>
+#include "../include/metamark.h"
+#include "../include/stats.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+MM_THREAD_LOCAL MMParseStats *mm_active_stats;
+
+MMParseStats* mm_parse_stats(MMParseStats *stats) {
+    MMParseStats *previous = mm_active_stats;
+    mm_active_stats = stats;
+    return previous;
+}
+
+double mm_stats_clock(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, count;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
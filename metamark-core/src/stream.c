@@ -0,0 +1,233 @@
+/**
+ * @file stream.c
+ * @brief Push-style incremental parser for chunked MetaMark input
+ *
+ * Input arrives in arbitrary chunks through mm_parser_feed(). The parser
+ * keeps only the bytes of the top-level block that is still incomplete and
+ * hands every finished block to the caller as soon as it is known to parse
+ * exactly as it would with the whole document available.
+ *
+ * A block is final once it ends at least PARSER_LOOKAHEAD bytes before the
+ * end of the buffered input, because no parse decision looks further ahead
+ * than that. An unfinished block is retried only after the buffered tail
+ * has doubled, which keeps the total rescanning linear in the input size.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+#include "../include/parser.h"
+
+#define STREAM_INITIAL_CAPACITY 4096
+
+struct MMParser {
+    char *buffer;             ///< Bytes not yet consumed by a finished block
+    size_t length;            ///< Number of buffered bytes
+    size_t capacity;          ///< Allocated size of buffer
+    size_t base;              ///< Absolute input offset of buffer[0]
+    size_t retry_length;      ///< Buffered length needed before reparsing
+    int started;              ///< Nonzero once leading whitespace and frontmatter are done
+    int stopped;              ///< Nonzero once a NUL byte ended the document
+    int failed;               ///< Nonzero after an error or callback abort
+    size_t emitted;           ///< Number of top-level nodes produced
+    MMNodeCallback callback;  ///< Receives finished top-level nodes, or NULL
+    void *user_data;          ///< Passed back to the callback
+    Document *doc;            ///< Document collecting metadata (and nodes)
+};
+
+/**
+ * @brief Hand a finished top-level node to the caller
+ *
+ * @return int 0 on success, -1 on error or if the callback asked to stop
+ */
+static int stream_emit(MMParser *parser, Node *node) {
+    // Translate buffer-relative offsets into absolute input offsets
+    if (shift_node_offsets(node, parser->base) != 0) {
+        free_node(node);
+        return -1;
+    }
+    parser->emitted++;
+
+    if (!parser->callback) {
+        add_child(parser->doc->root, node);
+        return 0;
+    }
+
+    int result = parser->callback(node, parser->user_data);
+    free_node(node);
+    return result == 0 ? 0 : -1;
+}
+
+/**
+ * @brief Parse every block of the buffer that is known to be complete
+ *
+ * @param parser The streaming parser
+ * @param at_eof Nonzero when no more input will arrive
+ * @return int 0 on success, -1 on error
+ */
+static int stream_process(MMParser *parser, int at_eof) {
+    if (parser->stopped || (!at_eof && parser->length < parser->retry_length)) {
+        return 0;
+    }
+
+    Parser p;
+    Lexer *lexer = &p.lexer;
+    parser_init(&p, parser->buffer, parser->length, NULL, 0);
+    size_t consumed = 0;
+
+    if (!parser->started) {
+        // Skip leading whitespace
+        while (isspace((unsigned char)peek(lexer))) {
+            next(lexer);
+        }
+        consumed = lexer->pos;
+
+        // Need the first three bytes to tell whether frontmatter follows
+        if (!at_eof && parser->length - consumed < PARSER_LOOKAHEAD) {
+            goto compact;
+        }
+
+        if (parser_at_metadata(&p)) {
+            Node *metadata_node = parser_metadata(&p, parser->doc);
+            if (!at_eof && lexer->pos + PARSER_LOOKAHEAD > parser->length) {
+                // The block is parsed again once more input arrives
+                free_node(metadata_node);
+                clear_metadata(parser->doc);
+                goto compact;
+            }
+            if (metadata_node) {
+                if (stream_emit(parser, metadata_node) != 0) {
+                    parser->failed = 1;
+                    return -1;
+                }
+            }
+        }
+
+        parser->started = 1;
+        consumed = lexer->pos;
+    }
+
+    while (lexer->pos < parser->length) {
+        if (peek(lexer) == '\0') {
+            // Like the whole-buffer parser, a NUL byte ends the document
+            parser->stopped = 1;
+            break;
+        }
+
+        Node *node = parser_step(&p);
+        if (!at_eof && lexer->pos + PARSER_LOOKAHEAD > parser->length) {
+            // The block may still change with more input; retry later
+            free_node(node);
+            break;
+        }
+
+        consumed = lexer->pos;
+        if (node && stream_emit(parser, node) != 0) {
+            parser->failed = 1;
+            return -1;
+        }
+    }
+
+compact:
+    // Keep only the unfinished tail and wait until it has doubled
+    memmove(parser->buffer, parser->buffer + consumed, parser->length - consumed);
+    parser->length -= consumed;
+    parser->base += consumed;
+    parser->retry_length = parser->length * 2;
+    if (parser->retry_length <= parser->length) {
+        parser->retry_length = parser->length + 1;
+    }
+    return 0;
+}
+
+MMParser* mm_parser_new(MMNodeCallback callback, void *user_data) {
+    MMParser *parser = safe_malloc(sizeof(MMParser));
+    if (!parser) {
+        return NULL;
+    }
+
+    memset(parser, 0, sizeof(MMParser));
+    parser->callback = callback;
+    parser->user_data = user_data;
+
+    parser->doc = safe_malloc(sizeof(Document));
+    if (!parser->doc) {
+        free(parser);
+        return NULL;
+    }
+
+    memset(parser->doc, 0, sizeof(Document));
+    parser->doc->root = create_node(NODE_DOCUMENT, NULL);
+    if (!parser->doc->root) {
+        set_error(MM_ERROR_MEMORY);
+        free(parser->doc);
+        free(parser);
+        return NULL;
+    }
+
+    return parser;
+}
+
+int mm_parser_feed(MMParser *parser, const char *buffer, size_t length) {
+    if (!parser || !parser->doc || parser->failed || (!buffer && length)) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+
+    if (parser->length + length > parser->capacity) {
+        size_t new_capacity = parser->capacity ? parser->capacity : STREAM_INITIAL_CAPACITY;
+        while (new_capacity < parser->length + length) {
+            new_capacity *= 2;
+        }
+
+        char *new_buffer = safe_realloc(parser->buffer, new_capacity);
+        if (!new_buffer) {
+            parser->failed = 1;
+            return -1;
+        }
+        parser->buffer = new_buffer;
+        parser->capacity = new_capacity;
+    }
+
+    if (length) {
+        memcpy(parser->buffer + parser->length, buffer, length);
+        parser->length += length;
+    }
+
+    return stream_process(parser, 0);
+}
+
+Document* mm_parser_finish(MMParser *parser) {
+    if (!parser || !parser->doc || parser->failed) {
+        set_error(MM_ERROR_INVALID);
+        return NULL;
+    }
+
+    if (stream_process(parser, 1) != 0) {
+        return NULL;
+    }
+
+    Document *doc = parser->doc;
+    parser->doc = NULL;
+
+    // Match parse_metamark(): a document without any node is an error
+    if (parser->emitted == 0) {
+        set_error(MM_ERROR_SYNTAX);
+        free_document(doc);
+        return NULL;
+    }
+
+    return doc;
+}
+
+void mm_parser_free(MMParser *parser) {
+    if (!parser) {
+        return;
+    }
+
+    free_document(parser->doc);
+    free(parser->buffer);
+    free(parser);
+}
@@ -0,0 +1,128 @@
+/**
+ * @file thread.c
+ * @brief pthread and Win32 implementations of the threading shim
+ */
+
+#include <stdlib.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+#include "../include/thread.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Heap copy of a thread's entry point, freed by the trampoline
+ */
+typedef struct {
+    MMThreadFn fn; ///< Function to run
+    void *arg;     ///< Argument for fn
+} ThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI thread_trampoline(LPVOID param) {
+#else
+static void* thread_trampoline(void *param) {
+#endif
+    ThreadStart start = *(ThreadStart *)param;
+    free(param);
+    start.fn(start.arg);
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+int mm_thread_create(mm_thread_t *thread, MMThreadFn fn, void *arg) {
+    ThreadStart *start = safe_malloc(sizeof(ThreadStart));
+    if (!start) {
+        return -1;
+    }
+    start->fn = fn;
+    start->arg = arg;
+
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL);
+    if (!*thread) {
+        free(start);
+        return -1;
+    }
+#else
+    if (pthread_create(thread, NULL, thread_trampoline, start) != 0) {
+        free(start);
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+void mm_thread_join(mm_thread_t thread) {
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+void mm_mutex_init(mm_mutex_t *mutex) {
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void mm_mutex_lock(mm_mutex_t *mutex) {
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void mm_mutex_unlock(mm_mutex_t *mutex) {
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+void mm_mutex_destroy(mm_mutex_t *mutex) {
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+#ifdef _WIN32
+static BOOL CALLBACK once_trampoline(PINIT_ONCE once, PVOID param, PVOID *context) {
+    (void)once;
+    (void)context;
+    ((void (*)(void))param)();
+    return TRUE;
+}
+#endif
+
+void mm_once(mm_once_t *once, void (*fn)(void)) {
+#ifdef _WIN32
+    InitOnceExecuteOnce(once, once_trampoline, (PVOID)fn, NULL);
+#else
+    pthread_once(once, fn);
+#endif
+}
+
+size_t mm_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (size_t)info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+#endif
+}
@@ -0,0 +1,45 @@
+/**
+ * @file trace.c
+ * @brief Trace sink registration and message formatting
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include "../include/metamark.h"
+#include "../include/trace.h"
+
+/**
+ * @brief Registered trace callback and its user data
+ *
+ * The sink is process-wide configuration; register it before parsing starts.
+ */
+static MMTraceCallback trace_callback = NULL;
+static void *trace_user_data = NULL;
+
+void mm_set_trace_callback(MMTraceCallback callback, void *user_data) {
+    trace_callback = callback;
+    trace_user_data = user_data;
+}
+
+#if MM_TRACE_ENABLED
+
+int mm_trace_active(void) {
+    return trace_callback != NULL;
+}
+
+void mm_trace(const char *format, ...) {
+    MMTraceCallback callback = trace_callback;
+    if (!callback) {
+        return;
+    }
+
+    char message[MM_TRACE_MAX_MESSAGE];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    callback(message, trace_user_data);
+}
+
+#endif /* MM_TRACE_ENABLED */
@@ -12,24 +12,128 @@
 #include <ctype.h>
 #include "../include/metamark.h"
 #include "../include/lexer.h"
+#include "../include/utils.h"
+#include "../include/stats.h"
 
 /**
- * @brief The last error that occurred in the library
+ * @brief Context receiving errors on this thread when none is active
  * 
- * This static variable stores the most recent error code.
- * It is updated by various functions when errors occur.
+ * Each thread has its own, so get_last_error() never reports failures
+ * that happened on another thread.
  */
-static MetaMarkError last_error = MM_ERROR_NONE;
+static MM_THREAD_LOCAL MMContext default_context;
+
+/**
+ * @brief Context of the parse running on this thread, or NULL
+ */
+static MM_THREAD_LOCAL MMContext *active_context;
+
+/**
+ * @brief Get the context errors are currently reported to
+ */
+static MMContext* current_context(void) {
+    return active_context ? active_context : &default_context;
+}
 
 /**
  * @brief Set the error code for the library
  * 
  * @param error The error code to set
  * 
- * This function sets the most recent error code for the library.
+ * This function records the most recent error in the current context.
+ * The failure position is cleared since it is unknown here.
  */
 void set_error(MetaMarkError error) {
-    last_error = error;
+    MMContext *ctx = current_context();
+    ctx->error = error;
+    ctx->offset = 0;
+    ctx->line = 0;
+    ctx->column = 0;
+}
+
+/**
+ * @brief Line position of the last failure reported on this thread
+ * 
+ * Parses report errors at increasing offsets, so counting lines resumes
+ * here instead of at the start of the input, which keeps a document
+ * full of errors linear to parse.
+ */
+typedef struct {
+    const char *input;  ///< Input of the cached position, NULL if none
+    size_t offset;      ///< Byte offset of the cached failure
+    size_t line;        ///< Its line number
+    size_t line_start;  ///< Offset of the first byte of that line
+} ErrorPosition;
+
+static MM_THREAD_LOCAL ErrorPosition last_position;
+
+void mm_error_position_reset(void) {
+    last_position.input = NULL;
+}
+
+/**
+ * @brief Set the error code along with the position of the failure
+ * 
+ * @param error The error code to set
+ * @param input The input being parsed
+ * @param offset Byte offset of the failure in the input
+ * 
+ * Line and column are only computed here, so the cost is paid on failure.
+ */
+void set_error_at(MetaMarkError error, const char *input, size_t offset) {
+    MMContext *ctx = current_context();
+    size_t line = 1;
+    size_t line_start = 0;
+    size_t i = 0;
+    
+    if (last_position.input == input && last_position.offset <= offset) {
+        line = last_position.line;
+        line_start = last_position.line_start;
+        i = last_position.offset;
+    }
+    for (; i < offset; i++) {
+        if (input[i] == '\n') {
+            line++;
+            line_start = i + 1;
+        }
+    }
+    
+    last_position.input = input;
+    last_position.offset = offset;
+    last_position.line = line;
+    last_position.line_start = line_start;
+    
+    ctx->error = error;
+    ctx->offset = offset;
+    ctx->line = line;
+    ctx->column = offset - line_start + 1;
+}
+
+/**
+ * @brief Make a context the error target of the calling thread
+ * 
+ * @param ctx The context to report to, or NULL for the thread default
+ * @return MMContext* The previous target, to be passed to mm_context_leave()
+ */
+MMContext* mm_context_enter(MMContext *ctx) {
+    MMContext *previous = active_context;
+    active_context = ctx;
+    return previous;
+}
+
+/**
+ * @brief Restore the error target saved by mm_context_enter()
+ * 
+ * @param previous The value returned by mm_context_enter()
+ */
+void mm_context_leave(MMContext *previous) {
+    active_context = previous;
+}
+
+void mm_context_init(MMContext *ctx) {
+    if (ctx) {
+        memset(ctx, 0, sizeof(MMContext));
+    }
 }
 
 /**
@@ -37,11 +141,11 @@ void set_error(MetaMarkError error) {
  * 
  * @return MetaMarkError The last error code
  * 
- * This function returns the most recent error code stored in last_error.
+ * This function returns the most recent error code of the calling thread.
  * It can be used to check for errors after operations that might fail.
  */
 MetaMarkError get_last_error(void) {
-    return last_error;
+    return current_context()->error;
 }
 
 /**
@@ -77,17 +181,18 @@ const char* error_to_string(MetaMarkError error) {
  * @return char* A new copy of the string, or NULL on error
  * 
  * This function creates a new copy of the input string using malloc.
- * It updates last_error if memory allocation fails.
+ * It sets the error if memory allocation fails.
  */
 char* str_dup(const char *str) {
     if (!str) {
-        last_error = MM_ERROR_MEMORY;
+        set_error(MM_ERROR_MEMORY);
         return NULL;
     }
     
     char *dup = strdup(str);
+    MM_STATS_ALLOC(strlen(str) + 1);
     if (!dup) {
-        last_error = MM_ERROR_MEMORY;
+        set_error(MM_ERROR_MEMORY);
     }
     return dup;
 }
@@ -128,12 +233,13 @@ char* str_trim(char *str) {
  * @return char* The file contents as a string, or NULL on error
  * 
  * This function reads the entire contents of a file into memory.
- * It handles file I/O errors and memory allocation failures.
+ * It handles file I/O errors and memory allocation failures. The file is
+ * read in binary mode so the byte count matches the file size everywhere.
  */
 char* read_file(const char *filename) {
-    FILE *file = fopen(filename, "r");
+    FILE *file = fopen(filename, "rb");
     if (!file) {
-        last_error = MM_ERROR_IO;
+        set_error(MM_ERROR_IO);
         return NULL;
     }
     
@@ -144,15 +250,15 @@ char* read_file(const char *filename) {
     
     if (size < 0) {
         fclose(file);
-        last_error = MM_ERROR_IO;
+        set_error(MM_ERROR_IO);
         return NULL;
     }
     
     // Allocate buffer
-    char *buffer = malloc(size + 1);
+    char *buffer = safe_malloc(size + 1);
     if (!buffer) {
         fclose(file);
-        last_error = MM_ERROR_MEMORY;
+        set_error(MM_ERROR_MEMORY);
         return NULL;
     }
     
@@ -170,12 +276,13 @@ char* read_file(const char *filename) {
  * @param size The number of bytes to allocate
  * @return void* The allocated memory, or NULL on error
  * 
- * This function wraps malloc and updates last_error if allocation fails.
+ * This function wraps malloc and sets the error if allocation fails.
  */
 void* safe_malloc(size_t size) {
     void *ptr = malloc(size);
+    MM_STATS_ALLOC(size);
     if (!ptr) {
-        last_error = MM_ERROR_MEMORY;
+        set_error(MM_ERROR_MEMORY);
     }
     return ptr;
 }
@@ -187,12 +294,13 @@ void* safe_malloc(size_t size) {
  * @param size The new size in bytes
  * @return void* The reallocated memory, or NULL on error
  * 
- * This function wraps realloc and updates last_error if reallocation fails.
+ * This function wraps realloc and sets the error if reallocation fails.
  */
 void* safe_realloc(void *ptr, size_t size) {
     void *new_ptr = realloc(ptr, size);
+    MM_STATS_ALLOC(size);
     if (!new_ptr) {
-        last_error = MM_ERROR_MEMORY;
+        set_error(MM_ERROR_MEMORY);
     }
     return new_ptr;
 }
@@ -244,26 +352,25 @@ void debug_print_token(TokenType token, const char *value) {
  * @param node The root node to print
  * @param indent The current indentation level
  * 
- * This function recursively prints the AST structure with proper indentation.
+ * This function prints the AST structure with proper indentation.
  * It shows the type, content, and number of children for each node.
  */
 void debug_print_node(const Node *node, int indent) {
-    if (!node) {
-        return;
-    }
-    
-    for (int i = 0; i < indent; i++) {
-        printf("  ");
-    }
-    
-    printf("Node(type=%s, content=%s, children=%zu)\n",
-           node_type_to_string(node->type),
-           node->content ? node->content : "NULL",
-           node->child_count);
-    
-    for (size_t i = 0; i < node->child_count; i++) {
-        debug_print_node(node->children[i], indent + 1);
+    MMWalker walker;
+    MMVisit visit;
+    size_t base = indent > 0 ? (size_t)indent : 0;
+    mm_walker_init(&walker, node, MM_WALK_ENTER);
+    while ((node = mm_walker_next(&walker, &visit))) {
+        for (size_t i = 0; i < base + visit.depth; i++) {
+            printf("  ");
+        }
+        
+        printf("Node(type=%s, content=%s, children=%zu)\n",
+               node_type_to_string(node->type),
+               node->content ? node->content : "NULL",
+               node->child_count);
     }
+    mm_walker_finish(&walker);
 }
 
 /**
@@ -284,4 +391,66 @@ Document* read_metamark_file(const char *filename) {
     Document *doc = parse_metamark(content);
     free(content);
     return doc;
-} 
\ No newline at end of file
+} 
+
+/**
+ * @brief Map and parse a MetaMark file without copying it
+ * 
+ * @param filename The path to the file to read
+ * @return Document* A new document structure, or NULL on error
+ * 
+ * The mapping is handed to the document, which releases it when freed.
+ */
+Document* read_metamark_file_mapped(const char *filename) {
+    const char *data;
+    size_t length;
+    MMFileMap *map = mm_map_file(filename, &data, &length);
+    if (!map) {
+        return NULL;
+    }
+    
+    Document *doc = parse_metamark_view(data, length, NULL);
+    if (!doc) {
+        mm_unmap_file(map);
+        return NULL;
+    }
+    
+    doc->mapping = map;
+    return doc;
+}
+
+static uint64_t rotl64(uint64_t value, int shift) {
+    return (value << shift) | (value >> (64 - shift));
+}
+
+static uint64_t mix64(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdull;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+/**
+ * @brief Hash bytes eight at a time
+ * 
+ * Not cryptographic: callers trust the inputs they compare.
+ */
+uint64_t mm_hash_bytes(const void *data, size_t length, uint64_t seed) {
+    const unsigned char *bytes = data;
+    uint64_t hash = 0x9e3779b97f4a7c15ull ^ seed ^ ((uint64_t)length * 0x87c37b91114253d5ull);
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash ^= rotl64(word * 0x87c37b91114253d5ull, 31) * 0x4cf5ad432745937full;
+        hash = rotl64(hash, 27) * 5 + 0x52dce729;
+    }
+    if (i < length) {
+        uint64_t word = 0;
+        memcpy(&word, bytes + i, length - i);
+        hash ^= rotl64(word * 0x87c37b91114253d5ull, 31) * 0x4cf5ad432745937full;
+    }
+    return mix64(hash);
+}
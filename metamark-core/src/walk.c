@@ -0,0 +1,172 @@
+/**
+ * @file walk.c
+ * @brief Tree traversal with an explicit stack
+ *
+ * Each open node is a frame holding the index of its next child. A step
+ * either pushes that child or, once the children are exhausted, pops the
+ * frame, so enter and leave visits fall out of the same loop and the C
+ * stack stays flat however deep the tree is.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "../include/metamark.h"
+#include "../include/utils.h"
+
+void mm_walker_init(MMWalker *walker, const Node *root, unsigned flags) {
+    walker->frames = walker->inline_frames;
+    walker->capacity = MM_WALK_INLINE_DEPTH;
+    mm_walker_reset(walker, root, flags);
+}
+
+void mm_walker_reset(MMWalker *walker, const Node *root, unsigned flags) {
+    walker->flags = flags;
+    walker->started = 0;
+    walker->failed = 0;
+    walker->depth = 0;
+    if (root) {
+        walker->frames[0].node = root;
+        walker->frames[0].index = 0;
+        walker->frames[0].next = 0;
+        walker->depth = 1;
+    }
+}
+
+/**
+ * @brief Make room for one more open node
+ */
+static int walker_reserve(MMWalker *walker) {
+    if (walker->depth < walker->capacity) {
+        return 0;
+    }
+
+    size_t capacity = walker->capacity * 2;
+    MMWalkFrame *frames;
+    if (walker->frames == walker->inline_frames) {
+        frames = safe_malloc(capacity * sizeof(MMWalkFrame));
+        if (frames) {
+            memcpy(frames, walker->inline_frames, sizeof(walker->inline_frames));
+        }
+    } else {
+        frames = safe_realloc(walker->frames, capacity * sizeof(MMWalkFrame));
+    }
+    if (!frames) {
+        set_error(MM_ERROR_MEMORY);
+        return -1;
+    }
+    walker->frames = frames;
+    walker->capacity = capacity;
+    return 0;
+}
+
+static size_t walker_child_count(const MMWalker *walker, const Node *node) {
+    return (walker->flags & MM_WALK_LAZY) ? node_child_count(node) : node->child_count;
+}
+
+static void fill_visit(const MMWalker *walker, const MMWalkFrame *frame, int leaving, MMVisit *visit) {
+    if (visit) {
+        size_t depth = (size_t)(frame - walker->frames);
+        visit->parent = depth > 0 ? frame[-1].node : NULL;
+        visit->index = frame->index;
+        visit->depth = depth;
+        visit->leaving = leaving;
+    }
+}
+
+const Node* mm_walker_next(MMWalker *walker, MMVisit *visit) {
+    if (!walker || walker->failed) {
+        return NULL;
+    }
+
+    if (!walker->started) {
+        walker->started = 1;
+        if (walker->depth > 0 && (walker->flags & MM_WALK_ENTER)) {
+            fill_visit(walker, &walker->frames[0], 0, visit);
+            return walker->frames[0].node;
+        }
+    }
+
+    while (walker->depth > 0) {
+        MMWalkFrame *top = &walker->frames[walker->depth - 1];
+        if (top->next < walker_child_count(walker, top->node)) {
+            if (walker_reserve(walker) != 0) {
+                walker->failed = 1;
+                return NULL;
+            }
+            top = &walker->frames[walker->depth - 1];
+
+            MMWalkFrame *child = &walker->frames[walker->depth++];
+            child->index = top->next++;
+            child->node = (walker->flags & MM_WALK_LAZY)
+                        ? node_child(top->node, child->index, &walker->body)
+                        : top->node->children[child->index];
+            child->next = 0;
+            if (walker->flags & MM_WALK_ENTER) {
+                fill_visit(walker, child, 0, visit);
+                return child->node;
+            }
+            continue;
+        }
+
+        // The children are done, so the node is left
+        walker->depth--;
+        if (walker->flags & MM_WALK_LEAVE) {
+            fill_visit(walker, top, 1, visit);
+            return top->node;
+        }
+    }
+    return NULL;
+}
+
+void mm_walker_skip(MMWalker *walker) {
+    if (walker && walker->depth > 0) {
+        walker->frames[walker->depth - 1].next = (size_t)-1;
+    }
+}
+
+int mm_walker_finish(MMWalker *walker) {
+    if (!walker) {
+        return 0;
+    }
+    if (walker->frames != walker->inline_frames) {
+        free(walker->frames);
+    }
+    walker->frames = walker->inline_frames;
+    walker->capacity = MM_WALK_INLINE_DEPTH;
+    walker->depth = 0;
+    return walker->failed ? -1 : 0;
+}
+
+int mm_walk(const Node *root, unsigned flags, MMVisitFn visit, void *user_data) {
+    if (!root || !visit) {
+        set_error(MM_ERROR_INVALID);
+        return -1;
+    }
+    if (!(flags & (MM_WALK_ENTER | MM_WALK_LEAVE))) {
+        flags |= MM_WALK_ENTER;
+    }
+
+    MMWalker walker;
+    MMVisit position;
+    const Node *node;
+    int stopped = 0;
+    mm_walker_init(&walker, root, flags);
+    while (!stopped && (node = mm_walker_next(&walker, &position))) {
+        switch (visit(node, &position, user_data)) {
+            case MM_WALK_SKIP:
+                if (!position.leaving) {
+                    mm_walker_skip(&walker);
+                }
+                break;
+            case MM_WALK_STOP:
+                stopped = 1;
+                break;
+            default:
+                break;
+        }
+    }
+    if (mm_walker_finish(&walker) != 0) {
+        return -1;
+    }
+    return stopped;
+}
@@ -13,6 +13,7 @@
 #include <assert.h>
 #include "../include/metamark.h"
 #include "../include/utils.h"
+#include "../include/scan.h"
 
 /**
  * @brief Sample MetaMark document for testing
@@ -58,6 +59,7 @@ const char *test_doc =
  * - The document has the correct number of metadata entries
  * - Metadata keys and values are correctly parsed
  * - Metadata can be retrieved using get_metadata()
+ * - parse_metadata_node() rebuilds the pairs from the node
  */
 void test_metadata() {
     printf("Testing metadata parsing...\n");
@@ -79,11 +81,130 @@ void test_metadata() {
     // Check metadata content
     assert(strstr(metadata->content, "title: Test Document") != NULL);
     assert(strstr(metadata->content, "author: John Doe") != NULL);
+    assert(doc->metadata_count == 2);
+    assert(strcmp(get_metadata(doc, "title"), "Test Document") == 0);
     
+    // The node alone is enough to fill in another document
+    Document copy;
+    memset(&copy, 0, sizeof(copy));
+    parse_metadata_node(&copy, metadata);
+    assert(copy.metadata_count == 2);
+    assert(strcmp(get_metadata(&copy, "author"), "John Doe") == 0);
+    clear_metadata(&copy);
+    
+    free_document(doc);
+    
+    // Keys and values are trimmed, values may contain colons
+    doc = parse_metamark("---\n  # comment\n  url :  http://x:80 \n\n\tkey\t:\tvalue\n---\n");
+    assert(doc != NULL);
+    assert(doc->metadata_count == 2);
+    assert(strcmp(get_metadata(doc, "url"), "http://x:80") == 0);
+    assert(strcmp(get_metadata(doc, "key"), "value") == 0);
     free_document(doc);
     printf("Metadata test passed\n");
 }
 
+/**
+ * @brief Build frontmatter with many numbered keys and a trailing heading
+ *
+ * Key i has the value "value-<i>"; key 0 appears a second time at the end.
+ */
+static char* build_large_frontmatter(size_t keys) {
+    size_t capacity = 64 + keys * 32;
+    char *input = malloc(capacity);
+    assert(input != NULL);
+    
+    size_t length = (size_t)snprintf(input, capacity, "---\n");
+    for (size_t i = 0; i < keys; i++) {
+        length += (size_t)snprintf(input + length, capacity - length, "key-%zu: value-%zu\n", i, i);
+    }
+    snprintf(input + length, capacity - length, "key-0: duplicate\n---\n# Heading\n");
+    return input;
+}
+
+/**
+ * @brief Check every key of build_large_frontmatter() output
+ */
+static void assert_large_frontmatter(const Document *doc, size_t keys) {
+    char key[32];
+    char value[32];
+    
+    assert(doc->metadata_count == keys + 1);
+    for (size_t i = 0; i < keys; i++) {
+        snprintf(key, sizeof(key), "key-%zu", i);
+        snprintf(value, sizeof(value), "value-%zu", i);
+        assert(get_metadata(doc, key) != NULL);
+        assert(strcmp(get_metadata(doc, key), value) == 0);
+    }
+    assert(get_metadata(doc, "missing") == NULL);
+    assert(get_metadata(doc, "key-") == NULL);
+}
+
+/**
+ * @brief Test metadata growth and indexed lookup
+ * 
+ * This test verifies that:
+ * - Frontmatter with hundreds of keys is stored completely
+ * - Every key is found, and a repeated key keeps its first value
+ * - Heap, arena and editable documents behave the same
+ * - Small frontmatter and documents built with add_metadata() work too
+ */
+void test_metadata_index() {
+    printf("Testing metadata index...\n");
+    
+    const size_t keys = 500;
+    char *input = build_large_frontmatter(keys);
+    
+    Document *doc = parse_metamark(input);
+    assert(doc != NULL);
+    assert_large_frontmatter(doc, keys);
+    assert(doc->metadata_capacity >= doc->metadata_count);
+    assert(strcmp(doc->metadata[keys].value, "duplicate") == 0);
+    free_document(doc);
+    
+    MMArena *arena = mm_arena_new(0);
+    assert(arena != NULL);
+    doc = parse_metamark_arena(input, arena);
+    assert(doc != NULL);
+    assert_large_frontmatter(doc, keys);
+    free_document(doc);
+    mm_arena_free(arena);
+    
+    // Rewriting the frontmatter of an editable document rebuilds the index
+    MMParseOptions options = { NULL, MM_PARSE_EDITABLE, 0 };
+    doc = mm_parse_document(NULL, input, strlen(input), &options);
+    assert(doc != NULL);
+    assert_large_frontmatter(doc, keys);
+    const char *first = strstr(input, "key-1:");
+    assert(first != NULL);
+    int result = mm_reparse(doc, (size_t)(first - input), 3, "new", 3, NULL);
+    assert(result == 0);
+    assert(get_metadata(doc, "key-1") == NULL);
+    assert(strcmp(get_metadata(doc, "new-1"), "value-1") == 0);
+    assert(strcmp(get_metadata(doc, "key-499"), "value-499") == 0);
+    free_document(doc);
+    free(input);
+    
+    // Below the index threshold lookups scan
+    doc = parse_metamark("---\na: 1\nb: 2\na: 3\n---\n# Heading\n");
+    assert(doc != NULL);
+    assert(doc->metadata_index == NULL);
+    assert(strcmp(get_metadata(doc, "a"), "1") == 0);
+    assert(strcmp(get_metadata(doc, "b"), "2") == 0);
+    
+    char key[32];
+    for (size_t i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "added-%zu", i);
+        add_metadata(doc, key, "x");
+    }
+    assert(doc->metadata_index != NULL);
+    assert(strcmp(get_metadata(doc, "a"), "1") == 0);
+    assert(strcmp(get_metadata(doc, "added-99"), "x") == 0);
+    free_document(doc);
+    
+    printf("Metadata index test passed\n");
+}
+
 /**
  * @brief Test AST structure and content
  * 
@@ -354,22 +475,2464 @@ void test_edge_cases() {
 }
 
 /**
- * @brief Main test entry point
+ * @brief Test arena-backed parsing
  * 
- * This function:
- * 1. Parses the test document
- * 2. Runs all test cases
- * 3. Prints the AST structure for visual inspection
- * 4. Cleans up resources
+ * This test verifies that:
+ * - An arena-backed parse produces the same tree as a heap parse
+ * - Nodes and the document are owned by the arena
+ * - The arena can be reused after free_document()
+ */
+void test_arena() {
+    printf("Testing arena parsing...\n");
+    
+    const char *input = "---\ntitle: Arena Test\n---\n\n"
+                       "# Heading\n\n"
+                       "A paragraph.\n\n"
+                       "[[diagram]]\ngraph TD\n[[/diagram]]\n";
+    
+    MMArena *arena = mm_arena_new(256);
+    assert(arena != NULL);
+    
+    Document *heap_doc = parse_metamark(input);
+    assert(heap_doc != NULL);
+    
+    for (int round = 0; round < 2; round++) {
+        Document *doc = parse_metamark_arena(input, arena);
+        assert(doc != NULL);
+        assert(doc->arena == arena);
+        assert(doc->root->arena == arena);
+        assert(doc->root->child_count == heap_doc->root->child_count);
+        
+        for (size_t i = 0; i < doc->root->child_count; i++) {
+            Node *a = doc->root->children[i];
+            Node *b = heap_doc->root->children[i];
+            assert(a->type == b->type);
+            assert(a->child_count == b->child_count);
+            assert(strcmp(a->content, b->content) == 0);
+        }
+        
+        assert(strcmp(get_metadata(doc, "title"), "Arena Test") == 0);
+        free_document(doc);
+    }
+    
+    assert(parse_metamark_arena(input, NULL) == NULL);
+    assert(get_last_error() == MM_ERROR_INVALID);
+    
+    free_document(heap_doc);
+    mm_arena_free(arena);
+    printf("Arena test passed\n");
+}
+
+/**
+ * @brief Check that two subtrees carry the same text
+ */
+static void assert_same_text(const Document *view_doc, const Node *view,
+                             const Node *copy) {
+    size_t length;
+    const char *text = mm_node_text(view_doc, view, &length);
+    
+    assert(view->type == copy->type);
+    assert(view->child_count == copy->child_count);
+    if (copy->content) {
+        assert(text != NULL);
+        assert(length == strlen(copy->content));
+        assert(memcmp(text, copy->content, length) == 0);
+    } else {
+        assert(text == NULL);
+    }
+    
+    for (size_t i = 0; i < copy->child_count; i++) {
+        assert_same_text(view_doc, view->children[i], copy->children[i]);
+    }
+}
+
+/**
+ * @brief Test zero-copy parsing
+ * 
+ * This test verifies that:
+ * - View nodes reference the caller's buffer instead of copying it
+ * - Every node's text matches the copying parser
+ * - The input does not need to be NUL-terminated
+ */
+void test_view() {
+    printf("Testing zero-copy parsing...\n");
+    
+    const char *input = "---\ntitle: View Test\n---\n\n"
+                       "# Heading\n\n"
+                       "A paragraph.\n\n"
+                       "[[diagram]]\ngraph TD\n[[/diagram]]\n\n"
+                       "> note: Remember this.\n\n"
+                       "%% %%\n"
+                       "# Last";
+    
+    // Copy into a buffer with trailing garbage and no terminator
+    size_t length = strlen(input);
+    char *buffer = malloc(length + 4);
+    assert(buffer != NULL);
+    memcpy(buffer, input, length);
+    memcpy(buffer + length, "#xyz", 4);
+    
+    Document *copy = parse_metamark(input);
+    Document *view = parse_metamark_view(buffer, length, NULL);
+    assert(copy != NULL && view != NULL);
+    assert(view->source == buffer);
+    
+    Node *heading = view->root->children[1];
+    assert(heading->flags & MM_NODE_VIEW);
+    assert(heading->content == NULL);
+    assert(buffer + heading->offset == mm_node_text(view, heading, NULL));
+    
+    assert_same_text(view, view->root, copy->root);
+    assert(strcmp(get_metadata(view, "title"), "View Test") == 0);
+    
+    // A heading at end of input keeps its last character
+    Node *last = copy->root->children[copy->root->child_count - 1];
+    assert(strcmp(last->content, "Last") == 0);
+    
+    free_document(view);
+    free_document(copy);
+    free(buffer);
+    printf("Zero-copy test passed\n");
+}
+
+/**
+ * @brief Trace sink that counts messages and remembers the first one
+ */
+typedef struct {
+    size_t count;
+    char first[64];
+} TraceCapture;
+
+static void capture_trace(const char *message, void *user_data) {
+    TraceCapture *capture = user_data;
+    if (capture->count++ == 0) {
+        snprintf(capture->first, sizeof(capture->first), "%s", message);
+    }
+}
+
+/**
+ * @brief Test the trace callback
+ * 
+ * This test verifies that:
+ * - Nothing is delivered while no callback is registered
+ * - Parser trace messages reach a registered callback in debug builds
+ * - Unregistering the callback stops delivery
+ */
+void test_trace() {
+    printf("Testing trace callback...\n");
+    
+    TraceCapture capture = {0};
+    mm_set_trace_callback(capture_trace, &capture);
+    
+    Document *doc = parse_metamark("# Traced\n");
+    assert(doc != NULL);
+    free_document(doc);
+    
+#ifndef NDEBUG
+    assert(capture.count > 0);
+    assert(strcmp(capture.first, "Found heading level 1") == 0);
+#endif
+    
+    mm_set_trace_callback(NULL, NULL);
+    size_t seen = capture.count;
+    doc = parse_metamark("# Quiet\n");
+    assert(doc != NULL);
+    free_document(doc);
+    assert(capture.count == seen);
+    
+    printf("Trace test passed\n");
+}
+
+/**
+ * @brief Check that two subtrees are identical, including source offsets
+ */
+static void assert_same_tree(const Node *a, const Node *b) {
+    assert(a->type == b->type);
+    assert(a->level == b->level);
+    assert(a->offset == b->offset);
+    assert(a->length == b->length);
+    assert(a->child_count == b->child_count);
+    assert((a->content == NULL) == (b->content == NULL));
+    if (a->content) {
+        assert(strcmp(a->content, b->content) == 0);
+    }
+    
+    for (size_t i = 0; i < a->child_count; i++) {
+        assert_same_tree(a->children[i], b->children[i]);
+    }
+}
+
+/**
+ * @brief Streaming callback that collects nodes into a second root
+ */
+static int collect_streamed(Node *node, void *user_data) {
+    Node *copy = user_data;
+    Node *clone = create_node(node->type, node->content);
+    assert(clone != NULL);
+    clone->level = node->level;
+    clone->offset = node->offset;
+    clone->length = node->length;
+    for (size_t i = 0; i < node->child_count; i++) {
+        Node *child = create_node(node->children[i]->type, node->children[i]->content);
+        child->offset = node->children[i]->offset;
+        child->length = node->children[i]->length;
+        add_child(clone, child);
+    }
+    add_child(copy, clone);
+    return 0;
+}
+
+/**
+ * @brief Test the streaming parser
+ * 
+ * This test verifies that:
+ * - Feeding a document in chunks of any size gives the same tree as
+ *   parse_metamark(), even when delimiters are split across chunks
+ * - Nodes reach the callback with absolute source offsets
+ * - Empty input is reported like parse_metamark() does
+ */
+void test_stream() {
+    printf("Testing streaming parser...\n");
+    
+    const char *input = "\n---\ntitle: Stream Test\nauthor: Jane\n---\n\n"
+                       "# Heading\n\n"
+                       "A paragraph that runs\nover two lines.\n\n"
+                       "[[diagram]]\ngraph TD\nA --> B\n[[/diagram]]\n"
+                       "> note: Split me.\n"
+                       "%% a comment %%\n"
+                       "Tail text";
+    size_t length = strlen(input);
+    
+    Document *expected = parse_metamark(input);
+    assert(expected != NULL);
+    
+    const size_t chunk_sizes[] = {1, 2, 3, 5, 16, 4096};
+    for (size_t c = 0; c < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); c++) {
+        // Collect into the document
+        MMParser *parser = mm_parser_new(NULL, NULL);
+        assert(parser != NULL);
+        for (size_t pos = 0; pos < length; pos += chunk_sizes[c]) {
+            size_t n = length - pos < chunk_sizes[c] ? length - pos : chunk_sizes[c];
+            int result = mm_parser_feed(parser, input + pos, n);
+            assert(result == 0);
+        }
+        Document *doc = mm_parser_finish(parser);
+        assert(doc != NULL);
+        assert_same_tree(doc->root, expected->root);
+        assert(doc->metadata_count == expected->metadata_count);
+        assert(strcmp(get_metadata(doc, "author"), "Jane") == 0);
+        free_document(doc);
+        mm_parser_free(parser);
+        
+        // Deliver through the callback
+        Node *streamed = create_node(NODE_DOCUMENT, NULL);
+        parser = mm_parser_new(collect_streamed, streamed);
+        for (size_t pos = 0; pos < length; pos += chunk_sizes[c]) {
+            size_t n = length - pos < chunk_sizes[c] ? length - pos : chunk_sizes[c];
+            int result = mm_parser_feed(parser, input + pos, n);
+            assert(result == 0);
+        }
+        doc = mm_parser_finish(parser);
+        assert(doc != NULL);
+        assert(doc->root->child_count == 0);
+        assert(strcmp(get_metadata(doc, "title"), "Stream Test") == 0);
+        assert_same_tree(streamed, expected->root);
+        free_node(streamed);
+        free_document(doc);
+        mm_parser_free(parser);
+    }
+    
+    // Whitespace-only input has no nodes
+    MMParser *parser = mm_parser_new(NULL, NULL);
+    int result = mm_parser_feed(parser, " \n\n ", 4);
+    assert(result == 0);
+    Document *finished = mm_parser_finish(parser);
+    assert(finished == NULL);
+    assert(get_last_error() == MM_ERROR_SYNTAX);
+    mm_parser_free(parser);
+    
+    free_document(expected);
+    printf("Streaming test passed\n");
+}
+
+/**
+ * @brief Event log filled by the SAX callbacks
+ */
+typedef struct {
+    char text[1024];
+    size_t length;
+    int stop_after;
+    int events;
+} EventLog;
+
+static int log_event(EventLog *log, const char *tag, const char *a, size_t alen,
+                     const char *b, size_t blen) {
+    int n = snprintf(log->text + log->length, sizeof(log->text) - log->length,
+                     "%s(%.*s|%.*s)", tag, (int)alen, a ? a : "", (int)blen, b ? b : "");
+    assert(n > 0 && (size_t)n < sizeof(log->text) - log->length);
+    log->length += (size_t)n;
+    log->events++;
+    return log->stop_after && log->events >= log->stop_after ? 42 : 0;
+}
+
+static int on_pair(const char *key, size_t klen, const char *value, size_t vlen, void *ud) {
+    return log_event(ud, "M", key, klen, value, vlen);
+}
+
+static int on_heading(size_t level, const char *text, size_t len, void *ud) {
+    char tag[8];
+    snprintf(tag, sizeof(tag), "H%zu", level);
+    return log_event(ud, tag, text, len, NULL, 0);
+}
+
+static int on_paragraph(const char *text, size_t len, void *ud) {
+    return log_event(ud, "P", text, len, NULL, 0);
+}
+
+static int on_begin(const char *type, size_t len, void *ud) {
+    return log_event(ud, "C", type, len, NULL, 0);
+}
+
+static int on_end(const char *type, size_t len, void *ud) {
+    return log_event(ud, "/C", type, len, NULL, 0);
+}
+
+static int on_annotation(const char *type, size_t tlen, const char *text, size_t len, void *ud) {
+    return log_event(ud, "A", type, tlen, text, len);
+}
+
+static int on_comment(const char *text, size_t len, void *ud) {
+    return log_event(ud, "X", text, len, NULL, 0);
+}
+
+void test_events() {
+    printf("Testing event parser...\n");
+    
+    const char *input = "---\ntitle: Events\n# skipped\nauthor : Jane \n---\n"
+                       "## Heading\n\n"
+                       "Some text.\n\n"
+                       "[[code]]\nint x;\n[[/code]]\n"
+                       "> note: Remember.\n"
+                       "> todo\n"
+                       "%% hidden %%";
+    const MMEventHandler handler = {
+        on_pair, on_heading, on_paragraph, on_begin, on_end, on_annotation, on_comment
+    };
+    
+    EventLog log;
+    memset(&log, 0, sizeof(log));
+    int result = mm_parse_events(input, strlen(input), &handler, &log);
+    assert(result == 0);
+    assert(strcmp(log.text,
+                  "M(title|Events)M(author|Jane)H2(Heading|)P(Some text.|)"
+                  "C(code|)P(int x;\n|)/C(code|)A(note|Remember.)A(todo|)X(hidden|)") == 0);
+    
+    // A nonzero callback result stops parsing and is passed through
+    memset(&log, 0, sizeof(log));
+    log.stop_after = 3;
+    result = mm_parse_events(input, strlen(input), &handler, &log);
+    assert(result == 42);
+    assert(log.events == 3);
+    
+    // Missing callbacks are skipped
+    const MMEventHandler headings_only = { .on_heading = on_heading };
+    memset(&log, 0, sizeof(log));
+    result = mm_parse_events(input, strlen(input), &headings_only, &log);
+    assert(result == 0);
+    assert(strcmp(log.text, "H2(Heading|)") == 0);
+    
+    // Errors match parse_metamark()
+    result = mm_parse_events("  \n ", 4, &handler, &log);
+    assert(result == -1);
+    assert(get_last_error() == MM_ERROR_SYNTAX);
+    result = mm_parse_events(NULL, 0, &handler, &log);
+    assert(result == -1);
+    assert(get_last_error() == MM_ERROR_INVALID);
+    
+    printf("Event parser test passed\n");
+}
+
+/**
+ * @brief Write a file for the file input tests
+ */
+static void write_test_file(const char *path, const char *content, size_t length) {
+    FILE *file = fopen(path, "wb");
+    assert(file != NULL);
+    size_t written = fwrite(content, 1, length, file);
+    assert(written == length);
+    fclose(file);
+}
+
+void test_mapped_file() {
+    printf("Testing mapped file input...\n");
+    
+    const char *path = "test_mapped.mmk";
+    const char *input = "---\r\ntitle: Mapped\r\n---\r\n# Heading\r\n\r\nBody text.\r\n";
+    write_test_file(path, input, strlen(input));
+    
+    // Binary reads keep every byte, so both readers agree
+    Document *copied = read_metamark_file(path);
+    Document *mapped = read_metamark_file_mapped(path);
+    assert(copied != NULL && mapped != NULL);
+    assert(mapped->mapping != NULL);
+    assert(mapped->source_length == strlen(input));
+    assert(strcmp(get_metadata(mapped, "title"), "Mapped") == 0);
+    assert(mapped->root->child_count == copied->root->child_count);
+    for (size_t i = 0; i < copied->root->child_count; i++) {
+        assert_same_text(mapped, mapped->root->children[i], copied->root->children[i]);
+    }
+    free_document(copied);
+    free_document(mapped);
+    
+    // Empty files map to an empty view and fail like empty strings
+    write_test_file(path, "", 0);
+    assert(read_metamark_file_mapped(path) == NULL);
+    assert(get_last_error() == MM_ERROR_SYNTAX);
+    
+    remove(path);
+    assert(read_metamark_file_mapped(path) == NULL);
+    assert(get_last_error() == MM_ERROR_IO);
+    
+    printf("Mapped file test passed\n");
+}
+
+void test_scan() {
+    printf("Testing special byte scanner...\n");
+    
+    // Every vector lane and tail position, for each special byte
+    const char specials[] = { '\0', '\n', '#', '[', '%', '-', '>', ']' };
+    char buffer[100];
+    for (size_t s = 0; s < sizeof(specials); s++) {
+        for (size_t hit = 0; hit < sizeof(buffer); hit++) {
+            memset(buffer, 'a', sizeof(buffer));
+            buffer[hit] = specials[s];
+            for (size_t pos = 0; pos <= sizeof(buffer); pos++) {
+                size_t expected = pos <= hit ? hit : sizeof(buffer);
+                assert(mm_scan_special(buffer, pos, sizeof(buffer)) == expected);
+            }
+        }
+    }
+    
+    // Bytes next to the special ones, including high-bit bytes
+    for (int c = 0; c < 256; c++) {
+        memset(buffer, c, sizeof(buffer));
+        size_t expected = MM_SCAN_IS_SPECIAL((char)c) ? 0 : sizeof(buffer);
+        assert(mm_scan_special(buffer, 0, sizeof(buffer)) == expected);
+    }
+    
+    // Long prose still parses the same paragraph boundaries
+    char prose[600];
+    memset(prose, 'x', sizeof(prose));
+    memcpy(prose + 250, "\n\n# Title\nmore - text %% c %%", 30);
+    prose[sizeof(prose) - 1] = '\0';
+    Document *doc = parse_metamark(prose);
+    assert(doc != NULL);
+    assert(doc->root->children[0]->type == NODE_PARAGRAPH);
+    assert(strlen(doc->root->children[0]->content) == 250);
+    assert(doc->root->children[1]->type == NODE_HEADING);
+    free_document(doc);
+    
+    printf("Scanner test passed\n");
+}
+
+void test_context() {
+    printf("Testing parse contexts...\n");
+    
+    MMContext ctx;
+    const char *input = "# Title\n>: missing type\n";
+    
+    // Errors carry the position of the rejected block
+    Document *doc = mm_parse_document(&ctx, input, strlen(input), NULL);
+    assert(doc != NULL);
+    assert(ctx.error == MM_ERROR_SYNTAX);
+    assert(ctx.offset == 9);
+    assert(ctx.line == 2);
+    assert(ctx.column == 2);
+    free_document(doc);
+    
+    // A context isolates the call from the thread default
+    assert(parse_metamark("") == NULL);
+    assert(get_last_error() == MM_ERROR_SYNTAX);
+    MMParseOptions options = { NULL, MM_PARSE_VIEW, 0 };
+    doc = mm_parse_document(&ctx, "Plain text", 10, &options);
+    assert(doc != NULL);
+    assert(ctx.error == MM_ERROR_NONE && ctx.line == 0);
+    assert(doc->root->children[0]->flags & MM_NODE_VIEW);
+    assert(get_last_error() == MM_ERROR_SYNTAX);
+    free_document(doc);
+    
+    assert(mm_parse_document(&ctx, NULL, 0, NULL) == NULL);
+    assert(ctx.error == MM_ERROR_INVALID);
+    
+    printf("Context test passed\n");
+}
+
+/**
+ * @brief Tally of batch results
+ */
+typedef struct {
+    int seen[32];
+    size_t parsed;
+    size_t failed;
+    size_t stop_after;
+    size_t calls;
+} BatchTally;
+
+static int tally_batch(const MMBatchResult *result, void *user_data) {
+    BatchTally *tally = user_data;
+    tally->seen[result->index]++;
+    tally->calls++;
+    
+    if (result->doc) {
+        size_t length;
+        const Node *heading = result->doc->root->children[0];
+        const char *text = mm_node_text(result->doc, heading, &length);
+        assert(heading->type == NODE_HEADING);
+        assert(length == strlen(result->path) && memcmp(text, result->path, length) == 0);
+        assert(result->context.error == MM_ERROR_NONE);
+        tally->parsed++;
+    } else {
+        tally->failed++;
+    }
+    
+    return tally->stop_after && tally->calls == tally->stop_after ? 7 : 0;
+}
+
+void test_batch() {
+    printf("Testing batch parsing...\n");
+    
+    enum { FILES = 24 };
+    char names[FILES][32];
+    const char *paths[FILES];
+    for (size_t i = 0; i < FILES; i++) {
+        snprintf(names[i], sizeof(names[i]), "test_batch_%zu.mmk", i);
+        paths[i] = names[i];
+        if (i == 5) {
+            continue;  // Missing file
+        }
+        if (i == 9) {
+            write_test_file(names[i], "", 0);  // Empty file
+            continue;
+        }
+        char content[128];
+        int n = snprintf(content, sizeof(content), "# %s\n\nBody of file %zu.\n", names[i], i);
+        write_test_file(names[i], content, (size_t)n);
+    }
+    
+    // The failures on this thread are untouched by the workers
+    assert(parse_metamark(NULL) == NULL);
+    
+    BatchTally tally;
+    memset(&tally, 0, sizeof(tally));
+    int result = mm_parse_batch(paths, FILES, 4, tally_batch, &tally);
+    assert(result == 0);
+    assert(tally.parsed == FILES - 2 && tally.failed == 2);
+    for (size_t i = 0; i < FILES; i++) {
+        assert(tally.seen[i] == 1);
+    }
+    assert(get_last_error() == MM_ERROR_INVALID);
+    
+    // A nonzero callback result stops the batch
+    memset(&tally, 0, sizeof(tally));
+    tally.stop_after = 3;
+    result = mm_parse_batch(paths, FILES, 4, tally_batch, &tally);
+    assert(result == 7);
+    assert(tally.calls == 3);
+    
+    // More threads than files, and the calling thread alone
+    memset(&tally, 0, sizeof(tally));
+    result = mm_parse_batch(paths, 2, 16, tally_batch, &tally);
+    assert(result == 0);
+    assert(tally.parsed == 2);
+    memset(&tally, 0, sizeof(tally));
+    result = mm_parse_batch(paths, FILES, 1, tally_batch, &tally);
+    assert(result == 0);
+    assert(tally.calls == FILES);
+    
+    for (size_t i = 0; i < FILES; i++) {
+        remove(names[i]);
+    }
+    printf("Batch test passed\n");
+}
+
+void test_parallel() {
+    printf("Testing parallel parsing...\n");
+    
+    // Enough blocks of every kind to spread over several workers
+    size_t capacity = 1 << 20;
+    char *input = malloc(capacity);
+    assert(input != NULL);
+    size_t length = (size_t)snprintf(input, capacity, "---\ntitle: Parallel\n---\n");
+    for (int i = 0; i < 2000; i++) {
+        length += (size_t)snprintf(input + length, capacity - length,
+                                   "## Section %d\n\nParagraph %d\nwith two lines.\n\n"
+                                   "[[note]]\nBody %d\n[[/note]]\n> todo: item %d\n%%%% c %d %%%%\n",
+                                   i, i, i, i, i);
+    }
+    
+    Document *serial = parse_metamark(input);
+    assert(serial != NULL);
+    assert(serial->root->child_count > 4096);
+    
+    const size_t thread_counts[] = {0, 1, 3, 8};
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+        MMContext ctx;
+        MMParseOptions options = { NULL, MM_PARSE_PARALLEL, thread_counts[t] };
+        Document *doc = mm_parse_document(&ctx, input, length, &options);
+        assert(doc != NULL);
+        assert(ctx.error == MM_ERROR_NONE);
+        assert_same_tree(doc->root, serial->root);
+        assert(strcmp(get_metadata(doc, "title"), "Parallel") == 0);
+        free_document(doc);
+    }
+    
+    // Views and arenas give the same tree too
+    MMArena *arena = mm_arena_new(0);
+    MMParseOptions options = { arena, MM_PARSE_PARALLEL | MM_PARSE_VIEW, 4 };
+    Document *doc = mm_parse_document(NULL, input, length, &options);
+    assert(doc != NULL);
+    assert(doc->root->child_count == serial->root->child_count);
+    for (size_t i = 0; i < serial->root->child_count; i++) {
+        assert_same_text(doc, doc->root->children[i], serial->root->children[i]);
+    }
+    free_document(doc);
+    mm_arena_free(arena);
+    
+    free_document(serial);
+    free(input);
+    printf("Parallel parsing test passed\n");
+}
+
+/**
+ * @brief Get the offset of a substring that must be present
+ */
+static size_t find_text(const char *text, const char *needle) {
+    const char *found = strstr(text, needle);
+    assert(found != NULL);
+    return (size_t)(found - text);
+}
+
+/**
+ * @brief Apply one edit to an editable document and to a plain copy of its text
+ * 
+ * The reparsed tree must match a fresh parse of the edited text, and every
+ * child outside the reported range must be the very node it was before.
+ */
+static MMRange check_reparse(Document *doc, char **text, size_t offset, size_t old_length,
+                          const char *new_text) {
+    size_t new_length = strlen(new_text);
+    size_t length = strlen(*text);
+    size_t old_count = doc->root->child_count;
+    Node **before = malloc((old_count + 1) * sizeof(Node*));
+    assert(before != NULL);
+    memcpy(before, doc->root->children, old_count * sizeof(Node*));
+    
+    char *edited = malloc(length - old_length + new_length + 1);
+    assert(edited != NULL);
+    memcpy(edited, *text, offset);
+    memcpy(edited + offset, new_text, new_length);
+    strcpy(edited + offset + new_length, *text + offset + old_length);
+    free(*text);
+    *text = edited;
+    
+    MMRange range;
+    int result = mm_reparse(doc, offset, old_length, new_text, new_length, &range);
+    assert(result == 0);
+    assert(range.first + range.inserted <= doc->root->child_count);
+    assert(old_count - range.removed == doc->root->child_count - range.inserted);
+    for (size_t i = 0; i < range.first; i++) {
+        assert(doc->root->children[i] == before[i]);
+    }
+    for (size_t i = range.first + range.inserted; i < doc->root->child_count; i++) {
+        assert(doc->root->children[i] == before[i - range.inserted + range.removed]);
+    }
+    
+    Document *fresh = parse_metamark(edited);
+    if (fresh) {
+        if (doc->source) {
+            assert(doc->source_length == strlen(edited));
+            assert_same_text(doc, doc->root, fresh->root);
+        } else {
+            assert_same_tree(doc->root, fresh->root);
+        }
+        assert(doc->metadata_count == fresh->metadata_count);
+        for (size_t i = 0; i < fresh->metadata_count; i++) {
+            assert(strcmp(get_metadata(doc, fresh->metadata[i].key), fresh->metadata[i].value) == 0);
+        }
+        free_document(fresh);
+    } else {
+        assert(doc->root->child_count == 0);
+    }
+    free(before);
+    return range;
+}
+
+/**
+ * @brief Test incremental reparsing
+ * 
+ * This test verifies that:
+ * - Edits inside and across blocks give the tree of a full parse
+ * - Nodes before and after the changed span are reused
+ * - Frontmatter edits update the metadata
+ * - View documents keep resolving against the edited text
+ * - Invalid edits are rejected
+ */
+void test_reparse() {
+    printf("Testing incremental reparse...\n");
+    
+    const char *input = "---\ntitle: Edit\n---\n\n"
+                       "# Heading\n\n"
+                       "First paragraph.\n\n"
+                       "[[note]]\nInside the note.\n[[/note]]\n\n"
+                       "> todo: Check this.\n\n"
+                       "%% comment %%\n\n"
+                       "Last paragraph\nwith two lines.\n";
+    
+    for (int view = 0; view <= 1; view++) {
+        MMParseOptions options = { NULL, MM_PARSE_EDITABLE | (view ? MM_PARSE_VIEW : 0), 0 };
+        Document *doc = mm_parse_document(NULL, input, strlen(input), &options);
+        assert(doc != NULL);
+        char *text = malloc(strlen(input) + 1);
+        assert(text != NULL);
+        strcpy(text, input);
+        
+        // Typing inside a paragraph only replaces that paragraph
+        size_t count = doc->root->child_count;
+        MMRange range = check_reparse(doc, &text, find_text(text, "First") + 5, 0,
+                                      " and only");
+        assert(range.first == 2 && range.removed == 1 && range.inserted == 1);
+        assert(doc->root->child_count == count);
+        
+        check_reparse(doc, &text, find_text(text, "Heading"), 7, "Title");
+        check_reparse(doc, &text, find_text(text, "Inside"), 0, "Still ");
+        check_reparse(doc, &text, find_text(text, "note]]\nStill"), 4, "warning");
+        check_reparse(doc, &text, find_text(text, "[[/note]]") + 3, 4, "warning");
+        check_reparse(doc, &text, find_text(text, "todo"), 4, "idea");
+        check_reparse(doc, &text, find_text(text, "%%"), 0, "\n\n## New");
+        
+        // Joining and splitting blocks
+        check_reparse(doc, &text, find_text(text, "paragraph.\n\n") + 10, 2, " ");
+        check_reparse(doc, &text, find_text(text, "Last") - 1, 0, "\n\n");
+        check_reparse(doc, &text, find_text(text, "two"), 0, "\n\n# Split ");
+        
+        // Opening a component swallows the following blocks until its end
+        check_reparse(doc, &text, find_text(text, "# Title"), 0, "[[box]]\n");
+        check_reparse(doc, &text, find_text(text, "[[box]]"), 8, "");
+        
+        // Frontmatter edits
+        check_reparse(doc, &text, find_text(text, "Edit"), 4, "Changed");
+        assert(strcmp(get_metadata(doc, "title"), "Changed") == 0);
+        check_reparse(doc, &text, find_text(text, "---\n\n"), 0, "author: Me\n");
+        assert(strcmp(get_metadata(doc, "author"), "Me") == 0);
+        check_reparse(doc, &text, 0, 1, "");
+        assert(get_metadata(doc, "title") == NULL);
+        check_reparse(doc, &text, 0, 0, "-");
+        assert(strcmp(get_metadata(doc, "title"), "Changed") == 0);
+        
+        // Edits at the very end
+        check_reparse(doc, &text, strlen(text), 0, "tail");
+        check_reparse(doc, &text, strlen(text) - 4, 4, "");
+        check_reparse(doc, &text, strlen(text), 0, "\n\n# End");
+        
+        // Pseudo-random edits drawn from MetaMark syntax fragments
+        static const char *const fragments[] = {
+            "", "x", " ", "\n", "\n\n", "# ", "## H", "[[a]]\n", "[[/a]]\n", "[[",
+            "]]", "> note: n", "%% ", " %%", "---\n", "text\nmore", ":", "[[/"
+        };
+        const size_t fragment_count = sizeof(fragments) / sizeof(fragments[0]);
+        unsigned int seed = 12345u + (unsigned int)view;
+        for (int i = 0; i < 600; i++) {
+            seed = seed * 1103515245u + 12345u;
+            size_t length = strlen(text);
+            size_t offset = length ? (seed >> 8) % (length + 1) : 0;
+            seed = seed * 1103515245u + 12345u;
+            size_t removed = (seed >> 8) % 6;
+            if (removed > length - offset) {
+                removed = length - offset;
+            }
+            seed = seed * 1103515245u + 12345u;
+            check_reparse(doc, &text, offset, removed, fragments[(seed >> 8) % fragment_count]);
+        }
+        
+        // Deleting everything leaves an empty root, typing brings it back
+        check_reparse(doc, &text, 0, strlen(text), "");
+        check_reparse(doc, &text, 0, 0, "# Again\n\nBody");
+        assert(doc->root->child_count == 2);
+        
+        // Out of range edits are rejected and leave the document alone
+        int result = mm_reparse(doc, strlen(text) + 1, 0, "x", 1, NULL);
+        assert(result == -1);
+        assert(get_last_error() == MM_ERROR_INVALID);
+        result = mm_reparse(doc, 0, strlen(text) + 1, "", 0, NULL);
+        assert(result == -1);
+        result = mm_reparse(doc, 0, 0, NULL, 1, NULL);
+        assert(result == -1);
+        assert(doc->root->child_count == 2);
+        
+        free_document(doc);
+        free(text);
+    }
+    
+    // Only editable documents can be reparsed, and they never use an arena
+    Document *plain = parse_metamark("# Plain");
+    assert(plain != NULL);
+    int result = mm_reparse(plain, 0, 0, "x", 1, NULL);
+    assert(result == -1);
+    free_document(plain);
+    
+    MMArena *arena = mm_arena_new(0);
+    MMParseOptions options = { arena, MM_PARSE_EDITABLE, 0 };
+    assert(mm_parse_document(NULL, "# A", 3, &options) == NULL);
+    mm_arena_free(arena);
+    
+    printf("Incremental reparse test passed\n");
+}
+
+/**
+ * @brief Sink that appends rendered output to a heap string
+ */
+typedef struct {
+    char *data;
+    size_t length;
+    size_t writes;
+    size_t stop_after;
+} RenderCapture;
+
+static int capture_render(const char *data, size_t length, void *user_data) {
+    RenderCapture *capture = user_data;
+    capture->data = realloc(capture->data, capture->length + length + 1);
+    assert(capture->data != NULL);
+    memcpy(capture->data + capture->length, data, length);
+    capture->length += length;
+    capture->data[capture->length] = '\0';
+    capture->writes++;
+    return capture->stop_after && capture->writes >= capture->stop_after ? 7 : 0;
+}
+
+/**
+ * @brief Test HTML rendering
+ * 
+ * This test verifies that:
+ * - Every block type maps to its element and text is escaped
+ * - Comments and frontmatter are left out
+ * - View documents and sinks give the same output as the string renderer
+ * - Large outputs are flushed to the sink in chunks and a sink can stop
+ */
+void test_html() {
+    printf("Testing HTML rendering...\n");
+    
+    const char *input = "---\ntitle: A <Title>\n---\n\n"
+                       "# Fish & Chips\n\n"
+                       "### Level \"three\"\n\n"
+                       "Use <b & 'quotes'.\n\n"
+                       "[[note]]\nInside & out\n[[/note]]\n\n"
+                       "> todo: Check <this>\n\n"
+                       "%% hidden %%\n";
+    const char *expected = "<h1>Fish &amp; Chips</h1>\n"
+                          "<h3>Level &quot;three&quot;</h3>\n"
+                          "<p>Use &lt;b &amp; &#39;quotes&#39;.</p>\n"
+                          "<div class=\"mm-component\" data-type=\"note\">\n"
+                          "<p>Inside &amp; out\n</p>\n"
+                          "</div>\n"
+                          "<aside class=\"mm-annotation\" data-type=\"todo\">\n"
+                          "<p>Check &lt;this&gt;</p>\n"
+                          "</aside>\n";
+    
+    Document *doc = parse_metamark(input);
+    assert(doc != NULL);
+    char *html = render_metamark_html(doc);
+    assert(html != NULL);
+    assert(strcmp(html, expected) == 0);
+    free(html);
+    
+    Document *view = parse_metamark_view(input, strlen(input), NULL);
+    assert(view != NULL);
+    html = render_metamark_html(view);
+    assert(html != NULL);
+    assert(strcmp(html, expected) == 0);
+    free(html);
+    free_document(view);
+    
+    // A standalone page wraps the same fragment
+    RenderCapture capture = {0};
+    int result = mm_render_html(doc, MM_HTML_STANDALONE, capture_render, &capture);
+    assert(result == 0);
+    assert(capture.writes == 1);
+    assert(strstr(capture.data, "<title>A &lt;Title&gt;</title>") != NULL);
+    assert(strstr(capture.data, expected) != NULL);
+    assert(strstr(capture.data, "hidden") == NULL);
+    free(capture.data);
+    free_document(doc);
+    
+    // Large documents reach the sink in several chunks
+    size_t capacity = 1 << 18;
+    char *large = malloc(capacity);
+    assert(large != NULL);
+    size_t length = 0;
+    for (int i = 0; i < 2000; i++) {
+        length += (size_t)snprintf(large + length, capacity - length,
+                                   "## Part %d\n\nText <%d> & more\n\n", i, i);
+    }
+    doc = parse_metamark(large);
+    assert(doc != NULL);
+    html = render_metamark_html(doc);
+    assert(html != NULL);
+    memset(&capture, 0, sizeof(capture));
+    result = mm_render_html(doc, 0, capture_render, &capture);
+    assert(result == 0);
+    assert(capture.writes > 1);
+    assert(strcmp(capture.data, html) == 0);
+    free(capture.data);
+    free(html);
+    
+    // A sink stops rendering by returning nonzero
+    memset(&capture, 0, sizeof(capture));
+    capture.stop_after = 1;
+    result = mm_render_html(doc, 0, capture_render, &capture);
+    assert(result == 7);
+    assert(capture.writes == 1);
+    free(capture.data);
+    free_document(doc);
+    free(large);
+    
+    assert(render_metamark_html(NULL) == NULL);
+    assert(get_last_error() == MM_ERROR_INVALID);
+    
+    printf("HTML rendering test passed\n");
+}
+
+/**
+ * @brief Drop the whitespace between JSON tokens
+ */
+static char* strip_json_whitespace(const char *json) {
+    char *result = malloc(strlen(json) + 1);
+    assert(result != NULL);
+    size_t length = 0;
+    int in_string = 0;
+    
+    for (const char *p = json; *p; p++) {
+        if (in_string) {
+            result[length++] = *p;
+            if (*p == '\\') {
+                result[length++] = *++p;
+            } else if (*p == '"') {
+                in_string = 0;
+            }
+        } else if (*p == '"') {
+            result[length++] = *p;
+            in_string = 1;
+        } else if (*p != ' ' && *p != '\n') {
+            result[length++] = *p;
+        }
+    }
+    result[length] = '\0';
+    return result;
+}
+
+/**
+ * @brief Streaming callback that writes each node as JSON
  */
+static int stream_json(Node *node, void *user_data) {
+    return mm_json_writer_node(user_data, NULL, node);
+}
+
+/**
+ * @brief Test JSON serialization
+ * 
+ * This test verifies that:
+ * - Nodes, levels and metadata are written with correct string escapes
+ * - Invalid UTF-8 is replaced and valid UTF-8 is kept
+ * - Pretty output only differs from compact output in whitespace
+ * - Offsets are included on request
+ * - Nodes from the streaming parser give the same JSON as a full parse
+ */
+void test_json() {
+    printf("Testing JSON serialization...\n");
+    
+    const char *input = "---\ntitle: \"Quoted\" \\ back\n---\n"
+                       "## Caf\xc3\xa9\n\n"
+                       "Tab\there\x01 and \xff bad\n"
+                       "[[note]]\nBody\n[[/note]]\n";
+    const char *expected = "{\"type\":\"DOCUMENT\",\"children\":["
+                          "{\"type\":\"METADATA\",\"content\":\"\\ntitle: \\\"Quoted\\\" \\\\ back\\n\","
+                          "\"children\":[{\"type\":\"PARAGRAPH\",\"content\":\"title:\\\"Quoted\\\" \\\\ back\"}]},"
+                          "{\"type\":\"HEADING\",\"level\":2,\"content\":\"Caf\xc3\xa9\"},"
+                          "{\"type\":\"PARAGRAPH\",\"content\":\"Tab\\there\\u0001 and \\ufffd bad\"},"
+                          "{\"type\":\"COMPONENT\",\"content\":\"note\","
+                          "\"children\":[{\"type\":\"PARAGRAPH\",\"content\":\"Body\\n\"}]}],"
+                          "\"metadata\":{\"title\":\"\\\"Quoted\\\" \\\\ back\"}}";
+    
+    Document *doc = parse_metamark(input);
+    assert(doc != NULL);
+    RenderCapture compact = {0};
+    int result = mm_write_json(doc, MM_JSON_COMPACT, capture_render, &compact);
+    assert(result == 0);
+    assert(strcmp(compact.data, expected) == 0);
+    
+    RenderCapture pretty = {0};
+    result = mm_write_json(doc, 0, capture_render, &pretty);
+    assert(result == 0);
+    assert(strstr(pretty.data, "{\n  \"type\": \"DOCUMENT\",\n  \"children\": [\n    {") == pretty.data);
+    char *stripped = strip_json_whitespace(pretty.data);
+    assert(strcmp(stripped, expected) == 0);
+    free(stripped);
+    free(pretty.data);
+    free(compact.data);
+    
+    // Offsets locate every node in the source
+    RenderCapture offsets = {0};
+    result = mm_write_json(doc, MM_JSON_COMPACT | MM_JSON_OFFSETS, capture_render, &offsets);
+    assert(result == 0);
+    char needle[64];
+    snprintf(needle, sizeof(needle), "\"offset\":%zu,\"length\":%zu",
+             (size_t)(strstr(input, "Caf") - input), strlen("Caf\xc3\xa9"));
+    assert(strstr(offsets.data, needle) != NULL);
+    free(offsets.data);
+    free_document(doc);
+    
+    // The streaming parser and the writer never hold more than one block
+    size_t capacity = 1 << 17;
+    char *large = malloc(capacity);
+    assert(large != NULL);
+    size_t length = (size_t)snprintf(large, capacity, "---\ntitle: Big\n---\n");
+    for (int i = 0; i < 1000; i++) {
+        length += (size_t)snprintf(large + length, capacity - length,
+                                   "# Part %d\n\nText \"%d\"\n\n> note: n%d\n", i, i, i);
+    }
+    
+    doc = parse_metamark(large);
+    assert(doc != NULL);
+    RenderCapture whole = {0};
+    result = mm_write_json(doc, MM_JSON_OFFSETS, capture_render, &whole);
+    assert(result == 0);
+    assert(whole.writes > 1);
+    free_document(doc);
+    
+    RenderCapture streamed = {0};
+    MMJsonWriter *writer = mm_json_writer_new(MM_JSON_OFFSETS, capture_render, &streamed);
+    assert(writer != NULL);
+    MMParser *parser = mm_parser_new(stream_json, writer);
+    assert(parser != NULL);
+    for (size_t pos = 0; pos < length; pos += 1000) {
+        result = mm_parser_feed(parser, large + pos, length - pos < 1000 ? length - pos : 1000);
+        assert(result == 0);
+    }
+    doc = mm_parser_finish(parser);
+    assert(doc != NULL);
+    result = mm_json_writer_finish(writer, doc);
+    assert(result == 0);
+    assert(strcmp(streamed.data, whole.data) == 0);
+    mm_json_writer_free(writer);
+    mm_parser_free(parser);
+    free_document(doc);
+    free(streamed.data);
+    free(whole.data);
+    free(large);
+    
+    // A writer without nodes or metadata still writes valid JSON
+    memset(&compact, 0, sizeof(compact));
+    writer = mm_json_writer_new(MM_JSON_COMPACT, capture_render, &compact);
+    assert(writer != NULL);
+    result = mm_json_writer_finish(writer, NULL);
+    assert(result == 0);
+    assert(strcmp(compact.data, "{\"type\":\"DOCUMENT\",\"children\":[],\"metadata\":{}}") == 0);
+    mm_json_writer_free(writer);
+    free(compact.data);
+    
+    result = mm_write_json(NULL, 0, capture_render, NULL);
+    assert(result == -1);
+    assert(get_last_error() == MM_ERROR_INVALID);
+    
+    printf("JSON serialization test passed\n");
+}
+
+/**
+ * @brief Check that a snapshot subtree matches a document subtree
+ */
+static void assert_same_snapshot(const MMSnapshot *snapshot, size_t index,
+                                 const Document *doc, const Node *node) {
+    MMSnapshotNode entry;
+    size_t length;
+    const char *text = mm_node_text(doc, node, &length);
+    
+    int result = mm_snapshot_node(snapshot, index, &entry);
+    assert(result == 0);
+    assert(entry.type == node->type);
+    assert(entry.level == node->level);
+    assert(entry.offset == node->offset);
+    assert(entry.child_count == node->child_count);
+    if (text) {
+        assert(entry.content != NULL);
+        assert(entry.length == length);
+        assert(memcmp(entry.content, text, length) == 0);
+        assert(entry.content[length] == '\0');
+    } else {
+        assert(entry.content == NULL);
+    }
+    
+    for (size_t i = 0; i < node->child_count; i++) {
+        assert_same_snapshot(snapshot, entry.first_child + i, doc, node->children[i]);
+    }
+}
+
+/**
+ * @brief Test binary snapshots
+ * 
+ * This test verifies that:
+ * - A snapshot reproduces the tree, the metadata and the stamp
+ * - Copied and view documents give identical snapshots
+ * - Malformed snapshots are rejected when opened or read
+ */
+void test_snapshot() {
+    printf("Testing binary snapshots...\n");
+    
+    const char *path = "test_snapshot.mms";
+    const char *input = "---\ntitle: Snapshot\nauthor: Jane\n---\n\n"
+                       "# Heading\n\n"
+                       "First paragraph.\n\n"
+                       "[[note]]\nInside the note.\n[[/note]]\n\n"
+                       "> todo: Check this.\n\n"
+                       "%% comment %%\n"
+                       "## Last";
+    
+    Document *doc = parse_metamark(input);
+    assert(doc != NULL);
+    int result = mm_snapshot_save(doc, 0x0123456789abcdefULL, path);
+    assert(result == 0);
+    
+    MMSnapshot *snapshot = mm_snapshot_open(path);
+    assert(snapshot != NULL);
+    assert(mm_snapshot_stamp(snapshot) == 0x0123456789abcdefULL);
+    assert_same_snapshot(snapshot, 0, doc, doc->root);
+    assert(mm_snapshot_metadata_count(snapshot) == 2);
+    assert(strcmp(mm_snapshot_get_metadata(snapshot, "title"), "Snapshot") == 0);
+    assert(strcmp(mm_snapshot_get_metadata(snapshot, "author"), "Jane") == 0);
+    assert(mm_snapshot_get_metadata(snapshot, "missing") == NULL);
+    
+    MMSnapshotNode entry;
+    result = mm_snapshot_node(snapshot, mm_snapshot_node_count(snapshot), &entry);
+    assert(result == -1);
+    const char *key, *value;
+    result = mm_snapshot_metadata(snapshot, 2, &key, &value);
+    assert(result == -1);
+    mm_snapshot_close(snapshot);
+    
+    // View documents serialize to the very same bytes
+    RenderCapture copied = {0};
+    RenderCapture viewed = {0};
+    Document *view = parse_metamark_view(input, strlen(input), NULL);
+    assert(view != NULL);
+    result = mm_snapshot_write(doc, 1, capture_render, &copied);
+    assert(result == 0);
+    result = mm_snapshot_write(view, 1, capture_render, &viewed);
+    assert(result == 0);
+    assert(copied.length == viewed.length);
+    assert(memcmp(copied.data, viewed.data, copied.length) == 0);
+    free_document(view);
+    free_document(doc);
+    
+    // A bad magic, version or truncation is caught when opening
+    char *bytes = malloc(copied.length);
+    assert(bytes != NULL);
+    memcpy(bytes, copied.data, copied.length);
+    bytes[0] = 'X';
+    write_test_file(path, bytes, copied.length);
+    assert(mm_snapshot_open(path) == NULL);
+    assert(get_last_error() == MM_ERROR_SYNTAX);
+    
+    memcpy(bytes, copied.data, copied.length);
+    bytes[8] = 2;
+    write_test_file(path, bytes, copied.length);
+    assert(mm_snapshot_open(path) == NULL);
+    
+    write_test_file(path, copied.data, copied.length - 1);
+    assert(mm_snapshot_open(path) == NULL);
+    write_test_file(path, copied.data, 10);
+    assert(mm_snapshot_open(path) == NULL);
+    
+    // Corrupt records are caught when they are read
+    memcpy(bytes, copied.data, copied.length);
+    bytes[64 + 8] = 0;   // root's first child points at the root itself
+    bytes[64 + 32 + 20] = (char)0xff;  // first child's content misses its terminator
+    write_test_file(path, bytes, copied.length);
+    snapshot = mm_snapshot_open(path);
+    assert(snapshot != NULL);
+    result = mm_snapshot_node(snapshot, 0, &entry);
+    assert(result == -1);
+    result = mm_snapshot_node(snapshot, 1, &entry);
+    assert(result == -1);
+    result = mm_snapshot_node(snapshot, 2, &entry);
+    assert(result == 0);
+    mm_snapshot_close(snapshot);
+    
+    free(bytes);
+    free(copied.data);
+    free(viewed.data);
+    remove(path);
+    assert(mm_snapshot_open(path) == NULL);
+    
+    printf("Binary snapshot test passed\n");
+}
+
+/**
+ * @brief Check that a frozen subtree matches a document subtree
+ *
+ * @return size_t The index one past the subtree, in pre-order
+ */
+static size_t assert_same_frozen(const MMFrozenDocument *frozen, size_t index, uint32_t depth,
+                                 const Document *doc, const Node *node) {
+    size_t length;
+    const char *text = mm_node_text(doc, node, &length);
+    
+    assert(index < frozen->count);
+    assert(frozen->types[index] == node->type);
+    assert(frozen->levels[index] == node->level);
+    assert(frozen->depths[index] == depth);
+    assert(frozen->offsets[index] == node->offset);
+    if (text) {
+        assert(frozen->content[index] != NULL);
+        assert(frozen->lengths[index] == length);
+        assert(memcmp(frozen->content[index], text, length) == 0);
+        assert(frozen->content[index][length] == '\0');
+    } else {
+        assert(frozen->content[index] == NULL);
+    }
+    
+    // Children hang off first_child and next_sibling in tree order
+    size_t next = index + 1;
+    uint32_t child = frozen->first_child[index];
+    for (size_t i = 0; i < node->child_count; i++) {
+        assert(child == next);
+        next = assert_same_frozen(frozen, next, depth + 1, doc, node->children[i]);
+        child = frozen->next_sibling[child];
+    }
+    assert(child == MM_FROZEN_NONE);
+    assert(frozen->subtree_end[index] == next);
+    return next;
+}
+
+/**
+ * @brief Test struct-of-arrays frozen documents
+ * 
+ * This test verifies that:
+ * - Freezing keeps the tree in pre-order with working links
+ * - Copied and view documents freeze to the same content
+ * - A frozen document outlives the document it came from
+ * - The iterator walks exactly the subtree it was started on
+ */
+void test_freeze() {
+    printf("Testing frozen documents...\n");
+    
+    const char *input = "---\ntitle: Frozen\nauthor: Jane\n---\n\n"
+                       "# Heading\n\n"
+                       "First paragraph.\n\n"
+                       "[[note]]\nInside the note.\n[[/note]]\n\n"
+                       "> todo: Check this.\n\n"
+                       "%% comment %%\n"
+                       "## Last";
+    
+    Document *doc = parse_metamark(input);
+    Document *view = parse_metamark_view(input, strlen(input), NULL);
+    assert(doc != NULL && view != NULL);
+    
+    MMFrozenDocument *frozen = mm_document_freeze(doc);
+    MMFrozenDocument *frozen_view = mm_document_freeze(view);
+    assert(frozen != NULL && frozen_view != NULL);
+    assert(assert_same_frozen(frozen, 0, 0, doc, doc->root) == frozen->count);
+    assert(assert_same_frozen(frozen_view, 0, 0, view, view->root) == frozen_view->count);
+    assert(frozen->count == frozen_view->count);
+    assert(frozen->types[0] == NODE_DOCUMENT);
+    mm_frozen_free(frozen_view);
+    
+    assert(frozen->metadata_count == 2);
+    free_document(view);
+    free_document(doc);
+    
+    // Everything was copied, so the source tree is no longer needed
+    assert(strcmp(frozen->metadata[0].key, "title") == 0);
+    assert(strcmp(frozen->metadata[0].value, "Frozen") == 0);
+    assert(strcmp(frozen->metadata[1].value, "Jane") == 0);
+    
+    size_t index;
+    size_t visited = 0;
+    MMFrozenIter iter = mm_frozen_iter(frozen, 0);
+    while (mm_frozen_next(&iter, &index)) {
+        assert(index == visited);
+        visited++;
+    }
+    assert(visited == frozen->count);
+    
+    // A component's subtree is the component and its body paragraph
+    size_t component = frozen->count;
+    for (size_t i = 0; i < frozen->count; i++) {
+        if (frozen->types[i] == NODE_COMPONENT) {
+            component = i;
+            break;
+        }
+    }
+    assert(component < frozen->count);
+    iter = mm_frozen_iter(frozen, component);
+    int result = mm_frozen_next(&iter, &index);
+    assert(result && index == component);
+    result = mm_frozen_next(&iter, &index);
+    assert(result && index == component + 1);
+    assert(frozen->types[index] == NODE_PARAGRAPH);
+    assert(strcmp(frozen->content[index], "Inside the note.\n") == 0);
+    result = mm_frozen_next(&iter, &index);
+    assert(!result);
+    
+    iter = mm_frozen_iter(frozen, frozen->count);
+    result = mm_frozen_next(&iter, &index);
+    assert(!result);
+    mm_frozen_free(frozen);
+    
+    assert(mm_document_freeze(NULL) == NULL);
+    assert(get_last_error() == MM_ERROR_INVALID);
+    mm_frozen_free(NULL);
+    
+    printf("Frozen document test passed\n");
+}
+
+/**
+ * @brief Capture the HTML, JSON, snapshot and frozen form of a document
+ */
+static void capture_outputs(const Document *doc, RenderCapture *html, RenderCapture *json,
+                            RenderCapture *snapshot) {
+    int result = mm_render_html(doc, 0, capture_render, html);
+    assert(result == 0);
+    result = mm_write_json(doc, MM_JSON_OFFSETS, capture_render, json);
+    assert(result == 0);
+    result = mm_snapshot_write(doc, 0, capture_render, snapshot);
+    assert(result == 0);
+}
+
+static void assert_same_capture(const RenderCapture *a, const RenderCapture *b) {
+    assert(a->length == b->length);
+    assert(memcmp(a->data, b->data, a->length) == 0);
+}
+
+/**
+ * @brief Test lazy component bodies
+ * 
+ * This test verifies that:
+ * - MM_PARSE_LAZY leaves component bodies unbuilt and readable in place
+ * - Renderers, writers and freezing see the same tree as an eager parse
+ * - mm_node_body() builds the body once, matching the eager child
+ * - Lazy parsing needs a view parse and rejects editable documents
+ */
+void test_lazy() {
+    printf("Testing lazy bodies...\n");
+    
+    const char *input = "---\ntitle: Lazy\n---\n"
+                       "# Heading\n\n"
+                       "[[secure]]\nU2FsdGVkX1+payload\n[[/secure]]\n\n"
+                       "[[diagram]]\ngraph TD\nA --> B\n[[/diagram]]\n\n"
+                       "> note: Stays eager.\n\n"
+                       "[[empty]]\n[[/empty]]\n"
+                       "Tail text";
+    size_t length = strlen(input);
+    
+    MMParseOptions eager_options = { NULL, MM_PARSE_VIEW, 0 };
+    MMParseOptions lazy_options = { NULL, MM_PARSE_VIEW | MM_PARSE_LAZY, 0 };
+    Document *eager = mm_parse_document(NULL, input, length, &eager_options);
+    Document *lazy = mm_parse_document(NULL, input, length, &lazy_options);
+    assert(eager != NULL && lazy != NULL);
+    assert(lazy->root->child_count == eager->root->child_count);
+    
+    size_t lazy_nodes = 0;
+    for (size_t i = 0; i < lazy->root->child_count; i++) {
+        Node *node = lazy->root->children[i];
+        Node *expected = eager->root->children[i];
+        size_t length_a, length_b;
+        const char *a = mm_node_body_text(lazy, node, &length_a);
+        const char *b = mm_node_body_text(eager, expected, &length_b);
+        assert((a == NULL) == (b == NULL));
+        if (a) {
+            assert(length_a == length_b && memcmp(a, b, length_a) == 0);
+        }
+        if (node->flags & MM_NODE_LAZY) {
+            assert(node->type == NODE_COMPONENT);
+            assert(node->child_count == 0);
+            lazy_nodes++;
+        } else {
+            assert(node->child_count == expected->child_count);
+        }
+    }
+    assert(lazy_nodes == 2);
+    
+    // Every consumer sees the unbuilt bodies
+    RenderCapture html[2] = {{0}}, json[2] = {{0}}, snapshot[2] = {{0}};
+    capture_outputs(eager, &html[0], &json[0], &snapshot[0]);
+    capture_outputs(lazy, &html[1], &json[1], &snapshot[1]);
+    assert_same_capture(&html[0], &html[1]);
+    assert_same_capture(&json[0], &json[1]);
+    assert_same_capture(&snapshot[0], &snapshot[1]);
+    assert(strstr(html[1].data, "graph TD") != NULL);
+    
+    MMFrozenDocument *frozen_eager = mm_document_freeze(eager);
+    MMFrozenDocument *frozen_lazy = mm_document_freeze(lazy);
+    assert(frozen_eager != NULL && frozen_lazy != NULL);
+    assert(frozen_eager->count == frozen_lazy->count);
+    for (size_t i = 0; i < frozen_eager->count; i++) {
+        assert(frozen_eager->types[i] == frozen_lazy->types[i]);
+        assert(frozen_eager->subtree_end[i] == frozen_lazy->subtree_end[i]);
+        assert(frozen_eager->lengths[i] == frozen_lazy->lengths[i]);
+    }
+    mm_frozen_free(frozen_eager);
+    mm_frozen_free(frozen_lazy);
+    
+    // Building the bodies gives the eager tree
+    for (size_t i = 0; i < lazy->root->child_count; i++) {
+        Node *node = lazy->root->children[i];
+        Node *body = mm_node_body(node);
+        assert(body == mm_node_body(node));
+        assert(!(node->flags & MM_NODE_LAZY));
+        if (node->type == NODE_COMPONENT || node->type == NODE_ANNOTATION) {
+            assert((body != NULL) == (eager->root->children[i]->child_count > 0));
+        } else {
+            assert(body == NULL);
+        }
+    }
+    assert_same_tree(lazy->root, eager->root);
+    
+    for (int i = 0; i < 2; i++) {
+        free(html[i].data);
+        free(json[i].data);
+        free(snapshot[i].data);
+    }
+    free_document(lazy);
+    free_document(eager);
+    
+    // Built bodies come from the node's arena
+    MMArena *arena = mm_arena_new(0);
+    assert(arena != NULL);
+    MMParseOptions arena_options = { arena, MM_PARSE_VIEW | MM_PARSE_LAZY, 0 };
+    lazy = mm_parse_document(NULL, input, length, &arena_options);
+    assert(lazy != NULL);
+    Node *secure = lazy->root->children[2];
+    assert(secure->flags & MM_NODE_LAZY);
+    Node *body = mm_node_body(secure);
+    assert(body != NULL && body->arena == arena);
+    assert(strncmp(mm_node_text(lazy, body, NULL), "U2FsdGVkX1+payload\n", body->length) == 0);
+    free_document(lazy);
+    mm_arena_free(arena);
+    
+    MMParseOptions invalid = { NULL, MM_PARSE_LAZY, 0 };
+    assert(mm_parse_document(NULL, input, length, &invalid) == NULL);
+    assert(get_last_error() == MM_ERROR_INVALID);
+    invalid.flags = MM_PARSE_VIEW | MM_PARSE_LAZY | MM_PARSE_EDITABLE;
+    assert(mm_parse_document(NULL, input, length, &invalid) == NULL);
+    assert(get_last_error() == MM_ERROR_INVALID);
+    assert(mm_node_body(NULL) == NULL);
+    assert(mm_node_body_text(NULL, NULL, NULL) == NULL);
+    
+    printf("Lazy body test passed\n");
+}
+
+/**
+ * @brief Add the nodes of a subtree to per-type counts
+ */
+static MMWalkAction count_node_type(const Node *node, const MMVisit *visit, void *user_data) {
+    (void)visit;
+    ((size_t *)user_data)[node->type]++;
+    return MM_WALK_CONTINUE;
+}
+
+static void count_node_types(const Node *node, size_t *counts) {
+    mm_walk(node, MM_WALK_ENTER, count_node_type, counts);
+}
+
+void test_stats() {
+    printf("Testing parse statistics...\n");
+    
+    const char *input = "---\ntitle: Stats\nauthor: Test\n---\n"
+                       "# Heading\n\n"
+                       "A paragraph.\n\n"
+                       "[[note]]\nBody\n[[/note]]\n"
+                       "> todo: Item\n"
+                       "%% comment %%\n";
+    size_t length = strlen(input);
+    
+    MMParseStats stats;
+    memset(&stats, 0, sizeof(stats));
+    MMParseStats *previous = mm_parse_stats(&stats);
+    assert(previous == NULL);
+    Document *doc = parse_metamark(input);
+    assert(doc != NULL);
+    MMParseStats parsed = stats;
+    free_document(doc);
+    previous = mm_parse_stats(NULL);
+    assert(previous == &stats);
+    
+    // Every node of the tree was counted once, by type
+    doc = parse_metamark(input);
+    assert(doc != NULL);
+    size_t counts[MM_NODE_TYPE_COUNT] = {0};
+    count_node_types(doc->root, counts);
+    for (size_t i = 0; i < MM_NODE_TYPE_COUNT; i++) {
+        assert(parsed.nodes[i] == counts[i]);
+    }
+    assert(counts[NODE_COMPONENT] == 1 && counts[NODE_HEADING] == 1);
+    assert(parsed.bytes_scanned > length / 2 && parsed.bytes_scanned <= length);
+    assert(parsed.allocations > 0 && parsed.allocated_bytes > 0);
+    assert(parsed.lex_seconds >= 0.0 && parsed.metadata_seconds > 0.0);
+    assert(parsed.component_seconds > 0.0 && parsed.build_seconds > 0.0);
+    assert(parsed.free_seconds == 0.0 && stats.free_seconds > 0.0);
+    
+    // Nothing is collected once stopped
+    MMParseStats after = stats;
+    free_document(doc);
+    doc = parse_metamark(input);
+    free_document(doc);
+    assert(memcmp(&after, &stats, sizeof(stats)) == 0);
+    
+    // An arena parse only asks the heap for arena blocks
+    MMArena *arena = mm_arena_new(0);
+    MMParseStats arena_stats;
+    memset(&arena_stats, 0, sizeof(arena_stats));
+    mm_parse_stats(&arena_stats);
+    doc = parse_metamark_arena(input, arena);
+    assert(doc != NULL);
+    mm_parse_stats(NULL);
+    assert(arena_stats.nodes[NODE_HEADING] == 1);
+    assert(arena_stats.allocations < parsed.allocations);
+    free_document(doc);
+    mm_arena_free(arena);
+    
+    // Parallel parses build serially while collecting, so nothing is missed
+    size_t capacity = 1 << 18;
+    char *large = malloc(capacity);
+    assert(large != NULL);
+    size_t large_length = 0;
+    for (int i = 0; i < 1500; i++) {
+        large_length += (size_t)snprintf(large + large_length, capacity - large_length,
+                                         "## Section %d\n\nText %d\n\n", i, i);
+    }
+    MMParseStats serial, parallel;
+    memset(&serial, 0, sizeof(serial));
+    memset(&parallel, 0, sizeof(parallel));
+    MMParseOptions options = { NULL, 0, 0 };
+    mm_parse_stats(&serial);
+    free_document(mm_parse_document(NULL, large, large_length, &options));
+    options.flags = MM_PARSE_PARALLEL;
+    mm_parse_stats(&parallel);
+    free_document(mm_parse_document(NULL, large, large_length, &options));
+    mm_parse_stats(NULL);
+    assert(serial.nodes[NODE_HEADING] == 1500);
+    assert(memcmp(serial.nodes, parallel.nodes, sizeof(serial.nodes)) == 0);
+    assert(serial.bytes_scanned == parallel.bytes_scanned);
+    free(large);
+    
+    printf("Parse statistics test passed\n");
+}
+
+/**
+ * @brief Read a little-endian u32 the way a language binding would
+ */
+static uint32_t read_u32_le(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Test flat document buffers for language bindings
+ * 
+ * This test verifies that:
+ * - A flat buffer holds the same bytes as a snapshot of the document
+ * - Its records can be decoded from offsets alone
+ * - Snapshots are readable in place from memory
+ */
+void test_flat() {
+    printf("Testing flat buffers...\n");
+    
+    const char *input = "---\ntitle: Flat\n---\n"
+                       "# Heading\n\n"
+                       "Some text.\n\n"
+                       "[[secure]]\nU2FsdGVkX1+payload\n[[/secure]]\n";
+    size_t length = strlen(input);
+    
+    Document *doc = parse_metamark(input);
+    assert(doc != NULL);
+    RenderCapture written = {0};
+    int result = mm_snapshot_write(doc, 0, capture_render, &written);
+    assert(result == 0);
+    size_t encoded_size = 0;
+    unsigned char *encoded = mm_snapshot_encode(doc, 0, &encoded_size);
+    assert(encoded != NULL);
+    assert(encoded_size == written.length);
+    assert(memcmp(encoded, written.data, encoded_size) == 0);
+    
+    size_t size = 0;
+    unsigned char *flat = mm_flat_parse(input, length, &size);
+    assert(flat != NULL);
+    assert(size == encoded_size && memcmp(flat, encoded, size) == 0);
+    
+    // Decode through offsets only, without the reader
+    assert(memcmp(flat, "MMSNAP", 6) == 0);
+    uint32_t count = read_u32_le(flat + 16);
+    uint32_t nodes = read_u32_le(flat + 40);
+    uint32_t pool = read_u32_le(flat + 56);
+    assert(count > 4);
+    assert(read_u32_le(flat + nodes) == NODE_DOCUMENT);
+    int found_heading = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const unsigned char *record = flat + nodes + i * 32;
+        if ((record[0] | (record[1] << 8)) == NODE_HEADING) {
+            assert((record[2] | (record[3] << 8)) == 1);
+            assert(read_u32_le(record + 4) & 1);
+            const char *text = (const char *)flat + pool + read_u32_le(record + 16);
+            assert(read_u32_le(record + 20) == strlen("Heading"));
+            assert(strcmp(text, "Heading") == 0);
+            found_heading = 1;
+        }
+    }
+    assert(found_heading);
+    
+    MMSnapshot *snapshot = mm_snapshot_from_buffer(flat, size);
+    assert(snapshot != NULL);
+    assert_same_snapshot(snapshot, 0, doc, doc->root);
+    assert(strcmp(mm_snapshot_get_metadata(snapshot, "title"), "Flat") == 0);
+    mm_snapshot_close(snapshot);   // leaves the buffer alone
+    assert(read_u32_le(flat + 16) == count);
+    
+    assert(mm_snapshot_from_buffer(flat, 32) == NULL);
+    assert(get_last_error() == MM_ERROR_SYNTAX);
+    assert(mm_snapshot_from_buffer(NULL, 0) == NULL);
+    assert(mm_flat_parse("  \n", 3, &size) == NULL);
+    assert(get_last_error() == MM_ERROR_SYNTAX);
+    assert(mm_flat_parse(input, length, NULL) == NULL);
+    assert(get_last_error() == MM_ERROR_INVALID);
+    
+    mm_free(flat);
+    mm_free(encoded);
+    mm_free(NULL);
+    free(written.data);
+    free_document(doc);
+    
+    printf("Flat buffer test passed\n");
+}
+
+/**
+ * @brief Name of the file a cache spills a snapshot to in the current directory
+ */
+static void spill_name(const MMCacheEntry *entry, char *name, size_t size) {
+    snprintf(name, size, "./%016llx.mms",
+             (unsigned long long)mm_snapshot_stamp(mm_cache_snapshot(entry)));
+}
+
+void test_cache() {
+    printf("Testing parse cache...\n");
+    
+    const char *input = "---\ntitle: Cached\n---\n# One\n\nText.\n";
+    size_t length = strlen(input);
+    Document *doc = parse_metamark(input);
+    assert(doc != NULL);
+    MMCacheStats stats;
+    
+    // Repeat lookups share one entry and skip the parser
+    MMParseCache *cache = mm_cache_new(1 << 20, NULL);
+    assert(cache != NULL);
+    MMCacheEntry *first = mm_cache_parse(cache, input, length);
+    MMCacheEntry *second = mm_cache_parse(cache, input, length);
+    assert(first != NULL && second == first);
+    assert_same_snapshot(mm_cache_snapshot(first), 0, doc, doc->root);
+    assert(strcmp(mm_snapshot_get_metadata(mm_cache_snapshot(first), "title"), "Cached") == 0);
+    mm_cache_stats(cache, &stats);
+    assert(stats.misses == 1 && stats.hits == 1 && stats.entries == 1);
+    size_t single_bytes = stats.bytes;
+    
+    MMCacheEntry *other = mm_cache_parse(cache, "# Two\n", 6);
+    assert(other != NULL && other != first);
+    assert(mm_snapshot_stamp(mm_cache_snapshot(other)) !=
+           mm_snapshot_stamp(mm_cache_snapshot(first)));
+    MMCacheEntry *rejected = mm_cache_parse(cache, "  \n", 3);
+    assert(rejected == NULL);
+    assert(get_last_error() == MM_ERROR_SYNTAX);
+    mm_cache_stats(cache, &stats);
+    assert(stats.entries == 2);
+    size_t entry_bytes = stats.bytes - single_bytes;   // the size of "# Two"
+    mm_cache_release(first);
+    mm_cache_release(second);
+    mm_cache_release(other);
+    mm_cache_release(NULL);
+    mm_cache_free(cache);
+    
+    // Held entries are pinned; released ones go oldest first
+    cache = mm_cache_new(2 * entry_bytes + entry_bytes / 2, NULL);
+    const char *inputs[] = { "# Aaa\n", "# Bbb\n", "# Ccc\n" };
+    MMCacheEntry *held[3];
+    for (size_t i = 0; i < 3; i++) {
+        held[i] = mm_cache_parse(cache, inputs[i], 6);
+        assert(held[i] != NULL);
+    }
+    mm_cache_stats(cache, &stats);
+    assert(stats.entries == 3 && stats.evictions == 0);
+    for (size_t i = 0; i < 3; i++) {
+        mm_cache_release(held[i]);
+    }
+    mm_cache_stats(cache, &stats);
+    assert(stats.entries == 2 && stats.evictions == 1);
+    
+    mm_cache_release(mm_cache_parse(cache, inputs[1], 6));   // Bbb becomes newest
+    mm_cache_release(mm_cache_parse(cache, inputs[0], 6));   // evicts Ccc
+    mm_cache_release(mm_cache_parse(cache, inputs[1], 6));
+    mm_cache_stats(cache, &stats);
+    assert(stats.misses == 4 && stats.hits == 2 && stats.evictions == 2);
+    mm_cache_free(cache);
+    
+    // Files are keyed by content, so an edit is a miss
+    const char *path = "test_cache.mmk";
+    cache = mm_cache_new(1 << 20, NULL);
+    write_test_file(path, input, length);
+    first = mm_cache_read_file(cache, path);
+    second = mm_cache_parse(cache, input, length);
+    assert(first != NULL && second == first);
+    write_test_file(path, "# Edited\n", 9);
+    other = mm_cache_read_file(cache, path);
+    assert(other != NULL && other != first);
+    mm_cache_stats(cache, &stats);
+    assert(stats.misses == 2 && stats.hits == 1);
+    mm_cache_release(first);
+    mm_cache_release(second);
+    mm_cache_release(other);
+    remove(path);
+    rejected = mm_cache_read_file(cache, path);
+    assert(rejected == NULL);
+    rejected = mm_cache_read_file(NULL, path);
+    assert(rejected == NULL);
+    assert(get_last_error() == MM_ERROR_INVALID);
+    mm_cache_free(cache);
+    
+    // A cache directory outlives the cache that wrote it
+    char name[64];
+    cache = mm_cache_new(1 << 20, ".");
+    first = mm_cache_parse(cache, input, length);
+    assert(first != NULL);
+    spill_name(first, name, sizeof(name));
+    mm_cache_release(first);
+    mm_cache_free(cache);
+    
+    cache = mm_cache_new(0, ".");
+    first = mm_cache_parse(cache, input, length);
+    assert(first != NULL);
+    assert_same_snapshot(mm_cache_snapshot(first), 0, doc, doc->root);
+    mm_cache_stats(cache, &stats);
+    assert(stats.disk_hits == 1 && stats.misses == 0);
+    mm_cache_release(first);
+    mm_cache_stats(cache, &stats);
+    assert(stats.entries == 0);   // a zero budget keeps nothing in memory
+    
+    // A damaged spill file is parsed again and replaced
+    write_test_file(name, "MMSNAP", 6);
+    first = mm_cache_parse(cache, input, length);
+    assert(first != NULL);
+    mm_cache_release(first);
+    mm_cache_release(mm_cache_parse(cache, input, length));
+    mm_cache_stats(cache, &stats);
+    assert(stats.misses == 1 && stats.disk_hits == 2);
+    mm_cache_free(cache);
+    mm_cache_free(NULL);
+    remove(name);
+    
+    free_document(doc);
+    
+    printf("Parse cache test passed\n");
+}
+
+void test_diff() {
+    printf("Testing structural diff...\n");
+    
+    const char *old_text = "---\ntitle: Old\n---\n"
+                          "# Intro\n\nFirst.\n\nSecond.\n\n"
+                          "[[component Card]]\nBody\n[[/component]]\n\nLast.\n";
+    const char *new_text = "---\ntitle: New\n---\n"
+                          "# Intro\n\nFirst.\n\nInserted.\n\nAlso inserted.\n\n"
+                          "[[component Card]]\nBody\n[[/component]]\n\nLast.\n";
+    Document *old_doc = parse_metamark(old_text);
+    Document *new_doc = parse_metamark(new_text);
+    assert(old_doc != NULL && new_doc != NULL);
+    
+    // The frontmatter node changed and "Second." became two paragraphs;
+    // every other block is matched
+    MMDiff *diff = mm_diff_documents(old_doc, new_doc);
+    assert(diff != NULL);
+    assert(diff->metadata_changed);
+    assert(diff->hunk_count == 2 && diff->distance == 5);
+    assert(diff->hunks[0].old_first == 0 && diff->hunks[0].old_count == 1);
+    assert(diff->hunks[0].new_first == 0 && diff->hunks[0].new_count == 1);
+    assert(diff->hunks[1].old_first == 3 && diff->hunks[1].old_count == 1);
+    assert(diff->hunks[1].new_first == 3 && diff->hunks[1].new_count == 2);
+    mm_diff_free(diff);
+    
+    diff = mm_diff_documents(old_doc, old_doc);
+    assert(diff != NULL && diff->hunk_count == 0 && !diff->metadata_changed);
+    mm_diff_free(diff);
+    diff = mm_diff_documents(NULL, new_doc);
+    assert(diff != NULL && diff->hunk_count == 1 && diff->distance == new_doc->root->child_count);
+    mm_diff_free(diff);
+    mm_diff_free(NULL);
+    
+    // Copied, view and lazy trees of one text hash alike
+    size_t length = strlen(old_text);
+    MMParseOptions lazy = { NULL, MM_PARSE_VIEW | MM_PARSE_LAZY, 0 };
+    Document *view = parse_metamark_view(old_text, length, NULL);
+    Document *unbuilt = mm_parse_document(NULL, old_text, length, &lazy);
+    assert(view != NULL && unbuilt != NULL);
+    assert(mm_node_hash(view, view->root) == mm_node_hash(old_doc, old_doc->root));
+    assert(mm_node_hash(unbuilt, unbuilt->root) == mm_node_hash(old_doc, old_doc->root));
+    assert(mm_node_hash(old_doc, old_doc->root) != mm_node_hash(new_doc, new_doc->root));
+    assert(mm_node_hash(NULL, NULL) == 0);
+    free_document(view);
+    free_document(unbuilt);
+    
+    // Hunks within a block come from diffing its children
+    Node *old_list = create_node(NODE_DOCUMENT, NULL);
+    Node *new_list = create_node(NODE_DOCUMENT, NULL);
+    const char *old_items[] = { "a", "b", "c", "a", "b", "b", "a" };
+    const char *new_items[] = { "c", "b", "a", "b", "a", "c" };
+    for (size_t i = 0; i < 7; i++) {
+        add_child(old_list, create_node(NODE_PARAGRAPH, old_items[i]));
+    }
+    for (size_t i = 0; i < 6; i++) {
+        add_child(new_list, create_node(NODE_PARAGRAPH, new_items[i]));
+    }
+    diff = mm_diff_nodes(NULL, old_list, NULL, new_list);
+    assert(diff != NULL && diff->distance == 5);   // Myers' own example, D = 5
+    size_t kept = 0, old_next = 0;
+    for (size_t i = 0; i < diff->hunk_count; i++) {
+        kept += diff->hunks[i].old_first - old_next;
+        old_next = diff->hunks[i].old_first + diff->hunks[i].old_count;
+    }
+    assert(kept + (7 - old_next) == 4);
+    mm_diff_free(diff);
+    free_node(old_list);
+    free_node(new_list);
+    
+    // The binding entry point parses for itself
+    size_t count = 99;
+    MMDiffHunk *hunks = mm_diff_text(old_text, length, new_text, strlen(new_text), &count);
+    assert(hunks != NULL && count == 2 && hunks[1].new_count == 2);
+    mm_free(hunks);
+    hunks = mm_diff_text("\n\n", 2, "# Title\n", 8, &count);
+    assert(hunks != NULL && count == 1 && hunks[0].old_count == 0 && hunks[0].new_count == 1);
+    mm_free(hunks);
+    hunks = mm_diff_text(old_text, length, old_text, length, &count);
+    assert(hunks != NULL && count == 0);
+    mm_free(hunks);
+    
+    // Texts larger than an arena block, with one paragraph changed
+    size_t paragraphs = 4000;
+    char *old_large = malloc(paragraphs * 64);
+    char *new_large = malloc(paragraphs * 64);
+    assert(old_large != NULL && new_large != NULL);
+    size_t old_size = 0, new_size = 0;
+    for (size_t i = 0; i < paragraphs; i++) {
+        old_size += sprintf(old_large + old_size, "Paragraph %zu of the large text.\n\n", i);
+        new_size += sprintf(new_large + new_size, i == paragraphs / 2
+                            ? "Paragraph %zu was edited.\n\n" : "Paragraph %zu of the large text.\n\n", i);
+    }
+    hunks = mm_diff_text(old_large, old_size, new_large, new_size, &count);
+    assert(hunks != NULL && count == 1 && hunks[0].old_count == 1 && hunks[0].new_count == 1);
+    assert(hunks[0].old_first == paragraphs / 2);
+    mm_free(hunks);
+    free(old_large);
+    free(new_large);
+    MMDiffHunk *rejected = mm_diff_text(NULL, 0, old_text, length, &count);
+    assert(rejected == NULL);
+    assert(get_last_error() == MM_ERROR_INVALID);
+    
+    free_document(old_doc);
+    free_document(new_doc);
+    
+    printf("Structural diff test passed\n");
+}
+
+/**
+ * @brief Check that every cross-reference entry points at its object
+ */
+static size_t check_pdf_xref(const char *pdf, size_t length) {
+    const char *start = strstr(pdf, "startxref\n");
+    assert(start != NULL);
+    size_t xref = (size_t)strtoul(start + 10, NULL, 10);
+    assert(xref < length && strncmp(pdf + xref, "xref\n0 ", 7) == 0);
+    
+    char *cursor;
+    size_t objects = (size_t)strtoul(pdf + xref + 7, &cursor, 10);
+    cursor = strchr(cursor, '\n') + 1 + 20;  // Skip the free entry
+    for (size_t i = 1; i < objects; i++, cursor += 20) {
+        char expected[32];
+        size_t offset = (size_t)strtoul(cursor, NULL, 10);
+        int n = snprintf(expected, sizeof(expected), "%zu 0 obj\n", i);
+        assert(offset < xref && strncmp(pdf + offset, expected, (size_t)n) == 0);
+    }
+    return objects;
+}
+
+static size_t count_text(const char *text, const char *needle) {
+    size_t count = 0;
+    for (const char *at = strstr(text, needle); at; at = strstr(at + 1, needle)) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Test PDF rendering
+ * 
+ * This test verifies that:
+ * - Blocks are set as text with PDF strings escaped and hidden blocks left out
+ * - The cross-reference table points at every object
+ * - Long paragraphs wrap, long documents span pages sharing one font set
+ * - Output does not depend on the number of layout threads
+ */
+void test_pdf() {
+    printf("Testing PDF rendering...\n");
+    
+    const char *input = "---\ntitle: A (Title)\n---\n\n"
+                       "# Fish & Chips\n\n"
+                       "Use (parentheses) and \\ here.\n\n"
+                       "[[note]]\nInside the note\n[[/note]]\n\n"
+                       "> todo: Check this\n\n"
+                       "%% hidden %%\n";
+    Document *doc = parse_metamark(input);
+    assert(doc != NULL);
+    
+    RenderCapture capture = {0};
+    int result = mm_render_pdf(doc, NULL, capture_render, &capture);
+    assert(result == 0);
+    assert(strncmp(capture.data, "%PDF-1.4\n", 9) == 0);
+    assert(capture.length > 6 && strcmp(capture.data + capture.length - 6, "%%EOF\n") == 0);
+    assert(strstr(capture.data, "/Title (A \\(Title\\))") != NULL);
+    assert(strstr(capture.data, "(Fish & Chips) Tj") != NULL);
+    assert(strstr(capture.data, "(Use \\(parentheses\\) and \\\\ here.) Tj") != NULL);
+    assert(strstr(capture.data, "(note) Tj") != NULL);
+    assert(strstr(capture.data, "(Inside the note) Tj") != NULL);
+    assert(strstr(capture.data, "(Check this) Tj") != NULL);
+    assert(strstr(capture.data, "hidden") == NULL);
+    assert(strstr(capture.data, "/Count 1 ") != NULL);
+    check_pdf_xref(capture.data, capture.length);
+    free(capture.data);
+    free_document(doc);
+    
+    // A paragraph wider than the page breaks between words
+    char *words = malloc(4096);
+    assert(words != NULL);
+    size_t length = 0;
+    for (int i = 0; i < 300; i++) {
+        length += (size_t)snprintf(words + length, 4096 - length, "word%d ", i);
+    }
+    doc = parse_metamark(words);
+    assert(doc != NULL);
+    memset(&capture, 0, sizeof(capture));
+    result = mm_render_pdf(doc, NULL, capture_render, &capture);
+    assert(result == 0);
+    assert(count_text(capture.data, " Tj\n") > 10);
+    assert(strstr(capture.data, "word299) Tj") != NULL);
+    assert(strstr(capture.data, " ) Tj") == NULL && strstr(capture.data, "( ") == NULL);
+    free(capture.data);
+    free_document(doc);
+    free(words);
+    
+    // Long documents span pages that share the font objects
+    size_t capacity = 1 << 18;
+    char *large = malloc(capacity);
+    assert(large != NULL);
+    length = 0;
+    for (int i = 0; i < 2000; i++) {
+        length += (size_t)snprintf(large + length, capacity - length,
+                                   "## Part %d\n\nText (%d) & more\n\n", i, i);
+    }
+    doc = parse_metamark(large);
+    assert(doc != NULL);
+    MMPdfOptions options = {0};
+    options.threads = 1;
+    RenderCapture serial = {0};
+    result = mm_render_pdf(doc, &options, capture_render, &serial);
+    assert(result == 0);
+    assert(serial.writes > 1);
+    size_t objects = check_pdf_xref(serial.data, serial.length);
+    size_t pages = count_text(serial.data, "/Type /Page ");
+    assert(pages > 50);
+    assert(objects == 8 + pages * 2);
+    assert(count_text(serial.data, "/BaseFont /Helvetica ") == 1);
+    assert(count_text(serial.data, "/Resources 3 0 R") == pages);
+    
+    options.threads = 4;
+    memset(&capture, 0, sizeof(capture));
+    result = mm_render_pdf(doc, &options, capture_render, &capture);
+    assert(result == 0);
+    assert(capture.length == serial.length && memcmp(capture.data, serial.data, serial.length) == 0);
+    free(capture.data);
+    free(serial.data);
+    
+    // A sink stops rendering by returning nonzero
+    memset(&capture, 0, sizeof(capture));
+    capture.stop_after = 1;
+    result = mm_render_pdf(doc, NULL, capture_render, &capture);
+    assert(result == 7);
+    free(capture.data);
+    
+    // Pages too small for any text are rejected
+    options.page_width = 100;
+    result = mm_render_pdf(doc, &options, capture_render, &capture);
+    assert(result == -1);
+    assert(get_last_error() == MM_ERROR_INVALID);
+    free_document(doc);
+    free(large);
+    
+    // An empty document is a single blank page
+    doc = parse_metamark("%% only a comment %%\n");
+    assert(doc != NULL);
+    memset(&capture, 0, sizeof(capture));
+    result = mm_render_pdf(doc, NULL, capture_render, &capture);
+    assert(result == 0);
+    assert(strstr(capture.data, "/Count 1 ") != NULL && strstr(capture.data, " Tj") == NULL);
+    check_pdf_xref(capture.data, capture.length);
+    free(capture.data);
+    free_document(doc);
+    
+    result = mm_render_pdf(NULL, NULL, capture_render, &capture);
+    assert(result == -1);
+    assert(get_last_error() == MM_ERROR_INVALID);
+    
+    printf("PDF rendering test passed\n");
+}
+
+void test_adversarial() {
+    printf("Testing adversarial input...\n");
+    
+    MMContext ctx;
+    const char *input = "# T\n>\n>\n> :\n";
+    
+    // Positions stay exact while line counting resumes at the last error
+    Document *doc = mm_parse_document(&ctx, input, strlen(input), NULL);
+    assert(doc != NULL);
+    assert(ctx.error == MM_ERROR_SYNTAX);
+    assert(ctx.offset == 10 && ctx.line == 4 && ctx.column == 3);
+    free_document(doc);
+    
+    // A buffer holding new text does not resume from the old position
+    char buffer[16];
+    strcpy(buffer, "x\n\n\n>\n");
+    doc = mm_parse_document(&ctx, buffer, strlen(buffer), NULL);
+    assert(doc != NULL);
+    assert(ctx.offset == 5 && ctx.line == 4);
+    free_document(doc);
+    strcpy(buffer, "abcd>\n");
+    doc = mm_parse_document(&ctx, buffer, strlen(buffer), NULL);
+    assert(doc != NULL);
+    assert(ctx.offset == 5 && ctx.line == 1 && ctx.column == 6);
+    free_document(doc);
+    
+    // Every failure makes progress, so hostile documents parse in linear
+    // time; a quadratic parse of these would run for minutes
+    static const char *const fragments[] = {
+        ">\n", "> :\n", "---\nno colon\n", "text\n---\n", "[[open]]\n",
+        "[[/open]]\n", "%% open\n", "#\n", "a>b#c%%d---e[[f"
+    };
+    size_t size = 1 << 20;
+    char *hostile = malloc(size + 1);
+    assert(hostile != NULL);
+    for (size_t f = 0; f < sizeof(fragments) / sizeof(fragments[0]); f++) {
+        size_t length = strlen(fragments[f]);
+        size_t used = 0;
+        while (used + length <= size) {
+            memcpy(hostile + used, fragments[f], length);
+            used += length;
+        }
+        hostile[used] = '\0';
+        free_document(parse_metamark(hostile));
+        free_document(parse_metamark_view(hostile, used, NULL));
+        MMParseOptions options = { NULL, MM_PARSE_VIEW | MM_PARSE_PARALLEL, 2 };
+        free_document(mm_parse_document(&ctx, hostile, used, &options));
+    }
+    free(hostile);
+    
+    // Content before an unclosed component survives it
+    doc = parse_metamark("# Title\n\nIntro.\n\n[[open]]\nnever closed\n");
+    assert(doc != NULL);
+    assert(doc->root->child_count == 2);
+    assert(doc->root->children[1]->type == NODE_PARAGRAPH);
+    free_document(doc);
+    
+    printf("Adversarial input test passed\n");
+}
+
+/**
+ * @brief Search hits collected by collect_hit()
+ */
+typedef struct {
+    size_t count;
+    char documents[8][32];
+    NodeType types[8];
+    size_t lines[8];
+    char previews[8][96];
+} HitList;
+
+static int collect_hit(const MMSearchHit *hit, void *user_data) {
+    HitList *hits = user_data;
+    if (hits->count < 8) {
+        snprintf(hits->documents[hits->count], 32, "%s", hit->document);
+        hits->types[hits->count] = hit->type;
+        hits->lines[hits->count] = hit->line;
+        snprintf(hits->previews[hits->count], 96, "%s", hit->preview);
+    }
+    hits->count++;
+    return 0;
+}
+
+static size_t search_count(const MMIndex *index, const char *query) {
+    HitList hits = { 0 };
+    int found = mm_index_search(index, query, collect_hit, &hits);
+    assert(found >= 0 && (size_t)found == hits.count);
+    return hits.count;
+}
+
+static int count_document(const char *name, const char *tag, void *user_data) {
+    (void)name;
+    (void)tag;
+    (*(size_t *)user_data)++;
+    return 0;
+}
+
+void test_index() {
+    printf("Testing the search index...\n");
+    
+    const char *guide = "---\nauthor: Ada\ntags: parser\n---\n# Parser Guide\n\n"
+                        "The parser builds a tree.\n\n> todo: speed up the Parser\n"
+                        "> note: parser notes\n\n[[diagram]]\ngraph TD\nA --> B\n[[/diagram]]\n";
+    const char *notes = "# Notes\n\n> todo: write docs\n\nNothing about trees.\n";
+    MMIndex *index = mm_index_new();
+    assert(index != NULL);
+    int result = mm_index_add(index, "guide.mmk", "v1", guide, strlen(guide));
+    assert(result == 0);
+    result = mm_index_add(index, "notes.mmk", NULL, notes, strlen(notes));
+    assert(result == 0);
+    assert(mm_index_document_count(index) == 2);
+    assert(strcmp(mm_index_tag(index, "guide.mmk"), "v1") == 0);
+    assert(strcmp(mm_index_tag(index, "notes.mmk"), "") == 0);
+    assert(mm_index_tag(index, "missing.mmk") == NULL);
+    
+    // Words ignore case and land on the entry they occur in
+    HitList hits = { 0 };
+    result = mm_index_search(index, "PARSER", collect_hit, &hits);
+    assert(result == 5);
+    assert(strcmp(hits.documents[0], "guide.mmk") == 0 && hits.types[0] == NODE_METADATA);
+    assert(hits.types[1] == NODE_HEADING && hits.lines[1] == 5);
+    assert(strcmp(hits.previews[1], "Parser Guide") == 0);
+    assert(hits.types[3] == NODE_ANNOTATION && hits.lines[3] == 9);
+    assert(strcmp(hits.previews[3], "todo: speed up the Parser") == 0);
+    
+    // Fields restrict the match; every clause must hit the same entry
+    assert(search_count(index, "heading:parser") == 1);
+    assert(search_count(index, "annotation:todo") == 2);
+    assert(search_count(index, "annotation:todo parser") == 1);
+    assert(search_count(index, "annotation:TODO docs") == 1);
+    assert(search_count(index, "annotation:note speed") == 0);
+    memset(&hits, 0, sizeof(hits));
+    result = mm_index_search(index, "component:diagram graph", collect_hit, &hits);
+    assert(result == 1);
+    assert(hits.types[0] == NODE_COMPONENT && hits.lines[0] == 12);
+    assert(strcmp(hits.previews[0], "diagram: graph TD A --> B") == 0);
+    assert(search_count(index, "tree") == 1);
+    assert(search_count(index, "unknownword") == 0);
+    
+    // Metadata keys select documents, or alone their pairs
+    assert(search_count(index, "meta:author") == 1);
+    assert(search_count(index, "meta:author annotation:todo") == 1);
+    assert(search_count(index, "meta:author docs") == 0);
+    result = mm_index_search(index, "meta:", collect_hit, &hits);
+    assert(result == -1);
+    result = mm_index_search(index, "  ", collect_hit, &hits);
+    assert(result == -1);
+    assert(get_last_error() == MM_ERROR_INVALID);
+    
+    // Re-adding replaces, removing drops the hits
+    const char *edited = "# Notes\n\nNow about trees and the parser.\n";
+    result = mm_index_add(index, "notes.mmk", "v2", edited, strlen(edited));
+    assert(result == 0);
+    assert(mm_index_document_count(index) == 2);
+    assert(search_count(index, "annotation:todo") == 1);
+    assert(search_count(index, "tree") == 1 && search_count(index, "trees") == 1);
+    result = mm_index_remove(index, "guide.mmk");
+    assert(result == 0);
+    result = mm_index_remove(index, "guide.mmk");
+    assert(result == -1 && get_last_error() == MM_ERROR_INVALID);
+    assert(search_count(index, "parser") == 1);
+    result = mm_index_add(index, "empty.mmk", NULL, "%% only %%\n", 11);
+    assert(result == 0);
+    result = mm_index_add(index, "blank.mmk", NULL, "", 0);
+    assert(result == 0);
+    size_t documents = 0;
+    result = mm_index_each(index, count_document, &documents);
+    assert(result == 0 && documents == 3);
+    
+    // Serialized indexes read back alike, and damage is rejected
+    RenderCapture file = { NULL, 0, 0, 0 };
+    result = mm_index_write(index, capture_render, &file);
+    assert(result == 0);
+    MMIndex *loaded = mm_index_from_buffer(file.data, file.length);
+    assert(loaded != NULL);
+    assert(mm_index_document_count(loaded) == 3);
+    assert(strcmp(mm_index_tag(loaded, "notes.mmk"), "v2") == 0);
+    assert(search_count(loaded, "heading:notes parser") == 0);
+    assert(search_count(loaded, "parser") == 1);
+    for (size_t length = 0; length < file.length; length++) {
+        assert(mm_index_from_buffer(file.data, length) == NULL);
+    }
+    for (size_t i = 5; i < file.length; i++) {
+        file.data[i] ^= 0x5a;
+        mm_index_free(mm_index_from_buffer(file.data, file.length));
+        file.data[i] ^= 0x5a;
+    }
+    free(file.data);
+    mm_index_free(loaded);
+    
+    // Churn compacts dead documents away without losing live ones
+    char name[32], text[64];
+    for (int i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "doc%d.mmk", i % 20);
+        snprintf(text, sizeof(text), "# Doc %d\n\nword%d shared\n", i, i);
+        result = mm_index_add(index, name, NULL, text, strlen(text));
+        assert(result == 0);
+    }
+    assert(mm_index_document_count(index) == 23);
+    assert(search_count(index, "shared") == 20);
+    assert(search_count(index, "word199") == 1 && search_count(index, "word0") == 0);
+    result = mm_index_save(index, "test_index.mmx");
+    assert(result == 0);
+    mm_index_free(index);
+    index = mm_index_load("test_index.mmx");
+    assert(index != NULL && search_count(index, "shared") == 20);
+    remove("test_index.mmx");
+    mm_index_free(index);
+    assert(mm_index_load("test_index.mmx") == NULL);
+    
+    printf("Search index test passed\n");
+}
+
+/**
+ * @brief Main test entry point
+ * 
+ * This function:
+ * 1. Parses the test document
+ * 2. Runs all test cases
+ * 3. Prints the AST structure for visual inspection
+ * 4. Cleans up resources
+ */
+/**
+ * @brief Record the visits of a walk as "type:depth:index" codes
+ */
+typedef struct {
+    char trace[256];
+    size_t visits;
+    size_t stop_after;
+} WalkTrace;
+
+static MMWalkAction trace_visit(const Node *node, const MMVisit *visit, void *user_data) {
+    WalkTrace *trace = user_data;
+    size_t length = strlen(trace->trace);
+    snprintf(trace->trace + length, sizeof(trace->trace) - length, "%s%d:%zu:%zu",
+             length ? " " : "", visit->leaving ? -(int)node->type : (int)node->type,
+             visit->depth, visit->index);
+    if (++trace->visits == trace->stop_after) {
+        return MM_WALK_STOP;
+    }
+    return node->type == NODE_COMPONENT && !visit->leaving ? MM_WALK_SKIP : MM_WALK_CONTINUE;
+}
+
+static void walk_trace(const Node *root, unsigned flags, MMWalker *walker, char *out, size_t size) {
+    MMVisit visit;
+    const Node *node;
+    size_t length = 0;
+    out[0] = '\0';
+    mm_walker_init(walker, root, flags);
+    while ((node = mm_walker_next(walker, &visit)) && length < size) {
+        length += (size_t)snprintf(out + length, size - length, "%s%c%d/%zu", length ? " " : "",
+                                   visit.leaving ? '-' : '+', (int)node->type, visit.depth);
+    }
+    int result = mm_walker_finish(walker);
+    assert(result == 0);
+}
+
+/**
+ * @brief Test the iterative walker
+ * 
+ * - Enter visits come in pre-order and leave visits in post-order
+ * - Skipping drops a subtree but keeps its leave visit; after a leave it
+ *   drops the remaining siblings
+ * - mm_walk() stops early and skips on request
+ * - Unbuilt lazy bodies show up only with MM_WALK_LAZY
+ * - Trees far deeper than the inline stack are walked, hashed, rendered,
+ *   written as JSON, encoded as a snapshot, frozen and freed without
+ *   recursion
+ */
+void test_walk() {
+    printf("Testing tree walking...\n");
+    
+    // DOCUMENT(0) > HEADING(3), COMPONENT(6) > [PARAGRAPH(2), PARAGRAPH(2)], PARAGRAPH(2)
+    Node *root = create_node(NODE_DOCUMENT, NULL);
+    Node *component = create_node(NODE_COMPONENT, "note");
+    add_child(root, create_node(NODE_HEADING, "Title"));
+    add_child(root, component);
+    add_child(component, create_node(NODE_PARAGRAPH, "first"));
+    add_child(component, create_node(NODE_PARAGRAPH, "second"));
+    add_child(root, create_node(NODE_PARAGRAPH, "last"));
+    
+    MMWalker walker;
+    char trace[256];
+    walk_trace(root, MM_WALK_ENTER, &walker, trace, sizeof(trace));
+    assert(strcmp(trace, "+0/0 +3/1 +6/1 +2/2 +2/2 +2/1") == 0);
+    walk_trace(root, MM_WALK_LEAVE, &walker, trace, sizeof(trace));
+    assert(strcmp(trace, "-3/1 -2/2 -2/2 -6/1 -2/1 -0/0") == 0);
+    walk_trace(root, MM_WALK_ENTER | MM_WALK_LEAVE, &walker, trace, sizeof(trace));
+    assert(strcmp(trace, "+0/0 +3/1 -3/1 +6/1 +2/2 -2/2 +2/2 -2/2 -6/1 +2/1 -2/1 -0/0") == 0);
+    walk_trace(NULL, MM_WALK_ENTER, &walker, trace, sizeof(trace));
+    assert(trace[0] == '\0');
+    
+    // Skipping after an enter visit drops the subtree, after a leave the siblings
+    MMVisit visit;
+    const Node *node;
+    size_t entered = 0;
+    mm_walker_init(&walker, root, MM_WALK_ENTER | MM_WALK_LEAVE);
+    while ((node = mm_walker_next(&walker, &visit))) {
+        entered += !visit.leaving;
+        if (node == component && !visit.leaving) {
+            mm_walker_skip(&walker);
+        }
+        if (node->type == NODE_HEADING && visit.leaving) {
+            assert(visit.parent == root && visit.index == 0);
+        }
+    }
+    int result = mm_walker_finish(&walker);
+    assert(result == 0);
+    assert(entered == 4);
+    
+    entered = 0;
+    mm_walker_init(&walker, root, MM_WALK_ENTER | MM_WALK_LEAVE);
+    while ((node = mm_walker_next(&walker, &visit))) {
+        entered += !visit.leaving;
+        if (node->type == NODE_HEADING && visit.leaving) {
+            mm_walker_skip(&walker);
+        }
+    }
+    result = mm_walker_finish(&walker);
+    assert(result == 0);
+    assert(entered == 2);
+    
+    // mm_walk() skips components on entry and stops on request
+    WalkTrace walked = { "", 0, 0 };
+    result = mm_walk(root, 0, trace_visit, &walked);
+    assert(result == 0);
+    assert(strcmp(walked.trace, "0:0:0 3:1:0 6:1:1 2:1:2") == 0);
+    WalkTrace stopped = { "", 0, 3 };
+    result = mm_walk(root, MM_WALK_ENTER | MM_WALK_LEAVE, trace_visit, &stopped);
+    assert(result == 1);
+    assert(strcmp(stopped.trace, "0:0:0 3:1:0 -3:1:0") == 0);
+    result = mm_walk(NULL, 0, trace_visit, &walked);
+    assert(result == -1);
+    free_node(root);
+    
+    // Lazy bodies are stand-in paragraphs of the walker
+    const char *input = "[[note]]\nBody text\n[[/note]]\n";
+    MMParseOptions lazy_options = { NULL, MM_PARSE_VIEW | MM_PARSE_LAZY, 0 };
+    Document *doc = mm_parse_document(NULL, input, strlen(input), &lazy_options);
+    assert(doc != NULL);
+    walk_trace(doc->root, MM_WALK_ENTER, &walker, trace, sizeof(trace));
+    assert(strcmp(trace, "+0/0 +6/1") == 0);
+    walk_trace(doc->root, MM_WALK_ENTER | MM_WALK_LAZY, &walker, trace, sizeof(trace));
+    assert(strcmp(trace, "+0/0 +6/1 +2/2") == 0);
+    mm_walker_init(&walker, doc->root, MM_WALK_ENTER | MM_WALK_LAZY);
+    while ((node = mm_walker_next(&walker, &visit)) && visit.depth < 2) {
+    }
+    size_t length;
+    const char *body = mm_node_text(doc, node, &length);
+    assert(node != NULL && length == 10 && strncmp(body, "Body text\n", length) == 0);
+    result = mm_walker_finish(&walker);
+    assert(result == 0);
+    free_document(doc);
+    
+    // A chain of nested components far deeper than any C stack would allow
+    // a recursive walk on a worker thread
+    size_t depth = 200000;
+    Document *deep = parse_metamark("# Deep\n");
+    assert(deep != NULL);
+    Node *parent = deep->root;
+    for (size_t i = 0; i < depth; i++) {
+        Node *child = create_node(NODE_COMPONENT, "box");
+        assert(child != NULL);
+        add_child(parent, child);
+        parent = child;
+    }
+    add_child(parent, create_node(NODE_PARAGRAPH, "core"));
+    
+    size_t deepest = 0;
+    mm_walker_init(&walker, deep->root, MM_WALK_ENTER);
+    while ((node = mm_walker_next(&walker, &visit))) {
+        deepest = visit.depth;
+    }
+    result = mm_walker_finish(&walker);
+    assert(result == 0);
+    assert(deepest == depth + 1);
+    assert(mm_node_hash(deep, deep->root) != 0);
+    
+    char *html = render_metamark_html(deep);
+    assert(html != NULL && strstr(html, "<p>core</p>") != NULL);
+    free(html);
+    RenderCapture json = { NULL, 0, 0, 0 };
+    result = mm_write_json(deep, MM_JSON_COMPACT, capture_render, &json);
+    assert(result == 0);
+    assert(json.data != NULL && strstr(json.data, "\"content\":\"core\"}]}") != NULL);
+    free(json.data);
+    size_t encoded_size = 0;
+    unsigned char *encoded = mm_snapshot_encode(deep, 0, &encoded_size);
+    assert(encoded != NULL);
+    MMSnapshot *snapshot = mm_snapshot_from_buffer(encoded, encoded_size);
+    assert(snapshot != NULL && mm_snapshot_node_count(snapshot) == depth + 3);
+    mm_snapshot_close(snapshot);
+    mm_free(encoded);
+    MMFrozenDocument *frozen = mm_document_freeze(deep);
+    assert(frozen != NULL);
+    assert(frozen->count == depth + 3 && frozen->subtree_end[0] == depth + 3);
+    assert(frozen->next_sibling[1] == 2 && frozen->depths[depth + 2] == depth + 1);
+    mm_frozen_free(frozen);
+    free_document(deep);
+    
+    printf("Tree walk test passed\n");
+}
+
 int main(void) {
     printf("Running MetaMark parser tests...\n\n");
     
     test_metadata();
+    test_metadata_index();
     test_ast_structure();
     test_error_handling();
     test_complex_document();
     test_edge_cases();
+    test_arena();
+    test_view();
+    test_trace();
+    test_stream();
+    test_events();
+    test_mapped_file();
+    test_scan();
+    test_context();
+    test_batch();
+    test_parallel();
+    test_reparse();
+    test_html();
+    test_json();
+    test_snapshot();
+    test_freeze();
+    test_lazy();
+    test_stats();
+    test_flat();
+    test_cache();
+    test_diff();
+    test_pdf();
+    test_adversarial();
+    test_index();
+    test_walk();
     
     printf("\nAll tests passed!\n");
     return 0;
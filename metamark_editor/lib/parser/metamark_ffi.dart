@@ -1,15 +1,31 @@
+import 'dart:convert';
 import 'dart:ffi';
 import 'dart:io';
+import 'dart:typed_data';
 import 'package:ffi/ffi.dart';
 
-// Define the Node structure that matches the C struct
-class Node extends Struct {
-  external Pointer<Utf8> type;
-  external Pointer<Utf8> content;
-  external Pointer<Node> next;
-  external Pointer<Node> child;
+/// Node types, in the order of the C `NodeType` enum
+enum MetaMarkNodeType {
+  document,
+  metadata,
+  paragraph,
+  heading,
+  annotation,
+  comment,
+  component,
+  collapsible,
+  diagram,
+  math,
+  secure,
 }
 
+// Layout of the flat buffer written by mm_flat_parse(), see metamark.h
+const int _headerSize = 64;
+const int _nodeSize = 32;
+const int _pairSize = 16;
+const int _formatVersion = 1;
+const List<int> _magic = [0x4d, 0x4d, 0x53, 0x4e, 0x41, 0x50, 0, 0]; // "MMSNAP\0\0"
+
 // Define the library name based on the platform
 String _getLibraryName() {
   if (Platform.isWindows) {
@@ -21,57 +37,271 @@ String _getLibraryName() {
   }
 }
 
+/// One node of a [MetaMarkDocument], decoded from its record on access
+class MetaMarkNode {
+  final MetaMarkDocument _document;
+
+  /// Index of the node in the document, 0 for the root
+  final int index;
+
+  MetaMarkNode._(this._document, this.index);
+
+  int get _record => _document._nodesOffset + index * _nodeSize;
+
+  int _u32(int offset) => _document._data.getUint32(_record + offset, Endian.little);
+
+  MetaMarkNodeType get type {
+    final raw = _document._data.getUint16(_record, Endian.little);
+    return raw < MetaMarkNodeType.values.length
+        ? MetaMarkNodeType.values[raw]
+        : MetaMarkNodeType.paragraph;
+  }
+
+  /// Heading level
+  int get level => _document._data.getUint16(_record + 2, Endian.little);
+
+  /// Byte offset of the content in the UTF-8 source
+  int get sourceOffset => _u32(24);
+
+  int get childCount => _u32(12);
+
+  /// Text of the node, or null if it has none
+  String? get content {
+    if (_u32(4) & 1 == 0) {
+      return null;
+    }
+    return _document._string(_u32(16), _u32(20));
+  }
+
+  /// Children in document order; they are consecutive records
+  Iterable<MetaMarkNode> get children sync* {
+    final first = _u32(8);
+    final count = childCount;
+    for (var i = 0; i < count && first + i < _document.nodeCount; i++) {
+      yield MetaMarkNode._(_document, first + i);
+    }
+  }
+}
+
+/// A parsed document, read in place from the one buffer the parser returns
+///
+/// Nodes and strings are decoded from the native memory when accessed, so
+/// reading the tree makes no FFI calls. Call [dispose] to release the
+/// buffer; nodes must not be used afterwards.
+class MetaMarkDocument {
+  Pointer<Uint8> _buffer;
+  final ByteData _data;
+  final Uint8List _bytes;
+  final int nodeCount;
+  final int _nodesOffset;
+  final int _metadataCount;
+  final int _metadataOffset;
+  final int _poolOffset;
+
+  MetaMarkDocument._(this._buffer, this._bytes, this._data, this.nodeCount,
+      this._nodesOffset, this._metadataCount, this._metadataOffset, this._poolOffset);
+
+  factory MetaMarkDocument._fromBuffer(Pointer<Uint8> buffer, int size) {
+    final bytes = buffer.asTypedList(size);
+    final data = ByteData.sublistView(bytes);
+    if (size < _headerSize ||
+        !_matchesMagic(bytes) ||
+        data.getUint32(8, Endian.little) != _formatVersion) {
+      MetaMarkFFI._free(buffer.cast());
+      throw const FormatException('Unsupported MetaMark buffer');
+    }
+
+    // Offsets are 64-bit in the header but buffers stay below 4 GiB
+    return MetaMarkDocument._(
+      buffer,
+      bytes,
+      data,
+      data.getUint32(16, Endian.little),
+      data.getUint32(40, Endian.little),
+      data.getUint32(20, Endian.little),
+      data.getUint32(48, Endian.little),
+      data.getUint32(56, Endian.little),
+    );
+  }
+
+  static bool _matchesMagic(Uint8List bytes) {
+    for (var i = 0; i < _magic.length; i++) {
+      if (bytes[i] != _magic[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  String _string(int offset, int length) {
+    final start = _poolOffset + offset;
+    return utf8.decode(Uint8List.sublistView(_bytes, start, start + length),
+        allowMalformed: true);
+  }
+
+  MetaMarkNode get root => MetaMarkNode._(this, 0);
+
+  /// Frontmatter pairs in document order
+  Map<String, String> get metadata {
+    final result = <String, String>{};
+    for (var i = 0; i < _metadataCount; i++) {
+      final record = _metadataOffset + i * _pairSize;
+      final key = _string(_data.getUint32(record, Endian.little),
+          _data.getUint32(record + 4, Endian.little));
+      result.putIfAbsent(key, () => _string(_data.getUint32(record + 8, Endian.little),
+          _data.getUint32(record + 12, Endian.little)));
+    }
+    return result;
+  }
+
+  /// Releases the buffer with a single call into the library
+  void dispose() {
+    if (_buffer != nullptr) {
+      MetaMarkFFI._free(_buffer.cast());
+      _buffer = nullptr;
+    }
+  }
+}
+
+/// One changed run of top-level blocks, as found by [MetaMarkFFI.diff]
+///
+/// Blocks [oldFirst, oldFirst + oldCount) of the old text were replaced by
+/// blocks [newFirst, newFirst + newCount) of the new one.
+class MetaMarkDiffHunk {
+  final int oldFirst;
+  final int oldCount;
+  final int newFirst;
+  final int newCount;
+
+  const MetaMarkDiffHunk(this.oldFirst, this.oldCount, this.newFirst, this.newCount);
+}
+
 class MetaMarkFFI {
-  static final DynamicLibrary _lib = DynamicLibrary.open(_getLibraryName());
-  
+  static DynamicLibrary? _library;
+  static bool _loadFailed = false;
+
+  static DynamicLibrary get _lib => _library ??= DynamicLibrary.open(_getLibraryName());
+
+  /// Whether the native library could be loaded
+  static bool get isAvailable {
+    if (_library != null) {
+      return true;
+    }
+    if (_loadFailed) {
+      return false;
+    }
+    try {
+      _lib;
+      return true;
+    } on ArgumentError {
+      _loadFailed = true;
+      return false;
+    }
+  }
+
   // Function signatures
+  static final _flatParse = _lib.lookupFunction<
+    Pointer<Uint8> Function(Pointer<Uint8>, IntPtr, Pointer<IntPtr>),
+    Pointer<Uint8> Function(Pointer<Uint8>, int, Pointer<IntPtr>)
+  >('mm_flat_parse');
+
+  static final _free = _lib.lookupFunction<
+    Void Function(Pointer<Void>),
+    void Function(Pointer<Void>)
+  >('mm_free');
+
+  static final _diffText = _lib.lookupFunction<
+    Pointer<IntPtr> Function(Pointer<Uint8>, IntPtr, Pointer<Uint8>, IntPtr, Pointer<IntPtr>),
+    Pointer<IntPtr> Function(Pointer<Uint8>, int, Pointer<Uint8>, int, Pointer<IntPtr>)
+  >('mm_diff_text');
+
   static final _parseMetamark = _lib.lookupFunction<
-    Pointer<Node> Function(Pointer<Utf8>),
-    Pointer<Node> Function(Pointer<Utf8>)
+    Pointer<Void> Function(Pointer<Utf8>),
+    Pointer<Void> Function(Pointer<Utf8>)
   >('parse_metamark');
 
   static final _renderMetamarkHtml = _lib.lookupFunction<
-    Pointer<Utf8> Function(Pointer<Node>),
-    Pointer<Utf8> Function(Pointer<Node>)
+    Pointer<Utf8> Function(Pointer<Void>),
+    Pointer<Utf8> Function(Pointer<Void>)
   >('render_metamark_html');
 
-  static final _freeAst = _lib.lookupFunction<
-    Void Function(Pointer<Node>),
-    void Function(Pointer<Node>)
-  >('free_ast');
+  static final _freeDocument = _lib.lookupFunction<
+    Void Function(Pointer<Void>),
+    void Function(Pointer<Void>)
+  >('free_document');
 
-  /// Parses a MetaMark string and returns a pointer to the AST
-  static Pointer<Node> parseMetamark(String input) {
-    final inputPtr = input.toNativeUtf8();
+  /// Parses a MetaMark string, or returns null if it holds no document
+  static MetaMarkDocument? parse(String input) {
+    final bytes = utf8.encode(input);
+    final inputPtr = malloc<Uint8>(bytes.isEmpty ? 1 : bytes.length);
+    final sizePtr = malloc<IntPtr>();
     try {
-      return _parseMetamark(inputPtr);
+      inputPtr.asTypedList(bytes.length).setAll(0, bytes);
+      final buffer = _flatParse(inputPtr, bytes.length, sizePtr);
+      if (buffer == nullptr) {
+        return null;
+      }
+      return MetaMarkDocument._fromBuffer(buffer, sizePtr.value);
     } finally {
-      calloc.free(inputPtr);
+      malloc.free(inputPtr);
+      malloc.free(sizePtr);
     }
   }
 
-  /// Renders the AST to HTML
-  static String renderMetamarkHtml(Pointer<Node> ast) {
-    final resultPtr = _renderMetamarkHtml(ast);
+  static Pointer<Uint8> _copyBytes(List<int> bytes) {
+    final pointer = malloc<Uint8>(bytes.isEmpty ? 1 : bytes.length);
+    pointer.asTypedList(bytes.length).setAll(0, bytes);
+    return pointer;
+  }
+
+  /// Compares two texts block by block, or returns null on error
+  ///
+  /// Unchanged blocks are matched by structural hash, so the cost follows
+  /// the number of changed blocks rather than the document size.
+  static List<MetaMarkDiffHunk>? diff(String oldText, String newText) {
+    final oldBytes = utf8.encode(oldText);
+    final newBytes = utf8.encode(newText);
+    final oldPtr = _copyBytes(oldBytes);
+    final newPtr = _copyBytes(newBytes);
+    final countPtr = malloc<IntPtr>();
     try {
-      return resultPtr.toDartString();
+      final hunks = _diffText(oldPtr, oldBytes.length, newPtr, newBytes.length, countPtr);
+      if (hunks == nullptr) {
+        return null;
+      }
+      final result = [
+        for (var i = 0; i < countPtr.value; i++)
+          MetaMarkDiffHunk(hunks[i * 4], hunks[i * 4 + 1], hunks[i * 4 + 2], hunks[i * 4 + 3]),
+      ];
+      _free(hunks.cast());
+      return result;
     } finally {
-      calloc.free(resultPtr);
+      malloc.free(oldPtr);
+      malloc.free(newPtr);
+      malloc.free(countPtr);
     }
   }
 
-  /// Frees the AST memory
-  static void freeAst(Pointer<Node> ast) {
-    _freeAst(ast);
-  }
-
-  /// Convenience method to parse and render in one step
+  /// Parses a MetaMark string and renders it to HTML
   static String parseAndRender(String input) {
-    final ast = parseMetamark(input);
+    final inputPtr = input.toNativeUtf8();
     try {
-      return renderMetamarkHtml(ast);
+      final doc = _parseMetamark(inputPtr);
+      if (doc == nullptr) {
+        return '';
+      }
+      final resultPtr = _renderMetamarkHtml(doc);
+      _freeDocument(doc);
+      if (resultPtr == nullptr) {
+        return '';
+      }
+      try {
+        return resultPtr.toDartString();
+      } finally {
+        _free(resultPtr.cast());
+      }
     } finally {
-      freeAst(ast);
+      malloc.free(inputPtr);
     }
   }
-} 
\ No newline at end of file
+}
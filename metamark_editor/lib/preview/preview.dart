@@ -2,6 +2,7 @@ import 'package:flutter/material.dart';
 import 'package:flutter_markdown/flutter_markdown.dart';
 import 'package:flutter_math_fork/flutter_math.dart';
 import 'package:markdown/markdown.dart' as md;
+import '../parser/metamark_ffi.dart';
 
 class PreviewPane extends StatelessWidget {
   final String content;
@@ -47,8 +48,31 @@ class PreviewPane extends StatelessWidget {
                     minWidth: constraints.maxWidth - 32,
                     maxWidth: constraints.maxWidth - 32,
                   ),
-                  child: Markdown(
-                    data: content.isEmpty ? '''
+                  child: _buildContent(context),
+                ),
+              );
+            },
+          ),
+        ),
+      ],
+    );
+  }
+
+  // Native tree when the library is loaded, Markdown otherwise
+  Widget _buildContent(BuildContext context) {
+    if (content.isNotEmpty && MetaMarkFFI.isAvailable) {
+      final doc = MetaMarkFFI.parse(content);
+      if (doc != null) {
+        try {
+          return NativeDocumentView.fromDocument(context, doc);
+        } finally {
+          doc.dispose();
+        }
+      }
+    }
+
+    return Markdown(
+      data: content.isEmpty ? '''
 # Welcome to MetaMark Editor
 
 This is a preview of your MetaMark content. The preview will update in real-time as you edit the file.
@@ -77,21 +101,14 @@ This is a collapsible section.
 This is an encrypted block.
 [[/secure]]
 ''' : content,
-                    builders: {
-                      'math': MathElementBuilder(),
-                      'component': ComponentBuilder(),
-                      'collapse': CollapseBuilder(),
-                      'secure': SecureBlockBuilder(),
-                    },
-                    shrinkWrap: true,
-                    selectable: true,
-                  ),
-                ),
-              );
-            },
-          ),
-        ),
-      ],
+      builders: {
+        'math': MathElementBuilder(),
+        'component': ComponentBuilder(),
+        'collapse': CollapseBuilder(),
+        'secure': SecureBlockBuilder(),
+      },
+      shrinkWrap: true,
+      selectable: true,
     );
   }
 }
@@ -144,23 +161,128 @@ class CollapseBuilder extends MarkdownElementBuilder {
   }
 }
 
+// Encrypted content is never shown
+Widget _secureCard() {
+  return ConstrainedBox(
+    constraints: const BoxConstraints(minWidth: double.infinity),
+    child: Card(
+      color: Colors.grey[200],
+      child: const Padding(
+        padding: EdgeInsets.all(16),
+        child: Row(
+          children: [
+            Icon(Icons.lock),
+            SizedBox(width: 8),
+            Expanded(child: Text('Encrypted Content')),
+          ],
+        ),
+      ),
+    ),
+  );
+}
+
 class SecureBlockBuilder extends MarkdownElementBuilder {
   @override
   Widget? visitElementAfter(md.Element element, TextStyle? preferredStyle) {
-    return ConstrainedBox(
-      constraints: const BoxConstraints(minWidth: double.infinity),
-      child: Card(
-        color: Colors.grey[200],
-        child: const Padding(
-          padding: EdgeInsets.all(16),
-          child: Row(
+    return _secureCard();
+  }
+}
+
+/// Preview built from the native parser's tree
+///
+/// The widgets are created from the document up front and copy what they
+/// show, so the document can be disposed as soon as this returns.
+class NativeDocumentView extends StatelessWidget {
+  final List<Widget> blocks;
+
+  const NativeDocumentView({super.key, required this.blocks});
+
+  factory NativeDocumentView.fromDocument(BuildContext context, MetaMarkDocument doc) {
+    return NativeDocumentView(blocks: _buildNodes(context, doc.root.children));
+  }
+
+  static List<Widget> _buildNodes(BuildContext context, Iterable<MetaMarkNode> nodes) {
+    final widgets = <Widget>[];
+    for (final node in nodes) {
+      final widget = _buildNode(context, node);
+      if (widget != null) {
+        widgets.add(Padding(
+          padding: const EdgeInsets.only(bottom: 12),
+          child: widget,
+        ));
+      }
+    }
+    return widgets;
+  }
+
+  static Widget? _buildNode(BuildContext context, MetaMarkNode node) {
+    final textTheme = Theme.of(context).textTheme;
+    final text = node.content ?? '';
+
+    switch (node.type) {
+      case MetaMarkNodeType.heading:
+        final style = node.level <= 1
+            ? textTheme.headlineMedium
+            : node.level == 2 ? textTheme.titleLarge : textTheme.titleMedium;
+        return Text(text, style: style);
+      case MetaMarkNodeType.paragraph:
+        return Text(text, style: textTheme.bodyMedium);
+      case MetaMarkNodeType.math:
+        return Math.tex(text, textStyle: textTheme.bodyMedium, textScaleFactor: 1.2);
+      case MetaMarkNodeType.secure:
+        return _secureCard();
+      case MetaMarkNodeType.component:
+        if (text == 'secure') {
+          return _secureCard();
+        }
+        return ConstrainedBox(
+          constraints: const BoxConstraints(minWidth: double.infinity),
+          child: Card(
+            child: Padding(
+              padding: const EdgeInsets.all(16),
+              child: Column(
+                crossAxisAlignment: CrossAxisAlignment.start,
+                children: _buildNodes(context, node.children),
+              ),
+            ),
+          ),
+        );
+      case MetaMarkNodeType.collapsible:
+        return ExpansionTile(
+          title: Text(text.isEmpty ? 'Collapsible Section' : text),
+          children: _buildNodes(context, node.children),
+        );
+      case MetaMarkNodeType.annotation:
+        return Container(
+          padding: const EdgeInsets.only(left: 12),
+          decoration: BoxDecoration(
+            border: Border(
+              left: BorderSide(color: Theme.of(context).colorScheme.primary, width: 3),
+            ),
+          ),
+          child: Column(
+            crossAxisAlignment: CrossAxisAlignment.start,
             children: [
-              Icon(Icons.lock),
-              SizedBox(width: 8),
-              Expanded(child: Text('Encrypted Content')),
+              if (text.isNotEmpty) Text(text, style: textTheme.labelLarge),
+              ..._buildNodes(context, node.children),
             ],
           ),
-        ),
+        );
+      case MetaMarkNodeType.metadata:
+      case MetaMarkNodeType.comment:
+        return null;
+      default:
+        final children = _buildNodes(context, node.children);
+        return children.isEmpty ? null : Column(children: children);
+    }
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    return SelectionArea(
+      child: Column(
+        crossAxisAlignment: CrossAxisAlignment.start,
+        children: blocks,
       ),
     );
   }